@@ -0,0 +1,261 @@
+// Barcode rasterizer benchmark
+//
+// Encodes and draws Code128, GS1-128, Data Matrix and QR symbols into a 4x6"
+// gray label at 203 DPI, the way template merge jobs put barcodes into the
+// band buffer, and checks that every module came out the same width.
+//
+// Built with -DBARCODE_BENCH_PDFIUM and linked against pdfium, it also runs
+// the PDF-vector path for comparison: the same modules as rectangle path
+// objects (0.33 mm modules, as an upstream PDF would specify them) on a page
+// rendered through pdfium, thresholded at 128 like the raw pipeline.
+//
+// Usage: barcode_bench [iterations]
+
+#include "barcode.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef BARCODE_BENCH_PDFIUM
+#include "fpdfview.h"
+#include "fpdf_edit.h"
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static const int kDpi = 203;
+static const int kLabelWidth = 812;    // 4" at 203 DPI
+static const int kLabelHeight = 1218;  // 6" at 203 DPI
+static const double kModuleMm = 0.33;
+static const double kBarHeightMm = 15;
+static const int kOriginX = 40;
+static const int kOriginY = 40;
+
+struct BenchCase {
+    const char* name;
+    BarcodeType type;
+    const char* data;
+};
+
+static const BenchCase kCases[] = {
+    { "code128", BARCODE_CODE128, "SHIP-0012345678-ABC" },
+    { "gs1_128", BARCODE_GS1_128, "(00)123456789012345675(420)94043" },
+    { "datamatrix", BARCODE_DATAMATRIX, "https://example.com/p/12345678" },
+    { "qr_m", BARCODE_QR, "https://example.com/p/12345678" }
+};
+
+static double ElapsedUs(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+static bool IsLinear(const BarcodeSymbol& symbol) {
+    return symbol.type == BARCODE_CODE128 || symbol.type == BARCODE_GS1_128;
+}
+
+// Scan the middle pixel row of every module row and compare its dark/light
+// runs with the symbol's. Reports the narrowest and widest single-module run
+// and the rows whose run count does not match at all.
+struct ModuleCheck {
+    int narrowMin = 1 << 30;
+    int narrowMax = 0;
+    int brokenRows = 0;
+};
+
+static ModuleCheck CheckModules(const BarcodeSymbol& symbol, const std::vector<unsigned char>& gray,
+                                double modulePixels, double rowPixels) {
+    ModuleCheck check;
+    int left = kOriginX - 2;
+    int right = std::min(kLabelWidth, (int)(kOriginX + symbol.columns * modulePixels) + 3);
+    for (int row = 0; row < symbol.rows; row++) {
+        const unsigned char* modules = &symbol.modules[(size_t)row * symbol.columns];
+        std::vector<int> moduleRuns;
+        for (int col = 0; col < symbol.columns;) {
+            int end = col;
+            while (end < symbol.columns && modules[end] == modules[col]) {
+                end++;
+            }
+            moduleRuns.push_back(end - col);
+            col = end;
+        }
+
+        int y = kOriginY + (int)((row + 0.5) * rowPixels);
+        const unsigned char* line = &gray[(size_t)y * kLabelWidth];
+        int x = left;
+        while (x < right && line[x] >= 128) {
+            x++;
+        }
+        std::vector<int> pixelRuns;
+        while (x < right) {
+            bool dark = line[x] < 128;
+            int end = x;
+            while (end < right && (line[end] < 128) == dark) {
+                end++;
+            }
+            pixelRuns.push_back(end - x);
+            x = end;
+        }
+        // The trailing run is quiet zone (or a light module followed by it)
+        if (!pixelRuns.empty() && pixelRuns.size() % 2 == 0) {
+            pixelRuns.pop_back();
+        }
+        if (modules[symbol.columns - 1] == 0) {
+            moduleRuns.pop_back();
+        }
+        if (modules[0] == 0) {
+            moduleRuns.erase(moduleRuns.begin());
+        }
+        if (pixelRuns.size() != moduleRuns.size()) {
+            check.brokenRows++;
+            continue;
+        }
+        for (size_t i = 0; i < moduleRuns.size(); i++) {
+            if (moduleRuns[i] == 1) {
+                check.narrowMin = std::min(check.narrowMin, pixelRuns[i]);
+                check.narrowMax = std::max(check.narrowMax, pixelRuns[i]);
+            }
+        }
+    }
+    return check;
+}
+
+static void PrintResult(const char* path, const BenchCase& bench, const BarcodeSymbol& symbol, int iterations,
+                        double prepareUs, double drawUs, const ModuleCheck& check, bool last) {
+    printf("    {\"name\": \"%s_%s\", \"iterations\": %d, \"modules\": \"%dx%d\", "
+           "\"prepare_us\": %.2f, \"draw_us\": %.2f, \"narrow_min_px\": %d, \"narrow_max_px\": %d, "
+           "\"broken_rows\": %d}%s\n",
+           bench.name, path, iterations, symbol.columns, symbol.rows, prepareUs / iterations, drawUs / iterations,
+           check.narrowMax ? check.narrowMin : 0, check.narrowMax, check.brokenRows, last ? "" : ",");
+}
+
+// Native path: encode, then draw whole modules straight into the gray buffer
+static void RunNative(const BenchCase& bench, int iterations, bool last) {
+    double scale = kDpi / 25.4;
+    int modulePixels = std::max(1, (int)(kModuleMm * scale + 0.5));
+    int barHeight = (int)(kBarHeightMm * scale + 0.5);
+    std::vector<unsigned char> gray((size_t)kLabelWidth * kLabelHeight, 255);
+
+    BarcodeTarget target;
+    target.buffer = gray.data();
+    target.width = kLabelWidth;
+    target.height = kLabelHeight;
+    target.stride = kLabelWidth;
+    target.pageWidth = kLabelWidth;
+    target.pageHeight = kLabelHeight;
+
+    BarcodeSymbol symbol;
+    std::string error;
+    double encodeUs = 0;
+    double drawUs = 0;
+    for (int i = 0; i < iterations; i++) {
+        Clock::time_point start = Clock::now();
+        if (!Barcode::Encode(bench.type, bench.data, 1, &symbol, &error)) {
+            fprintf(stderr, "%s: %s\n", bench.name, error.c_str());
+            exit(1);
+        }
+        Clock::time_point encoded = Clock::now();
+        Barcode::Draw(symbol, kOriginX, kOriginY, modulePixels, barHeight, target);
+        Clock::time_point drawn = Clock::now();
+        encodeUs += ElapsedUs(start, encoded);
+        drawUs += ElapsedUs(encoded, drawn);
+    }
+
+    ModuleCheck check = CheckModules(symbol, gray, modulePixels, IsLinear(symbol) ? barHeight : modulePixels);
+    PrintResult("native", bench, symbol, iterations, encodeUs, drawUs, check, last);
+}
+
+#ifdef BARCODE_BENCH_PDFIUM
+// Vector path: one rectangle per dark run on a 4x6" page, rendered by pdfium
+static void RunVector(const BenchCase& bench, int iterations, bool last) {
+    BarcodeSymbol symbol;
+    std::string error;
+    if (!Barcode::Encode(bench.type, bench.data, 1, &symbol, &error)) {
+        fprintf(stderr, "%s: %s\n", bench.name, error.c_str());
+        exit(1);
+    }
+    double pointsPerPixel = 72.0 / kDpi;
+    float module = (float)(kModuleMm * 72 / 25.4);
+    float rowHeight = IsLinear(symbol) ? (float)(kBarHeightMm * 72 / 25.4) : module;
+    float pageHeight = (float)(kLabelHeight * pointsPerPixel);
+    float left = (float)(kOriginX * pointsPerPixel);
+    float top = (float)(kOriginY * pointsPerPixel);
+
+    std::vector<unsigned char> gray((size_t)kLabelWidth * kLabelHeight, 255);
+    double buildUs = 0;
+    double renderUs = 0;
+    for (int i = 0; i < iterations; i++) {
+        Clock::time_point start = Clock::now();
+        FPDF_DOCUMENT document = FPDF_CreateNewDocument();
+        FPDF_PAGE page = FPDFPage_New(document, 0, (float)(kLabelWidth * pointsPerPixel), pageHeight);
+        for (int row = 0; row < symbol.rows; row++) {
+            const unsigned char* modules = &symbol.modules[(size_t)row * symbol.columns];
+            for (int col = 0; col < symbol.columns;) {
+                if (!modules[col]) {
+                    col++;
+                    continue;
+                }
+                int end = col;
+                while (end < symbol.columns && modules[end]) {
+                    end++;
+                }
+                FPDF_PAGEOBJECT rect = FPDFPageObj_CreateNewRect(left + col * module,
+                                                                 pageHeight - top - (row + 1) * rowHeight,
+                                                                 (end - col) * module, rowHeight);
+                FPDFPageObj_SetFillColor(rect, 0, 0, 0, 255);
+                FPDFPath_SetDrawMode(rect, FPDF_FILLMODE_WINDING, 0);
+                FPDFPage_InsertObject(page, rect);
+                col = end;
+            }
+        }
+        FPDFPage_GenerateContent(page);
+        Clock::time_point built = Clock::now();
+
+        FPDF_BITMAP bitmap = FPDFBitmap_CreateEx(kLabelWidth, kLabelHeight, FPDFBitmap_Gray, gray.data(),
+                                                 kLabelWidth);
+        FPDFBitmap_FillRect(bitmap, 0, 0, kLabelWidth, kLabelHeight, 0xFFFFFFFF);
+        FPDF_RenderPageBitmap(bitmap, page, 0, 0, kLabelWidth, kLabelHeight, 0,
+                              FPDF_GRAYSCALE | FPDF_PRINTING | FPDF_NO_CATCH);
+        FPDFBitmap_Destroy(bitmap);
+        Clock::time_point rendered = Clock::now();
+
+        FPDF_ClosePage(page);
+        FPDF_CloseDocument(document);
+        buildUs += ElapsedUs(start, built);
+        renderUs += ElapsedUs(built, rendered);
+    }
+
+    ModuleCheck check = CheckModules(symbol, gray, module / pointsPerPixel, rowHeight / pointsPerPixel);
+    PrintResult("pdf_vector", bench, symbol, iterations, buildUs, renderUs, check, last);
+}
+#endif
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    if (iterations <= 0) {
+        iterations = 2000;
+    }
+#ifdef BARCODE_BENCH_PDFIUM
+    FPDF_InitLibrary();
+    const bool withVector = true;
+#else
+    const bool withVector = false;
+#endif
+
+    size_t count = sizeof(kCases) / sizeof(kCases[0]);
+    printf("{\n  \"dpi\": %d,\n  \"benchmarks\": [\n", kDpi);
+    for (size_t i = 0; i < count; i++) {
+        bool last = i + 1 == count;
+        RunNative(kCases[i], iterations, last && !withVector);
+#ifdef BARCODE_BENCH_PDFIUM
+        RunVector(kCases[i], std::max(1, iterations / 10), last);
+#endif
+    }
+    printf("  ]\n}\n");
+#ifdef BARCODE_BENCH_PDFIUM
+    FPDF_DestroyLibrary();
+#endif
+    return 0;
+}
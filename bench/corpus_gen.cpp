@@ -0,0 +1,617 @@
+// Synthetic PDF corpus generator
+//
+// Builds documents with pdfium's own edit API, so performance problems can be
+// reproduced without sharing customer files. Every page is made of the
+// content types that drive render cost:
+//   - text: lines of words in the standard 14 fonts, or in an embedded
+//     TrueType font
+//   - vector paths: filled and stroked curves with a given number of
+//     segments
+//   - images: generated RGB bitmaps of a given pixel size; with
+//     transparency they carry a soft mask
+//   - transparency: translucent shapes, half of them with a blend mode, so
+//     the page needs compositing
+//   - forms: a letterhead form XObject placed on the page several times
+// All content comes from a seeded generator, the creation date is left out
+// and the file ID is derived from the content, so the same parameters always
+// produce the same bytes. The output feeds bench/pipeline_bench, and a
+// parameter line can be attached to a bug report instead of the file.
+//
+// Usage: corpus_gen [options] <output.pdf>
+//        corpus_gen --corpus <directory>
+// Options (per page unless noted):
+//   --pages N          pages in the document (default 10)
+//   --page SIZE        letter, a4 or label (4x6"), default letter
+//   --text-lines N     lines of text (default 40)
+//   --fonts N          distinct standard fonts, used line by line (1-14, default 1)
+//   --font-file PATH   embed this TrueType font for every other line
+//   --paths N          vector paths (default 20)
+//   --path-segments N  curve segments per path (default 8)
+//   --images N         images (default 0)
+//   --image-size N     image width and height in pixels (default 600)
+//   --transparency N   translucent shapes; images get a soft mask (default 0)
+//   --forms N          placements of the letterhead form XObject (default 0)
+//   --seed N           generator seed (default 1)
+// --corpus writes a fixed set of documents covering each content type.
+
+#include "fpdfview.h"
+#include "fpdf_edit.h"
+#include "fpdf_ppo.h"
+#include "fpdf_save.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct CorpusOptions {
+    int pages = 10;
+    float pageWidth = 612;
+    float pageHeight = 792;
+    int textLines = 40;
+    int fonts = 1;
+    std::string fontFile;
+    int paths = 20;
+    int pathSegments = 8;
+    int images = 0;
+    int imageSize = 600;
+    int transparency = 0;
+    int forms = 0;
+    unsigned seed = 1;
+};
+
+static const char* const kStandardFonts[] = {
+    "Helvetica", "Times-Roman", "Courier", "Helvetica-Bold", "Times-Bold", "Courier-Bold", "Helvetica-Oblique",
+    "Times-Italic", "Courier-Oblique", "Helvetica-BoldOblique", "Times-BoldItalic", "Courier-BoldOblique",
+    "Symbol", "ZapfDingbats"
+};
+static const int kStandardFontCount = (int)(sizeof(kStandardFonts) / sizeof(kStandardFonts[0]));
+
+static const char* const kBlendModes[] = { "Multiply", "Screen", "Overlay", "Darken", "Lighten", "Difference" };
+
+static const char* const kWords[] = {
+    "invoice", "order", "shipment", "total", "quantity", "the", "of", "and", "item", "price", "customer",
+    "delivery", "address", "reference", "payment", "tax", "net", "due", "date", "account", "warehouse",
+    "carrier", "tracking", "unit", "package", "weight", "service", "balance", "description", "number"
+};
+static const int kWordCount = (int)(sizeof(kWords) / sizeof(kWords[0]));
+
+// Same LCG as the other benches, so sequences stay identical across platforms
+class Random {
+public:
+    explicit Random(unsigned seed) : m_state(seed) {}
+
+    unsigned Next() {
+        m_state = m_state * 1103515245 + 12345;
+        return m_state >> 16;
+    }
+
+    int Range(int from, int to) { return from + (int)(Next() % (unsigned)(to - from + 1)); }
+
+    float Uniform(float from, float to) { return from + (to - from) * (float)(Next() & 0x7FFF) / 32767.0f; }
+
+private:
+    unsigned m_state;
+};
+
+static std::vector<unsigned short> WideText(const std::string& text) {
+    std::vector<unsigned short> wide(text.begin(), text.end());
+    wide.push_back(0);
+    return wide;
+}
+
+static void AddText(FPDF_DOCUMENT document, FPDF_PAGE page, const CorpusOptions& options,
+                    const std::vector<FPDF_FONT>& fonts, Random& random) {
+    if (options.textLines <= 0 || fonts.empty()) {
+        return;
+    }
+    float margin = 36;
+    float lineHeight = (options.pageHeight - 2 * margin) / options.textLines;
+    float fontSize = std::min(12.0f, lineHeight * 0.8f);
+    int charsPerLine = (int)((options.pageWidth - 2 * margin) / (fontSize * 0.5f));
+    for (int line = 0; line < options.textLines; line++) {
+        std::string text;
+        while ((int)text.size() < charsPerLine - 12) {
+            text += kWords[random.Next() % kWordCount];
+            text += random.Next() % 7 == 0 ? " 4711 " : " ";
+        }
+        FPDF_PAGEOBJECT object = FPDFPageObj_CreateTextObj(document, fonts[line % fonts.size()], fontSize);
+        std::vector<unsigned short> wide = WideText(text);
+        FPDFText_SetText(object, wide.data());
+        FPDFPageObj_SetFillColor(object, 0, 0, random.Range(0, 80), 255);
+        FPDFPageObj_Transform(object, 1, 0, 0, 1, margin, options.pageHeight - margin - (line + 1) * lineHeight);
+        FPDFPage_InsertObject(page, object);
+    }
+}
+
+static FPDF_PAGEOBJECT NewCurve(const CorpusOptions& options, int segments, Random& random) {
+    float x = random.Uniform(0, options.pageWidth);
+    float y = random.Uniform(0, options.pageHeight);
+    float reach = std::min(options.pageWidth, options.pageHeight) / 4;
+    FPDF_PAGEOBJECT path = FPDFPageObj_CreateNewPath(x, y);
+    for (int i = 0; i < segments; i++) {
+        float x1 = x + random.Uniform(-reach, reach);
+        float y1 = y + random.Uniform(-reach, reach);
+        float x2 = x + random.Uniform(-reach, reach);
+        float y2 = y + random.Uniform(-reach, reach);
+        x = std::max(0.0f, std::min(options.pageWidth, x + random.Uniform(-reach, reach)));
+        y = std::max(0.0f, std::min(options.pageHeight, y + random.Uniform(-reach, reach)));
+        if (i % 3 == 2) {
+            FPDFPath_LineTo(path, x, y);
+        } else {
+            FPDFPath_BezierTo(path, x1, y1, x2, y2, x, y);
+        }
+    }
+    FPDFPath_Close(path);
+    return path;
+}
+
+// Drawn one component at a time: the order in which function arguments are
+// evaluated differs between compilers, and the output must not
+static unsigned int RandomColor(Random& random, int max) {
+    unsigned int red = (unsigned int)random.Range(0, max);
+    unsigned int green = (unsigned int)random.Range(0, max);
+    unsigned int blue = (unsigned int)random.Range(0, max);
+    return (red << 16) | (green << 8) | blue;
+}
+
+static void AddPaths(FPDF_PAGE page, const CorpusOptions& options, Random& random) {
+    for (int i = 0; i < options.paths; i++) {
+        FPDF_PAGEOBJECT path = NewCurve(options, std::max(1, options.pathSegments), random);
+        bool fill = i % 2 == 0;
+        unsigned int fillColor = RandomColor(random, 255);
+        unsigned int strokeColor = RandomColor(random, 128);
+        FPDFPageObj_SetFillColor(path, fillColor >> 16, (fillColor >> 8) & 0xFF, fillColor & 0xFF, 255);
+        FPDFPageObj_SetStrokeColor(path, strokeColor >> 16, (strokeColor >> 8) & 0xFF, strokeColor & 0xFF, 255);
+        FPDFPageObj_SetStrokeWidth(path, random.Uniform(0.25f, 3));
+        FPDFPath_SetDrawMode(path, fill ? FPDF_FILLMODE_WINDING : FPDF_FILLMODE_NONE, 1);
+        FPDFPage_InsertObject(page, path);
+    }
+}
+
+static void AddTransparency(FPDF_PAGE page, const CorpusOptions& options, Random& random) {
+    for (int i = 0; i < options.transparency; i++) {
+        FPDF_PAGEOBJECT path = NewCurve(options, 4, random);
+        unsigned int color = RandomColor(random, 255);
+        unsigned int alpha = (unsigned int)random.Range(60, 200);
+        FPDFPageObj_SetFillColor(path, color >> 16, (color >> 8) & 0xFF, color & 0xFF, alpha);
+        FPDFPath_SetDrawMode(path, FPDF_FILLMODE_ALTERNATE, 0);
+        if (i % 2 == 1) {
+            FPDFPageObj_SetBlendMode(path, kBlendModes[random.Next() % 6]);
+        }
+        FPDFPage_InsertObject(page, path);
+    }
+}
+
+// Smooth gradients with noise, so the image neither compresses to nothing
+// nor looks like random data to the renderer's resampler
+static FPDF_BITMAP NewImageBitmap(int size, bool alpha, Random& random) {
+    FPDF_BITMAP bitmap = FPDFBitmap_Create(size, size, alpha ? 1 : 0);
+    if (!bitmap) {
+        return nullptr;
+    }
+    unsigned char* pixels = (unsigned char*)FPDFBitmap_GetBuffer(bitmap);
+    int stride = FPDFBitmap_GetStride(bitmap);
+    int phase = random.Range(0, 255);
+    for (int y = 0; y < size; y++) {
+        unsigned char* row = pixels + (size_t)y * stride;
+        for (int x = 0; x < size; x++) {
+            int noise = (int)(random.Next() & 31);
+            row[x * 4 + 0] = (unsigned char)((x * 255 / size + phase + noise) & 0xFF);
+            row[x * 4 + 1] = (unsigned char)((y * 255 / size + noise) & 0xFF);
+            row[x * 4 + 2] = (unsigned char)(((x + y) * 127 / size + phase) & 0xFF);
+            // Opaque in the middle, fading out towards the corners
+            int dx = x - size / 2;
+            int dy = y - size / 2;
+            int edge = 255 - (int)((long long)(dx * dx + dy * dy) * 255 / ((long long)size * size / 2));
+            row[x * 4 + 3] = (unsigned char)(alpha ? std::max(0, std::min(255, edge)) : 255);
+        }
+    }
+    return bitmap;
+}
+
+static bool AddImages(FPDF_DOCUMENT document, FPDF_PAGE page, const CorpusOptions& options, Random& random) {
+    for (int i = 0; i < options.images; i++) {
+        FPDF_BITMAP bitmap = NewImageBitmap(options.imageSize, options.transparency > 0, random);
+        FPDF_PAGEOBJECT image = bitmap ? FPDFPageObj_NewImageObj(document) : nullptr;
+        if (!image || !FPDFImageObj_SetBitmap(nullptr, 0, image, bitmap)) {
+            if (image) {
+                FPDFPageObj_Destroy(image);
+            }
+            if (bitmap) {
+                FPDFBitmap_Destroy(bitmap);
+            }
+            return false;
+        }
+        FPDFBitmap_Destroy(bitmap);
+        float width = random.Uniform(options.pageWidth / 4, options.pageWidth / 2);
+        float x = random.Uniform(0, options.pageWidth - width);
+        float y = random.Uniform(0, options.pageHeight - width);
+        FPDFImageObj_SetMatrix(image, width, 0, 0, width, x, y);
+        FPDFPage_InsertObject(page, image);
+    }
+    return true;
+}
+
+// A letterhead: logo shape, rules and an address block, on a page of its own
+// document so it can be turned into a form XObject
+static FPDF_DOCUMENT NewFormSource(const CorpusOptions& options, FPDF_FONT* font) {
+    FPDF_DOCUMENT source = FPDF_CreateNewDocument();
+    if (!source) {
+        return nullptr;
+    }
+    float width = options.pageWidth;
+    float height = 72;
+    FPDF_PAGE page = FPDFPage_New(source, 0, width, height);
+    for (int i = 0; i < 6; i++) {
+        FPDF_PAGEOBJECT petal = FPDFPageObj_CreateNewPath(36, 36);
+        FPDFPath_BezierTo(petal, 36 + 10 * i, 70, 70, 10 * i, 36, 36);
+        FPDFPageObj_SetFillColor(petal, 30 * i, 90, 200 - 20 * i, 255);
+        FPDFPath_SetDrawMode(petal, FPDF_FILLMODE_WINDING, 0);
+        FPDFPage_InsertObject(page, petal);
+    }
+    FPDF_PAGEOBJECT rule = FPDFPageObj_CreateNewRect(80, 8, width - 116, 1.5f);
+    FPDFPageObj_SetFillColor(rule, 0, 0, 0, 255);
+    FPDFPath_SetDrawMode(rule, FPDF_FILLMODE_WINDING, 0);
+    FPDFPage_InsertObject(page, rule);
+
+    *font = FPDFText_LoadStandardFont(source, "Helvetica-Bold");
+    const char* const lines[] = { "Example Logistics Ltd.", "1 Harbour Road, Dock 7", "+1 555 0100" };
+    for (int i = 0; i < 3; i++) {
+        FPDF_PAGEOBJECT text = FPDFPageObj_CreateTextObj(source, *font, i == 0 ? 14.0f : 8.0f);
+        std::vector<unsigned short> wide = WideText(lines[i]);
+        FPDFText_SetText(text, wide.data());
+        FPDFPageObj_Transform(text, 1, 0, 0, 1, 80, 52 - i * 14);
+        FPDFPage_InsertObject(page, text);
+    }
+    FPDFPage_GenerateContent(page);
+    FPDF_ClosePage(page);
+    return source;
+}
+
+static void AddForms(FPDF_PAGE page, FPDF_XOBJECT form, const CorpusOptions& options, Random& random) {
+    for (int i = 0; i < options.forms; i++) {
+        FPDF_PAGEOBJECT object = FPDF_NewFormObjectFromXObject(form);
+        if (!object) {
+            return;
+        }
+        // The first placement is the page header, the rest are scattered stamps
+        double scale = i == 0 ? 1.0 : random.Uniform(0.3f, 0.8f);
+        double x = i == 0 ? 0 : random.Uniform(0, options.pageWidth / 2);
+        double y = i == 0 ? options.pageHeight - 72 : random.Uniform(0, options.pageHeight - 72);
+        FPDFPageObj_Transform(object, scale, 0, 0, scale, x, y);
+        FPDFPage_InsertObject(page, object);
+    }
+}
+
+struct MemoryWriter : FPDF_FILEWRITE {
+    std::string data;
+};
+
+static int WriteBlock(FPDF_FILEWRITE* writer, const void* data, unsigned long size) {
+    static_cast<MemoryWriter*>(writer)->data.append((const char*)data, size);
+    return 1;
+}
+
+// pdfium seeds the trailer /ID from a heap address. Overwrite its hex digits
+// in place, byte offsets unchanged, with a hash of the rest of the file
+static bool StabilizeFileId(std::string* pdf) {
+    size_t id = pdf->rfind("/ID");
+    size_t end = id == std::string::npos ? std::string::npos : pdf->find(']', id);
+    if (end == std::string::npos) {
+        return id == std::string::npos;
+    }
+    std::vector<size_t> digits;
+    bool inHex = false;
+    for (size_t i = id + 3; i < end; i++) {
+        char c = (*pdf)[i];
+        if (c == '<' || c == '>') {
+            inHex = c == '<';
+        } else if (c == '(') {
+            return false;
+        } else if (inHex && isxdigit((unsigned char)c)) {
+            digits.push_back(i);
+            (*pdf)[i] = '0';
+        }
+    }
+    unsigned long long hash = 1469598103934665603ULL;
+    for (unsigned char c : *pdf) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    static const char kHex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < digits.size(); i++) {
+        (*pdf)[digits[i]] = kHex[(hash >> ((i % 16) * 4)) & 0xF];
+    }
+    return true;
+}
+
+static bool ReadFile(const std::string& path, std::string* data) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data->append(buffer, read);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool Generate(const CorpusOptions& options, const std::string& outputPath, std::string* error) {
+    FPDF_DOCUMENT document = FPDF_CreateNewDocument();
+    if (!document) {
+        *error = "Failed to create document";
+        return false;
+    }
+
+    std::vector<FPDF_FONT> fonts;
+    int standardFonts = std::max(1, std::min(kStandardFontCount, options.fonts));
+    std::string fontData;
+    FPDF_FONT embedded = nullptr;
+    if (!options.fontFile.empty()) {
+        if (!ReadFile(options.fontFile, &fontData)) {
+            *error = "Failed to read font file: " + options.fontFile;
+            FPDF_CloseDocument(document);
+            return false;
+        }
+        embedded = FPDFText_LoadFont(document, (const uint8_t*)fontData.data(), (uint32_t)fontData.size(),
+                                     FPDF_FONT_TRUETYPE, 0);
+        if (!embedded) {
+            *error = "Failed to load font file: " + options.fontFile;
+            FPDF_CloseDocument(document);
+            return false;
+        }
+    }
+    for (int i = 0; i < standardFonts; i++) {
+        // Symbol and ZapfDingbats draw the same words as glyph soup, which is fine here
+        fonts.push_back(FPDFText_LoadStandardFont(document, kStandardFonts[i]));
+        if (embedded) {
+            fonts.push_back(embedded);
+        }
+    }
+
+    FPDF_FONT formFont = nullptr;
+    FPDF_DOCUMENT formSource = options.forms > 0 ? NewFormSource(options, &formFont) : nullptr;
+    FPDF_XOBJECT form = formSource ? FPDF_NewXObjectFromPage(document, formSource, 0) : nullptr;
+
+    Random random(options.seed);
+    bool ok = true;
+    for (int i = 0; i < options.pages && ok; i++) {
+        FPDF_PAGE page = FPDFPage_New(document, i, options.pageWidth, options.pageHeight);
+        if (!page) {
+            *error = "Failed to create page " + std::to_string(i + 1);
+            ok = false;
+            break;
+        }
+        // Back to front: images, vector art, translucent shapes, letterhead, text
+        if (!AddImages(document, page, options, random)) {
+            *error = "Failed to create image on page " + std::to_string(i + 1);
+            ok = false;
+        }
+        AddPaths(page, options, random);
+        AddTransparency(page, options, random);
+        if (form) {
+            AddForms(page, form, options, random);
+        }
+        AddText(document, page, options, fonts, random);
+        if (!FPDFPage_GenerateContent(page)) {
+            *error = "Failed to generate content of page " + std::to_string(i + 1);
+            ok = false;
+        }
+        FPDF_ClosePage(page);
+    }
+
+    MemoryWriter writer;
+    writer.version = 1;
+    writer.WriteBlock = WriteBlock;
+    if (ok && !FPDF_SaveAsCopy(document, &writer, FPDF_NO_INCREMENTAL)) {
+        *error = "Failed to save document";
+        ok = false;
+    }
+
+    if (form) {
+        FPDF_CloseXObject(form);
+    }
+    if (formFont) {
+        FPDFFont_Close(formFont);
+    }
+    if (formSource) {
+        FPDF_CloseDocument(formSource);
+    }
+    for (int i = 0; i < standardFonts; i++) {
+        FPDFFont_Close(fonts[embedded ? i * 2 : i]);
+    }
+    if (embedded) {
+        FPDFFont_Close(embedded);
+    }
+    FPDF_CloseDocument(document);
+    if (!ok) {
+        return false;
+    }
+
+    if (!StabilizeFileId(&writer.data)) {
+        fprintf(stderr, "%s: file ID left as written, output is not reproducible\n", outputPath.c_str());
+    }
+    FILE* file = fopen(outputPath.c_str(), "wb");
+    if (!file) {
+        *error = "Failed to open output file: " + outputPath;
+        return false;
+    }
+    bool written = fwrite(writer.data.data(), 1, writer.data.size(), file) == writer.data.size();
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        *error = "Failed to write output file: " + outputPath;
+        return false;
+    }
+    printf("%s: %d pages, %zu bytes\n", outputPath.c_str(), options.pages, writer.data.size());
+    return true;
+}
+
+static bool SetPageSize(const std::string& name, CorpusOptions* options) {
+    if (name == "letter") {
+        options->pageWidth = 612;
+        options->pageHeight = 792;
+    } else if (name == "a4") {
+        options->pageWidth = 595.28f;
+        options->pageHeight = 841.89f;
+    } else if (name == "label") {
+        options->pageWidth = 288;
+        options->pageHeight = 432;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// The standard corpus: one document per cost driver plus a mixed one
+static bool GenerateCorpus(const std::string& directory, std::string* error) {
+    struct CorpusEntry {
+        const char* name;
+        CorpusOptions options;
+    };
+    std::vector<CorpusEntry> entries;
+    CorpusOptions base;
+    base.pages = 10;
+    base.textLines = 0;
+    base.paths = 0;
+
+    CorpusEntry text = { "text_dense.pdf", base };
+    text.options.textLines = 60;
+    text.options.fonts = 4;
+    entries.push_back(text);
+
+    CorpusEntry vector = { "vector_complex.pdf", base };
+    vector.options.paths = 400;
+    vector.options.pathSegments = 24;
+    entries.push_back(vector);
+
+    CorpusEntry images = { "image_heavy.pdf", base };
+    images.options.pages = 4;
+    images.options.images = 4;
+    images.options.imageSize = 1200;
+    entries.push_back(images);
+
+    CorpusEntry transparency = { "transparency.pdf", base };
+    transparency.options.paths = 40;
+    transparency.options.transparency = 60;
+    transparency.options.images = 1;
+    entries.push_back(transparency);
+
+    CorpusEntry forms = { "forms.pdf", base };
+    forms.options.textLines = 30;
+    forms.options.forms = 8;
+    entries.push_back(forms);
+
+    CorpusEntry label = { "label_4x6.pdf", base };
+    label.options.pages = 50;
+    SetPageSize("label", &label.options);
+    label.options.textLines = 12;
+    label.options.paths = 30;
+    label.options.pathSegments = 2;
+    entries.push_back(label);
+
+    CorpusEntry mixed = { "mixed.pdf", CorpusOptions() };
+    mixed.options.pages = 20;
+    mixed.options.fonts = 3;
+    mixed.options.images = 1;
+    mixed.options.transparency = 4;
+    mixed.options.forms = 1;
+    entries.push_back(mixed);
+
+    std::error_code created;
+    std::filesystem::create_directories(directory, created);
+    if (created) {
+        *error = "Failed to create directory: " + directory;
+        return false;
+    }
+    for (const CorpusEntry& entry : entries) {
+        if (!Generate(entry.options, directory + "/" + entry.name, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void PrintUsage() {
+    fprintf(stderr,
+            "Usage: corpus_gen [options] <output.pdf>\n"
+            "       corpus_gen --corpus <directory>\n"
+            "Options: --pages N --page letter|a4|label --text-lines N --fonts N --font-file PATH\n"
+            "         --paths N --path-segments N --images N --image-size N --transparency N\n"
+            "         --forms N --seed N\n");
+}
+
+int main(int argc, char** argv) {
+    CorpusOptions options;
+    std::string outputPath;
+    std::string corpusDirectory;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            outputPath = arg;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            PrintUsage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        int number = atoi(value.c_str());
+        if (arg == "--corpus") {
+            corpusDirectory = value;
+        } else if (arg == "--page") {
+            if (!SetPageSize(value, &options)) {
+                PrintUsage();
+                return 2;
+            }
+        } else if (arg == "--font-file") {
+            options.fontFile = value;
+        } else if (arg == "--pages") {
+            options.pages = std::max(1, number);
+        } else if (arg == "--text-lines") {
+            options.textLines = std::max(0, number);
+        } else if (arg == "--fonts") {
+            options.fonts = std::max(1, std::min(kStandardFontCount, number));
+        } else if (arg == "--paths") {
+            options.paths = std::max(0, number);
+        } else if (arg == "--path-segments") {
+            options.pathSegments = std::max(1, number);
+        } else if (arg == "--images") {
+            options.images = std::max(0, number);
+        } else if (arg == "--image-size") {
+            options.imageSize = std::max(1, std::min(8000, number));
+        } else if (arg == "--transparency") {
+            options.transparency = std::max(0, number);
+        } else if (arg == "--forms") {
+            options.forms = std::max(0, number);
+        } else if (arg == "--seed") {
+            options.seed = (unsigned)strtoul(value.c_str(), nullptr, 10);
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (outputPath.empty() == corpusDirectory.empty()) {
+        PrintUsage();
+        return 2;
+    }
+
+    FPDF_InitLibrary();
+    // Without machine time access FPDF_CreateNewDocument writes no CreationDate
+    FPDF_SetSandBoxPolicy(FPDF_POLICY_MACHINETIME_ACCESS, 0);
+    std::string error;
+    bool ok = corpusDirectory.empty() ? Generate(options, outputPath, &error)
+                                      : GenerateCorpus(corpusDirectory, &error);
+    FPDF_DestroyLibrary();
+    if (!ok) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,283 @@
+// Print pipeline benchmark
+//
+// Runs the stages of a print job against a corpus of PDFs:
+//   - document load through LoadPdf (file read and parse)
+//   - page load and full-page rendering through RenderPageToBitmap at
+//     150, 300 and 600 DPI
+//   - the raw printer path at 203 DPI through RasterPipeline: banded gray
+//     rendering, gray -> 1-bit conversion (threshold and ordered dither),
+//     ESC/POS and ZPL encoding, written to a null sink so that only the
+//     pipeline itself is measured, and optionally to a file sink
+// Stage splits (file read vs. parse, page load vs. render) come from the
+// Metrics histograms the library records anyway.
+//
+// Results go to stdout as JSON, one entry per document and case, so runs can
+// be compared commit by commit. Needs a pdfium build for the host platform.
+//
+// Usage: pipeline_bench [-n iterations] [-o sink-file] <file.pdf | directory>...
+//
+// A reproducible corpus comes from bench/corpus_gen:
+//   corpus_gen --corpus corpus && pipeline_bench corpus
+
+#include "metrics.h"
+#include "pdfium_win.h"
+#include "raster_pipeline.h"
+#include "raster_sink.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static const int kRenderDpis[] = { 150, 300, 600 };
+
+// Discards the output and only counts it
+class NullSink : public RasterSink {
+public:
+    bool Write(const unsigned char* data, size_t length) override {
+        (void)data;
+        m_bytesWritten += length;
+        return true;
+    }
+
+    bool Close() override { return true; }
+};
+
+static double Percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(p * (values.size() - 1));
+    return values[index];
+}
+
+static std::string JsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)(unsigned char)c);
+            out.append(escaped);
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+    return out;
+}
+
+// name, document and latency fields shared by every entry; the caller appends
+// its own fields and the closing brace
+static std::string BeginEntry(const char* name, const std::string& document, int iterations,
+                              const std::vector<double>& latencies) {
+    char line[256];
+    snprintf(line, sizeof(line), ", \"iterations\": %d, \"p50_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f",
+             iterations, Percentile(latencies, 0.5), Percentile(latencies, 0.99), Percentile(latencies, 1.0));
+    return std::string("    {\"name\": \"") + name + "\", \"document\": " + JsonString(document) + line;
+}
+
+static double StageP50(const MetricsSnapshot& snapshot, MetricStage stage) {
+    return snapshot.stages[stage].p50Ms;
+}
+
+static std::string ErrorEntry(const char* name, const std::string& document, const std::string& error) {
+    return std::string("    {\"name\": \"") + name + "\", \"document\": " + JsonString(document) +
+           ", \"error\": " + JsonString(error) + "}";
+}
+
+// LoadPdf and CloseDocument, the path every job starts with
+static std::string BenchLoad(const std::string& path, int iterations) {
+    std::vector<double> latencies;
+    Metrics::Reset();
+    for (int i = 0; i < iterations; i++) {
+        Clock::time_point start = Clock::now();
+        if (!PdfiumWrapper::LoadPdf(path)) {
+            return ErrorEntry("load_pdf", path, "Failed to load document");
+        }
+        latencies.push_back(ElapsedMs(start, Clock::now()));
+        PdfiumWrapper::CloseDocument();
+    }
+    MetricsSnapshot snapshot = Metrics::GetSnapshot();
+    char fields[256];
+    snprintf(fields, sizeof(fields), ", \"bytes\": %lld, \"file_read_p50_ms\": %.4f, \"document_load_p50_ms\": %.4f}",
+             snapshot.counters[COUNTER_BYTES_READ] / iterations, StageP50(snapshot, STAGE_FILE_READ),
+             StageP50(snapshot, STAGE_DOCUMENT_LOAD));
+    return BeginEntry("load_pdf", path, iterations, latencies) + fields;
+}
+
+// Every page as a BGRA bitmap, the GDI path; latencies are per page
+static std::string BenchRender(PdfDocument* document, const std::string& path, int dpi, int iterations) {
+    std::string name = "render_" + std::to_string(dpi) + "dpi";
+    int pageCount = PdfiumWrapper::GetPageCount(document);
+    std::vector<double> latencies;
+    double pixels = 0;
+    double totalMs = 0;
+    Metrics::Reset();
+    for (int i = 0; i < iterations; i++) {
+        for (int page = 0; page < pageCount; page++) {
+            Clock::time_point start = Clock::now();
+            BitmapData* bitmap = PdfiumWrapper::RenderPageToBitmap(document, page, dpi);
+            double ms = ElapsedMs(start, Clock::now());
+            if (!bitmap) {
+                return ErrorEntry(name.c_str(), path, "Failed to render page " + std::to_string(page + 1));
+            }
+            pixels += (double)bitmap->width * bitmap->height;
+            PdfiumWrapper::FreeBitmap(bitmap);
+            latencies.push_back(ms);
+            totalMs += ms;
+        }
+    }
+    MetricsSnapshot snapshot = Metrics::GetSnapshot();
+    char fields[256];
+    snprintf(fields, sizeof(fields),
+             ", \"pages\": %d, \"megapixels_per_s\": %.2f, \"page_load_p50_ms\": %.4f, \"render_p50_ms\": %.4f}",
+             pageCount, totalMs > 0 ? pixels / 1e3 / totalMs : 0.0, StageP50(snapshot, STAGE_PAGE_LOAD),
+             StageP50(snapshot, STAGE_RENDER));
+    return BeginEntry(name.c_str(), path, iterations, latencies) + fields;
+}
+
+// The whole document through the raw pipeline; latencies are per job
+static std::string BenchRaw(PdfDocument* document, const std::string& path, const char* name,
+                            const RasterJobOptions& options, const std::string& sinkPath, int iterations) {
+    std::vector<double> latencies;
+    RasterJobStats totals;
+    for (int i = 0; i < iterations; i++) {
+        NullSink nullSink;
+        FileSink fileSink;
+        RasterSink* sink = &nullSink;
+        if (!sinkPath.empty()) {
+            if (!fileSink.Open(sinkPath)) {
+                return ErrorEntry(name, path, fileSink.LastError());
+            }
+            sink = &fileSink;
+        }
+
+        RasterJobStats stats;
+        std::string error;
+        Clock::time_point start = Clock::now();
+        bool ok = RasterPipeline::PrintDocument(document, options, *sink, &stats, &error);
+        sink->Close();
+        latencies.push_back(ElapsedMs(start, Clock::now()));
+        if (!ok) {
+            return ErrorEntry(name, path, error);
+        }
+        totals.pages += stats.pages;
+        totals.bytesWritten += stats.bytesWritten;
+        totals.rowsElided += stats.rowsElided;
+        totals.renderMs += stats.renderMs;
+        totals.encodeMs += stats.encodeMs;
+        totals.writeMs += stats.writeMs;
+    }
+    int pages = std::max(1, totals.pages);
+    char fields[256];
+    snprintf(fields, sizeof(fields),
+             ", \"pages\": %d, \"bytes_per_page\": %lld, \"rows_elided_per_page\": %lld, "
+             "\"render_ms_per_page\": %.4f, \"encode_ms_per_page\": %.4f, \"write_ms_per_page\": %.4f}",
+             totals.pages / iterations, totals.bytesWritten / pages, totals.rowsElided / pages,
+             totals.renderMs / pages, totals.encodeMs / pages, totals.writeMs / pages);
+    return BeginEntry(name, path, iterations, latencies) + fields;
+}
+
+// Directories contribute their *.pdf files in name order, so the entry order
+// is stable between runs
+static std::vector<std::string> CollectCorpus(const std::vector<std::string>& paths) {
+    std::vector<std::string> files;
+    for (const std::string& path : paths) {
+        std::error_code error;
+        if (!std::filesystem::is_directory(path, error)) {
+            files.push_back(path);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const auto& entry : std::filesystem::directory_iterator(path, error)) {
+            std::string extension = entry.path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if (entry.is_regular_file() && extension == ".pdf") {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 5;
+    std::string sinkPath;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            sinkPath = argv[++i];
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (iterations <= 0) {
+        iterations = 5;
+    }
+    std::vector<std::string> corpus = CollectCorpus(paths);
+    if (corpus.empty()) {
+        fprintf(stderr, "Usage: pipeline_bench [-n iterations] [-o sink-file] <file.pdf | directory>...\n");
+        return 2;
+    }
+
+    PdfiumWrapper::Initialize();
+    Metrics::SetEnabled(true);
+
+    // Blank areas go out as feeds, so the blank-row detector is measured too
+    RasterJobOptions escpos;
+    escpos.language = RASTER_ESCPOS;
+    escpos.skipBlank = true;
+    RasterJobOptions zpl;
+    zpl.language = RASTER_ZPL;
+    zpl.skipBlank = true;
+    RasterJobOptions zplDither = zpl;
+    zplDither.dither = true;
+
+    std::vector<std::string> entries;
+    int failures = 0;
+    for (const std::string& path : corpus) {
+        entries.push_back(BenchLoad(path, iterations));
+        PdfDocument* document = PdfiumWrapper::OpenDocument(path);
+        if (!document) {
+            entries.push_back(ErrorEntry("open_document", path, "Failed to open document"));
+            continue;
+        }
+        for (int dpi : kRenderDpis) {
+            entries.push_back(BenchRender(document, path, dpi, iterations));
+        }
+        entries.push_back(BenchRaw(document, path, "raw_escpos_203dpi_null", escpos, std::string(), iterations));
+        entries.push_back(BenchRaw(document, path, "raw_zpl_203dpi_null", zpl, std::string(), iterations));
+        entries.push_back(BenchRaw(document, path, "raw_zpl_dither_203dpi_null", zplDither, std::string(),
+                                   iterations));
+        if (!sinkPath.empty()) {
+            entries.push_back(BenchRaw(document, path, "raw_zpl_203dpi_file", zpl, sinkPath, iterations));
+        }
+        PdfiumWrapper::CloseDocument(document);
+    }
+
+    printf("{\n  \"iterations\": %d,\n  \"benchmarks\": [\n", iterations);
+    for (size_t i = 0; i < entries.size(); i++) {
+        failures += entries[i].find("\"error\"") != std::string::npos ? 1 : 0;
+        printf("%s%s\n", entries[i].c_str(), i + 1 < entries.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+
+    PdfiumWrapper::Shutdown();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+// Raw raster output benchmark
+//
+// Measures the per-label latency of the band pipeline after rendering:
+// gray -> 1-bit conversion, ESC/POS / ZPL encoding and writing to a file sink,
+// plus the blank-row detector used to skip white bands.
+// A synthetic 4x6" shipping label stands in for the pdfium output so the
+// benchmark runs anywhere.
+//
+// Usage: raster_bench [output-file] [iterations]
+
+#include "raster_ops.h"
+#include "raster_sink.h"
+#include "thermal_encoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static void FillRect(std::vector<unsigned char>& gray, int stride, int x, int y, int w, int h, unsigned char value) {
+    for (int row = y; row < y + h; row++) {
+        std::fill(gray.begin() + (size_t)row * stride + x, gray.begin() + (size_t)row * stride + x + w, value);
+    }
+}
+
+// Text lines, a border, a Code128-like bar pattern and a gray logo block
+static std::vector<unsigned char> MakeLabel(int width, int height) {
+    std::vector<unsigned char> gray((size_t)width * height, 255);
+    FillRect(gray, width, 10, 10, width - 20, 4, 0);
+    FillRect(gray, width, 10, height - 14, width - 20, 4, 0);
+    for (int line = 0; line < 12; line++) {
+        int y = 40 + line * 36;
+        for (int x = 30; x < width - 200; x += 14) {
+            if ((x * 7 + line * 13) % 5 != 0) {
+                FillRect(gray, width, x, y, 10, 22, 0);
+            }
+        }
+    }
+    unsigned seed = 12345;
+    for (int x = 60; x < width - 60;) {
+        seed = seed * 1103515245 + 12345;
+        int bar = 2 + (seed >> 16) % 8;
+        FillRect(gray, width, x, 560, bar, 240, 0);
+        x += bar + 2 + (seed >> 20) % 6;
+    }
+    for (int y = 860; y < 1060; y++) {
+        for (int x = 60; x < 360; x++) {
+            gray[(size_t)y * width + x] = (unsigned char)((x + y) & 0xFF);
+        }
+    }
+    return gray;
+}
+
+static double Percentile(std::vector<double> values, double p) {
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(p * (values.size() - 1));
+    return values[index];
+}
+
+static void RunCase(const char* name, RasterLanguage language, const std::vector<unsigned char>& label,
+                    int width, int height, int bandHeight, const std::string& outputPath, int iterations,
+                    bool last) {
+    std::unique_ptr<RasterEncoder> encoder(RasterEncoder::Create(language, true, 203, 0));
+    FileSink sink;
+    if (!sink.Open(outputPath)) {
+        fprintf(stderr, "%s\n", sink.LastError().c_str());
+        exit(1);
+    }
+
+    int monoStride = (width + 7) / 8;
+    std::vector<unsigned char> mono((size_t)monoStride * bandHeight);
+    std::vector<unsigned char> out;
+    std::vector<double> latencies;
+
+    for (int i = 0; i < iterations; i++) {
+        Clock::time_point start = Clock::now();
+        encoder->BeginJob(out);
+        encoder->BeginPage(out, width, height);
+        for (int top = 0; top < height; top += bandHeight) {
+            int rows = std::min(bandHeight, height - top);
+            for (int y = 0; y < rows; y++) {
+                RasterOps::GrayRowToMono(&label[(size_t)(top + y) * width], width,
+                                         &mono[(size_t)y * monoStride], 128, -1);
+            }
+            encoder->EncodeBand(out, mono.data(), monoStride, width, top, rows);
+            sink.Write(out.data(), out.size());
+            out.clear();
+        }
+        encoder->EndPage(out, height);
+        encoder->EndJob(out);
+        sink.Write(out.data(), out.size());
+        out.clear();
+        latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    size_t bytes = sink.BytesWritten();
+    sink.Close();
+
+    printf("    {\"name\": \"%s\", \"iterations\": %d, \"bytes_per_label\": %zu, "
+           "\"p50_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}%s\n",
+           name, iterations, bytes / iterations, Percentile(latencies, 0.5), Percentile(latencies, 0.99),
+           Percentile(latencies, 1.0), last ? "" : ",");
+}
+
+// Blank-row detection over every row of the label (the SIMD path on x86/ARM64)
+static void RunBlankScan(const std::vector<unsigned char>& label, int width, int height, int iterations,
+                         bool last) {
+    int minWhite = RasterOps::MinWhiteLevel(128, false);
+    int blankRows = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (int y = 0; y < height; y++) {
+            blankRows += RasterOps::IsGrayRowBlank(&label[(size_t)y * width], width, minWhite) ? 1 : 0;
+        }
+    }
+    double elapsedNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    printf("    {\"name\": \"blank_row_scan_812px\", \"iterations\": %d, \"blank_rows_per_label\": %d, "
+           "\"ns_per_row\": %.2f}%s\n",
+           iterations, blankRows / iterations, elapsedNs / ((double)iterations * height), last ? "" : ",");
+}
+
+int main(int argc, char** argv) {
+    std::string outputPath = argc > 1 ? argv[1] : "raster_bench.out";
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    if (iterations <= 0) {
+        iterations = 200;
+    }
+
+    // 4x6" label at 203 DPI
+    const int width = 812;
+    const int height = 1218;
+    std::vector<unsigned char> label = MakeLabel(width, height);
+
+    printf("{\n  \"benchmarks\": [\n");
+    RunCase("escpos_4x6_203dpi_file", RASTER_ESCPOS, label, width, height, 128, outputPath, iterations, false);
+    RunCase("zpl_acs_4x6_203dpi_file", RASTER_ZPL, label, width, height, 128, outputPath, iterations, false);
+    RunBlankScan(label, width, height, iterations, true);
+    printf("  ]\n}\n");
+    return 0;
+}
@@ -1,10 +1,36 @@
 {
+  "variables": {
+    "variables": {
+      "pdfium_dir%": "pdfium-prebuilt/pdfium-linux-x64"
+    },
+    "pdfium_dir%": "<(pdfium_dir)",
+    "pdfium_lib_dir%": "<!(node -p \"require('path').resolve('<(pdfium_dir)/lib')\")",
+    "pdfium_bench%": "<!(node -p \"+require('fs').existsSync('<(pdfium_dir)/lib')\")"
+  },
   "targets": [
     {
       "target_name": "pdfprint",
       "sources": [
         "src/pdfprint.cpp",
-        "src/pdfium_win.cpp"
+        "src/barcode.cpp",
+        "src/connection_pool.cpp",
+        "src/cost_estimator.cpp",
+        "src/gdi_printer.cpp",
+        "src/job_scheduler.cpp",
+        "src/metrics.cpp",
+        "src/page_cache.cpp",
+        "src/page_dedup.cpp",
+        "src/page_stream.cpp",
+        "src/pdfium_win.cpp",
+        "src/printer_caps.cpp",
+        "src/raster_ops.cpp",
+        "src/raster_pipeline.cpp",
+        "src/raster_sink.cpp",
+        "src/render_pool.cpp",
+        "src/template_merge.cpp",
+        "src/thermal_encoder.cpp",
+        "src/trace.cpp",
+        "src/util.cpp"
       ],
       "defines": [
         "NAPI_CPP_EXCEPTIONS",
@@ -84,8 +110,162 @@
       "libraries": [
         "pdfium.dll.lib",
         "-lgdi32",
-        "-lwinspool"
+        "-lwinspool",
+        "-lws2_32"
       ]
     }
+  ],
+  "conditions": [
+    ["OS=='win'", {
+      "targets": [
+        {
+          "target_name": "pdfprint_render_worker",
+          "type": "executable",
+          "sources": [
+            "src/render_worker.cpp",
+            "src/metrics.cpp",
+            "src/pdfium_win.cpp",
+            "src/trace.cpp",
+            "src/util.cpp"
+          ],
+          "defines": [
+            "PDF_ENABLE_V8=1"
+          ],
+          "cflags_cc!": ["-fno-exceptions"],
+          "conditions": [
+            ["target_arch=='arm64'", {
+              "include_dirs": [
+                "pdfium-prebuilt/pdfium-win-arm64/include"
+              ],
+              "msvs_settings": {
+                "VCCLCompilerTool": {
+                  "ExceptionHandling": 1
+                },
+                "VCLinkerTool": {
+                  "SubSystem": 1,
+                  "AdditionalLibraryDirectories": [
+                    "..\\pdfium-prebuilt\\pdfium-win-arm64\\lib"
+                  ]
+                }
+              }
+            }],
+            ["target_arch=='x64'", {
+              "include_dirs": [
+                "pdfium-prebuilt/pdfium-win-x64/include"
+              ],
+              "msvs_settings": {
+                "VCCLCompilerTool": {
+                  "ExceptionHandling": 1
+                },
+                "VCLinkerTool": {
+                  "SubSystem": 1,
+                  "AdditionalLibraryDirectories": [
+                    "..\\pdfium-prebuilt\\pdfium-win-x64\\lib"
+                  ]
+                }
+              }
+            }]
+          ],
+          "libraries": [
+            "pdfium.dll.lib"
+          ]
+        }
+      ]
+    }],
+    ["OS!='win'", {
+      "targets": [
+        {
+          "target_name": "raster_bench",
+          "type": "executable",
+          "sources": [
+            "bench/raster_bench.cpp",
+            "src/raster_ops.cpp",
+            "src/raster_sink.cpp",
+            "src/thermal_encoder.cpp",
+            "src/util.cpp"
+          ],
+          "include_dirs": [
+            "src"
+          ],
+          "cflags_cc": ["-O2", "-std=c++17"],
+          "cflags_cc!": ["-fno-exceptions", "-fno-rtti"]
+        },
+        {
+          "target_name": "barcode_bench",
+          "type": "executable",
+          "sources": [
+            "bench/barcode_bench.cpp",
+            "src/barcode.cpp",
+            "src/util.cpp"
+          ],
+          "include_dirs": [
+            "src"
+          ],
+          "cflags_cc": ["-O2", "-std=c++17"],
+          "cflags_cc!": ["-fno-exceptions", "-fno-rtti"]
+        }
+      ],
+      "conditions": [
+        # Needs a pdfium build for the host (include/ and lib/libpdfium), e.g.
+        # node-gyp rebuild -- -Dpdfium_dir=/path/to/pdfium-linux-x64
+        ["pdfium_bench==1", {
+          "targets": [
+            {
+              "target_name": "pipeline_bench",
+              "type": "executable",
+              "sources": [
+                "bench/pipeline_bench.cpp",
+                "src/connection_pool.cpp",
+                "src/metrics.cpp",
+                "src/pdfium_win.cpp",
+                "src/raster_ops.cpp",
+                "src/raster_pipeline.cpp",
+                "src/raster_sink.cpp",
+                "src/thermal_encoder.cpp",
+                "src/trace.cpp",
+                "src/util.cpp"
+              ],
+              "include_dirs": [
+                "src",
+                "<(pdfium_dir)/include"
+              ],
+              "library_dirs": [
+                "<(pdfium_lib_dir)"
+              ],
+              "libraries": [
+                "-lpdfium",
+                "-lpthread"
+              ],
+              "ldflags": [
+                "-Wl,-rpath,<(pdfium_lib_dir)"
+              ],
+              "cflags_cc": ["-O2", "-std=c++17"],
+              "cflags_cc!": ["-fno-exceptions", "-fno-rtti"]
+            },
+            {
+              "target_name": "corpus_gen",
+              "type": "executable",
+              "sources": [
+                "bench/corpus_gen.cpp"
+              ],
+              "include_dirs": [
+                "<(pdfium_dir)/include"
+              ],
+              "library_dirs": [
+                "<(pdfium_lib_dir)"
+              ],
+              "libraries": [
+                "-lpdfium"
+              ],
+              "ldflags": [
+                "-Wl,-rpath,<(pdfium_lib_dir)"
+              ],
+              "cflags_cc": ["-O2", "-std=c++17"],
+              "cflags_cc!": ["-fno-exceptions", "-fno-rtti"]
+            }
+          ]
+        }]
+      ]
+    }]
   ]
 }
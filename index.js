@@ -1,4 +1,6 @@
+const fs = require("fs");
 const path = require("path");
+const { Readable } = require("stream");
 const nodeGypBuild = require("node-gyp-build");
 
 // 使用 node-gyp-build 加载原生模块
@@ -39,9 +41,574 @@ function printPdf(filePath, dpi = 300) {
   return pdfprint.printPdf(filePath, dpi);
 }
 
+/**
+ * Print a PDF file as raw printer language (ESC/POS or ZPL) for thermal
+ * receipt and label printers, bypassing the GDI driver
+ * @param {string} filePath - Path to the PDF file
+ * @param {Object} [options]
+ * @param {"escpos"|"zpl"} [options.language="escpos"] - Printer language
+ * @param {number} [options.dpi=203] - Native printer resolution (203 or 300)
+ * @param {number} [options.width] - Print head width in dots (default: page width)
+ * @param {number} [options.height] - Label length in dots (default: page height)
+ * @param {number} [options.bandHeight=128] - Raster rows rendered and sent per band
+ * @param {number} [options.threshold=128] - Gray level below which a dot is printed
+ * @param {boolean} [options.dither=false] - Use ordered dithering instead of a threshold
+ * @param {boolean} [options.cut=true] - Cut after each page (ESC/POS); in roll mode, once at the end
+ * @param {boolean} [options.roll=false] - Continuous roll: stream all pages as one variable-length
+ *   raster at native resolution, without fitting each page to a label
+ * @param {boolean} [options.trim=false] - In roll mode, drop leading and trailing blank rows
+ * @param {boolean} [options.skipBlank=false] - Send blank areas as media feed commands instead of raster data
+ * @param {number} [options.feedUnits] - ESC/POS vertical motion units per inch used by the ESC J feeds that
+ *   replace blank areas, commonly 180 or 203 (default: `dpi`, one unit per dot row)
+ * @param {boolean} [options.skipBlankPages=false] - Leave out pages that are completely blank
+ * @param {string} [options.file] - Write output to this file
+ * @param {string} [options.host] - Send output to this printer host over TCP
+ * @param {number} [options.port=9100] - TCP port used with `host`
+ * @param {number} [options.timeout=10000] - TCP send timeout in milliseconds
+ * @param {string} [options.printer] - Windows printer queue for a RAW job (default printer if omitted)
+ * @returns {{pages: number, rows: number, bytesWritten: number, trimmedRows: number, rowsElided: number, bytesElided: number, pagesSkipped: number, renderMs: number, encodeMs: number, writeMs: number, totalMs: number}} Job statistics
+ */
+function printPdfRaw(filePath, options = {}) {
+  return pdfprint.printPdfRaw(filePath, options);
+}
+
+/**
+ * Get printer capabilities from the native cache. Values are in printer dots,
+ * so they can be used to size rasters before a print job is started.
+ * @param {string} [printerName] - Printer name (default printer if omitted)
+ * @param {number} [maxAgeMs=300000] - Re-query the driver when the cached entry is older; 0 forces a refresh
+ * @returns {{name: string, dpiX: number, dpiY: number, physicalWidth: number, physicalHeight: number,
+ *   offsetX: number, offsetY: number, printableWidth: number, printableHeight: number,
+ *   color: boolean, duplex: boolean, paperNames: string[], resolutions: {x: number, y: number}[]}}
+ */
+function getPrinterCapabilities(printerName, maxAgeMs) {
+  return pdfprint.getPrinterCapabilities(printerName, maxAgeMs);
+}
+
+/**
+ * Drop cached printer capabilities, e.g. after changing printer settings
+ * @param {string} [printerName] - Printer name (all printers if omitted)
+ */
+function invalidatePrinterCapabilities(printerName) {
+  pdfprint.invalidatePrinterCapabilities(printerName);
+}
+
+/**
+ * Get connection pool metrics. Printer handles/DCs, RAW spooler handles and
+ * TCP connections are kept open between jobs and reused.
+ * @returns {{acquires: number, hits: number, misses: number, hitRate: number, waits: number,
+ *   healthFailures: number, idleEvictions: number, discarded: number, setupMs: number,
+ *   savedMs: number, idle: number, active: number}}
+ */
+function getConnectionPoolStats() {
+  return pdfprint.getConnectionPoolStats();
+}
+
+/**
+ * Configure the connection pool
+ * @param {Object} options
+ * @param {number} [options.maxPerPrinter=4] - Maximum open connections per printer (in use + idle)
+ * @param {number} [options.idleTimeoutMs=60000] - Close idle connections after this long; 0 disables pooling
+ * @param {number} [options.acquireTimeoutMs=30000] - How long a job waits for a free connection at the limit
+ */
+function configureConnectionPool(options) {
+  pdfprint.configureConnectionPool(options);
+}
+
+/**
+ * Close all idle pooled connections
+ */
+function clearConnectionPool() {
+  pdfprint.clearConnectionPool();
+}
+
+/**
+ * Queue a print job on the native scheduler. Jobs run on a shared pool of
+ * worker threads: higher priority first, then earliest deadline, rotating
+ * between printers so that one large job does not hold up other printers.
+ * @param {string} filePath - Path to the PDF file
+ * @param {Object} [options] - Scheduling options, plus the options of `printPdf` (`dpi`, `printer`)
+ *   or, with `mode: "raw"`, the options of `printPdfRaw`
+ * @param {"gdi"|"raw"} [options.mode="gdi"] - Print through the driver or as raw ESC/POS / ZPL
+ * @param {number} [options.priority=0] - Higher values run first (-1000 to 1000)
+ * @param {number} [options.deadlineMs] - Fail the job if it has not started this many milliseconds after submission
+ * @param {number} [options.timeoutMs] - Stop the job if it runs longer than this
+ * @param {number} [options.pageBudgetMs] - Render time budget per page; a page that exceeds it is
+ *   re-rendered at `fallbackDpi` if set (GDI jobs), otherwise the job fails
+ * @param {number} [options.fallbackDpi] - Lower DPI for pages over budget (GDI jobs)
+ * @param {number} [options.minDpi] - Enables adaptive resolution (GDI jobs): each page is analysed and
+ *   rendered at the lowest DPI between `minDpi` and `dpi` that keeps its images at their source
+ *   resolution; text and vector-only pages use `minDpi`. The DPI chosen per page is reported in the
+ *   `pageRendered` event (`dpi`) and in `stats.pageDpi`
+ * @param {1|2|4|6|9|16} [options.nup=1] - Pages per sheet. The pages are imposed onto sheets the size of
+ *   the first page (turned sideways for 2-up and 6-up) and each sheet is rendered once, so pixels
+ *   rendered and pages spooled drop by the N-up factor
+ * @param {boolean} [options.booklet=false] - Saddle-stitch booklet: two pages per side in folding order,
+ *   padded with blanks to a multiple of four. Printed with `duplex: "short"` unless set otherwise
+ * @param {"none"|"long"|"short"} [options.duplex="none"] - Double-sided printing, bound on the long or short
+ *   edge of the paper (GDI jobs). Short-edge back sides are rendered upside down and the printer flips
+ *   on the long edge. Odd page counts get a blank last page
+ * @param {"draw"|"flatten"|"none"} [options.forms="draw"] - How filled AcroForm fields are printed: drawn
+ *   through a form-fill environment, flattened into the page content in memory first, or left out
+ * @param {boolean} [options.preflight=true] - While the job waits, score its pages (object counts, image
+ *   megapixels, transparency, output pixel area) to predict its run time and memory. Only a sample of up to
+ *   8 pages is parsed; the other pages take the content of the nearest sampled page. Across printers,
+ *   the most expensive jobs start first; jobs for the same printer keep their submission order
+ * @param {AbortSignal} [options.signal] - Cancels the job: a queued job is removed, a running job
+ *   stops at its next render slice
+ * @param {boolean} [options.isolate=false] - Render in a separate renderer process (see `configureRenderPool`),
+ *   so a malformed file that crashes pdfium fails this job instead of the whole process. Pages come back
+ *   through shared memory. Isolated jobs are also the way to render on several cores at once; without
+ *   `isolate` every render in the process takes turns. Cannot be combined with `nup`, `booklet` or
+ *   templates; skips the preflight
+ * @param {boolean} [options.cache=true] - Use the page cache when it is enabled (see `configurePageCache`):
+ *   pages already rendered from the same file content at the same settings are not rendered again.
+ *   Jobs with `nup`, `booklet` or a template are not cached
+ * @param {boolean} [options.dedup=false] - Fingerprint each page's content (drawing objects, image data,
+ *   embedded fonts, character positions) before rendering, and reuse the pixels of a page with the same
+ *   content already rendered at the same settings by this or an earlier job (see `configurePageDedup`).
+ *   Pages with annotations, form fields, transparency or shadings are always rendered. Ignored with
+ *   `isolate`, `nup`, `booklet` or a template
+ * @param {string} [options.printer] - Printer name (default printer if omitted)
+ * @param {function(Object): void} [options.onEvent] - Receives job events in order:
+ *   `started`, `loaded`, `pageRendered`, `pageSpooled`, `bytesWritten` (raw jobs), then `completed` or `failed`.
+ *   Each event has `type`, `jobId`, `timestamp` (ms since epoch), `elapsedMs` (since submission) and
+ *   `durationMs` (of the stage that just ended), plus `page`, `pageCount`, `dpi`, `bytes`/`totalBytes` or `error`
+ *   where they apply. Events are delivered from the native side in batches.
+ * @returns {{id: number, done: Promise<Object>}} Job id, and a promise that resolves with the job
+ *   result (including `stats`) or rejects with an Error whose `job` property holds the job state
+ * @throws {Error} If the queue is full (see `configureScheduler`)
+ */
+function submitJob(filePath, options = {}) {
+  const { onEvent, signal } = options;
+  if (options.isolate && !pdfprint.getRenderPoolStats().configured) {
+    configureRenderPool();
+  }
+  let id;
+  const done = new Promise((resolve, reject) => {
+    id = pdfprint.submitJob(filePath, options, (events, final, err, result) => {
+      if (onEvent) {
+        for (const event of events) {
+          onEvent(event);
+        }
+      }
+      if (!final) {
+        return;
+      }
+      if (err) {
+        reject(err);
+      } else {
+        resolve(result);
+      }
+    });
+  });
+  if (signal) {
+    const onAbort = () => pdfprint.cancelJob(id);
+    if (signal.aborted) {
+      onAbort();
+    } else {
+      signal.addEventListener("abort", onAbort, { once: true });
+      const cleanup = () => signal.removeEventListener("abort", onAbort);
+      done.then(cleanup, cleanup);
+    }
+  }
+  return { id, done };
+}
+
+/**
+ * Cancel a job. A queued job is removed; a running job stops at its next
+ * render slice and its `done` promise rejects with state "cancelled".
+ * @param {number} id - Job id
+ * @returns {boolean} True if the job was still queued or running
+ */
+function cancelJob(id) {
+  return pdfprint.cancelJob(id);
+}
+
+/**
+ * Get the state of a queued, running or recently finished job
+ * @param {number} id - Job id
+ * @returns {{id: number, state: "queued"|"running"|"completed"|"failed"|"cancelled", error?: string,
+ *   printer: string, priority: number, estimatedBytes: number, costScore?: number, estimatedMs?: number,
+ *   queuedMs: number, runMs: number, deadlineMissed: boolean}|null} Job state, or null if unknown.
+ *   `costScore` and `estimatedMs` are set once the job has been preflighted
+ */
+function getJob(id) {
+  return pdfprint.getJob(id);
+}
+
+/**
+ * Configure the job scheduler
+ * @param {Object} options
+ * @param {number} [options.workers=2] - Worker threads shared by all printers
+ * @param {number} [options.maxPerPrinter=1] - Jobs running at the same time on one printer or output
+ * @param {number} [options.memoryBudgetMB=512] - Estimated memory of running jobs; larger jobs wait
+ *   while smaller ones go ahead
+ * @param {number} [options.maxQueued=1000] - Waiting jobs before `submitJob` throws
+ */
+function configureScheduler(options) {
+  pdfprint.configureScheduler(options);
+}
+
+/**
+ * Get job scheduler counters
+ * @returns {{submitted: number, rejected: number, completed: number, failed: number, cancelled: number,
+ *   expired: number, deadlineMisses: number, memoryWaits: number, preflighted: number, costSamples: number,
+ *   costErrorPct: number, msPerCostUnit: number, queued: number, running: number, memoryInUse: number}}
+ *   `costErrorPct` is the mean absolute error of predicted against actual run time over `costSamples`
+ *   completed jobs; `msPerCostUnit` is the current calibration of cost scores to milliseconds
+ */
+function getSchedulerStats() {
+  return pdfprint.getSchedulerStats();
+}
+
+/**
+ * Configure the renderer process pool used by jobs submitted with `isolate: true`.
+ * Each renderer process has its own shared memory, split into `slots` buffers:
+ * whole pages for GDI jobs, a ring of bands for raw jobs. A renderer process that
+ * crashes is replaced, and one that is still busy when its job is cancelled or
+ * times out is killed. Called with the defaults on the first isolated job.
+ * pdfium is not thread-safe, so rendering inside one process is serialized by a
+ * process-wide lock, across scheduler workers and worker_threads alike. Each
+ * renderer process has its own pdfium, so `processes` is how many pages render
+ * in parallel (test-workers.js checks that more processes finish sooner).
+ * @param {Object} [options]
+ * @param {number} [options.processes=2] - Renderer processes; isolated jobs beyond this wait
+ * @param {number} [options.slots=4] - Shared memory buffers per process
+ * @param {number} [options.slotMB=64] - Size of each buffer; must hold a whole BGRA page at the job DPI
+ * @param {string} [options.workerPath] - Renderer executable (defaults to the one built next to the addon)
+ */
+function configureRenderPool(options = {}) {
+  const executable = process.platform === "win32" ? "pdfprint_render_worker.exe" : "pdfprint_render_worker";
+  const workerPath = options.workerPath || path.join(__dirname, "build", "Release", executable);
+  pdfprint.configureRenderPool({ ...options, workerPath });
+}
+
+/**
+ * Get renderer process pool counters
+ * @returns {{configured: boolean, processes: number, busy: number, spawned: number, crashes: number,
+ *   killed: number, sessions: number}} `spawned` includes restarts; `killed` counts renderer processes
+ *   stopped for cancelled, timed-out or hung jobs
+ */
+function getRenderPoolStats() {
+  return pdfprint.getRenderPoolStats();
+}
+
+/**
+ * Enable the on-disk page cache for reprints. Rendered pages are stored
+ * compressed, addressed by a hash of the file content, the page and the render
+ * settings, so a retried or repeated job reads its pages back instead of
+ * rendering them. Files are written atomically and read through memory mapping;
+ * the least recently used pages are deleted once the cache exceeds `maxMB`.
+ * Pages cached by earlier runs in the same directory are reused.
+ * @param {Object} options
+ * @param {string} [options.directory] - Cache directory (created if missing); an empty string disables the cache
+ * @param {number} [options.maxMB=1024] - Total size of the cache files
+ */
+function configurePageCache(options) {
+  pdfprint.configurePageCache(options);
+}
+
+/**
+ * Get page cache counters
+ * @returns {{enabled: boolean, hits: number, misses: number, hitRate: number, writes: number,
+ *   writeErrors: number, evictions: number, corrupt: number, entries: number, bytes: number}}
+ *   `corrupt` counts damaged cache files that were deleted and rendered again
+ */
+function getPageCacheStats() {
+  return pdfprint.getPageCacheStats();
+}
+
+/**
+ * Delete all cached pages
+ */
+function clearPageCache() {
+  pdfprint.clearPageCache();
+}
+
+/**
+ * Limit the memory kept for identical-page reuse (`dedup` job option).
+ * Rendered pages stay in memory until the total exceeds `maxMB`, then the
+ * least recently used ones are released.
+ * @param {Object} options
+ * @param {number} [options.maxMB=256] - Memory for reused pages; 0 turns reuse off
+ */
+function configurePageDedup(options) {
+  pdfprint.configurePageDedup(options);
+}
+
+/**
+ * Get identical-page reuse counters
+ * @returns {{pages: number, hits: number, misses: number, skipped: number, hitRate: number,
+ *   evictions: number, entries: number, bytes: number}} `pages` counts fingerprinted pages,
+ *   `skipped` pages whose content could not be fingerprinted; `hitRate` is hits over all pages
+ */
+function getPageDedupStats() {
+  return pdfprint.getPageDedupStats();
+}
+
+/**
+ * Release all pages kept for identical-page reuse
+ */
+function clearPageDedup() {
+  pdfprint.clearPageDedup();
+}
+
+/**
+ * Turn per-stage timing on or off. While enabled, file reads, document and
+ * page loads, rendering, pdfium lock waits, bitmap conversion, spooler calls,
+ * encoding and output writes are timed into latency histograms, and pages,
+ * pixels, bytes and pixel-buffer allocations are counted. Disabled by default;
+ * when disabled each instrumented point costs one flag check.
+ * @param {Object} options
+ * @param {boolean} [options.enabled] - Start or stop recording; recorded values are kept
+ * @param {boolean} [options.reset=false] - Clear all histograms and counters
+ */
+function configureMetrics(options) {
+  pdfprint.configureMetrics(options);
+}
+
+/**
+ * Get the recorded metrics. Percentiles come from log-linear histograms
+ * accurate to 1/16 of the value.
+ * @returns {{enabled: boolean,
+ *   stages: Object<string, {count: number, totalMs: number, meanMs: number, maxMs: number,
+ *     p50Ms: number, p90Ms: number, p99Ms: number, p999Ms: number}>,
+ *   counters: {jobs: number, pages: number, pixels: number, bytes_read: number, bytes_written: number,
+ *     allocations: number, allocated_bytes: number}}}
+ *   Stages: `queue`, `job`, `file_read`, `document_load`, `page_load`, `render` (one page or band),
+ *   `lock_wait` (contended only), `bitmap_convert`, `spool_start`, `spool_page`, `spool_end`,
+ *   `encode` (one band), `write`. Isolated jobs render in another process, so their pdfium stages
+ *   are not included
+ */
+function getMetrics() {
+  return pdfprint.getMetrics();
+}
+
+/**
+ * Get the recorded metrics in the Prometheus text exposition format, for
+ * serving from a `/metrics` endpoint. Stage durations are summaries in seconds
+ * (`pdfprint_stage_duration_seconds{stage="render",quantile="0.99"}`), counters
+ * end in `_total`.
+ * @returns {string}
+ */
+function getMetricsText() {
+  return pdfprint.getMetricsText();
+}
+
+/**
+ * Start recording a timeline of the print pipeline: jobs, queueing, pages,
+ * file reads, document and page loads, render slices, lock waits, spooling,
+ * encoding and writes, each on the thread that ran it. Starting again discards
+ * a timeline that was never stopped.
+ * @param {Object} [options]
+ * @param {number} [options.maxEventsPerThread=65536] - Events kept per thread;
+ *   later ones are dropped and counted
+ */
+function startTrace(options) {
+  pdfprint.startTrace(options);
+}
+
+/**
+ * Stop recording and return the timeline in the Chrome trace-event format,
+ * which chrome://tracing and https://ui.perfetto.dev open directly. Isolated
+ * jobs render in another process and only show as their job span.
+ * @param {string} [filePath] - Also write the JSON to this file
+ * @returns {{json: string, droppedEvents: number}|null} Null if no trace was running
+ */
+function stopTrace(filePath) {
+  const result = pdfprint.stopTrace();
+  if (result && filePath) {
+    fs.writeFileSync(filePath, result.json);
+  }
+  return result;
+}
+
+/**
+ * Open a PDF as a template for variable-data printing. The template is parsed
+ * once; each page's static content is rendered once per output resolution and
+ * cached, and every record only draws its own fields over a copy of it.
+ * @param {string} filePath - Path to the template PDF
+ * @returns {number} Template id for `submitMergeJob`
+ */
+function openTemplate(filePath) {
+  return pdfprint.openTemplate(filePath);
+}
+
+/**
+ * Close a template. Jobs already submitted with it still complete.
+ * @param {number} id - Template id
+ * @returns {boolean} True if the template was open
+ */
+function closeTemplate(id) {
+  return pdfprint.closeTemplate(id);
+}
+
+/**
+ * Get template cache counters
+ * @param {number} id - Template id
+ * @returns {{pageCount: number, pages: number, layersRendered: number, layerHits: number,
+ *   cacheBytes: number, staticMs: number, overlayMs: number}|null} `pages` counts merged pages,
+ *   `layersRendered` and `layerHits` the static page renders and their reuses; null if not open
+ */
+function getTemplateStats(id) {
+  return pdfprint.getTemplateStats(id);
+}
+
+/**
+ * Queue a variable-data job: every record prints all template pages with its
+ * own fields drawn on top. Coordinates are in points from the top-left corner
+ * of the template page.
+ * @param {number} templateId - Id from `openTemplate`
+ * @param {Array<Array<Object>>} records - One array of fields per record. A field is
+ *   `{ type: "text", page, x, y, text, font, size, color }` (`y` is the baseline; `font` one of the
+ *   14 standard PDF fonts, default Helvetica; `size` default 10; `color` 0xAARRGGBB) or
+ *   `{ type: "image", page, x, y, width, height, image: { width, height, data } }` (`data` BGRA pixels) or
+ *   `{ type: "barcode", page, x, y, symbology, data, moduleSize, height, ecc }`. Barcodes
+ *   (`symbology` "code128", "gs1-128", "datamatrix" or "qr") are drawn straight into the output pixels
+ *   with every module rounded to the same whole number of device pixels: `moduleSize` in points
+ *   (default 1), `height` the bar height of linear codes (default 36), `ecc` the QR error correction
+ *   level "L", "M" (default), "Q" or "H". GS1-128 data is written as "(01)09501101530003(10)ABC".
+ *   `x`/`y` is the top-left corner of the symbol; the quiet zone around it is cleared. For exact
+ *   modules on GDI printers, submit at the printer's own resolution
+ * @param {Object} [options] - Options of `submitJob`, except `nup`, `booklet` and `forms`
+ * @returns {{id: number, done: Promise<Object>}} As `submitJob`; no `loaded` event is emitted
+ */
+function submitMergeJob(templateId, records, options = {}) {
+  return submitJob("", { ...options, template: templateId, records });
+}
+
+/**
+ * Open a PDF for rendering with `renderPage`. The document stays parsed until
+ * `closeDocument`, so rendering several pages does not reload it.
+ * @param {string} filePath - Path to the PDF file
+ * @param {Object} [options]
+ * @param {"draw"|"flatten"|"none"} [options.forms="draw"] - How AcroForm field values are rendered
+ * @returns {number} Document id
+ */
+function openDocument(filePath, options = {}) {
+  return pdfprint.openDocument(filePath, options);
+}
+
+/**
+ * Close a document opened with `openDocument`. Pixel buffers already
+ * returned by `renderPage` stay valid.
+ * @param {number} id - Document id
+ * @returns {boolean} True if the document was open
+ */
+function closeDocument(id) {
+  return pdfprint.closeDocument(id);
+}
+
+/**
+ * Get the page count and page sizes of an open document
+ * @param {number} id - Document id
+ * @returns {{pageCount: number, pages: {width: number, height: number}[]}} Sizes in points (1/72 inch)
+ */
+function getDocumentInfo(id) {
+  return pdfprint.getDocumentInfo(id);
+}
+
+/**
+ * Render one page to BGRA pixels, e.g. for previews or a custom print
+ * pipeline. `data` wraps the native bitmap without copying it; the memory is
+ * released when the buffer is garbage collected, and is reported to V8 so
+ * large renders count towards GC pressure.
+ * The module can be loaded in worker_threads and each thread gets its own
+ * documents, but renders from all threads wait on one process-wide lock, so
+ * they do not run in parallel. Submit jobs with `isolate: true` to render on
+ * several cores.
+ * @param {number} id - Document id from `openDocument`
+ * @param {number} pageIndex - Page index (0-based)
+ * @param {Object} [options]
+ * @param {number} [options.dpi=150] - Render resolution
+ * @param {0|90|180|270} [options.rotate=0] - Clockwise rotation; 90 and 270 swap width and height
+ * @returns {{data: ArrayBuffer, width: number, height: number, stride: number, format: "bgra"}}
+ *   `stride` is the number of bytes per row, which may exceed `width * 4`
+ */
+function renderPage(id, pageIndex, options = {}) {
+  return pdfprint.renderPage(id, pageIndex, options);
+}
+
+/**
+ * Stream the rendered pages of an open document, e.g. to upload or encode them
+ * one at a time. Rendering runs on a native thread but only ahead of the
+ * consumer by `highWaterMark` chunks, so memory follows the consumer's speed
+ * rather than the document's size.
+ * @param {number} id - Document id from `openDocument`
+ * @param {Object} [options]
+ * @param {number} [options.dpi=150] - Render resolution
+ * @param {0|90|180|270} [options.rotate=0] - Clockwise rotation of whole pages
+ * @param {number} [options.firstPage=0] - First page index
+ * @param {number} [options.lastPage] - Last page index (inclusive; default: last page)
+ * @param {number} [options.bandHeight=0] - When set, emit 8-bit gray bands of this many rows
+ *   instead of whole BGRA pages
+ * @param {number} [options.highWaterMark=2] - Chunks rendered ahead of the consumer
+ * @returns {Readable} Object-mode stream of `{page, top, data, width, height, stride, format}`
+ *   chunks as returned by `renderPage`; `top` is the first row of a band (0 for whole pages)
+ */
+function createPageStream(id, options = {}) {
+  let stream;
+  const handle = pdfprint.createPageStream(id, options, (error, chunk) => {
+    if (stream.destroyed) {
+      return;
+    }
+    if (error) {
+      stream.destroy(error);
+    } else {
+      stream.push(chunk);
+    }
+  });
+  stream = new Readable({
+    objectMode: true,
+    highWaterMark: options.highWaterMark || 2,
+    read() {
+      pdfprint.readPageStream(handle);
+    },
+    destroy(error, callback) {
+      pdfprint.closePageStream(handle);
+      callback(error);
+    },
+  });
+  return stream;
+}
+
 module.exports = {
   initialize,
   loadPdf,
   getPageCount,
   printPdf,
+  printPdfRaw,
+  getPrinterCapabilities,
+  invalidatePrinterCapabilities,
+  getConnectionPoolStats,
+  configureConnectionPool,
+  clearConnectionPool,
+  submitJob,
+  cancelJob,
+  getJob,
+  configureScheduler,
+  getSchedulerStats,
+  configureRenderPool,
+  getRenderPoolStats,
+  configurePageCache,
+  getPageCacheStats,
+  clearPageCache,
+  configurePageDedup,
+  getPageDedupStats,
+  clearPageDedup,
+  configureMetrics,
+  getMetrics,
+  getMetricsText,
+  startTrace,
+  stopTrace,
+  openTemplate,
+  closeTemplate,
+  getTemplateStats,
+  submitMergeJob,
+  openDocument,
+  closeDocument,
+  getDocumentInfo,
+  renderPage,
+  createPageStream,
 };
@@ -0,0 +1,1014 @@
+#include "barcode.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// ---------------------------------------------------------------------------
+// Reed-Solomon over GF(256)
+
+struct GaloisField {
+    unsigned char exp[512];
+    unsigned char log[256];
+
+    explicit GaloisField(int polynomial) {
+        int value = 1;
+        for (int i = 0; i < 255; i++) {
+            exp[i] = (unsigned char)value;
+            log[value] = (unsigned char)i;
+            value <<= 1;
+            if (value & 0x100) {
+                value ^= polynomial;
+            }
+        }
+        for (int i = 255; i < 512; i++) {
+            exp[i] = exp[i - 255];
+        }
+        log[0] = 0;
+    }
+
+    unsigned char Multiply(unsigned char a, unsigned char b) const {
+        return (a == 0 || b == 0) ? 0 : exp[log[a] + log[b]];
+    }
+};
+
+// QR codes use x^8+x^4+x^3+x^2+1, Data Matrix x^8+x^5+x^3+x^2+1
+static const GaloisField& QrField() {
+    static const GaloisField field(0x11D);
+    return field;
+}
+
+static const GaloisField& DataMatrixField() {
+    static const GaloisField field(0x12D);
+    return field;
+}
+
+// Check codewords for one block: the remainder of data * x^count divided by
+// the generator whose roots are a^firstRoot .. a^(firstRoot + count - 1)
+static std::vector<unsigned char> ReedSolomon(const GaloisField& field, const unsigned char* data, size_t length,
+                                              int count, int firstRoot) {
+    // Generator coefficients, highest degree first; monic
+    std::vector<unsigned char> generator(1, 1);
+    for (int i = 0; i < count; i++) {
+        unsigned char root = field.exp[(firstRoot + i) % 255];
+        std::vector<unsigned char> next(generator.size() + 1, 0);
+        for (size_t j = 0; j < generator.size(); j++) {
+            next[j] ^= generator[j];
+            next[j + 1] ^= field.Multiply(generator[j], root);
+        }
+        generator.swap(next);
+    }
+
+    std::vector<unsigned char> remainder(count, 0);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char factor = data[i] ^ remainder[0];
+        memmove(remainder.data(), remainder.data() + 1, count - 1);
+        remainder[count - 1] = 0;
+        for (int j = 0; j < count; j++) {
+            remainder[j] ^= field.Multiply(generator[j + 1], factor);
+        }
+    }
+    return remainder;
+}
+
+// ---------------------------------------------------------------------------
+// Code 128 / GS1-128
+
+// Bar and space widths of symbol values 0-105, then the stop pattern
+static const char* const kCode128Patterns[107] = {
+    "212222", "222122", "222221", "121223", "121322", "131222", "122213", "122312", "132212", "221213",
+    "221312", "231212", "112232", "122132", "122231", "113222", "123122", "123221", "223211", "221132",
+    "221231", "213212", "223112", "312131", "311222", "321122", "321221", "312212", "322112", "322211",
+    "212123", "212321", "232121", "111323", "131123", "131321", "112313", "132113", "132311", "211313",
+    "231113", "231311", "112133", "112331", "132131", "113123", "113321", "133121", "313121", "211331",
+    "231131", "213113", "213311", "213131", "311123", "311321", "331121", "312113", "312311", "332111",
+    "314111", "221411", "431111", "111224", "111422", "121124", "121421", "141122", "141221", "112214",
+    "112412", "122114", "122411", "142112", "142211", "241211", "221114", "413111", "241112", "134111",
+    "111242", "121142", "121241", "114212", "124112", "124211", "411212", "421112", "421211", "212141",
+    "214121", "412121", "111143", "111341", "131141", "114113", "114311", "411113", "411311", "113141",
+    "114131", "311141", "411131", "211412", "211214", "211232", "2331112"
+};
+
+static const int kCode128Fnc1 = -1;  // marker in the input text
+static const int kCode128ValueFnc1 = 102;
+static const int kCode128CodeA = 101;
+static const int kCode128CodeB = 100;
+static const int kCode128CodeC = 99;
+static const int kCode128StartA = 103;
+static const int kCode128Stop = 106;
+
+static int DigitRun(const std::vector<int>& text, size_t start) {
+    int run = 0;
+    while (start + run < text.size() && text[start + run] >= '0' && text[start + run] <= '9') {
+        run++;
+    }
+    return run;
+}
+
+static int Code128Value(int set, int c) {
+    if (set == 'A' && c < 32) {
+        return c + 64;
+    }
+    return c - 32;
+}
+
+// Encode characters 0-127 (and FNC1 markers), switching to code set C for
+// runs of four or more digits and between A and B for control characters
+static bool EncodeCode128(const std::vector<int>& text, BarcodeSymbol* symbol, std::string* error) {
+    size_t first = 0;
+    while (first < text.size() && text[first] == kCode128Fnc1) {
+        first++;
+    }
+    if (first == text.size()) {
+        return Fail(error, "Barcode data is empty");
+    }
+    for (int c : text) {
+        if (c > 127) {
+            return Fail(error, "Code 128 can only encode ASCII characters");
+        }
+    }
+
+    std::vector<int> values;
+    int run = DigitRun(text, first);
+    int set = (run >= 4 || (run == 2 && first + 2 == text.size())) ? 'C' : (text[first] < 32 ? 'A' : 'B');
+    values.push_back(kCode128StartA + (set - 'A'));
+
+    size_t i = 0;
+    while (i < text.size()) {
+        int c = text[i];
+        if (c == kCode128Fnc1) {
+            values.push_back(kCode128ValueFnc1);
+            i++;
+            continue;
+        }
+        if (set == 'C') {
+            if (DigitRun(text, i) >= 2) {
+                values.push_back((text[i] - '0') * 10 + (text[i + 1] - '0'));
+                i += 2;
+                continue;
+            }
+            set = c < 32 ? 'A' : 'B';
+            values.push_back(set == 'A' ? kCode128CodeA : kCode128CodeB);
+            continue;
+        }
+        run = DigitRun(text, i);
+        if (run >= 4) {
+            // An odd digit stays in the current set so that C gets pairs
+            if (run % 2) {
+                values.push_back(Code128Value(set, c));
+                i++;
+            }
+            values.push_back(kCode128CodeC);
+            set = 'C';
+            continue;
+        }
+        if (set == 'A' && c >= 96) {
+            values.push_back(kCode128CodeB);
+            set = 'B';
+        } else if (set == 'B' && c < 32) {
+            values.push_back(kCode128CodeA);
+            set = 'A';
+        }
+        values.push_back(Code128Value(set, c));
+        i++;
+    }
+
+    int checksum = values[0];
+    for (size_t k = 1; k < values.size(); k++) {
+        checksum += (int)k * values[k];
+    }
+    values.push_back(checksum % 103);
+    values.push_back(kCode128Stop);
+
+    symbol->modules.clear();
+    for (int value : values) {
+        const char* pattern = kCode128Patterns[value];
+        for (int k = 0; pattern[k]; k++) {
+            symbol->modules.insert(symbol->modules.end(), pattern[k] - '0', (unsigned char)(k % 2 == 0));
+        }
+    }
+    symbol->columns = (int)symbol->modules.size();
+    symbol->rows = 1;
+    symbol->quietZone = 10;
+    return true;
+}
+
+// Application identifiers whose data has a predefined length, by their first
+// two digits; all others are terminated with FNC1 unless they come last
+static bool IsFixedLengthAi(const std::string& ai) {
+    static const char* const kFixed[] = {
+        "00", "01", "02", "03", "04", "11", "12", "13", "14", "15", "16", "17", "18", "19", "20",
+        "31", "32", "33", "34", "35", "36", "41"
+    };
+    for (const char* prefix : kFixed) {
+        if (ai.compare(0, 2, prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// "(01)09501101530003(10)ABC" -> FNC1 0109501101530003 10ABC
+static bool ParseGs1(const std::string& data, std::vector<int>* text, std::string* error) {
+    if (data.empty() || data[0] != '(') {
+        return Fail(error, "GS1 data must start with an application identifier in parentheses");
+    }
+    text->push_back(kCode128Fnc1);
+    bool needSeparator = false;
+    size_t i = 0;
+    while (i < data.size()) {
+        size_t close = data.find(')', i);
+        if (data[i] != '(' || close == std::string::npos) {
+            return Fail(error, "Malformed GS1 data near position " + std::to_string(i));
+        }
+        std::string ai = data.substr(i + 1, close - i - 1);
+        if (ai.size() < 2 || ai.size() > 4 || ai.find_first_not_of("0123456789") != std::string::npos) {
+            return Fail(error, "Invalid GS1 application identifier '" + ai + "'");
+        }
+        size_t next = data.find('(', close + 1);
+        if (next == std::string::npos) {
+            next = data.size();
+        }
+        if (next == close + 1) {
+            return Fail(error, "GS1 application identifier '" + ai + "' has no data");
+        }
+        if (needSeparator) {
+            text->push_back(kCode128Fnc1);
+        }
+        text->insert(text->end(), ai.begin(), ai.end());
+        for (size_t k = close + 1; k < next; k++) {
+            text->push_back((unsigned char)data[k]);
+        }
+        needSeparator = !IsFixedLengthAi(ai);
+        i = next;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// QR code
+
+// Indexed by error correction level (L, M, Q, H) and version
+static const signed char kQrEccPerBlock[4][41] = {
+    { -1,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28,
+          28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30 },
+    { -1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26,
+          26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28 },
+    { -1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30,
+          28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30 },
+    { -1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28,
+          30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30 }
+};
+
+static const signed char kQrBlocks[4][41] = {
+    { -1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4, 4, 4, 4, 4, 6, 6, 6, 6, 7, 8,
+          8, 9, 9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25 },
+    { -1, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5, 5, 8, 9, 9, 10, 10, 11, 13, 14, 16,
+          17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49 },
+    { -1, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8, 8, 10, 12, 16, 12, 17, 16, 18, 21, 20,
+          23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68 },
+    { -1, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25,
+          25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81 }
+};
+
+// Format information bits of L, M, Q, H
+static const int kQrFormatBits[4] = { 1, 0, 3, 2 };
+
+static const char kQrAlphanumeric[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+
+static int QrRawDataModules(int version) {
+    int result = (16 * version + 128) * version + 64;
+    if (version >= 2) {
+        int alignments = version / 7 + 2;
+        result -= (25 * alignments - 10) * alignments - 55;
+        if (version >= 7) {
+            result -= 36;
+        }
+    }
+    return result;
+}
+
+static int QrDataCodewords(int version, int ecc) {
+    return QrRawDataModules(version) / 8 - kQrEccPerBlock[ecc][version] * kQrBlocks[ecc][version];
+}
+
+static std::vector<int> QrAlignmentPositions(int version) {
+    std::vector<int> result;
+    if (version == 1) {
+        return result;
+    }
+    int count = version / 7 + 2;
+    int step = version == 32 ? 26 : (version * 4 + count * 2 + 1) / (count * 2 - 2) * 2;
+    for (int i = 0, pos = version * 4 + 10; i < count - 1; i++, pos -= step) {
+        result.insert(result.begin(), pos);
+    }
+    result.insert(result.begin(), 6);
+    return result;
+}
+
+class BitBuffer {
+public:
+    void Append(unsigned int value, int bits) {
+        for (int i = bits - 1; i >= 0; i--) {
+            m_bits.push_back((value >> i) & 1);
+        }
+    }
+    size_t Size() const { return m_bits.size(); }
+    std::vector<unsigned char> Bytes() const {
+        std::vector<unsigned char> result((m_bits.size() + 7) / 8, 0);
+        for (size_t i = 0; i < m_bits.size(); i++) {
+            result[i >> 3] |= (unsigned char)(m_bits[i] << (7 - (i & 7)));
+        }
+        return result;
+    }
+
+private:
+    std::vector<unsigned char> m_bits;
+};
+
+struct QrMatrix {
+    int size;
+    std::vector<unsigned char> dark;
+    std::vector<unsigned char> function;
+
+    explicit QrMatrix(int n) : size(n), dark((size_t)n * n, 0), function((size_t)n * n, 0) {}
+
+    void Set(int x, int y, bool value) {
+        dark[(size_t)y * size + x] = value ? 1 : 0;
+        function[(size_t)y * size + x] = 1;
+    }
+};
+
+static void DrawQrFormatBits(QrMatrix& m, int ecc, int mask) {
+    int data = kQrFormatBits[ecc] << 3 | mask;
+    int remainder = data;
+    for (int i = 0; i < 10; i++) {
+        remainder = (remainder << 1) ^ ((remainder >> 9) * 0x537);
+    }
+    int bits = (data << 10 | remainder) ^ 0x5412;
+    int size = m.size;
+    for (int i = 0; i < 6; i++) {
+        m.Set(8, i, (bits >> i) & 1);
+    }
+    m.Set(8, 7, (bits >> 6) & 1);
+    m.Set(8, 8, (bits >> 7) & 1);
+    m.Set(7, 8, (bits >> 8) & 1);
+    for (int i = 9; i < 15; i++) {
+        m.Set(14 - i, 8, (bits >> i) & 1);
+    }
+    for (int i = 0; i < 8; i++) {
+        m.Set(size - 1 - i, 8, (bits >> i) & 1);
+    }
+    for (int i = 8; i < 15; i++) {
+        m.Set(8, size - 15 + i, (bits >> i) & 1);
+    }
+    m.Set(8, size - 8, true);
+}
+
+static void DrawQrFunctionPatterns(QrMatrix& m, int version, int ecc) {
+    int size = m.size;
+    for (int i = 0; i < size; i++) {
+        m.Set(6, i, i % 2 == 0);
+        m.Set(i, 6, i % 2 == 0);
+    }
+
+    // Finder patterns with their separators
+    const int centers[3][2] = { { 3, 3 }, { size - 4, 3 }, { 3, size - 4 } };
+    for (const auto& center : centers) {
+        for (int dy = -4; dy <= 4; dy++) {
+            for (int dx = -4; dx <= 4; dx++) {
+                int x = center[0] + dx;
+                int y = center[1] + dy;
+                if (x >= 0 && x < size && y >= 0 && y < size) {
+                    int distance = std::max(std::abs(dx), std::abs(dy));
+                    m.Set(x, y, distance != 2 && distance != 4);
+                }
+            }
+        }
+    }
+
+    std::vector<int> positions = QrAlignmentPositions(version);
+    int count = (int)positions.size();
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < count; j++) {
+            // Skip the three corners taken by finder patterns
+            if ((i == 0 && j == 0) || (i == 0 && j == count - 1) || (i == count - 1 && j == 0)) {
+                continue;
+            }
+            for (int dy = -2; dy <= 2; dy++) {
+                for (int dx = -2; dx <= 2; dx++) {
+                    m.Set(positions[i] + dx, positions[j] + dy, std::max(std::abs(dx), std::abs(dy)) != 1);
+                }
+            }
+        }
+    }
+
+    // Reserve the format areas; the real bits are drawn once the mask is chosen
+    DrawQrFormatBits(m, ecc, 0);
+
+    if (version >= 7) {
+        int remainder = version;
+        for (int i = 0; i < 12; i++) {
+            remainder = (remainder << 1) ^ ((remainder >> 11) * 0x1F25);
+        }
+        long bits = (long)version << 12 | remainder;
+        for (int i = 0; i < 18; i++) {
+            bool bit = (bits >> i) & 1;
+            int a = size - 11 + i % 3;
+            int b = i / 3;
+            m.Set(a, b, bit);
+            m.Set(b, a, bit);
+        }
+    }
+}
+
+static bool QrMaskBit(int mask, int x, int y) {
+    switch (mask) {
+    case 0: return (x + y) % 2 == 0;
+    case 1: return y % 2 == 0;
+    case 2: return x % 3 == 0;
+    case 3: return (x + y) % 3 == 0;
+    case 4: return (x / 3 + y / 2) % 2 == 0;
+    case 5: return x * y % 2 + x * y % 3 == 0;
+    case 6: return (x * y % 2 + x * y % 3) % 2 == 0;
+    default: return ((x + y) % 2 + x * y % 3) % 2 == 0;
+    }
+}
+
+static void ApplyQrMask(QrMatrix& m, int mask) {
+    for (int y = 0; y < m.size; y++) {
+        for (int x = 0; x < m.size; x++) {
+            size_t index = (size_t)y * m.size + x;
+            if (!m.function[index] && QrMaskBit(mask, x, y)) {
+                m.dark[index] ^= 1;
+            }
+        }
+    }
+}
+
+static long QrPenalty(const QrMatrix& m) {
+    static const unsigned char kFinderLike[2][11] = {
+        { 1, 0, 1, 1, 1, 0, 1, 0, 0, 0, 0 },
+        { 0, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1 }
+    };
+    int size = m.size;
+    long penalty = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int a = 0; a < size; a++) {
+            // Rows on the first pass, columns on the second
+            auto at = [&](int b) {
+                return pass == 0 ? m.dark[(size_t)a * size + b] : m.dark[(size_t)b * size + a];
+            };
+            int run = 1;
+            for (int b = 1; b <= size; b++) {
+                if (b < size && at(b) == at(b - 1)) {
+                    run++;
+                    continue;
+                }
+                if (run >= 5) {
+                    penalty += 3 + (run - 5);
+                }
+                run = 1;
+            }
+            for (int b = 0; b + 11 <= size; b++) {
+                for (const auto& pattern : kFinderLike) {
+                    int k = 0;
+                    while (k < 11 && at(b + k) == pattern[k]) {
+                        k++;
+                    }
+                    if (k == 11) {
+                        penalty += 40;
+                    }
+                }
+            }
+        }
+    }
+    long darkCount = 0;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            unsigned char c = m.dark[(size_t)y * size + x];
+            darkCount += c;
+            if (x + 1 < size && y + 1 < size && c == m.dark[(size_t)y * size + x + 1] &&
+                c == m.dark[(size_t)(y + 1) * size + x] && c == m.dark[(size_t)(y + 1) * size + x + 1]) {
+                penalty += 3;
+            }
+        }
+    }
+    long total = (long)size * size;
+    long k = (std::labs(darkCount * 20 - total * 10) + total - 1) / total - 1;
+    return penalty + k * 10;
+}
+
+static bool EncodeQr(const std::string& data, int ecc, BarcodeSymbol* symbol, std::string* error) {
+    if (ecc < 0 || ecc > 3) {
+        return Fail(error, "QR error correction level must be L, M, Q or H");
+    }
+    if (data.empty()) {
+        return Fail(error, "Barcode data is empty");
+    }
+
+    // One segment in the densest mode that covers all of the data
+    bool numeric = data.find_first_not_of("0123456789") == std::string::npos;
+    bool alphanumeric = !numeric && data.find_first_not_of(kQrAlphanumeric) == std::string::npos;
+    int modeBits = numeric ? 0x1 : alphanumeric ? 0x2 : 0x4;
+    size_t length = data.size();
+    size_t dataBits = numeric ? length / 3 * 10 + (length % 3 == 2 ? 7 : length % 3 == 1 ? 4 : 0)
+                    : alphanumeric ? length / 2 * 11 + (length % 2) * 6
+                    : length * 8;
+
+    int version = 0;
+    int countBits = 0;
+    for (int v = 1; v <= 40; v++) {
+        int range = v <= 9 ? 0 : v <= 26 ? 1 : 2;
+        countBits = numeric ? 10 + 2 * range : alphanumeric ? 9 + 2 * range : (range == 0 ? 8 : 16);
+        if (length < ((size_t)1 << countBits) &&
+            4 + countBits + dataBits <= (size_t)QrDataCodewords(v, ecc) * 8) {
+            version = v;
+            break;
+        }
+    }
+    if (version == 0) {
+        return Fail(error, "Data is too long for a QR code");
+    }
+
+    BitBuffer bits;
+    bits.Append(modeBits, 4);
+    bits.Append((unsigned int)length, countBits);
+    if (numeric) {
+        for (size_t i = 0; i < length; i += 3) {
+            size_t n = std::min<size_t>(3, length - i);
+            bits.Append((unsigned int)atoi(data.substr(i, n).c_str()), (int)n * 3 + 1);
+        }
+    } else if (alphanumeric) {
+        for (size_t i = 0; i < length; i += 2) {
+            unsigned int value = (unsigned int)(strchr(kQrAlphanumeric, data[i]) - kQrAlphanumeric);
+            if (i + 1 < length) {
+                value = value * 45 + (unsigned int)(strchr(kQrAlphanumeric, data[i + 1]) - kQrAlphanumeric);
+                bits.Append(value, 11);
+            } else {
+                bits.Append(value, 6);
+            }
+        }
+    } else {
+        for (unsigned char c : data) {
+            bits.Append(c, 8);
+        }
+    }
+
+    // Terminator, byte alignment and alternating pad bytes
+    size_t capacityBits = (size_t)QrDataCodewords(version, ecc) * 8;
+    bits.Append(0, (int)std::min<size_t>(4, capacityBits - bits.Size()));
+    bits.Append(0, (int)((8 - bits.Size() % 8) % 8));
+    for (unsigned int pad = 0xEC; bits.Size() < capacityBits; pad ^= 0xEC ^ 0x11) {
+        bits.Append(pad, 8);
+    }
+    std::vector<unsigned char> codewords = bits.Bytes();
+
+    // Split into blocks, add check codewords and interleave
+    int blocks = kQrBlocks[ecc][version];
+    int eccLength = kQrEccPerBlock[ecc][version];
+    int rawCodewords = QrRawDataModules(version) / 8;
+    int shortBlocks = blocks - rawCodewords % blocks;
+    int shortLength = rawCodewords / blocks;
+    std::vector<std::vector<unsigned char>> blockData;
+    std::vector<std::vector<unsigned char>> blockEcc;
+    size_t offset = 0;
+    for (int i = 0; i < blocks; i++) {
+        int dataLength = shortLength - eccLength + (i < shortBlocks ? 0 : 1);
+        blockData.emplace_back(codewords.begin() + offset, codewords.begin() + offset + dataLength);
+        blockEcc.push_back(ReedSolomon(QrField(), blockData.back().data(), dataLength, eccLength, 0));
+        offset += dataLength;
+    }
+    std::vector<unsigned char> interleaved;
+    for (int i = 0; i <= shortLength - eccLength; i++) {
+        for (int j = 0; j < blocks; j++) {
+            if (i < (int)blockData[j].size()) {
+                interleaved.push_back(blockData[j][i]);
+            }
+        }
+    }
+    for (int i = 0; i < eccLength; i++) {
+        for (int j = 0; j < blocks; j++) {
+            interleaved.push_back(blockEcc[j][i]);
+        }
+    }
+
+    int size = version * 4 + 17;
+    QrMatrix matrix(size);
+    DrawQrFunctionPatterns(matrix, version, ecc);
+
+    // Codewords zigzag up and down two-module columns from the right,
+    // skipping the vertical timing pattern
+    size_t bit = 0;
+    for (int right = size - 1; right >= 1; right -= 2) {
+        if (right == 6) {
+            right = 5;
+        }
+        for (int vertical = 0; vertical < size; vertical++) {
+            for (int j = 0; j < 2; j++) {
+                int x = right - j;
+                bool upward = ((right + 1) & 2) == 0;
+                int y = upward ? size - 1 - vertical : vertical;
+                size_t index = (size_t)y * size + x;
+                if (!matrix.function[index] && bit < interleaved.size() * 8) {
+                    matrix.dark[index] = (interleaved[bit >> 3] >> (7 - (bit & 7))) & 1;
+                    bit++;
+                }
+            }
+        }
+    }
+
+    int bestMask = 0;
+    long bestPenalty = -1;
+    for (int mask = 0; mask < 8; mask++) {
+        ApplyQrMask(matrix, mask);
+        DrawQrFormatBits(matrix, ecc, mask);
+        long penalty = QrPenalty(matrix);
+        if (bestPenalty < 0 || penalty < bestPenalty) {
+            bestMask = mask;
+            bestPenalty = penalty;
+        }
+        ApplyQrMask(matrix, mask);  // XOR again to undo
+    }
+    ApplyQrMask(matrix, bestMask);
+    DrawQrFormatBits(matrix, ecc, bestMask);
+
+    symbol->columns = size;
+    symbol->rows = size;
+    symbol->quietZone = 4;
+    symbol->modules = matrix.dark;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Data Matrix ECC 200
+
+struct DataMatrixSize {
+    int size;           // modules per side, including finder and clock tracks
+    int region;         // data modules per side of one region
+    int dataCodewords;
+    int eccCodewords;
+    int blocks;         // interleaved Reed-Solomon blocks
+};
+
+static const DataMatrixSize kDataMatrixSizes[] = {
+    { 10, 8, 3, 5, 1 }, { 12, 10, 5, 7, 1 }, { 14, 12, 8, 10, 1 }, { 16, 14, 12, 12, 1 },
+    { 18, 16, 18, 14, 1 }, { 20, 18, 22, 18, 1 }, { 22, 20, 30, 20, 1 }, { 24, 22, 36, 24, 1 },
+    { 26, 24, 44, 28, 1 }, { 32, 14, 62, 36, 1 }, { 36, 16, 86, 42, 1 }, { 40, 18, 114, 48, 1 },
+    { 44, 20, 144, 56, 1 }, { 48, 22, 174, 68, 1 }, { 52, 24, 204, 84, 2 }, { 64, 14, 280, 112, 2 },
+    { 72, 16, 368, 144, 4 }, { 80, 18, 456, 192, 4 }, { 88, 20, 576, 224, 4 }, { 96, 22, 696, 272, 4 },
+    { 104, 24, 816, 336, 6 }, { 120, 18, 1050, 408, 6 }, { 132, 20, 1304, 496, 8 }, { 144, 22, 1558, 620, 10 }
+};
+
+// Module placement of ISO/IEC 16022 Annex F on the nrow x ncol mapping matrix
+// (the data regions without their finder and clock tracks). Each cell gets
+// codeword * 10 + bit (1 = most significant), or 1 for the fixed dark corner.
+class DataMatrixPlacement {
+public:
+    DataMatrixPlacement(int rows, int columns) : m_rows(rows), m_columns(columns), m_cells((size_t)rows * columns, 0) {}
+
+    const std::vector<int>& Place() {
+        int chr = 1;
+        int row = 4;
+        int col = 0;
+        do {
+            if (row == m_rows && col == 0) {
+                Corner1(chr++);
+            }
+            if (row == m_rows - 2 && col == 0 && m_columns % 4) {
+                Corner2(chr++);
+            }
+            if (row == m_rows - 2 && col == 0 && m_columns % 8 == 4) {
+                Corner3(chr++);
+            }
+            if (row == m_rows + 4 && col == 2 && !(m_columns % 8)) {
+                Corner4(chr++);
+            }
+            do {
+                if (row < m_rows && col >= 0 && !Cell(row, col)) {
+                    Utah(row, col, chr++);
+                }
+                row -= 2;
+                col += 2;
+            } while (row >= 0 && col < m_columns);
+            row += 1;
+            col += 3;
+            do {
+                if (row >= 0 && col < m_columns && !Cell(row, col)) {
+                    Utah(row, col, chr++);
+                }
+                row += 2;
+                col -= 2;
+            } while (row < m_rows && col >= 0);
+            row += 3;
+            col += 1;
+        } while (row < m_rows || col < m_columns);
+
+        if (!Cell(m_rows - 1, m_columns - 1)) {
+            Cell(m_rows - 1, m_columns - 1) = 1;
+            Cell(m_rows - 2, m_columns - 2) = 1;
+        }
+        return m_cells;
+    }
+
+private:
+    int& Cell(int row, int col) { return m_cells[(size_t)row * m_columns + col]; }
+
+    void Module(int row, int col, int chr, int bit) {
+        if (row < 0) {
+            row += m_rows;
+            col += 4 - ((m_rows + 4) % 8);
+        }
+        if (col < 0) {
+            col += m_columns;
+            row += 4 - ((m_columns + 4) % 8);
+        }
+        Cell(row, col) = chr * 10 + bit;
+    }
+
+    void Utah(int row, int col, int chr) {
+        Module(row - 2, col - 2, chr, 1);
+        Module(row - 2, col - 1, chr, 2);
+        Module(row - 1, col - 2, chr, 3);
+        Module(row - 1, col - 1, chr, 4);
+        Module(row - 1, col, chr, 5);
+        Module(row, col - 2, chr, 6);
+        Module(row, col - 1, chr, 7);
+        Module(row, col, chr, 8);
+    }
+
+    void Corner1(int chr) {
+        Module(m_rows - 1, 0, chr, 1);
+        Module(m_rows - 1, 1, chr, 2);
+        Module(m_rows - 1, 2, chr, 3);
+        Module(0, m_columns - 2, chr, 4);
+        Module(0, m_columns - 1, chr, 5);
+        Module(1, m_columns - 1, chr, 6);
+        Module(2, m_columns - 1, chr, 7);
+        Module(3, m_columns - 1, chr, 8);
+    }
+
+    void Corner2(int chr) {
+        Module(m_rows - 3, 0, chr, 1);
+        Module(m_rows - 2, 0, chr, 2);
+        Module(m_rows - 1, 0, chr, 3);
+        Module(0, m_columns - 4, chr, 4);
+        Module(0, m_columns - 3, chr, 5);
+        Module(0, m_columns - 2, chr, 6);
+        Module(0, m_columns - 1, chr, 7);
+        Module(1, m_columns - 1, chr, 8);
+    }
+
+    void Corner3(int chr) {
+        Module(m_rows - 3, 0, chr, 1);
+        Module(m_rows - 2, 0, chr, 2);
+        Module(m_rows - 1, 0, chr, 3);
+        Module(0, m_columns - 2, chr, 4);
+        Module(0, m_columns - 1, chr, 5);
+        Module(1, m_columns - 1, chr, 6);
+        Module(2, m_columns - 1, chr, 7);
+        Module(3, m_columns - 1, chr, 8);
+    }
+
+    void Corner4(int chr) {
+        Module(m_rows - 1, 0, chr, 1);
+        Module(m_rows - 1, m_columns - 1, chr, 2);
+        Module(0, m_columns - 3, chr, 3);
+        Module(0, m_columns - 2, chr, 4);
+        Module(0, m_columns - 1, chr, 5);
+        Module(1, m_columns - 3, chr, 6);
+        Module(1, m_columns - 2, chr, 7);
+        Module(1, m_columns - 1, chr, 8);
+    }
+
+    int m_rows;
+    int m_columns;
+    std::vector<int> m_cells;
+};
+
+static bool EncodeDataMatrix(const std::string& data, BarcodeSymbol* symbol, std::string* error) {
+    if (data.empty()) {
+        return Fail(error, "Barcode data is empty");
+    }
+
+    // ASCII encodation: digit pairs in one codeword, bytes above 127 behind
+    // an upper shift
+    std::vector<unsigned char> codewords;
+    for (size_t i = 0; i < data.size(); i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (c >= '0' && c <= '9' && i + 1 < data.size() && data[i + 1] >= '0' && data[i + 1] <= '9') {
+            codewords.push_back((unsigned char)(130 + (c - '0') * 10 + (data[i + 1] - '0')));
+            i++;
+        } else if (c > 127) {
+            codewords.push_back(235);
+            codewords.push_back((unsigned char)(c - 127));
+        } else {
+            codewords.push_back((unsigned char)(c + 1));
+        }
+    }
+
+    const DataMatrixSize* size = nullptr;
+    for (const DataMatrixSize& candidate : kDataMatrixSizes) {
+        if ((int)codewords.size() <= candidate.dataCodewords) {
+            size = &candidate;
+            break;
+        }
+    }
+    if (!size) {
+        return Fail(error, "Data is too long for a Data Matrix symbol");
+    }
+
+    // The first pad is 129, later ones are randomized by their position
+    if ((int)codewords.size() < size->dataCodewords) {
+        codewords.push_back(129);
+    }
+    while ((int)codewords.size() < size->dataCodewords) {
+        int position = (int)codewords.size() + 1;
+        int pad = 129 + (149 * position) % 253 + 1;
+        codewords.push_back((unsigned char)(pad <= 254 ? pad : pad - 254));
+    }
+
+    // Block b holds every blocks-th data codeword starting at b; its check
+    // codewords are interleaved the same way after the data
+    int blocks = size->blocks;
+    int eccPerBlock = size->eccCodewords / blocks;
+    codewords.resize(size->dataCodewords + size->eccCodewords);
+    for (int b = 0; b < blocks; b++) {
+        std::vector<unsigned char> blockData;
+        for (int i = b; i < size->dataCodewords; i += blocks) {
+            blockData.push_back(codewords[i]);
+        }
+        std::vector<unsigned char> ecc = ReedSolomon(DataMatrixField(), blockData.data(), blockData.size(),
+                                                     eccPerBlock, 1);
+        for (int j = 0; j < eccPerBlock; j++) {
+            codewords[size->dataCodewords + j * blocks + b] = ecc[j];
+        }
+    }
+
+    int regions = size->size / (size->region + 2);
+    int mapping = regions * size->region;
+    DataMatrixPlacement placement(mapping, mapping);
+    const std::vector<int>& cells = placement.Place();
+
+    int n = size->size;
+    symbol->modules.assign((size_t)n * n, 0);
+    int block = size->region + 2;
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            int by = y % block;
+            int bx = x % block;
+            bool dark;
+            if (bx == 0 || by == block - 1) {
+                dark = true;                 // solid L finder
+            } else if (by == 0) {
+                dark = bx % 2 == 0;          // top clock track
+            } else if (bx == block - 1) {
+                dark = by % 2 == 1;          // right clock track
+            } else {
+                int cell = cells[(size_t)((y / block) * size->region + by - 1) * mapping +
+                                 (x / block) * size->region + bx - 1];
+                dark = cell == 1 || (cell >= 10 && (codewords[cell / 10 - 1] >> (8 - cell % 10)) & 1);
+            }
+            symbol->modules[(size_t)y * n + x] = dark ? 1 : 0;
+        }
+    }
+    symbol->columns = n;
+    symbol->rows = n;
+    symbol->quietZone = 1;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+bool Barcode::ParseType(const std::string& name, BarcodeType* type) {
+    if (name == "code128") {
+        *type = BARCODE_CODE128;
+    } else if (name == "gs1-128") {
+        *type = BARCODE_GS1_128;
+    } else if (name == "datamatrix") {
+        *type = BARCODE_DATAMATRIX;
+    } else if (name == "qr") {
+        *type = BARCODE_QR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool Barcode::Encode(BarcodeType type, const std::string& data, int eccLevel, BarcodeSymbol* symbol,
+                     std::string* error) {
+    symbol->type = type;
+    switch (type) {
+    case BARCODE_CODE128: {
+        std::vector<int> text(data.begin(), data.end());
+        for (int& c : text) {
+            c = (unsigned char)c;
+        }
+        return EncodeCode128(text, symbol, error);
+    }
+    case BARCODE_GS1_128: {
+        std::vector<int> text;
+        return ParseGs1(data, &text, error) && EncodeCode128(text, symbol, error);
+    }
+    case BARCODE_DATAMATRIX:
+        return EncodeDataMatrix(data, symbol, error);
+    case BARCODE_QR:
+        return EncodeQr(data, eccLevel, symbol, error);
+    }
+    return Fail(error, "Unknown barcode type");
+}
+
+// Fill a rectangle given in unrotated page pixels, mapped through the page
+// rotation into the target buffer and clipped to it
+static void FillRect(const BarcodeTarget& target, int x0, int y0, int x1, int y1, unsigned char value) {
+    int w = target.pageWidth;
+    int h = target.pageHeight;
+    int rx0, ry0, rx1, ry1;
+    switch (target.rotation & 3) {
+    case 1: rx0 = h - y1; ry0 = x0; rx1 = h - y0; ry1 = x1; break;
+    case 2: rx0 = w - x1; ry0 = h - y1; rx1 = w - x0; ry1 = h - y0; break;
+    case 3: rx0 = y0; ry0 = w - x1; rx1 = y1; ry1 = w - x0; break;
+    default: rx0 = x0; ry0 = y0; rx1 = x1; ry1 = y1; break;
+    }
+    rx0 = std::max(rx0 - target.originX, 0);
+    rx1 = std::min(rx1 - target.originX, target.width);
+    ry0 = std::max(ry0 - target.originY, 0);
+    ry1 = std::min(ry1 - target.originY, target.height);
+    if (rx0 >= rx1 || ry0 >= ry1) {
+        return;
+    }
+    for (int y = ry0; y < ry1; y++) {
+        unsigned char* row = target.buffer + (size_t)y * target.stride;
+        if (target.gray) {
+            memset(row + rx0, value, rx1 - rx0);
+        } else {
+            for (int x = rx0; x < rx1; x++) {
+                row[x * 4] = value;
+                row[x * 4 + 1] = value;
+                row[x * 4 + 2] = value;
+                row[x * 4 + 3] = 255;
+            }
+        }
+    }
+}
+
+void Barcode::Draw(const BarcodeSymbol& symbol, int x, int y, int modulePixels, int barHeight,
+                   const BarcodeTarget& target) {
+    if (!target.buffer || modulePixels <= 0 || symbol.columns <= 0 || symbol.rows <= 0) {
+        return;
+    }
+    bool linear = symbol.type == BARCODE_CODE128 || symbol.type == BARCODE_GS1_128;
+    int rowHeight = linear ? barHeight : modulePixels;
+    if (rowHeight <= 0) {
+        return;
+    }
+
+    // Clear the symbol and its quiet zone (only left and right for linear codes)
+    int quiet = symbol.quietZone * modulePixels;
+    int width = symbol.columns * modulePixels;
+    int height = symbol.rows * rowHeight;
+    int verticalQuiet = linear ? 0 : quiet;
+    FillRect(target, x - quiet, y - verticalQuiet, x + width + quiet, y + height + verticalQuiet, 255);
+
+    // One rectangle per run of dark modules. Unrotated, each module row is
+    // drawn on its first visible pixel row and copied to the rest, which
+    // keeps tall linear bars cheap.
+    bool copyRows = (target.rotation & 3) == 0;
+    int spanLeft = std::max(x - quiet - target.originX, 0);
+    int spanRight = std::min(x + width + quiet - target.originX, target.width);
+    int bytesPerPixel = target.gray ? 1 : 4;
+    for (int row = 0; row < symbol.rows; row++) {
+        const unsigned char* modules = &symbol.modules[(size_t)row * symbol.columns];
+        int top = y + row * rowHeight;
+        int bottom = top + rowHeight;
+        int first = std::max(top - target.originY, 0);
+        int last = std::min(bottom - target.originY, target.height);
+        if (copyRows) {
+            if (first >= last || spanLeft >= spanRight) {
+                continue;
+            }
+            top = first + target.originY;
+            bottom = top + 1;
+        }
+        for (int col = 0; col < symbol.columns;) {
+            if (!modules[col]) {
+                col++;
+                continue;
+            }
+            int end = col;
+            while (end < symbol.columns && modules[end]) {
+                end++;
+            }
+            FillRect(target, x + col * modulePixels, top, x + end * modulePixels, bottom, 0);
+            col = end;
+        }
+        if (copyRows) {
+            const unsigned char* source = target.buffer + (size_t)first * target.stride + spanLeft * bytesPerPixel;
+            for (int line = first + 1; line < last; line++) {
+                memcpy(target.buffer + (size_t)line * target.stride + spanLeft * bytesPerPixel, source,
+                       (size_t)(spanRight - spanLeft) * bytesPerPixel);
+            }
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef BARCODE_H
+#define BARCODE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * 条码类型
+ */
+enum BarcodeType {
+    BARCODE_CODE128 = 0,     // Code 128（自动切换 A/B/C 字符集）
+    BARCODE_GS1_128 = 1,     // GS1-128，数据按 "(01)09501101530003(10)ABC" 的形式给出应用标识符
+    BARCODE_DATAMATRIX = 2,  // Data Matrix ECC 200（正方形符号）
+    BARCODE_QR = 3           // QR 码（版本 1-40）
+};
+
+/**
+ * 编码后的条码符号
+ * 以模块为单位，不含静区
+ */
+struct BarcodeSymbol {
+    BarcodeType type = BARCODE_CODE128;
+    int columns = 0;    // 横向模块数
+    int rows = 0;       // 纵向模块数，一维条码为 1
+    int quietZone = 0;  // 四周需要留空的模块数
+    std::vector<unsigned char> modules;  // rows * columns，1 表示深色
+};
+
+/**
+ * 条码绘制目标：8 位灰度或 BGRA 像素缓冲区（可以是页面的一个条带）
+ */
+struct BarcodeTarget {
+    unsigned char* buffer = nullptr;
+    int width = 0;        // 缓冲区宽度（像素）
+    int height = 0;       // 缓冲区高度（像素）
+    int stride = 0;       // 每行字节数
+    bool gray = true;     // true 表示 8 位灰度，false 表示 BGRA
+    int originX = 0;      // 缓冲区左上角在（旋转后的）页面中的位置（像素）
+    int originY = 0;
+    int pageWidth = 0;    // 页面渲染宽度（像素，旋转前）
+    int pageHeight = 0;   // 页面渲染高度（像素，旋转前）
+    int rotation = 0;     // 页面顺时针旋转的 90° 次数（0-3）
+};
+
+/**
+ * 条码编码和光栅化
+ * 直接按设备分辨率写入像素：每个模块为整数个像素，边缘不经过缩放和抗锯齿，
+ * 单色化后模块宽度精确。不依赖 pdfium
+ */
+class Barcode {
+public:
+    /**
+     * 按名称解析条码类型
+     * @param name code128、gs1-128、datamatrix 或 qr
+     * @param type 输出条码类型
+     * @return 名称有效返回 true
+     */
+    static bool ParseType(const std::string& name, BarcodeType* type);
+
+    /**
+     * 编码条码
+     * @param type 条码类型
+     * @param data 数据（Code 128 为 ASCII；Data Matrix 和 QR 码为任意字节，通常为 UTF-8）
+     * @param eccLevel QR 码纠错等级：0 = L、1 = M、2 = Q、3 = H，其他类型忽略
+     * @param symbol 输出符号
+     * @param error 失败时输出错误描述
+     * @return 成功返回 true
+     */
+    static bool Encode(BarcodeType type, const std::string& data, int eccLevel, BarcodeSymbol* symbol,
+                       std::string* error);
+
+    /**
+     * 将符号绘制到缓冲区，先把符号及静区涂白，再画深色模块，超出缓冲区的部分被裁掉
+     * @param symbol 符号
+     * @param x 符号左上角（不含静区）在页面中的横坐标（像素，旋转前）
+     * @param y 符号左上角在页面中的纵坐标（像素，旋转前）
+     * @param modulePixels 每个模块的像素数
+     * @param barHeight 一维条码的条高（像素），二维条码忽略
+     * @param target 绘制目标
+     */
+    static void Draw(const BarcodeSymbol& symbol, int x, int y, int modulePixels, int barHeight,
+                     const BarcodeTarget& target);
+};
+
+#endif // BARCODE_H
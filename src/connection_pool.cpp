@@ -0,0 +1,250 @@
+#include "connection_pool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winspool.h>
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+typedef std::chrono::steady_clock Clock;
+
+struct IdleConnection {
+    PooledConnection* connection;
+    Clock::time_point since;
+};
+
+struct PoolKeyState {
+    std::vector<IdleConnection> idle;  // most recently used at the back
+    int active = 0;
+    long long created = 0;
+    double setupMs = 0;
+};
+
+static std::mutex g_poolMutex;
+static std::condition_variable g_poolReleased;
+static std::map<std::string, PoolKeyState> g_pool;
+static ConnectionPoolConfig g_poolConfig;
+static ConnectionPoolStats g_poolStats;
+
+// Collect idle connections that exceed the idle timeout or the per-key limit;
+// the caller deletes them after dropping the lock
+static void CollectExpiredLocked(std::vector<PooledConnection*>* expired) {
+    Clock::time_point now = Clock::now();
+    std::chrono::milliseconds timeout(g_poolConfig.idleTimeoutMs);
+    for (auto& entry : g_pool) {
+        PoolKeyState& state = entry.second;
+        size_t keep = 0;
+        for (size_t i = 0; i < state.idle.size(); i++) {
+            bool tooOld = now - state.idle[i].since >= timeout;
+            // Oldest entries are at the front, so trim those first when over the limit
+            bool overLimit = (int)(state.idle.size() - i) + state.active > g_poolConfig.maxPerKey;
+            if (tooOld || overLimit) {
+                expired->push_back(state.idle[i].connection);
+                g_poolStats.idleEvictions++;
+            } else {
+                state.idle[keep++] = state.idle[i];
+            }
+        }
+        state.idle.resize(keep);
+    }
+}
+
+static void DeleteConnections(const std::vector<PooledConnection*>& connections) {
+    for (PooledConnection* connection : connections) {
+        delete connection;
+    }
+}
+
+PooledConnection* ConnectionPool::Acquire(const std::string& key, const Factory& create, std::string* error) {
+    std::vector<PooledConnection*> expired;
+    std::unique_lock<std::mutex> lock(g_poolMutex);
+    CollectExpiredLocked(&expired);
+
+    // std::map references stay valid; keys are never erased
+    PoolKeyState& state = g_pool[key];
+    g_poolStats.acquires++;
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(g_poolConfig.acquireTimeoutMs);
+
+    for (;;) {
+        while (!state.idle.empty()) {
+            PooledConnection* connection = state.idle.back().connection;
+            state.idle.pop_back();
+            state.active++;
+
+            // Health checks may talk to the spooler; do not hold the lock
+            lock.unlock();
+            bool healthy = connection->IsHealthy();
+            lock.lock();
+
+            if (healthy) {
+                g_poolStats.hits++;
+                if (state.created > 0) {
+                    g_poolStats.savedMs += state.setupMs / state.created;
+                }
+                lock.unlock();
+                DeleteConnections(expired);
+                return connection;
+            }
+            state.active--;
+            g_poolStats.healthFailures++;
+            expired.push_back(connection);
+        }
+
+        if (state.active < g_poolConfig.maxPerKey) {
+            break;
+        }
+
+        g_poolStats.waits++;
+        if (g_poolReleased.wait_until(lock, deadline) == std::cv_status::timeout &&
+            state.idle.empty() && state.active >= g_poolConfig.maxPerKey) {
+            lock.unlock();
+            DeleteConnections(expired);
+            if (error) {
+                *error = "Timed out waiting for a free printer connection (" + key + ")";
+            }
+            return nullptr;
+        }
+    }
+
+    state.active++;
+    g_poolStats.misses++;
+    lock.unlock();
+    DeleteConnections(expired);
+
+    Clock::time_point start = Clock::now();
+    PooledConnection* connection = create(error);
+    double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    lock.lock();
+    if (!connection) {
+        state.active--;
+        g_poolReleased.notify_all();
+        return nullptr;
+    }
+    state.created++;
+    state.setupMs += elapsedMs;
+    g_poolStats.setupMs += elapsedMs;
+    return connection;
+}
+
+void ConnectionPool::Release(const std::string& key, PooledConnection* connection, bool reusable) {
+    if (!connection) {
+        return;
+    }
+
+    std::vector<PooledConnection*> expired;
+    {
+        std::lock_guard<std::mutex> lock(g_poolMutex);
+        PoolKeyState& state = g_pool[key];
+        state.active--;
+        if (reusable && g_poolConfig.idleTimeoutMs > 0) {
+            IdleConnection idle = { connection, Clock::now() };
+            state.idle.push_back(idle);
+        } else {
+            g_poolStats.discarded++;
+            expired.push_back(connection);
+        }
+        CollectExpiredLocked(&expired);
+    }
+    g_poolReleased.notify_all();
+    DeleteConnections(expired);
+}
+
+void ConnectionPool::Configure(const ConnectionPoolConfig& config) {
+    std::vector<PooledConnection*> expired;
+    {
+        std::lock_guard<std::mutex> lock(g_poolMutex);
+        g_poolConfig = config;
+        if (g_poolConfig.maxPerKey < 1) {
+            g_poolConfig.maxPerKey = 1;
+        }
+        CollectExpiredLocked(&expired);
+    }
+    g_poolReleased.notify_all();
+    DeleteConnections(expired);
+}
+
+ConnectionPoolConfig ConnectionPool::GetConfig() {
+    std::lock_guard<std::mutex> lock(g_poolMutex);
+    return g_poolConfig;
+}
+
+ConnectionPoolStats ConnectionPool::GetStats() {
+    std::lock_guard<std::mutex> lock(g_poolMutex);
+    ConnectionPoolStats stats = g_poolStats;
+    stats.idle = 0;
+    stats.active = 0;
+    for (auto& entry : g_pool) {
+        stats.idle += (int)entry.second.idle.size();
+        stats.active += entry.second.active;
+    }
+    return stats;
+}
+
+void ConnectionPool::Clear() {
+    std::vector<PooledConnection*> expired;
+    {
+        std::lock_guard<std::mutex> lock(g_poolMutex);
+        for (auto& entry : g_pool) {
+            for (IdleConnection& idle : entry.second.idle) {
+                expired.push_back(idle.connection);
+            }
+            entry.second.idle.clear();
+        }
+    }
+    DeleteConnections(expired);
+}
+
+// ---------------------------------------------------------------------------
+// PrinterConnection
+
+#ifdef _WIN32
+PrinterConnection::~PrinterConnection() {
+    if (dc) {
+        DeleteDC((HDC)dc);
+    }
+    if (printer) {
+        ClosePrinter((HANDLE)printer);
+    }
+}
+
+bool PrinterConnection::IsHealthy() {
+    // A stale handle (spooler restart, printer removed) fails GetPrinter
+    DWORD needed = 0;
+    PRINTER_INFO_6 info = {0};
+    return GetPrinterW((HANDLE)printer, 6, (LPBYTE)&info, sizeof(info), &needed) != 0;
+}
+
+PrinterConnection* PrinterConnection::Open(const std::wstring& printerName, bool withDC, std::string* error) {
+    PRINTER_DEFAULTSW printerDefaults = {0};
+    printerDefaults.DesiredAccess = PRINTER_ACCESS_USE;
+
+    std::wstring name = printerName;
+    HANDLE hPrinter = nullptr;
+    if (!OpenPrinterW(&name[0], &hPrinter, &printerDefaults)) {
+        if (error) {
+            *error = "Failed to open printer, error code: " + std::to_string(GetLastError());
+        }
+        return nullptr;
+    }
+
+    PrinterConnection* connection = new PrinterConnection();
+    connection->printer = hPrinter;
+    if (withDC) {
+        HDC hdc = CreateDCW(L"WINSPOOL", name.c_str(), nullptr, nullptr);
+        if (!hdc) {
+            if (error) {
+                *error = "Failed to create printer DC, error code: " + std::to_string(GetLastError());
+            }
+            delete connection;
+            return nullptr;
+        }
+        connection->dc = hdc;
+    }
+    return connection;
+}
+#endif
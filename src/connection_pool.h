@@ -0,0 +1,131 @@
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "raster_sink.h"
+
+/**
+ * 可复用的打印机连接
+ */
+class PooledConnection {
+public:
+    virtual ~PooledConnection() {}
+
+    /**
+     * 复用前的健康检查，应尽量廉价
+     * @return 连接仍可使用返回 true
+     */
+    virtual bool IsHealthy() = 0;
+};
+
+/**
+ * 原始端口 TCP 连接（如 9100 端口）
+ * 作业数据（ESC/POS、ZPL）自带边界，连接可以跨作业保持
+ */
+class SocketConnection : public PooledConnection {
+public:
+    bool IsHealthy() override { return sink.IsAlive(); }
+
+    SocketSink sink;
+};
+
+#ifdef _WIN32
+/**
+ * Windows 打印机句柄，可附带一个打印机 DC
+ * 同一个 DC 可以依次用于多个 StartDoc/EndDoc 作业
+ */
+class PrinterConnection : public PooledConnection {
+public:
+    ~PrinterConnection() override;
+    bool IsHealthy() override;
+
+    /**
+     * 打开打印机
+     * @param printerName 打印机名称
+     * @param withDC 是否同时创建打印机 DC（GDI 打印需要，RAW 作业不需要）
+     * @param error 失败时输出错误描述
+     * @return 连接指针，失败返回 nullptr
+     */
+    static PrinterConnection* Open(const std::wstring& printerName, bool withDC, std::string* error);
+
+    void* printer = nullptr;  // HANDLE
+    void* dc = nullptr;       // HDC
+};
+#endif
+
+/**
+ * 连接池配置
+ */
+struct ConnectionPoolConfig {
+    int maxPerKey = 4;                   // 每台打印机的最大连接数（使用中 + 空闲）
+    unsigned int idleTimeoutMs = 60000;  // 空闲连接超过该时间后关闭
+    unsigned int acquireTimeoutMs = 30000;  // 达到上限时等待空闲连接的最长时间
+};
+
+/**
+ * 连接池统计
+ */
+struct ConnectionPoolStats {
+    long long acquires = 0;        // 获取次数
+    long long hits = 0;            // 复用空闲连接次数
+    long long misses = 0;          // 新建连接次数
+    long long waits = 0;           // 因达到上限而等待的次数
+    long long healthFailures = 0;  // 健康检查失败而丢弃的连接数
+    long long idleEvictions = 0;   // 因空闲超时而关闭的连接数
+    long long discarded = 0;       // 出错后未归还而关闭的连接数
+    double setupMs = 0;            // 新建连接累计耗时
+    double savedMs = 0;            // 复用连接节省的估计耗时（按该打印机的平均建立耗时计）
+    int idle = 0;                  // 当前空闲连接数
+    int active = 0;                // 当前使用中的连接数
+};
+
+/**
+ * 打印机连接池
+ * 按键（如 "gdi:打印机名"、"raw:打印机名"、"tcp:主机:端口"）分组保存空闲连接，
+ * 稳定负载下的作业无需再打开打印机或建立 TCP 连接。线程安全
+ */
+class ConnectionPool {
+public:
+    typedef std::function<PooledConnection*(std::string* error)> Factory;
+
+    /**
+     * 获取连接：优先复用通过健康检查的空闲连接，否则调用 create 新建
+     * @param key 连接分组键
+     * @param create 新建连接的工厂函数
+     * @param error 失败时输出错误描述
+     * @return 连接指针，失败返回 nullptr。使用完后必须调用 Release
+     */
+    static PooledConnection* Acquire(const std::string& key, const Factory& create, std::string* error);
+
+    /**
+     * 归还连接
+     * @param key 连接分组键
+     * @param connection 连接指针
+     * @param reusable 连接是否仍可复用，false 时直接关闭（如作业出错）
+     */
+    static void Release(const std::string& key, PooledConnection* connection, bool reusable);
+
+    /**
+     * 修改配置，立即按新配置清理空闲连接
+     */
+    static void Configure(const ConnectionPoolConfig& config);
+
+    /**
+     * 获取当前配置
+     */
+    static ConnectionPoolConfig GetConfig();
+
+    /**
+     * 获取统计信息
+     */
+    static ConnectionPoolStats GetStats();
+
+    /**
+     * 关闭所有空闲连接
+     */
+    static void Clear();
+};
+
+#endif // CONNECTION_POOL_H
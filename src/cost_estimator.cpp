@@ -0,0 +1,89 @@
+#include "cost_estimator.h"
+#include "util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// Rough per-item costs in milliseconds on a reference desktop core; the
+// scheduler rescales them from measured run times
+static const double kPixelCost = 4.0;          // per output megapixel (fill, composite, hand-off)
+static const double kObjectCost = 0.01;        // per text or path object
+static const double kShadingCost = 0.5;        // per shading (evaluated over its whole area)
+static const double kImageCost = 8.0;          // per source image megapixel (decode and resample)
+static const double kTransparencyFactor = 1.5; // transparency groups render through extra buffers
+
+// Preflight parses the contents of at most this many pages, spread over the
+// document; the other pages borrow the content of the nearest sampled page
+static const int kSampledPages = 8;
+
+// Parsed document structures take a few times the file size
+static const size_t kDocumentOverhead = 3;
+static const size_t kJobBaseBytes = 4 * 1024 * 1024;
+
+double CostEstimator::ScorePage(const PageContent& content, int dpi, double* outputMegapixels) {
+    double pixels = (content.width / 72.0 * dpi) * (content.height / 72.0 * dpi) / 1e6;
+    if (outputMegapixels) {
+        *outputMegapixels = pixels;
+    }
+    double score = pixels * kPixelCost +
+                   (content.textObjects + content.pathObjects) * kObjectCost +
+                   content.shadingObjects * kShadingCost +
+                   content.imageMegapixels * kImageCost;
+    if (content.hasTransparency) {
+        score *= kTransparencyFactor;
+    }
+    return score;
+}
+
+bool CostEstimator::EstimateDocument(PdfDocument* document, int dpi, DocumentCost* cost) {
+    if (!document || !cost) {
+        return false;
+    }
+    Clock::time_point start = Clock::now();
+    DocumentCost local;
+    local.pages = PdfiumWrapper::GetPageCount(document);
+    local.documentBytes = PdfiumWrapper::GetDocumentSize(document);
+    if (local.pages == 0) {
+        return false;
+    }
+
+    // Each AnalyzePage call takes the pdfium lock for one page only, so
+    // renders on other threads get in between the sampled pages
+    int samples = std::min(local.pages, kSampledPages);
+    std::vector<PageContent> sampled(samples);
+    for (int j = 0; j < samples; j++) {
+        int pageIndex = samples > 1 ? (int)((long long)j * (local.pages - 1) / (samples - 1)) : 0;
+        if (!PdfiumWrapper::AnalyzePage(document, pageIndex, &sampled[j])) {
+            return false;
+        }
+    }
+    for (int i = 0; i < local.pages; i++) {
+        int nearest = local.pages > 1 ? (int)std::lround((double)i * (samples - 1) / (local.pages - 1)) : 0;
+        PageContent content = sampled[nearest];
+        if (!PdfiumWrapper::GetPageSize(document, i, &content.width, &content.height)) {
+            return false;
+        }
+        double pixels = 0;
+        double score = ScorePage(content, dpi, &pixels);
+        local.score += score;
+        if (score > local.maxPageScore) {
+            local.maxPageScore = score;
+        }
+        if (pixels > local.peakOutputMegapixels) {
+            local.peakOutputMegapixels = pixels;
+        }
+    }
+
+    local.analyzeMs = ElapsedMs(start, Clock::now());
+    *cost = local;
+    return true;
+}
+
+size_t CostEstimator::EstimateBytes(size_t documentBytes, double outputMegapixels, double bytesPerPixel) {
+    return documentBytes * kDocumentOverhead + kJobBaseBytes +
+           (size_t)(outputMegapixels * 1e6 * bytesPerPixel);
+}
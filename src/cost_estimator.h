@@ -0,0 +1,55 @@
+#ifndef COST_ESTIMATOR_H
+#define COST_ESTIMATOR_H
+
+#include <cstddef>
+#include "pdfium_win.h"
+
+/**
+ * 文档渲染开销预估
+ */
+struct DocumentCost {
+    int pages = 0;
+    double score = 0;                 // 各页开销之和（开销单位，校准后换算为毫秒）
+    double maxPageScore = 0;          // 开销最大的一页
+    double peakOutputMegapixels = 0;  // 最大一页的输出像素（百万像素）
+    size_t documentBytes = 0;         // 文档文件大小
+    double analyzeMs = 0;             // 预检耗时
+};
+
+/**
+ * 渲染开销预估
+ * 单页开销按页面内容计算，不渲染。整个文档的预检只解析均匀抽取的几页内容，
+ * 其余页面按尺寸计算，内容取最近的抽样页。开销单位约等于参考机器上的渲染毫秒数，
+ * 实际换算系数由调度器根据作业实际耗时校准
+ */
+class CostEstimator {
+public:
+    /**
+     * 计算单页开销
+     * @param content 页面内容统计
+     * @param dpi 渲染分辨率
+     * @param outputMegapixels 输出该页渲染后的像素数（百万像素，可为 nullptr）
+     * @return 开销
+     */
+    static double ScorePage(const PageContent& content, int dpi, double* outputMegapixels);
+
+    /**
+     * 预检文档：抽样分析页面内容（对象数、图像像素、透明度），按各页尺寸累计开销
+     * @param document 文档指针
+     * @param dpi 渲染分辨率
+     * @param cost 输出开销预估
+     * @return 成功返回 true
+     */
+    static bool EstimateDocument(PdfDocument* document, int dpi, DocumentCost* cost);
+
+    /**
+     * 预估作业峰值内存
+     * @param documentBytes 文档文件大小
+     * @param outputMegapixels 最大一页的输出像素（百万像素）
+     * @param bytesPerPixel 每个输出像素同时占用的字节数（整页位图及其副本），按条带渲染时为 0
+     * @return 字节数
+     */
+    static size_t EstimateBytes(size_t documentBytes, double outputMegapixels, double bytesPerPixel);
+};
+
+#endif // COST_ESTIMATOR_H
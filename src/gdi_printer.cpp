@@ -0,0 +1,412 @@
+#include "gdi_printer.h"
+#include "connection_pool.h"
+#include "metrics.h"
+#include "printer_caps.h"
+#include "util.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// A print job open on a pooled printer DC
+struct GdiDocument {
+    PrinterCaps caps;
+    std::string poolKey;
+    PrinterConnection* connection = nullptr;
+    HDC dc = nullptr;
+};
+
+// Switch the DC's devmode to duplex. Short-edge binding is emulated by the
+// caller (back sides rendered upside down), so the device always flips on
+// the long edge; drivers that only implement that one still bind correctly.
+static bool SetDuplex(PrinterConnection* connection, const std::wstring& printerName, std::string* error) {
+    HANDLE hPrinter = (HANDLE)connection->printer;
+    std::wstring name = printerName;
+    LONG size = DocumentPropertiesW(nullptr, hPrinter, &name[0], nullptr, nullptr, 0);
+    if (size <= 0) {
+        return Fail(error, "Failed to query printer settings, error code: " + std::to_string(GetLastError()));
+    }
+    std::vector<unsigned char> buffer(size);
+    DEVMODEW* devMode = (DEVMODEW*)buffer.data();
+    if (DocumentPropertiesW(nullptr, hPrinter, &name[0], devMode, nullptr, DM_OUT_BUFFER) != IDOK) {
+        return Fail(error, "Failed to query printer settings, error code: " + std::to_string(GetLastError()));
+    }
+    devMode->dmFields |= DM_DUPLEX;
+    devMode->dmDuplex = DMDUP_VERTICAL;
+    if (DocumentPropertiesW(nullptr, hPrinter, &name[0], devMode, devMode, DM_IN_BUFFER | DM_OUT_BUFFER) != IDOK ||
+        !ResetDCW((HDC)connection->dc, devMode)) {
+        return Fail(error, "Failed to enable duplex printing, error code: " + std::to_string(GetLastError()));
+    }
+    return true;
+}
+
+static bool BeginDocument(const std::wstring& printerName, bool duplex, GdiDocument* document, std::string* error) {
+    // Resolve the printer and its geometry from the capability cache; the
+    // spooler/driver is only queried when the entry is missing or stale
+    if (!PrinterCapsCache::Get(printerName, PrinterCapsCache::kDefaultMaxAgeMs, &document->caps, error)) {
+        return false;
+    }
+    std::wstring resolvedName = document->caps.name;
+    if (duplex && !document->caps.duplex) {
+        return Fail(error, "Printer does not support duplex printing: " + WideToUtf8(resolvedName));
+    }
+    
+    // Reuse an open printer handle and DC from the pool when possible. A DC
+    // switched to duplex keeps that devmode, so it is pooled separately.
+    document->poolKey = "gdi:" + WideToUtf8(resolvedName) + (duplex ? "|duplex" : "");
+    document->connection = static_cast<PrinterConnection*>(ConnectionPool::Acquire(document->poolKey,
+        [&](std::string* createError) -> PooledConnection* {
+            PrinterConnection* connection = PrinterConnection::Open(resolvedName, true, createError);
+            if (connection && duplex && !SetDuplex(connection, resolvedName, createError)) {
+                delete connection;
+                return nullptr;
+            }
+            return connection;
+        }, error));
+    if (!document->connection) {
+        PrinterCapsCache::Invalidate(resolvedName);
+        return false;
+    }
+    document->dc = (HDC)document->connection->dc;
+    
+    DOCINFOW di = {0};
+    di.cbSize = sizeof(di);
+    di.lpszDocName = L"PDF Print Job";
+    
+    StageTimer startTimer(STAGE_SPOOL_START);
+    int docResult = StartDocW(document->dc, &di);
+    startTimer.Stop();
+    if (docResult <= 0) {
+        DWORD errorCode = GetLastError();
+        ConnectionPool::Release(document->poolKey, document->connection, false);
+        document->connection = nullptr;
+        std::string errorMsg = "Failed to start print job (StartDocW), error code: " + std::to_string(errorCode);
+        return Fail(error, errorMsg);
+    }
+    return true;
+}
+
+// Drop a started job and the DC it was printed on
+static void AbortDocument(GdiDocument* document) {
+    if (!document->connection) {
+        return;
+    }
+    AbortDoc(document->dc);
+    ConnectionPool::Release(document->poolKey, document->connection, false);
+    document->connection = nullptr;
+}
+
+static bool EndDocument(GdiDocument* document, std::string* error) {
+    StageTimer timer(STAGE_SPOOL_END);
+    bool docEnded = EndDoc(document->dc) > 0;
+    timer.Stop();
+    DWORD errorCode = GetLastError();
+    ConnectionPool::Release(document->poolKey, document->connection, docEnded);
+    document->connection = nullptr;
+    if (!docEnded) {
+        return Fail(error, "Failed to finish print job (EndDoc), error code: " + std::to_string(errorCode));
+    }
+    return true;
+}
+
+// Finish the page that StartPage began; on failure the job is aborted
+static bool FinishPage(GdiDocument* document, std::string* error) {
+    if (EndPage(document->dc) <= 0) {
+        DWORD errorCode = GetLastError();
+        AbortDocument(document);
+        return Fail(error, "Failed to finish page (EndPage), error code: " + std::to_string(errorCode));
+    }
+    Metrics::Add(COUNTER_PAGES, 1);
+    return true;
+}
+
+// Print one page of an open job, with the bitmap scaled to fit the printable
+// area; a null bitmap leaves the page blank. On failure the job is aborted.
+static bool PrintPage(GdiDocument* document, HBITMAP hBitmap, std::string* error) {
+    StageTimer timer(STAGE_SPOOL_PAGE);
+    HDC hdcPrinter = document->dc;
+    int pageResult = StartPage(hdcPrinter);
+    if (pageResult <= 0) {
+        DWORD errorCode = GetLastError();
+        AbortDocument(document);
+        std::string errorMsg = "Failed to start page (StartPage), error code: " + std::to_string(errorCode);
+        return Fail(error, errorMsg);
+    }
+    if (!hBitmap) {
+        return FinishPage(document, error);
+    }
+    
+    // Get bitmap dimensions
+    BITMAP bm;
+    GetObject(hBitmap, sizeof(BITMAP), &bm);
+    
+    // Printer page size and margins come from the cached capabilities
+    int marginX = document->caps.offsetX;
+    int marginY = document->caps.offsetY;
+    int printableWidth = document->caps.printableWidth;
+    int printableHeight = document->caps.printableHeight;
+    
+    // Validate dimensions
+    if (bm.bmWidth <= 0 || bm.bmHeight <= 0 || 
+        printableWidth <= 0 || printableHeight <= 0) {
+        PrinterCapsCache::Invalidate(document->caps.name);
+        AbortDocument(document);
+        std::string errorMsg = "Invalid bitmap or printer dimensions (bitmap: " + 
+                               std::to_string(bm.bmWidth) + "x" + std::to_string(bm.bmHeight) +
+                               ", printable: " + std::to_string(printableWidth) + "x" + std::to_string(printableHeight) + ")";
+        return Fail(error, errorMsg);
+    }
+    
+    // Calculate scaling to fit printable area
+    double scaleX = (double)printableWidth / bm.bmWidth;
+    double scaleY = (double)printableHeight / bm.bmHeight;
+    double scale = (scaleX < scaleY) ? scaleX : scaleY;
+    
+    int printWidth = (int)(bm.bmWidth * scale);
+    int printHeight = (int)(bm.bmHeight * scale);
+    int printX = marginX + (printableWidth - printWidth) / 2;
+    int printY = marginY + (printableHeight - printHeight) / 2;
+    
+    // Create memory DC for bitmap
+    HDC hdcMem = CreateCompatibleDC(hdcPrinter);
+    if (!hdcMem) {
+        DWORD errorCode = GetLastError();
+        AbortDocument(document);
+        std::string errorMsg = "Failed to create memory DC, error code: " + std::to_string(errorCode);
+        return Fail(error, errorMsg);
+    }
+    
+    HGDIOBJ oldBitmap = SelectObject(hdcMem, hBitmap);
+    
+    // Use HALFTONE for better quality
+    SetStretchBltMode(hdcPrinter, HALFTONE);
+    SetBrushOrgEx(hdcPrinter, 0, 0, nullptr);
+    
+    // Blit bitmap to printer DC (reference WinUtil.cpp BlitHBITMAP)
+    BOOL blitSuccess = StretchBlt(hdcPrinter, printX, printY, printWidth, printHeight,
+                                 hdcMem, 0, 0, bm.bmWidth, bm.bmHeight, SRCCOPY);
+    
+    SelectObject(hdcMem, oldBitmap);
+    DeleteDC(hdcMem);
+    
+    if (!blitSuccess) {
+        DWORD errorCode = GetLastError();
+        AbortDocument(document);
+        std::string errorMsg = "Failed to blit bitmap to printer, error code: " + std::to_string(errorCode);
+        return Fail(error, errorMsg);
+    }
+    
+    return FinishPage(document, error);
+}
+
+// Print one bitmap as its own job, scaled to fit the printable area
+bool GdiPrinter::PrintBitmap(HBITMAP hBitmap, const std::wstring& printerName, std::string* error) {
+    if (!hBitmap) {
+        return Fail(error, "PrintBitmap: hBitmap is null");
+    }
+    
+    GdiDocument document;
+    if (!BeginDocument(printerName, false, &document, error)) {
+        return false;
+    }
+    if (!PrintPage(&document, hBitmap, error)) {
+        return false;
+    }
+    return EndDocument(&document, error);
+}
+
+HBITMAP GdiPrinter::CreateBitmap(BitmapData* bitmapData) {
+    if (!bitmapData || !bitmapData->data || 
+        bitmapData->width <= 0 || bitmapData->height <= 0) {
+        return nullptr;
+    }
+    
+    BITMAPINFO bmi = {0};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = bitmapData->width;
+    bmi.bmiHeader.biHeight = -bitmapData->height; // Negative for top-down DIB
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    
+    StageTimer timer(STAGE_BITMAP_CONVERT);
+    void* bits = nullptr;
+    HBITMAP hBitmap = CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+    
+    if (!hBitmap || !bits) {
+        if (hBitmap) {
+            DeleteObject(hBitmap);
+        }
+        return nullptr;
+    }
+    Metrics::CountAllocation((size_t)bitmapData->width * 4 * bitmapData->height);
+    
+    // Copy bitmap data (BGRA format)
+    unsigned char* dest = (unsigned char*)bits;
+    unsigned char* src = bitmapData->data;
+    int destStride = bitmapData->width * 4;
+    
+    for (int y = 0; y < bitmapData->height; y++) {
+        memcpy(dest, src, destStride);
+        dest += destStride;
+        src += bitmapData->stride;
+    }
+    
+    return hBitmap;
+}
+
+int GdiPrinter::ChoosePageDpi(const PageContent& content, int minDpi, int maxDpi) {
+    // Text and paths are vector data: the printer driver's halftoning
+    // dominates, so they gain little past the floor. Images only need as
+    // many device pixels as they carry source pixels.
+    int dpi = (int)std::ceil(content.maxImageDpi);
+    if (dpi < minDpi) {
+        dpi = minDpi;
+    }
+    if (dpi > maxDpi) {
+        dpi = maxDpi;
+    }
+    return dpi;
+}
+
+bool GdiPrinter::PrintDocument(PdfDocument* document, const GdiJobOptions& options,
+                               GdiJobStats* stats, std::string* error, const JobEventCallback& onEvent,
+                               const RenderControl* control) {
+    int pageCount = PdfiumWrapper::GetPageCount(document);
+    if (pageCount == 0) {
+        return Fail(error, "PDF has no pages");
+    }
+    
+    PageRenderer render = [document, control](int pageIndex, int dpi, int rotation, RenderStatus* status) {
+        return PdfiumWrapper::RenderPageToBitmap(document, pageIndex, dpi, control, status, rotation);
+    };
+    return PrintPages(pageCount, render, document, options, stats, error, onEvent, control);
+}
+
+bool GdiPrinter::PrintPages(int pageCount, const PageRenderer& render, PdfDocument* document,
+                            const GdiJobOptions& options, GdiJobStats* stats, std::string* error,
+                            const JobEventCallback& onEvent, const RenderControl* control) {
+    Clock::time_point jobStart = Clock::now();
+    GdiJobStats local;
+    
+    if (pageCount <= 0) {
+        return Fail(error, "Nothing to print");
+    }
+    
+    // All pages go into one spooler job, so the driver can pair front and
+    // back sides and the job is only set up once
+    bool duplex = options.duplex != DUPLEX_NONE;
+    GdiDocument printJob;
+    if (!BeginDocument(options.printerName, duplex, &printJob, error)) {
+        return false;
+    }
+    local.spoolMs += ElapsedMs(jobStart, Clock::now());
+    
+    // Print each page
+    for (int i = 0; i < pageCount; i++) {
+        TraceScope pageScope("page", "page", i);
+        if (control && control->IsCancelled()) {
+            AbortDocument(&printJob);
+            return Fail(error, PdfiumWrapper::RenderStatusMessage(RENDER_CANCELLED, i));
+        }
+        
+        // Pick the page resolution from its content; PrintPage scales to
+        // the printable area, so the printed size does not depend on it
+        int dpi = options.dpi;
+        if (document && options.minDpi > 0 && options.minDpi < options.dpi) {
+            Clock::time_point analyzeStart = Clock::now();
+            PageContent content;
+            if (PdfiumWrapper::AnalyzePage(document, i, &content)) {
+                dpi = ChoosePageDpi(content, options.minDpi, options.dpi);
+            }
+            local.analyzeMs += ElapsedMs(analyzeStart, Clock::now());
+        }
+        
+        // The device flips on the long edge; for short-edge binding the back
+        // sides are rendered upside down
+        int rotation = options.duplex == DUPLEX_SHORT_EDGE && i % 2 == 1 ? 2 : 0;
+        
+        Clock::time_point mark = Clock::now();
+        
+        // Render page to bitmap
+        RenderStatus status = RENDER_OK;
+        BitmapData* bitmap = render(i, dpi, rotation, &status);
+        if (!bitmap && status == RENDER_PAGE_TIMEOUT &&
+            options.fallbackDpi > 0 && options.fallbackDpi < dpi) {
+            // The page blew its budget: print it at the lower resolution rather
+            // than failing the job. The retry gets a fresh budget.
+            bitmap = render(i, options.fallbackDpi, rotation, &status);
+            if (bitmap) {
+                local.pagesDegraded++;
+                dpi = options.fallbackDpi;
+            }
+        }
+        if (!bitmap) {
+            AbortDocument(&printJob);
+            if (status == RENDER_FAILED) {
+                return Fail(error, "Failed to render page " + std::to_string(i + 1) + " to bitmap");
+            }
+            return Fail(error, PdfiumWrapper::RenderStatusMessage(status, i));
+        }
+        
+        // Convert to HBITMAP; the pdfium buffer is no longer needed afterwards
+        HBITMAP hBitmap = CreateBitmap(bitmap);
+        PdfiumWrapper::FreeBitmap(bitmap);
+        if (!hBitmap) {
+            AbortDocument(&printJob);
+            return Fail(error, "Failed to create HBITMAP for page " + std::to_string(i + 1));
+        }
+        
+        Clock::time_point rendered = Clock::now();
+        local.renderMs += ElapsedMs(mark, rendered);
+        if (onEvent) {
+            JobEvent event;
+            event.type = JOB_EVENT_PAGE_RENDERED;
+            event.page = i;
+            event.dpi = dpi;
+            event.durationMs = ElapsedMs(mark, rendered);
+            onEvent(event);
+        }
+        
+        bool printed = PrintPage(&printJob, hBitmap, error);
+        DeleteObject(hBitmap);
+        Clock::time_point spooled = Clock::now();
+        local.spoolMs += ElapsedMs(rendered, spooled);
+        if (!printed) {
+            return false;
+        }
+        local.pages++;
+        local.pageDpi.push_back(dpi);
+        if (onEvent) {
+            JobEvent event;
+            event.type = JOB_EVENT_PAGE_SPOOLED;
+            event.page = i;
+            event.durationMs = ElapsedMs(rendered, spooled);
+            onEvent(event);
+        }
+    }
+    
+    // Pad to whole sheets so the last front side is not paired with the
+    // next job's first page
+    Clock::time_point finishStart = Clock::now();
+    if (duplex && pageCount % 2 == 1) {
+        if (!PrintPage(&printJob, nullptr, error)) {
+            return false;
+        }
+        local.blankPages++;
+    }
+    bool finished = EndDocument(&printJob, error);
+    local.spoolMs += ElapsedMs(finishStart, Clock::now());
+    if (!finished) {
+        return false;
+    }
+    local.sheets = duplex ? (pageCount + 1) / 2 : pageCount;
+    
+    local.totalMs = ElapsedMs(jobStart, Clock::now());
+    if (stats) {
+        *stats = local;
+    }
+    return true;
+}
@@ -0,0 +1,123 @@
+#ifndef GDI_PRINTER_H
+#define GDI_PRINTER_H
+
+#include <windows.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "job_events.h"
+#include "pdfium_win.h"
+
+/**
+ * 双面打印方式（以纸张的边为准）
+ */
+enum DuplexMode {
+    DUPLEX_NONE = 0,        // 单面
+    DUPLEX_LONG_EDGE = 1,   // 长边装订
+    DUPLEX_SHORT_EDGE = 2   // 短边装订（背面旋转 180° 渲染，打印机按长边翻转）
+};
+
+/**
+ * GDI 打印选项
+ */
+struct GdiJobOptions {
+    int dpi = 300;             // 渲染分辨率（自适应时为上限）
+    int minDpi = 0;            // 自适应分辨率下限，0 或不小于 dpi 时所有页面使用 dpi
+    int fallbackDpi = 0;       // 页面超过渲染时间预算时改用的较低分辨率，0 表示不降级
+    DuplexMode duplex = DUPLEX_NONE;  // 双面打印，页数为奇数时在末尾补空白页
+    std::wstring printerName;  // 打印机名称，为空时使用默认打印机
+};
+
+/**
+ * GDI 打印统计
+ */
+struct GdiJobStats {
+    int pages = 0;          // 已打印页数
+    int pagesDegraded = 0;  // 超出时间预算后以较低分辨率重新渲染的页数
+    int blankPages = 0;     // 双面打印时补齐的空白页数
+    int sheets = 0;         // 用纸张数
+    std::vector<int> pageDpi;  // 每页实际使用的渲染分辨率
+    double analyzeMs = 0;   // 页面内容分析耗时
+    double renderMs = 0;    // 渲染耗时
+    double spoolMs = 0;     // 提交到打印机（StartDoc、各页和 EndDoc）耗时
+    double totalMs = 0;     // 总耗时
+};
+
+/**
+ * 页面渲染函数，页面不直接来自已加载的文档时使用（如模板套打）
+ * @param pageIndex 页面索引
+ * @param dpi 渲染分辨率
+ * @param rotation 顺时针旋转的 90° 次数
+ * @param status 输出渲染结果
+ * @return 位图数据（BGRA），失败返回 nullptr。打印后通过 PdfiumWrapper::FreeBitmap 释放
+ */
+typedef std::function<BitmapData*(int pageIndex, int dpi, int rotation, RenderStatus* status)> PageRenderer;
+
+/**
+ * GDI 打印
+ * 将渲染后的位图通过打印机驱动打印，打印机 DC 从连接池获取。
+ * 一个文档的所有页面在同一个打印作业中提交。
+ * 不依赖 JS 环境，可以在工作线程中调用
+ */
+class GdiPrinter {
+public:
+    /**
+     * 从位图数据创建 HBITMAP
+     * @param bitmapData 位图数据（BGRA）
+     * @return HBITMAP，失败返回 nullptr。使用完后需调用 DeleteObject 释放
+     */
+    static HBITMAP CreateBitmap(BitmapData* bitmapData);
+
+    /**
+     * 将位图缩放到可打印区域并作为一个打印作业提交
+     * @param hBitmap 位图
+     * @param printerName 打印机名称，为空时使用默认打印机
+     * @param error 失败时输出错误描述
+     * @return 成功返回 true
+     */
+    static bool PrintBitmap(HBITMAP hBitmap, const std::wstring& printerName, std::string* error);
+
+    /**
+     * 根据页面内容选择渲染分辨率：保留图像有效分辨率的最低值，
+     * 只有文本和矢量图形的页面使用下限
+     * @param content 页面内容统计
+     * @param minDpi 分辨率下限
+     * @param maxDpi 分辨率上限
+     * @return 渲染分辨率
+     */
+    static int ChoosePageDpi(const PageContent& content, int minDpi, int maxDpi);
+
+    /**
+     * 逐页渲染并作为一个打印作业打印文档
+     * @param document 文档指针
+     * @param options 打印选项
+     * @param stats 输出统计信息（可为 nullptr）
+     * @param error 失败时输出错误描述
+     * @param onEvent 页面进度回调（可为空）
+     * @param control 渲染控制（可为 nullptr），用于取消和时间预算
+     * @return 成功返回 true
+     */
+    static bool PrintDocument(PdfDocument* document, const GdiJobOptions& options,
+                              GdiJobStats* stats, std::string* error,
+                              const JobEventCallback& onEvent = JobEventCallback(),
+                              const RenderControl* control = nullptr);
+
+    /**
+     * 逐页渲染并作为一个打印作业打印
+     * @param pageCount 页数
+     * @param render 页面渲染函数
+     * @param document 用于自适应分辨率分析的文档（可为 nullptr，此时所有页面使用 options.dpi）
+     * @param options 打印选项
+     * @param stats 输出统计信息（可为 nullptr）
+     * @param error 失败时输出错误描述
+     * @param onEvent 页面进度回调（可为空）
+     * @param control 渲染控制（可为 nullptr），用于取消
+     * @return 成功返回 true
+     */
+    static bool PrintPages(int pageCount, const PageRenderer& render, PdfDocument* document,
+                           const GdiJobOptions& options, GdiJobStats* stats, std::string* error,
+                           const JobEventCallback& onEvent = JobEventCallback(),
+                           const RenderControl* control = nullptr);
+};
+
+#endif // GDI_PRINTER_H
@@ -0,0 +1,43 @@
+#ifndef JOB_EVENTS_H
+#define JOB_EVENTS_H
+
+#include <functional>
+#include <string>
+
+/**
+ * 作业事件类型
+ */
+enum JobEventType {
+    JOB_EVENT_STARTED = 0,        // 作业开始执行，durationMs 为排队耗时
+    JOB_EVENT_LOADED = 1,         // 文档已加载，durationMs 为加载耗时
+    JOB_EVENT_PAGE_RENDERED = 2,  // 页面渲染完成，durationMs 为该页渲染耗时
+    JOB_EVENT_PAGE_SPOOLED = 3,   // 页面已提交给打印机/输出端，durationMs 为编码和写出（或 GDI 提交）耗时
+    JOB_EVENT_BYTES_WRITTEN = 4,  // 数据已写出，bytes 为本次字节数，totalBytes 为累计字节数
+    JOB_EVENT_COMPLETED = 5,      // 作业完成，durationMs 为执行耗时
+    JOB_EVENT_FAILED = 6          // 作业失败或被取消，error 为原因
+};
+
+/**
+ * 作业事件
+ */
+struct JobEvent {
+    JobEventType type = JOB_EVENT_STARTED;
+    long long jobId = 0;
+    int page = -1;              // 页面索引（从 0 开始），与页面无关的事件为 -1
+    int pageCount = 0;          // 文档页数（loaded 事件）
+    int dpi = 0;                // 页面渲染分辨率（pageRendered 事件，GDI 打印）
+    long long bytes = 0;        // 本次写出的字节数
+    long long totalBytes = 0;   // 累计写出的字节数
+    double timestamp = 0;       // 事件发生时间（Unix 时间，毫秒）
+    double elapsedMs = 0;       // 距作业提交的时间
+    double durationMs = 0;      // 本阶段耗时
+    std::string error;          // 失败原因
+};
+
+/**
+ * 作业事件回调
+ * 由打印管线在工作线程中调用，调用方负责补充作业 ID 和时间戳
+ */
+typedef std::function<void(const JobEvent& event)> JobEventCallback;
+
+#endif // JOB_EVENTS_H
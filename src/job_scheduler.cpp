@@ -0,0 +1,651 @@
+#include "job_scheduler.h"
+#include "cost_estimator.h"
+#include "metrics.h"
+#include "util.h"
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// A job that does not fit the memory budget lets smaller jobs pass at most
+// this many times; after that the budget is held back until it fits
+static const int kMaxBypass = 8;
+
+// Finished jobs kept around for GetJob
+static const size_t kMaxFinishedJobs = 1000;
+
+// Weight of the newest sample when recalibrating cost units to milliseconds
+static const double kCalibrationWeight = 0.2;
+
+struct ScheduledJob {
+    PrintJobRequest request;
+    PrintJobInfo info;
+    Clock::time_point submittedAt;
+    Clock::time_point startedAt;
+    Clock::time_point deadline;
+    bool hasDeadline = false;
+    int bypassed = 0;
+    bool needsPreflight = false;
+    RenderControl control;
+};
+
+struct ResourceState {
+    int running = 0;
+    long long lastServed = 0;  // serve tick of the last job started on this resource
+};
+
+static std::mutex g_schedulerMutex;
+static std::condition_variable g_schedulerWake;
+static std::list<ScheduledJob*> g_queue;
+static std::map<long long, ScheduledJob*> g_activeJobs;
+static std::map<long long, PrintJobInfo> g_finishedJobs;
+static std::deque<long long> g_finishedOrder;
+static std::map<std::string, ResourceState> g_resources;
+static std::vector<std::thread> g_workers;
+static std::thread g_preflightThread;
+static SchedulerConfig g_schedulerConfig;
+static SchedulerStats g_schedulerStats;
+static bool g_stopping = false;
+static long long g_generation = 0;  // bumped by Shutdown; threads of an older generation exit
+static long long g_nextJobId = 1;
+static long long g_serveTick = 0;
+
+// Set on a scheduler thread that ran Shutdown itself (from a job callback);
+// the thread releases the library once it has left the job and exits
+static thread_local bool t_releaseLibraryOnExit = false;
+
+// Ordering between two runnable jobs: priority, then earliest deadline, then
+// across printers the most expensive job (so long jobs do not start last and
+// stretch the tail), then the resource that was served longest ago (fair
+// sharing), then submit order.
+// Not a strict weak ordering: the cost tiebreak only applies across printers,
+// while jobs for one printer keep submit order, so three jobs on two printers
+// can compare in a cycle. It is only meant for the linear scan in PickLocked;
+// never use it with std::sort, a heap or an ordered container.
+static bool RunsBefore(const ScheduledJob* a, const ScheduledJob* b) {
+    if (a->request.priority != b->request.priority) {
+        return a->request.priority > b->request.priority;
+    }
+    if (a->hasDeadline != b->hasDeadline) {
+        return a->hasDeadline;
+    }
+    if (a->hasDeadline && a->deadline != b->deadline) {
+        return a->deadline < b->deadline;
+    }
+    if (a->request.resourceKey != b->request.resourceKey &&
+        a->info.costScore > 0 && b->info.costScore > 0 && a->info.costScore != b->info.costScore) {
+        return a->info.costScore > b->info.costScore;
+    }
+    long long servedA = g_resources[a->request.resourceKey].lastServed;
+    long long servedB = g_resources[b->request.resourceKey].lastServed;
+    if (servedA != servedB) {
+        return servedA < servedB;
+    }
+    return a->info.id < b->info.id;
+}
+
+// Pick the next job to start and take it off the queue. Expired jobs must
+// have been taken off first (ExpireLocked).
+static ScheduledJob* PickLocked() {
+    ScheduledJob* best = nullptr;
+    ScheduledJob* blocked = nullptr;
+
+    for (ScheduledJob* job : g_queue) {
+        if (g_resources[job->request.resourceKey].running >= g_schedulerConfig.maxPerPrinter) {
+            continue;
+        }
+        // A job larger than the whole budget still runs, but only on its own
+        bool fits = g_schedulerStats.running == 0 ||
+                    g_schedulerStats.memoryInUse + job->info.estimatedBytes <= g_schedulerConfig.memoryBudgetBytes;
+        if (!fits) {
+            if (!blocked || RunsBefore(job, blocked)) {
+                blocked = job;
+            }
+            continue;
+        }
+        if (!best || RunsBefore(job, best)) {
+            best = job;
+        }
+    }
+
+    if (blocked && (!best || RunsBefore(blocked, best))) {
+        if (blocked->bypassed >= kMaxBypass) {
+            return nullptr;
+        }
+        if (best) {
+            blocked->bypassed++;
+            g_schedulerStats.memoryWaits++;
+        }
+    }
+    if (best) {
+        g_queue.remove(best);
+    }
+    return best;
+}
+
+// Track how far predictions were off, then move the cost-to-time factor
+// towards what this job actually took
+static void RecordCostSampleLocked(const PrintJobInfo& info) {
+    double errorPct = std::fabs(info.runMs - info.estimatedMs) / info.runMs * 100.0;
+    long long samples = g_schedulerStats.costSamples;
+    g_schedulerStats.costErrorPct = (g_schedulerStats.costErrorPct * samples + errorPct) / (samples + 1);
+    g_schedulerStats.costSamples++;
+
+    double measured = info.runMs / info.costScore;
+    g_schedulerStats.msPerCostUnit = samples == 0 ? measured
+        : g_schedulerStats.msPerCostUnit * (1.0 - kCalibrationWeight) + measured * kCalibrationWeight;
+}
+
+// Record the final state of a job that has left the queue or finished running
+static void FinishLocked(ScheduledJob* job, PrintJobState state, const std::string& error) {
+    Clock::time_point now = Clock::now();
+    job->info.state = state;
+    job->info.error = error;
+    if (state == JOB_COMPLETED || state == JOB_FAILED) {
+        if (job->info.runMs == 0 && job->startedAt != Clock::time_point()) {
+            job->info.runMs = ElapsedMs(job->startedAt, now);
+        }
+        job->info.deadlineMissed = job->hasDeadline && now > job->deadline;
+    }
+    if (job->info.queuedMs == 0 && job->startedAt == Clock::time_point()) {
+        job->info.queuedMs = ElapsedMs(job->submittedAt, now);
+    }
+    Metrics::RecordMs(STAGE_QUEUE, job->info.queuedMs);
+    if ((state == JOB_COMPLETED || state == JOB_FAILED) && job->startedAt != Clock::time_point()) {
+        Metrics::RecordMs(STAGE_JOB, job->info.runMs);
+        Metrics::Add(COUNTER_JOBS, 1);
+    }
+
+    switch (state) {
+    case JOB_COMPLETED:
+        g_schedulerStats.completed++;
+        break;
+    case JOB_FAILED:
+        g_schedulerStats.failed++;
+        break;
+    case JOB_CANCELLED:
+        g_schedulerStats.cancelled++;
+        break;
+    default:
+        break;
+    }
+    if (job->info.deadlineMissed && state == JOB_COMPLETED) {
+        g_schedulerStats.deadlineMisses++;
+    }
+    if (state == JOB_COMPLETED && job->info.estimatedMs > 0 && job->info.runMs > 0) {
+        RecordCostSampleLocked(job->info);
+    }
+
+    g_activeJobs.erase(job->info.id);
+    g_finishedJobs[job->info.id] = job->info;
+    g_finishedOrder.push_back(job->info.id);
+    while (g_finishedOrder.size() > kMaxFinishedJobs) {
+        g_finishedJobs.erase(g_finishedOrder.front());
+        g_finishedOrder.pop_front();
+    }
+}
+
+// Fail the queued jobs whose deadline has passed; the caller notifies them
+// once the lock is released
+static void ExpireLocked(std::vector<ScheduledJob*>* expired) {
+    Clock::time_point now = Clock::now();
+    for (auto it = g_queue.begin(); it != g_queue.end();) {
+        ScheduledJob* job = *it;
+        if (!job->hasDeadline || now <= job->deadline) {
+            ++it;
+            continue;
+        }
+        it = g_queue.erase(it);
+        g_schedulerStats.expired++;
+        FinishLocked(job, JOB_FAILED, "Deadline exceeded before the job started");
+        expired->push_back(job);
+    }
+}
+
+// Sleep until woken or until the earliest queued deadline passes, so that a
+// job can expire while no submit, release or finish wakes the scheduler
+static void WaitLocked(std::unique_lock<std::mutex>& lock) {
+    bool hasDeadline = false;
+    Clock::time_point earliest;
+    for (const ScheduledJob* job : g_queue) {
+        if (job->hasDeadline && (!hasDeadline || job->deadline < earliest)) {
+            hasDeadline = true;
+            earliest = job->deadline;
+        }
+    }
+    if (hasDeadline) {
+        // Expiry needs now > deadline
+        g_schedulerWake.wait_until(lock, earliest + std::chrono::milliseconds(1));
+    } else {
+        g_schedulerWake.wait(lock);
+    }
+}
+
+// Stamp an event with the job id and times, then hand it to the listener
+static void EmitEvent(const ScheduledJob* job, JobEvent event) {
+    if (!job->request.onEvent) {
+        return;
+    }
+    event.jobId = job->info.id;
+    event.timestamp = std::chrono::duration<double, std::milli>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    event.elapsedMs = ElapsedMs(job->submittedAt, Clock::now());
+    job->request.onEvent(event);
+}
+
+// Callbacks run without the scheduler lock so they may submit new jobs
+static void NotifyFinished(const std::vector<ScheduledJob*>& jobs) {
+    for (ScheduledJob* job : jobs) {
+        JobEvent event;
+        event.type = job->info.state == JOB_COMPLETED ? JOB_EVENT_COMPLETED : JOB_EVENT_FAILED;
+        event.durationMs = job->info.runMs;
+        event.error = job->info.error;
+        EmitEvent(job, event);
+
+        if (job->request.onFinished) {
+            job->request.onFinished(job->info);
+        }
+        delete job;
+    }
+}
+
+// Open the job's file and apply its form mode and page layout. The imposed
+// document refers to the source, so both are returned and closed by
+// CloseJobDocument.
+static PdfDocument* OpenJobDocument(const std::string& filePath, FormMode formMode, const PageLayout& layout,
+                                    PdfDocument** source, std::string* error) {
+    *source = PdfiumWrapper::OpenDocument(filePath);
+    if (!*source) {
+        *error = "Failed to load PDF file: " + filePath;
+        return nullptr;
+    }
+    PdfiumWrapper::SetFormMode(*source, formMode);
+    if (layout.nup <= 1 && !layout.booklet) {
+        return *source;
+    }
+    PdfDocument* imposed = PdfiumWrapper::ImposeDocument(*source, layout);
+    if (!imposed) {
+        *error = "Failed to impose pages of " + filePath;
+        PdfiumWrapper::CloseDocument(*source);
+        *source = nullptr;
+    }
+    return imposed;
+}
+
+static void CloseJobDocument(PdfDocument* document, PdfDocument* source) {
+    if (document != source) {
+        PdfiumWrapper::CloseDocument(document);
+    }
+    PdfiumWrapper::CloseDocument(source);
+}
+
+static bool RunJob(ScheduledJob* job, std::string* error) {
+    Tracing::Complete("queue", job->submittedAt, job->startedAt, "job", job->info.id);
+    TraceScope jobScope("job", "job", job->info.id);
+    JobEvent started;
+    started.type = JOB_EVENT_STARTED;
+    started.durationMs = job->info.queuedMs;
+    EmitEvent(job, started);
+
+    // Jobs without a file (template merges) bring their own pages
+    PdfDocument* source = nullptr;
+    PdfDocument* document = nullptr;
+    if (!job->request.filePath.empty()) {
+        Clock::time_point loadStart = Clock::now();
+        document = OpenJobDocument(job->request.filePath, job->request.formMode, job->request.layout,
+                                   &source, error);
+        if (!document) {
+            return false;
+        }
+
+        JobEvent loaded;
+        loaded.type = JOB_EVENT_LOADED;
+        loaded.pageCount = PdfiumWrapper::GetPageCount(document);
+        loaded.durationMs = ElapsedMs(loadStart, Clock::now());
+        EmitEvent(job, loaded);
+    }
+
+    JobEventCallback onEvent;
+    if (job->request.onEvent) {
+        onEvent = [job](const JobEvent& event) {
+            EmitEvent(job, event);
+        };
+    }
+
+    bool success = false;
+    try {
+        success = job->request.run(document, job->control, onEvent, error);
+    } catch (const std::exception& e) {
+        *error = "Exception during PDF processing: " + std::string(e.what());
+    } catch (...) {
+        *error = "Unknown exception during PDF processing";
+    }
+    if (document) {
+        CloseJobDocument(document, source);
+    }
+    return success;
+}
+
+static void WorkerMain(int index, long long generation) {
+    Tracing::SetThreadName("scheduler worker " + std::to_string(index + 1));
+    std::unique_lock<std::mutex> lock(g_schedulerMutex);
+    for (;;) {
+        std::vector<ScheduledJob*> expired;
+        ScheduledJob* job = nullptr;
+        while (!g_stopping && generation == g_generation) {
+            // Workers above the configured count stay parked
+            if (index < g_schedulerConfig.workers) {
+                ExpireLocked(&expired);
+                job = PickLocked();
+            }
+            if (job || !expired.empty()) {
+                break;
+            }
+            if (index < g_schedulerConfig.workers) {
+                WaitLocked(lock);
+            } else {
+                g_schedulerWake.wait(lock);
+            }
+        }
+        if (!job && expired.empty()) {
+            break;
+        }
+
+        if (job) {
+            ResourceState& resource = g_resources[job->request.resourceKey];
+            resource.running++;
+            resource.lastServed = ++g_serveTick;
+            g_schedulerStats.running++;
+            g_schedulerStats.memoryInUse += job->info.estimatedBytes;
+            job->startedAt = Clock::now();
+            job->control.SetTimeout(job->request.timeoutMs);
+            job->control.SetPageBudget(job->request.pageBudgetMs);
+            job->info.state = JOB_RUNNING;
+            job->info.queuedMs = ElapsedMs(job->submittedAt, job->startedAt);
+        }
+
+        lock.unlock();
+        NotifyFinished(expired);
+        if (!job) {
+            lock.lock();
+            continue;
+        }
+
+        std::string error;
+        bool success = RunJob(job, &error);
+
+        lock.lock();
+        g_resources[job->request.resourceKey].running--;
+        g_schedulerStats.running--;
+        g_schedulerStats.memoryInUse -= job->info.estimatedBytes;
+        job->info.runMs = ElapsedMs(job->startedAt, Clock::now());
+        PrintJobState state = success ? JOB_COMPLETED
+                            : job->control.IsCancelled() ? JOB_CANCELLED : JOB_FAILED;
+        FinishLocked(job, state, success ? std::string() : error);
+        // Capacity was freed: any parked worker may now be able to start a job
+        g_schedulerWake.notify_all();
+
+        lock.unlock();
+        NotifyFinished(std::vector<ScheduledJob*>(1, job));
+        lock.lock();
+    }
+    if (t_releaseLibraryOnExit) {
+        PdfiumWrapper::ReleaseLibrary();
+    }
+}
+
+// Scores queued jobs ahead of the workers, one at a time, so that ordering
+// and memory admission can use real page data. Jobs a worker picks up before
+// their preflight simply run with the caller's estimate. Also expires queued
+// jobs while all workers are busy.
+static void PreflightMain(long long generation) {
+    Tracing::SetThreadName("preflight");
+    std::unique_lock<std::mutex> lock(g_schedulerMutex);
+    while (!g_stopping && generation == g_generation) {
+        // With every worker busy, nobody else is waiting to expire jobs
+        std::vector<ScheduledJob*> expired;
+        ExpireLocked(&expired);
+        if (!expired.empty()) {
+            lock.unlock();
+            NotifyFinished(expired);
+            lock.lock();
+            continue;
+        }
+
+        ScheduledJob* job = nullptr;
+        for (ScheduledJob* queued : g_queue) {
+            if (queued->needsPreflight) {
+                job = queued;
+                break;
+            }
+        }
+        if (!job) {
+            WaitLocked(lock);
+            continue;
+        }
+        job->needsPreflight = false;
+        long long id = job->info.id;
+        std::string filePath = job->request.filePath;
+        PageLayout layout = job->request.layout;
+        FormMode formMode = job->request.formMode;
+        int dpi = job->request.preflightDpi;
+
+        // The job may start, finish or be cancelled meanwhile; look it up again after
+        lock.unlock();
+        DocumentCost cost;
+        bool estimated = false;
+        std::string error;
+        PdfDocument* source = nullptr;
+        PdfDocument* document = OpenJobDocument(filePath, formMode, layout, &source, &error);
+        if (document) {
+            estimated = CostEstimator::EstimateDocument(document, dpi, &cost);
+            cost.documentBytes = PdfiumWrapper::GetDocumentSize(source);
+            CloseJobDocument(document, source);
+        }
+        lock.lock();
+
+        auto active = g_activeJobs.find(id);
+        if (!estimated || active == g_activeJobs.end() || active->second->info.state != JOB_QUEUED) {
+            continue;
+        }
+        job = active->second;
+        job->info.costScore = cost.score;
+        job->info.estimatedMs = cost.score * g_schedulerStats.msPerCostUnit;
+        job->info.estimatedBytes = CostEstimator::EstimateBytes(cost.documentBytes, cost.peakOutputMegapixels,
+                                                                job->request.bytesPerPixel);
+        g_schedulerStats.preflighted++;
+        // The new estimates may let a parked worker start this or another job
+        g_schedulerWake.notify_all();
+    }
+    if (t_releaseLibraryOnExit) {
+        PdfiumWrapper::ReleaseLibrary();
+    }
+}
+
+static void EnsureWorkersLocked() {
+    if (g_workers.empty()) {
+        PdfiumWrapper::AcquireLibrary();
+        g_preflightThread = std::thread(PreflightMain, g_generation);
+    }
+    while ((int)g_workers.size() < g_schedulerConfig.workers) {
+        g_workers.push_back(std::thread(WorkerMain, (int)g_workers.size(), g_generation));
+    }
+}
+
+long long PrintJobScheduler::Submit(const PrintJobRequest& request, std::string* error) {
+    std::lock_guard<std::mutex> lock(g_schedulerMutex);
+    if (g_stopping) {
+        if (error) {
+            *error = "Print scheduler is shutting down";
+        }
+        return 0;
+    }
+    // Backpressure: refuse instead of buffering without bound
+    if ((int)g_queue.size() >= g_schedulerConfig.maxQueued) {
+        g_schedulerStats.rejected++;
+        if (error) {
+            *error = "Print queue is full (" + std::to_string(g_queue.size()) + " jobs waiting)";
+        }
+        return 0;
+    }
+
+    ScheduledJob* job = new ScheduledJob();
+    job->request = request;
+    job->submittedAt = Clock::now();
+    if (request.deadlineMs > 0) {
+        job->hasDeadline = true;
+        job->deadline = job->submittedAt + std::chrono::milliseconds(request.deadlineMs);
+    }
+    job->info.id = g_nextJobId++;
+    job->info.resourceKey = request.resourceKey;
+    job->info.priority = request.priority;
+    job->info.estimatedBytes = request.estimatedBytes;
+    job->needsPreflight = request.preflightDpi > 0 && !request.filePath.empty();
+
+    g_queue.push_back(job);
+    g_activeJobs[job->info.id] = job;
+    g_schedulerStats.submitted++;
+
+    EnsureWorkersLocked();
+    g_schedulerWake.notify_all();
+    return job->info.id;
+}
+
+bool PrintJobScheduler::Cancel(long long id) {
+    ScheduledJob* job = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(g_schedulerMutex);
+        auto active = g_activeJobs.find(id);
+        if (active != g_activeJobs.end() && active->second->info.state == JOB_RUNNING) {
+            // The job sees the flag at its next render slice or page boundary
+            active->second->control.Cancel();
+            return true;
+        }
+        for (auto it = g_queue.begin(); it != g_queue.end(); ++it) {
+            if ((*it)->info.id == id) {
+                job = *it;
+                g_queue.erase(it);
+                break;
+            }
+        }
+        if (!job) {
+            return false;
+        }
+        FinishLocked(job, JOB_CANCELLED, "Job cancelled");
+    }
+    NotifyFinished(std::vector<ScheduledJob*>(1, job));
+    return true;
+}
+
+bool PrintJobScheduler::GetJob(long long id, PrintJobInfo* info) {
+    std::lock_guard<std::mutex> lock(g_schedulerMutex);
+    auto active = g_activeJobs.find(id);
+    if (active != g_activeJobs.end()) {
+        ScheduledJob* job = active->second;
+        *info = job->info;
+        Clock::time_point now = Clock::now();
+        if (job->info.state == JOB_QUEUED) {
+            info->queuedMs = ElapsedMs(job->submittedAt, now);
+        } else {
+            info->runMs = ElapsedMs(job->startedAt, now);
+        }
+        return true;
+    }
+    auto finished = g_finishedJobs.find(id);
+    if (finished != g_finishedJobs.end()) {
+        *info = finished->second;
+        return true;
+    }
+    return false;
+}
+
+void PrintJobScheduler::Configure(const SchedulerConfig& config) {
+    std::lock_guard<std::mutex> lock(g_schedulerMutex);
+    g_schedulerConfig = config;
+    if (g_schedulerConfig.workers < 1) {
+        g_schedulerConfig.workers = 1;
+    }
+    if (g_schedulerConfig.maxPerPrinter < 1) {
+        g_schedulerConfig.maxPerPrinter = 1;
+    }
+    if (!g_workers.empty() && !g_stopping) {
+        EnsureWorkersLocked();
+    }
+    g_schedulerWake.notify_all();
+}
+
+SchedulerConfig PrintJobScheduler::GetConfig() {
+    std::lock_guard<std::mutex> lock(g_schedulerMutex);
+    return g_schedulerConfig;
+}
+
+SchedulerStats PrintJobScheduler::GetStats() {
+    std::lock_guard<std::mutex> lock(g_schedulerMutex);
+    SchedulerStats stats = g_schedulerStats;
+    stats.queued = (int)g_queue.size();
+    return stats;
+}
+
+void PrintJobScheduler::Shutdown() {
+    std::vector<ScheduledJob*> cancelled;
+    std::vector<std::thread> workers;
+    std::thread preflight;
+    {
+        std::lock_guard<std::mutex> lock(g_schedulerMutex);
+        if (g_stopping) {
+            return;
+        }
+        g_stopping = true;
+        g_generation++;
+        for (ScheduledJob* job : g_queue) {
+            FinishLocked(job, JOB_CANCELLED, "Print scheduler shut down");
+            cancelled.push_back(job);
+        }
+        g_queue.clear();
+        for (auto& entry : g_activeJobs) {
+            entry.second->control.Cancel();
+        }
+        workers.swap(g_workers);
+        preflight.swap(g_preflightThread);
+    }
+    g_schedulerWake.notify_all();
+    NotifyFinished(cancelled);
+
+    // Called from a job callback, the calling thread cannot join itself. It is
+    // detached instead; its generation is over, so it exits once the callback
+    // returns and releases the library then, after its job has closed the
+    // document.
+    bool started = !workers.empty();
+    bool selfDetached = false;
+    workers.push_back(std::move(preflight));
+    for (std::thread& thread : workers) {
+        if (!thread.joinable()) {
+            continue;
+        }
+        if (thread.get_id() == std::this_thread::get_id()) {
+            thread.detach();
+            selfDetached = true;
+        } else {
+            thread.join();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_schedulerMutex);
+    g_stopping = false;
+    if (started) {
+        if (selfDetached) {
+            t_releaseLibraryOnExit = true;
+        } else {
+            PdfiumWrapper::ReleaseLibrary();
+        }
+    }
+}
@@ -0,0 +1,160 @@
+#ifndef JOB_SCHEDULER_H
+#define JOB_SCHEDULER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "job_events.h"
+#include "pdfium_win.h"
+
+/**
+ * 作业状态
+ */
+enum PrintJobState {
+    JOB_QUEUED = 0,     // 排队中
+    JOB_RUNNING = 1,    // 正在渲染/打印
+    JOB_COMPLETED = 2,  // 已完成
+    JOB_FAILED = 3,     // 失败（包括开始前已超过截止时间）
+    JOB_CANCELLED = 4   // 被取消
+};
+
+/**
+ * 作业信息快照
+ */
+struct PrintJobInfo {
+    long long id = 0;
+    PrintJobState state = JOB_QUEUED;
+    std::string error;          // 失败原因
+    std::string resourceKey;    // 打印机/输出端分组键
+    int priority = 0;
+    size_t estimatedBytes = 0;  // 预估峰值内存（预检后按最大页面重新计算）
+    double costScore = 0;       // 预检得到的渲染开销，未预检为 0
+    double estimatedMs = 0;     // 预测执行耗时，未预检为 0
+    bool deadlineMissed = false;  // 完成时间晚于截止时间
+    double queuedMs = 0;        // 排队耗时
+    double runMs = 0;           // 执行耗时
+};
+
+/**
+ * 作业提交参数
+ */
+struct PrintJobRequest {
+    std::string filePath;       // PDF 文件路径（UTF-8 编码），为空时不加载文档（作业主体自行提供页面）
+    std::string resourceKey;    // 打印机/输出端分组键，同一键受并发上限约束
+    int priority = 0;           // 优先级，数值越大越先执行
+    unsigned int deadlineMs = 0;  // 相对提交时间的截止时间（毫秒），0 表示不限。超时仍未开始的作业直接失败
+    size_t estimatedBytes = 0;  // 预估峰值内存，用于准入控制
+    unsigned int timeoutMs = 0;     // 作业开始后的执行时间上限（毫秒），0 表示不限
+    unsigned int pageBudgetMs = 0;  // 单页渲染时间预算（毫秒），0 表示不限
+    PageLayout layout;          // 拼版方式（N 合 1、小册子），作业主体收到的是拼版后的文档
+    FormMode formMode = FORMS_DRAW;  // 表单域的打印方式
+    int preflightDpi = 0;       // 预检使用的渲染分辨率，0 表示不预检。预检在排队期间进行，结果用于排序和内存预估
+    double bytesPerPixel = 0;   // 每个输出像素占用的内存，预检后据此重新预估峰值内存
+
+    /**
+     * 作业主体，在工作线程中以已打开的文档调用（filePath 为空时 document 为 nullptr）
+     * 渲染时应传入 control 以支持取消和时间预算；
+     * 页面进度通过 onEvent 上报（作业 ID 和时间戳由调度器补充）。
+     * 返回 false 并设置错误描述表示失败
+     */
+    std::function<bool(PdfDocument* document, const RenderControl& control,
+                       const JobEventCallback& onEvent, std::string* error)> run;
+
+    /**
+     * 作业事件（开始、加载、页面进度、完成、失败），在工作线程中调用（可为空）
+     */
+    JobEventCallback onEvent;
+
+    /**
+     * 作业结束（完成、失败或取消）时调用，可能在工作线程中调用
+     */
+    std::function<void(const PrintJobInfo& info)> onFinished;
+};
+
+/**
+ * 调度器配置
+ */
+struct SchedulerConfig {
+    int workers = 2;                 // 工作线程数（渲染池大小）
+    int maxPerPrinter = 1;           // 每个打印机/输出端同时执行的作业数
+    size_t memoryBudgetBytes = 512 * 1024 * 1024;  // 同时执行作业的预估内存总和上限
+    int maxQueued = 1000;            // 排队作业数上限，超过后拒绝提交
+};
+
+/**
+ * 调度器统计
+ */
+struct SchedulerStats {
+    long long submitted = 0;     // 已接受的作业数
+    long long rejected = 0;      // 因队列已满被拒绝的作业数
+    long long completed = 0;     // 已完成
+    long long failed = 0;        // 失败
+    long long cancelled = 0;     // 取消
+    long long expired = 0;       // 开始前已超过截止时间
+    long long deadlineMisses = 0;  // 完成但晚于截止时间
+    long long memoryWaits = 0;   // 因内存预算不足而让其他作业先执行的次数
+    long long preflighted = 0;   // 完成预检的作业数
+    long long costSamples = 0;   // 用于校准开销预估的已完成作业数
+    double costErrorPct = 0;     // 预测耗时相对实际耗时的平均绝对误差（百分比）
+    double msPerCostUnit = 1;    // 当前开销单位到毫秒的换算系数
+    int queued = 0;              // 当前排队数
+    int running = 0;             // 当前执行数
+    size_t memoryInUse = 0;      // 当前执行作业的预估内存总和
+};
+
+/**
+ * 打印作业调度器
+ * 作业按优先级、截止时间排序；同优先级时不同打印机的作业按预检开销从大到小执行
+ *（耗时长的作业先开始，缩短整体完成时间），开销相同或未预检时在各打印机之间轮转，
+ * 一台打印机上的大作业不会阻塞其他打印机。同一打印机上的作业保持提交顺序。
+ * 预估内存超出预算的作业让位给能放下的作业，但被跳过多次后会保留预算，避免饿死。
+ * 线程安全
+ */
+class PrintJobScheduler {
+public:
+    /**
+     * 提交作业
+     * @param request 作业参数
+     * @param error 失败时输出错误描述
+     * @return 作业 ID，队列已满或调度器已关闭时返回 0
+     */
+    static long long Submit(const PrintJobRequest& request, std::string* error);
+
+    /**
+     * 取消作业：排队中的作业直接移出队列，执行中的作业在当前渲染时间片结束时停止
+     * @param id 作业 ID
+     * @return 作业存在且尚未结束返回 true
+     */
+    static bool Cancel(long long id);
+
+    /**
+     * 查询作业信息（最近结束的作业保留一段时间）
+     * @param id 作业 ID
+     * @param info 输出作业信息
+     * @return 找到返回 true
+     */
+    static bool GetJob(long long id, PrintJobInfo* info);
+
+    /**
+     * 修改配置，立即生效
+     */
+    static void Configure(const SchedulerConfig& config);
+
+    /**
+     * 获取当前配置
+     */
+    static SchedulerConfig GetConfig();
+
+    /**
+     * 获取统计信息
+     */
+    static SchedulerStats GetStats();
+
+    /**
+     * 取消所有排队和执行中的作业，等待工作线程停止
+     * 之后可以再次提交，工作线程会重新启动
+     */
+    static void Shutdown();
+};
+
+#endif // JOB_SCHEDULER_H
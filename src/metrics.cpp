@@ -0,0 +1,214 @@
+#include "metrics.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+
+// Log-linear buckets as in HdrHistogram: values below kSubBuckets get a bucket
+// each, every power of two above that is split into kSubBuckets equal parts,
+// so a bucket is never wider than 1/16 of its lower bound. 640 buckets reach
+// 2^43 ns (about 2.4 hours); longer values land in the last one.
+static const int kSubBits = 4;
+static const int kSubBuckets = 1 << kSubBits;
+static const int kBuckets = 40 * kSubBuckets;
+
+struct StageHistogram {
+    std::atomic<uint64_t> buckets[kBuckets];
+    std::atomic<uint64_t> totalNs;
+    std::atomic<uint64_t> maxNs;
+};
+
+static std::atomic<bool> g_metricsEnabled(false);
+static StageHistogram g_stageHistograms[STAGE_COUNT];
+static std::atomic<long long> g_counters[COUNTER_COUNT];
+
+static const char* const kStageNames[STAGE_COUNT] = {
+    "queue", "job", "file_read", "document_load", "page_load", "render", "lock_wait",
+    "bitmap_convert", "spool_start", "spool_page", "spool_end", "encode", "write"
+};
+
+static const char* const kCounterNames[COUNTER_COUNT] = {
+    "jobs", "pages", "pixels", "bytes_read", "bytes_written", "allocations", "allocated_bytes"
+};
+
+static int HighestBit(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+static int BucketIndex(uint64_t value) {
+    if (value < (uint64_t)kSubBuckets) {
+        return (int)value;
+    }
+    int shift = HighestBit(value) - kSubBits;
+    int index = (shift + 1) * kSubBuckets + (int)((value >> shift) - kSubBuckets);
+    return std::min(index, kBuckets - 1);
+}
+
+// Largest value that falls into the bucket, as HdrHistogram reports percentiles
+static uint64_t BucketUpperBound(int index) {
+    if (index < kSubBuckets) {
+        return (uint64_t)index;
+    }
+    int shift = index / kSubBuckets - 1;
+    uint64_t lower = (uint64_t)(kSubBuckets + index % kSubBuckets) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void Metrics::SetEnabled(bool enabled) {
+    g_metricsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Metrics::IsEnabled() {
+    return g_metricsEnabled.load(std::memory_order_relaxed);
+}
+
+void Metrics::Record(MetricStage stage, uint64_t nanoseconds) {
+    if (!IsEnabled() || stage < 0 || stage >= STAGE_COUNT) {
+        return;
+    }
+    StageHistogram& histogram = g_stageHistograms[stage];
+    histogram.buckets[BucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    histogram.totalNs.fetch_add(nanoseconds, std::memory_order_relaxed);
+    uint64_t max = histogram.maxNs.load(std::memory_order_relaxed);
+    while (nanoseconds > max && !histogram.maxNs.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+void Metrics::RecordMs(MetricStage stage, double milliseconds) {
+    if (IsEnabled() && milliseconds >= 0) {
+        Record(stage, (uint64_t)(milliseconds * 1e6));
+    }
+}
+
+void Metrics::Add(MetricCounter counter, long long value) {
+    if (IsEnabled() && counter >= 0 && counter < COUNTER_COUNT) {
+        g_counters[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::CountAllocation(size_t bytes) {
+    if (IsEnabled()) {
+        g_counters[COUNTER_ALLOCATIONS].fetch_add(1, std::memory_order_relaxed);
+        g_counters[COUNTER_ALLOCATED_BYTES].fetch_add((long long)bytes, std::memory_order_relaxed);
+    }
+}
+
+// Counts are read bucket by bucket while other threads may still record, so
+// the total is taken from the buckets themselves to keep percentiles consistent
+static StageMetrics Summarize(const StageHistogram& histogram) {
+    uint64_t counts[kBuckets];
+    uint64_t total = 0;
+    for (int i = 0; i < kBuckets; i++) {
+        counts[i] = histogram.buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    StageMetrics stage;
+    stage.count = (long long)total;
+    if (total == 0) {
+        return stage;
+    }
+    uint64_t maxNs = histogram.maxNs.load(std::memory_order_relaxed);
+    stage.totalMs = histogram.totalNs.load(std::memory_order_relaxed) / 1e6;
+    stage.maxMs = maxNs / 1e6;
+
+    const double quantiles[4] = { 0.5, 0.9, 0.99, 0.999 };
+    double* outputs[4] = { &stage.p50Ms, &stage.p90Ms, &stage.p99Ms, &stage.p999Ms };
+    uint64_t seen = 0;
+    int q = 0;
+    for (int i = 0; i < kBuckets && q < 4; i++) {
+        seen += counts[i];
+        while (q < 4 && seen >= (uint64_t)std::max(1.0, std::ceil(quantiles[q] * total))) {
+            *outputs[q] = std::min(BucketUpperBound(i), maxNs) / 1e6;
+            q++;
+        }
+    }
+    return stage;
+}
+
+MetricsSnapshot Metrics::GetSnapshot() {
+    MetricsSnapshot snapshot;
+    snapshot.enabled = IsEnabled();
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        snapshot.stages[i] = Summarize(g_stageHistograms[i]);
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        snapshot.counters[i] = g_counters[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+void Metrics::Reset() {
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        StageHistogram& histogram = g_stageHistograms[i];
+        for (int j = 0; j < kBuckets; j++) {
+            histogram.buckets[j].store(0, std::memory_order_relaxed);
+        }
+        histogram.totalNs.store(0, std::memory_order_relaxed);
+        histogram.maxNs.store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        g_counters[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* Metrics::StageName(MetricStage stage) {
+    return stage >= 0 && stage < STAGE_COUNT ? kStageNames[stage] : "unknown";
+}
+
+const char* Metrics::CounterName(MetricCounter counter) {
+    return counter >= 0 && counter < COUNTER_COUNT ? kCounterNames[counter] : "unknown";
+}
+
+static void AppendLine(std::string* out, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    out->append(line);
+    out->push_back('\n');
+}
+
+std::string Metrics::PrometheusText() {
+    MetricsSnapshot snapshot = GetSnapshot();
+    std::string out;
+    out.reserve(8 * 1024);
+
+    AppendLine(&out, "# HELP pdfprint_stage_duration_seconds Time spent in each print pipeline stage.");
+    AppendLine(&out, "# TYPE pdfprint_stage_duration_seconds summary");
+    const char* quantileNames[4] = { "0.5", "0.9", "0.99", "0.999" };
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const StageMetrics& stage = snapshot.stages[i];
+        const double quantiles[4] = { stage.p50Ms, stage.p90Ms, stage.p99Ms, stage.p999Ms };
+        // Quantiles of an empty summary are NaN, as the Prometheus client libraries report them
+        for (int q = 0; q < 4; q++) {
+            if (stage.count == 0) {
+                AppendLine(&out, "pdfprint_stage_duration_seconds{stage=\"%s\",quantile=\"%s\"} NaN",
+                           kStageNames[i], quantileNames[q]);
+            } else {
+                AppendLine(&out, "pdfprint_stage_duration_seconds{stage=\"%s\",quantile=\"%s\"} %.9g",
+                           kStageNames[i], quantileNames[q], quantiles[q] / 1000.0);
+            }
+        }
+        AppendLine(&out, "pdfprint_stage_duration_seconds_sum{stage=\"%s\"} %.9g", kStageNames[i],
+                   stage.totalMs / 1000.0);
+        AppendLine(&out, "pdfprint_stage_duration_seconds_count{stage=\"%s\"} %lld", kStageNames[i], stage.count);
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        AppendLine(&out, "# TYPE pdfprint_%s_total counter", kCounterNames[i]);
+        AppendLine(&out, "pdfprint_%s_total %lld", kCounterNames[i], snapshot.counters[i]);
+    }
+    return out;
+}
@@ -0,0 +1,169 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "trace.h"
+
+/**
+ * 计时的处理阶段
+ */
+enum MetricStage {
+    STAGE_QUEUE = 0,        // 作业排队
+    STAGE_JOB,              // 作业执行（从开始到完成或失败）
+    STAGE_FILE_READ,        // 读取 PDF 文件
+    STAGE_DOCUMENT_LOAD,    // 解析文档（FPDF_LoadMemDocument）
+    STAGE_PAGE_LOAD,        // 加载页面（FPDF_LoadPage，含表单准备）
+    STAGE_RENDER,           // 渲染（FPDF_RenderPageBitmap，整页或一个条带）
+    STAGE_LOCK_WAIT,        // 等待 pdfium 全局锁（只计有竞争的加锁）
+    STAGE_BITMAP_CONVERT,   // 位图转换为 HBITMAP
+    STAGE_SPOOL_START,      // 开始打印作业（StartDoc）
+    STAGE_SPOOL_PAGE,       // 提交一页（StartPage、StretchBlt、EndPage）
+    STAGE_SPOOL_END,        // 结束打印作业（EndDoc）
+    STAGE_ENCODE,           // 单色化与打印机语言编码（一个条带）
+    STAGE_WRITE,            // 写出到输出端
+    STAGE_COUNT
+};
+
+/**
+ * 计数器
+ */
+enum MetricCounter {
+    COUNTER_JOBS = 0,         // 执行完成的作业数（含失败）
+    COUNTER_PAGES,            // 提交给打印机或输出端的页数
+    COUNTER_PIXELS,           // 渲染的像素数
+    COUNTER_BYTES_READ,       // 读取的 PDF 文件字节数
+    COUNTER_BYTES_WRITTEN,    // 写出到输出端的字节数
+    COUNTER_ALLOCATIONS,      // 分配的像素缓冲区数
+    COUNTER_ALLOCATED_BYTES,  // 分配的像素缓冲区字节数
+    COUNTER_COUNT
+};
+
+/**
+ * 单个阶段的耗时分布（毫秒）
+ * 分位数来自对数线性分桶的直方图，相对误差不超过 1/16
+ */
+struct StageMetrics {
+    long long count = 0;
+    double totalMs = 0;
+    double maxMs = 0;
+    double p50Ms = 0;
+    double p90Ms = 0;
+    double p99Ms = 0;
+    double p999Ms = 0;
+};
+
+/**
+ * 指标快照
+ */
+struct MetricsSnapshot {
+    bool enabled = false;
+    StageMetrics stages[STAGE_COUNT];
+    long long counters[COUNTER_COUNT] = { 0 };
+};
+
+/**
+ * 处理阶段耗时直方图和计数器
+ * 各线程直接对全局的原子计数累加，不加锁；停用时每个计时点只读取一次开关。线程安全
+ */
+class Metrics {
+public:
+    /**
+     * 启用或停用记录，已记录的数据保留
+     */
+    static void SetEnabled(bool enabled);
+
+    /**
+     * 是否正在记录
+     */
+    static bool IsEnabled();
+
+    /**
+     * 记录一次阶段耗时（未启用时忽略）
+     * @param stage 阶段
+     * @param nanoseconds 耗时（纳秒）
+     */
+    static void Record(MetricStage stage, uint64_t nanoseconds);
+
+    /**
+     * 记录一次阶段耗时（毫秒）
+     */
+    static void RecordMs(MetricStage stage, double milliseconds);
+
+    /**
+     * 累加计数器（未启用时忽略）
+     */
+    static void Add(MetricCounter counter, long long value);
+
+    /**
+     * 记录一次像素缓冲区分配
+     * @param bytes 分配的字节数
+     */
+    static void CountAllocation(size_t bytes);
+
+    /**
+     * 获取当前的指标快照
+     */
+    static MetricsSnapshot GetSnapshot();
+
+    /**
+     * 清零所有直方图和计数器
+     */
+    static void Reset();
+
+    /**
+     * 以 Prometheus 文本格式输出所有指标（阶段耗时为 summary，单位秒）
+     */
+    static std::string PrometheusText();
+
+    /**
+     * 阶段名称（如 "render"）
+     */
+    static const char* StageName(MetricStage stage);
+
+    /**
+     * 计数器名称（如 "pages"）
+     */
+    static const char* CounterName(MetricCounter counter);
+};
+
+/**
+ * 阶段计时：构造时开始，析构或 Stop 时记录到直方图，正在跟踪时同时记录时间线事件。
+ * 构造时两者都未启用则不读取时钟
+ */
+class StageTimer {
+public:
+    explicit StageTimer(MetricStage stage)
+        : m_stage(stage), m_active(Metrics::IsEnabled() || Tracing::IsActive()) {
+        if (m_active) {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~StageTimer() { Stop(); }
+
+    /**
+     * 提前结束计时
+     */
+    void Stop() {
+        if (m_active) {
+            m_active = false;
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            Metrics::Record(m_stage, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                end - m_start).count());
+            Tracing::Complete(Metrics::StageName(m_stage), m_start, end);
+        }
+    }
+
+private:
+    StageTimer(const StageTimer&);
+    StageTimer& operator=(const StageTimer&);
+
+    MetricStage m_stage;
+    bool m_active;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#endif // METRICS_H
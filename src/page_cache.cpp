@@ -0,0 +1,806 @@
+#include "page_cache.h"
+#include "util.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// Bumped whenever the file layout or the renderer output changes, so old
+// entries stop matching instead of being misread
+static const char kCacheVersion[] = "pdfprint-page-1";
+static const char kPageSuffix[] = ".page";
+static const char kTempSuffix[] = ".tmp";
+
+// Stored before the compressed rows. dataBytes lets a torn or truncated file
+// (left by a crash between write and rename on some file systems) be detected
+struct PageFileHeader {
+    char magic[4];
+    uint32_t format;    // BitmapData::bitmapFormat
+    int32_t width;
+    int32_t height;     // rows stored
+    int32_t rowBytes;   // uncompressed bytes per row
+    uint32_t reserved;
+    uint64_t dataBytes; // compressed rows that follow, each prefixed by its uint32 length
+};
+
+static const char kMagic[4] = { 'P', 'G', 'C', '1' };
+
+static int BytesPerPixel(int format) {
+    return format == 2 ? 1 : format == 1 ? 3 : 4;
+}
+
+struct CacheEntry {
+    size_t bytes = 0;
+    std::list<std::string>::iterator use;  // position in g_pageCacheUse
+};
+
+static std::mutex g_pageCacheMutex;
+static PageCacheConfig g_pageCacheConfig;
+static PageCacheStats g_pageCacheStats;
+static std::map<std::string, CacheEntry> g_pageCacheEntries;
+static std::list<std::string> g_pageCacheUse;  // most recently used first
+static std::atomic<unsigned long long> g_tempCounter(0);
+
+static bool EndsWith(const std::string& text, const char* suffix) {
+    size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Hashing (128-bit, MurmurHash3 x64 construction)
+
+static inline uint64_t Rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t Fmix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+std::string PageCache::HashBytes(const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    uint64_t h1 = 0x9368e53c2f6af274ULL;
+    uint64_t h2 = 0x586dcd208f7cd3fdULL;
+
+    size_t blocks = size / 16;
+    for (size_t i = 0; i < blocks; i++) {
+        uint64_t k1, k2;
+        memcpy(&k1, bytes + i * 16, 8);
+        memcpy(&k2, bytes + i * 16 + 8, 8);
+        k1 *= c1; k1 = Rotl(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = Rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2; k2 = Rotl(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = Rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    unsigned char tail[16] = {};
+    memcpy(tail, bytes + blocks * 16, size % 16);
+    uint64_t k1, k2;
+    memcpy(&k1, tail, 8);
+    memcpy(&k2, tail + 8, 8);
+    k2 *= c2; k2 = Rotl(k2, 33); k2 *= c1; h2 ^= k2;
+    k1 *= c1; k1 = Rotl(k1, 31); k1 *= c2; h1 ^= k1;
+
+    h1 ^= (uint64_t)size;
+    h2 ^= (uint64_t)size;
+    h1 += h2;
+    h2 += h1;
+    h1 = Fmix(h1);
+    h2 = Fmix(h2);
+    h1 += h2;
+    h2 += h1;
+
+    char hex[33];
+    snprintf(hex, sizeof(hex), "%016llx%016llx", (unsigned long long)h1, (unsigned long long)h2);
+    return hex;
+}
+
+// ---------------------------------------------------------------------------
+// PackBits, one row at a time
+
+static void PackRow(const unsigned char* row, int length, std::vector<unsigned char>& out) {
+    int i = 0;
+    while (i < length) {
+        // A run of three or more equal bytes
+        int run = 1;
+        while (i + run < length && run < 128 && row[i + run] == row[i]) {
+            run++;
+        }
+        if (run >= 3) {
+            out.push_back((unsigned char)(257 - run));
+            out.push_back(row[i]);
+            i += run;
+            continue;
+        }
+        // Literal bytes up to the next run of three
+        int start = i;
+        while (i < length && i - start < 128) {
+            if (i + 2 < length && row[i] == row[i + 1] && row[i] == row[i + 2]) {
+                break;
+            }
+            i++;
+        }
+        out.push_back((unsigned char)(i - start - 1));
+        out.insert(out.end(), row + start, row + i);
+    }
+}
+
+// Decodes exactly length bytes; false if the input is malformed
+static bool UnpackRow(const unsigned char* in, size_t inLength, unsigned char* row, int length) {
+    size_t p = 0;
+    int o = 0;
+    while (o < length) {
+        if (p >= inLength) {
+            return false;
+        }
+        int control = in[p++];
+        if (control < 128) {
+            int count = control + 1;
+            if (o + count > length || p + count > inLength) {
+                return false;
+            }
+            memcpy(row + o, in + p, count);
+            p += count;
+            o += count;
+        } else if (control > 128) {
+            int count = 257 - control;
+            if (o + count > length || p >= inLength) {
+                return false;
+            }
+            memset(row + o, in[p++], count);
+            o += count;
+        }
+    }
+    return p == inLength;
+}
+
+// ---------------------------------------------------------------------------
+// Platform layer: files, directories and mappings
+
+struct DirectoryFile {
+    std::string name;
+    size_t bytes = 0;
+    long long modified = 0;
+};
+
+#ifdef _WIN32
+static std::string JoinPath(const std::string& directory, const std::string& name) {
+    return directory + "\\" + name;
+}
+
+static bool MakeDirectory(const std::string& path) {
+    std::wstring wide = Utf8ToWide(path);
+    if (CreateDirectoryW(wide.c_str(), nullptr)) {
+        return true;
+    }
+    DWORD attributes = GetFileAttributesW(wide.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+static std::vector<DirectoryFile> ListDirectory(const std::string& directory) {
+    std::vector<DirectoryFile> files;
+    WIN32_FIND_DATAW found;
+    HANDLE search = FindFirstFileW(Utf8ToWide(JoinPath(directory, "*")).c_str(), &found);
+    if (search == INVALID_HANDLE_VALUE) {
+        return files;
+    }
+    do {
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            continue;
+        }
+        DirectoryFile file;
+        file.name = WideToUtf8(found.cFileName);
+        file.bytes = ((size_t)found.nFileSizeHigh << 32) | found.nFileSizeLow;
+        file.modified = ((long long)found.ftLastWriteTime.dwHighDateTime << 32) | found.ftLastWriteTime.dwLowDateTime;
+        files.push_back(file);
+    } while (FindNextFileW(search, &found));
+    FindClose(search);
+    return files;
+}
+
+static void RemoveFile(const std::string& path) {
+    DeleteFileW(Utf8ToWide(path).c_str());
+}
+
+static bool ReplaceFile(const std::string& from, const std::string& to) {
+    return MoveFileExW(Utf8ToWide(from).c_str(), Utf8ToWide(to).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+static FILE* OpenForWrite(const std::string& path) {
+    return _wfopen(Utf8ToWide(path).c_str(), L"wb");
+}
+
+// Keep the use order across restarts: the directory scan sorts by write time
+static void TouchFile(const std::string& path) {
+    HANDLE file = CreateFileW(Utf8ToWide(path).c_str(), FILE_WRITE_ATTRIBUTES,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0,
+                              nullptr);
+    if (file != INVALID_HANDLE_VALUE) {
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        SetFileTime(file, nullptr, nullptr, &now);
+        CloseHandle(file);
+    }
+}
+
+// Read-only view of a cache file. Shared for deletion, so eviction can
+// remove a file that another job is still reading
+class MappedFile {
+public:
+    ~MappedFile() {
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+        }
+    }
+
+    bool Open(const std::string& path) {
+        HANDLE file = CreateFileW(Utf8ToWide(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!mapping) {
+            return false;
+        }
+        m_data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        m_size = (size_t)size.QuadPart;
+        return m_data != nullptr;
+    }
+
+    const unsigned char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+};
+#else
+static std::string JoinPath(const std::string& directory, const std::string& name) {
+    return directory + "/" + name;
+}
+
+static bool MakeDirectory(const std::string& path) {
+    if (mkdir(path.c_str(), 0755) == 0) {
+        return true;
+    }
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static std::vector<DirectoryFile> ListDirectory(const std::string& directory) {
+    std::vector<DirectoryFile> files;
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        return files;
+    }
+    while (dirent* item = readdir(dir)) {
+        struct stat info;
+        std::string name = item->d_name;
+        if (stat(JoinPath(directory, name).c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        DirectoryFile file;
+        file.name = name;
+        file.bytes = (size_t)info.st_size;
+        file.modified = (long long)info.st_mtime;
+        files.push_back(file);
+    }
+    closedir(dir);
+    return files;
+}
+
+static void RemoveFile(const std::string& path) {
+    unlink(path.c_str());
+}
+
+static bool ReplaceFile(const std::string& from, const std::string& to) {
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+static FILE* OpenForWrite(const std::string& path) {
+    return fopen(path.c_str(), "wb");
+}
+
+// Keep the use order across restarts: the directory scan sorts by write time
+static void TouchFile(const std::string& path) {
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+}
+
+// Read-only view of a cache file; stays valid if eviction unlinks the file
+class MappedFile {
+public:
+    ~MappedFile() {
+        if (m_data) {
+            munmap((void*)m_data, m_size);
+        }
+    }
+
+    bool Open(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        m_data = (const unsigned char*)data;
+        m_size = (size_t)info.st_size;
+        madvise(data, m_size, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    const unsigned char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+};
+#endif
+
+// ---------------------------------------------------------------------------
+// Index
+
+// Drop least recently used entries until the cache fits; returns the paths
+// to delete, which happens outside the lock
+static std::vector<std::string> EvictLocked() {
+    std::vector<std::string> victims;
+    while (g_pageCacheStats.bytes > g_pageCacheConfig.maxBytes && !g_pageCacheUse.empty()) {
+        std::string key = g_pageCacheUse.back();
+        g_pageCacheUse.pop_back();
+        auto it = g_pageCacheEntries.find(key);
+        if (it != g_pageCacheEntries.end()) {
+            g_pageCacheStats.bytes -= it->second.bytes;
+            g_pageCacheEntries.erase(it);
+        }
+        g_pageCacheStats.evictions++;
+        victims.push_back(JoinPath(g_pageCacheConfig.directory, key + kPageSuffix));
+    }
+    g_pageCacheStats.entries = (int)g_pageCacheEntries.size();
+    return victims;
+}
+
+static void RemoveFiles(const std::vector<std::string>& paths) {
+    for (const std::string& path : paths) {
+        RemoveFile(path);
+    }
+}
+
+static void ForgetLocked(const std::string& key) {
+    auto it = g_pageCacheEntries.find(key);
+    if (it != g_pageCacheEntries.end()) {
+        g_pageCacheStats.bytes -= it->second.bytes;
+        g_pageCacheUse.erase(it->second.use);
+        g_pageCacheEntries.erase(it);
+        g_pageCacheStats.entries = (int)g_pageCacheEntries.size();
+    }
+}
+
+static void InsertLocked(const std::string& key, size_t bytes) {
+    ForgetLocked(key);
+    g_pageCacheUse.push_front(key);
+    CacheEntry entry;
+    entry.bytes = bytes;
+    entry.use = g_pageCacheUse.begin();
+    g_pageCacheEntries[key] = entry;
+    g_pageCacheStats.bytes += bytes;
+    g_pageCacheStats.entries = (int)g_pageCacheEntries.size();
+}
+
+bool PageCache::Configure(const PageCacheConfig& config, std::string* error) {
+    if (!config.directory.empty() && !MakeDirectory(config.directory)) {
+        return Fail(error, "Failed to create page cache directory: " + config.directory);
+    }
+
+    // Files from an earlier run are indexed oldest first, so the most
+    // recently written or used pages are the last to go
+    std::vector<DirectoryFile> files;
+    if (!config.directory.empty()) {
+        files = ListDirectory(config.directory);
+        std::sort(files.begin(), files.end(), [](const DirectoryFile& a, const DirectoryFile& b) {
+            return a.modified < b.modified;
+        });
+    }
+
+    std::vector<std::string> victims;
+    {
+        std::lock_guard<std::mutex> lock(g_pageCacheMutex);
+        bool sameDirectory = config.directory == g_pageCacheConfig.directory;
+        g_pageCacheConfig = config;
+        if (!sameDirectory) {
+            g_pageCacheEntries.clear();
+            g_pageCacheUse.clear();
+            g_pageCacheStats.bytes = 0;
+            for (const DirectoryFile& file : files) {
+                if (EndsWith(file.name, kTempSuffix)) {
+                    // Left behind by a process that exited mid-write
+                    victims.push_back(JoinPath(config.directory, file.name));
+                } else if (EndsWith(file.name, kPageSuffix)) {
+                    InsertLocked(file.name.substr(0, file.name.size() - strlen(kPageSuffix)), file.bytes);
+                }
+            }
+            g_pageCacheStats.entries = (int)g_pageCacheEntries.size();
+        }
+        std::vector<std::string> evicted = EvictLocked();
+        victims.insert(victims.end(), evicted.begin(), evicted.end());
+    }
+    RemoveFiles(victims);
+    return true;
+}
+
+PageCacheConfig PageCache::GetConfig() {
+    std::lock_guard<std::mutex> lock(g_pageCacheMutex);
+    return g_pageCacheConfig;
+}
+
+bool PageCache::IsEnabled() {
+    std::lock_guard<std::mutex> lock(g_pageCacheMutex);
+    return !g_pageCacheConfig.directory.empty();
+}
+
+PageCacheStats PageCache::GetStats() {
+    std::lock_guard<std::mutex> lock(g_pageCacheMutex);
+    return g_pageCacheStats;
+}
+
+void PageCache::Clear() {
+    std::string directory;
+    {
+        std::lock_guard<std::mutex> lock(g_pageCacheMutex);
+        directory = g_pageCacheConfig.directory;
+        g_pageCacheEntries.clear();
+        g_pageCacheUse.clear();
+        g_pageCacheStats.bytes = 0;
+        g_pageCacheStats.entries = 0;
+    }
+    if (directory.empty()) {
+        return;
+    }
+    for (const DirectoryFile& file : ListDirectory(directory)) {
+        if (EndsWith(file.name, kPageSuffix)) {
+            RemoveFile(JoinPath(directory, file.name));
+        }
+    }
+}
+
+bool PageCache::HashFile(const std::string& filePath, std::string* hash) {
+    MappedFile file;
+    if (!file.Open(filePath)) {
+        return false;
+    }
+    *hash = HashBytes(file.Data(), file.Size());
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Entries
+
+static std::string PageKey(const std::string& documentHash, int pageIndex, const std::string& settings) {
+    std::string text = std::string(kCacheVersion) + "|" + documentHash + "|" + std::to_string(pageIndex) + "|" +
+                       settings;
+    return PageCache::HashBytes(text.data(), text.size());
+}
+
+// A cache file mapped and checked: the header is sane and the row lengths
+// add up to exactly the file size
+class PageEntry {
+public:
+    // Band entries must hold gray rows of exactly bandWidth pixels for the
+    // whole page; bitmap entries pass 0
+    bool Open(const std::string& key, int bandWidth = 0, int pixelHeight = 0) {
+        m_bandWidth = bandWidth;
+        m_pixelHeight = pixelHeight;
+        std::string directory;
+        {
+            std::lock_guard<std::mutex> lock(g_pageCacheMutex);
+            directory = g_pageCacheConfig.directory;
+            if (directory.empty() || g_pageCacheEntries.find(key) == g_pageCacheEntries.end()) {
+                g_pageCacheStats.misses++;
+                return false;
+            }
+        }
+        std::string path = JoinPath(directory, key + kPageSuffix);
+        bool opened = m_file.Open(path);
+        if (opened && Validate()) {
+            {
+                std::lock_guard<std::mutex> lock(g_pageCacheMutex);
+                auto it = g_pageCacheEntries.find(key);
+                if (it != g_pageCacheEntries.end()) {
+                    g_pageCacheUse.splice(g_pageCacheUse.begin(), g_pageCacheUse, it->second.use);
+                }
+                g_pageCacheStats.hits++;
+            }
+            TouchFile(path);
+            return true;
+        }
+
+        // Gone (cleared by hand) or damaged: forget it and render again
+        {
+            std::lock_guard<std::mutex> lock(g_pageCacheMutex);
+            ForgetLocked(key);
+            g_pageCacheStats.misses++;
+            g_pageCacheStats.corrupt += opened ? 1 : 0;
+        }
+        if (opened) {
+            RemoveFile(path);
+        }
+        return false;
+    }
+
+    const PageFileHeader& Header() const { return m_header; }
+
+    // Decode the next count rows into rows (rowBytes apart)
+    bool ReadRows(unsigned char* rows, int count) {
+        for (int y = 0; y < count; y++) {
+            uint32_t length;
+            memcpy(&length, m_file.Data() + m_offset, sizeof(length));
+            m_offset += sizeof(length);
+            if (!UnpackRow(m_file.Data() + m_offset, length, rows + (size_t)y * m_header.rowBytes,
+                           m_header.rowBytes)) {
+                return false;
+            }
+            m_offset += length;
+        }
+        return true;
+    }
+
+private:
+    bool Validate() {
+        if (m_file.Size() < sizeof(PageFileHeader)) {
+            return false;
+        }
+        memcpy(&m_header, m_file.Data(), sizeof(m_header));
+        // Readers take width * bytes per pixel from every row, so a truncated
+        // or tampered header must not claim shorter rows than that
+        if (memcmp(m_header.magic, kMagic, sizeof(kMagic)) != 0 || m_header.format > 2 || m_header.width <= 0 ||
+            m_header.height <= 0 ||
+            m_header.rowBytes < (int64_t)m_header.width * BytesPerPixel((int)m_header.format) ||
+            m_header.dataBytes != m_file.Size() - sizeof(PageFileHeader)) {
+            return false;
+        }
+        if (m_bandWidth > 0 &&
+            (m_header.format != 2 || m_header.width != m_bandWidth || m_header.height != m_pixelHeight)) {
+            return false;
+        }
+        size_t offset = sizeof(PageFileHeader);
+        for (int y = 0; y < m_header.height; y++) {
+            uint32_t length;
+            if (offset + sizeof(length) > m_file.Size()) {
+                return false;
+            }
+            memcpy(&length, m_file.Data() + offset, sizeof(length));
+            offset += sizeof(length) + length;
+            if (offset > m_file.Size()) {
+                return false;
+            }
+        }
+        m_offset = sizeof(PageFileHeader);
+        return offset == m_file.Size();
+    }
+
+    MappedFile m_file;
+    PageFileHeader m_header;
+    size_t m_offset = 0;
+    int m_bandWidth = 0;
+    int m_pixelHeight = 0;
+};
+
+// Collects compressed rows in memory and writes them out in one go
+class PageWriter {
+public:
+    PageWriter(int format, int width, int rowBytes) : m_format(format), m_width(width), m_rowBytes(rowBytes) {
+        m_data.reserve(64 * 1024);
+    }
+
+    void AddRows(const unsigned char* rows, int stride, int count) {
+        for (int y = 0; y < count; y++) {
+            size_t lengthAt = m_data.size();
+            m_data.resize(lengthAt + sizeof(uint32_t));
+            PackRow(rows + (size_t)y * stride, m_rowBytes, m_data);
+            uint32_t length = (uint32_t)(m_data.size() - lengthAt - sizeof(uint32_t));
+            memcpy(&m_data[lengthAt], &length, sizeof(length));
+        }
+        m_height += count;
+    }
+
+    // Written to a temporary name and renamed, so readers only ever see a
+    // complete file
+    void Commit(const std::string& key) {
+        std::string directory = PageCache::GetConfig().directory;
+        if (directory.empty() || m_height == 0) {
+            return;
+        }
+        PageFileHeader header;
+        memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.format = (uint32_t)m_format;
+        header.width = m_width;
+        header.height = m_height;
+        header.rowBytes = m_rowBytes;
+        header.reserved = 0;
+        header.dataBytes = m_data.size();
+
+        std::string path = JoinPath(directory, key + kPageSuffix);
+        std::string tempPath = JoinPath(directory, key + "." + std::to_string(++g_tempCounter) + kTempSuffix);
+        FILE* file = OpenForWrite(tempPath);
+        bool ok = file != nullptr;
+        if (ok) {
+            ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 (m_data.empty() || fwrite(m_data.data(), m_data.size(), 1, file) == 1);
+            ok = fclose(file) == 0 && ok;
+        }
+        // Another job may have stored the same page first; its file is kept
+        ok = ok && ReplaceFile(tempPath, path);
+        if (!ok) {
+            RemoveFile(tempPath);
+        }
+
+        std::vector<std::string> victims;
+        {
+            std::lock_guard<std::mutex> lock(g_pageCacheMutex);
+            if (!ok) {
+                if (g_pageCacheEntries.find(key) == g_pageCacheEntries.end()) {
+                    g_pageCacheStats.writeErrors++;
+                }
+                return;
+            }
+            InsertLocked(key, sizeof(header) + m_data.size());
+            g_pageCacheStats.writes++;
+            victims = EvictLocked();
+        }
+        RemoveFiles(victims);
+    }
+
+private:
+    int m_format;
+    int m_width;
+    int m_rowBytes;
+    int m_height = 0;
+    std::vector<unsigned char> m_data;
+};
+
+static BitmapData* LoadBitmap(const std::string& key) {
+    PageEntry entry;
+    if (!entry.Open(key)) {
+        return nullptr;
+    }
+    const PageFileHeader& header = entry.Header();
+    BitmapData* bitmap = new (std::nothrow) BitmapData();
+    unsigned char* data = bitmap ? new (std::nothrow) unsigned char[(size_t)header.rowBytes * header.height]
+                                 : nullptr;
+    if (!data || !entry.ReadRows(data, header.height)) {
+        delete[] data;
+        delete bitmap;
+        return nullptr;
+    }
+    bitmap->data = data;
+    bitmap->width = header.width;
+    bitmap->height = header.height;
+    bitmap->stride = header.rowBytes;
+    bitmap->bitmapFormat = (int)header.format;
+    return bitmap;
+}
+
+BitmapRenderer PageCache::CachedRenderer(const BitmapRenderer& render, const std::string& documentHash,
+                                         const std::string& settings) {
+    return [render, documentHash, settings](int pageIndex, int dpi, int rotation, RenderStatus* status) {
+        if (!IsEnabled()) {
+            return render(pageIndex, dpi, rotation, status);
+        }
+        std::string key = PageKey(documentHash, pageIndex, "bitmap|dpi=" + std::to_string(dpi) + "|rotation=" +
+                                  std::to_string(rotation) + "|" + settings);
+        BitmapData* cached = LoadBitmap(key);
+        if (cached) {
+            SetStatus(status, RENDER_OK);
+            return cached;
+        }
+        BitmapData* bitmap = render(pageIndex, dpi, rotation, status);
+        if (bitmap) {
+            PageWriter writer(bitmap->bitmapFormat, bitmap->width, bitmap->width * BytesPerPixel(bitmap->bitmapFormat));
+            writer.AddRows(bitmap->data, bitmap->stride, bitmap->height);
+            writer.Commit(key);
+        }
+        return bitmap;
+    };
+}
+
+// Hand a cached page to onBand in bands of bandHeight rows
+static bool ReplayBands(PageEntry& entry, int bandHeight, const BandCallback& onBand, const RenderControl* control,
+                        RenderStatus* status) {
+    const PageFileHeader& header = entry.Header();
+    std::vector<unsigned char> band((size_t)header.rowBytes * bandHeight);
+    for (int top = 0; top < header.height; top += bandHeight) {
+        RenderStatus stop = control ? control->Check(Clock::now()) : RENDER_OK;
+        if (stop != RENDER_OK) {
+            SetStatus(status, stop);
+            return false;
+        }
+        int rows = std::min(bandHeight, header.height - top);
+        if (!entry.ReadRows(band.data(), rows)) {
+            SetStatus(status, RENDER_FAILED);
+            return false;
+        }
+        if (!onBand(band.data(), header.rowBytes, top, rows)) {
+            SetStatus(status, RENDER_FAILED);
+            return false;
+        }
+    }
+    SetStatus(status, RENDER_OK);
+    return true;
+}
+
+RasterPageSource PageCache::CachedSource(const RasterPageSource& source, const std::string& documentHash,
+                                         const std::string& settings) {
+    RasterPageSource cached = source;
+    cached.renderBands = [source, documentHash, settings](int pageIndex, int bandWidth, int pixelWidth,
+                                                          int pixelHeight, int bandHeight, const BandCallback& onBand,
+                                                          const RenderControl* control, RenderStatus* status) {
+        if (!IsEnabled()) {
+            return source.renderBands(pageIndex, bandWidth, pixelWidth, pixelHeight, bandHeight, onBand, control,
+                                      status);
+        }
+        std::string key = PageKey(documentHash, pageIndex, "bands|width=" + std::to_string(bandWidth) +
+                                  "|page=" + std::to_string(pixelWidth) + "x" + std::to_string(pixelHeight) + "|" +
+                                  settings);
+        PageEntry entry;
+        if (entry.Open(key, bandWidth, pixelHeight)) {
+            return ReplayBands(entry, bandHeight, onBand, control, status);
+        }
+
+        // Rows are compressed as they pass through; the page is only stored
+        // once every band has been rendered and accepted
+        PageWriter writer(2, bandWidth, bandWidth);
+        bool rendered = source.renderBands(pageIndex, bandWidth, pixelWidth, pixelHeight, bandHeight,
+            [&](const unsigned char* gray, int stride, int top, int rows) {
+                writer.AddRows(gray, stride, rows);
+                return onBand(gray, stride, top, rows);
+            }, control, status);
+        if (rendered) {
+            writer.Commit(key);
+        }
+        return rendered;
+    };
+    return cached;
+}
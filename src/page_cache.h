@@ -0,0 +1,105 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "pdfium_win.h"
+#include "raster_pipeline.h"
+
+/**
+ * 页面缓存配置
+ */
+struct PageCacheConfig {
+    std::string directory;                         // 缓存目录（UTF-8 编码），为空时不缓存
+    size_t maxBytes = (size_t)1024 * 1024 * 1024;  // 缓存文件总大小上限，超过后淘汰最久未使用的页面
+};
+
+/**
+ * 页面缓存统计
+ */
+struct PageCacheStats {
+    long long hits = 0;         // 命中次数（跳过渲染的页面）
+    long long misses = 0;       // 未命中次数
+    long long writes = 0;       // 写入的页面数
+    long long writeErrors = 0;  // 写入失败次数（磁盘已满等，不影响作业）
+    long long evictions = 0;    // 淘汰的页面数
+    long long corrupt = 0;      // 损坏而删除的缓存文件数
+    int entries = 0;            // 当前缓存的页面数
+    size_t bytes = 0;           // 当前缓存文件总大小
+};
+
+/**
+ * 整页位图的渲染函数，与 GdiPrinter 的 PageRenderer 相同
+ */
+typedef std::function<BitmapData*(int pageIndex, int dpi, int rotation, RenderStatus* status)> BitmapRenderer;
+
+/**
+ * 渲染结果的磁盘缓存，用于重打（失败重试、重复订单）
+ * 按文档内容哈希、页面、分辨率、格式和渲染参数寻址，同样的文件换了路径也能命中。
+ * 位图逐行用 PackBits 压缩后写入单独的文件：先写临时文件再改名，进程中途退出不会留下半个页面；
+ * 读取时映射文件直接解压，不经过读缓冲区。总大小超过上限时按最近使用时间淘汰。线程安全
+ */
+class PageCache {
+public:
+    /**
+     * 启用缓存或修改配置。目录不存在时创建，已有的缓存文件继续使用
+     * @param config 配置，directory 为空时停用缓存（不删除文件）
+     * @param error 失败时输出错误描述
+     * @return 成功返回 true
+     */
+    static bool Configure(const PageCacheConfig& config, std::string* error);
+
+    /**
+     * 获取当前配置
+     */
+    static PageCacheConfig GetConfig();
+
+    /**
+     * 是否已启用
+     */
+    static bool IsEnabled();
+
+    /**
+     * 获取统计信息
+     */
+    static PageCacheStats GetStats();
+
+    /**
+     * 删除所有缓存文件
+     */
+    static void Clear();
+
+    /**
+     * 计算内容哈希（128 位，十六进制）
+     */
+    static std::string HashBytes(const void* data, size_t size);
+
+    /**
+     * 计算文件内容哈希
+     * @param filePath 文件路径（UTF-8 编码）
+     * @param hash 输出哈希
+     * @return 成功返回 true
+     */
+    static bool HashFile(const std::string& filePath, std::string* hash);
+
+    /**
+     * 为整页位图渲染加上缓存：命中时从缓存解压，不调用 render；未命中时渲染并写入缓存
+     * @param render 实际的渲染函数
+     * @param documentHash 文档内容哈希
+     * @param settings 影响渲染结果的其他参数（如表单处理方式），分辨率和旋转由调用参数提供
+     * @return 带缓存的渲染函数
+     */
+    static BitmapRenderer CachedRenderer(const BitmapRenderer& render, const std::string& documentHash,
+                                         const std::string& settings);
+
+    /**
+     * 为按条带渲染的页面来源加上缓存：命中时按请求的条带高度回放缓存，不渲染；
+     * 未命中时条带在交给调用方的同时写入缓存，整页渲染完成后保存
+     * 参数与 CachedRenderer 相同
+     */
+    static RasterPageSource CachedSource(const RasterPageSource& source, const std::string& documentHash,
+                                         const std::string& settings);
+};
+
+#endif // PAGE_CACHE_H
@@ -0,0 +1,255 @@
+#include "page_dedup.h"
+#include "util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// Rendered pixels, kept unpadded: rows are exactly width * bytes per pixel
+struct StoredPage {
+    int format = 0;
+    int width = 0;
+    int height = 0;
+    int rowBytes = 0;
+    std::vector<unsigned char> pixels;
+};
+
+struct DedupEntry {
+    std::string content;  // full page description and settings, compared on every hit
+    std::shared_ptr<const StoredPage> page;
+    std::list<std::string>::iterator use;  // position in g_dedupUse
+};
+
+static std::mutex g_dedupMutex;
+static PageDedupConfig g_dedupConfig;
+static PageDedupStats g_dedupStats;
+static std::map<std::string, DedupEntry> g_dedupEntries;
+static std::list<std::string> g_dedupUse;  // most recently used first
+
+static int BytesPerPixel(int format) {
+    return format == 2 ? 1 : format == 1 ? 3 : 4;
+}
+
+static void EvictLocked() {
+    while (g_dedupStats.bytes > g_dedupConfig.maxBytes && !g_dedupUse.empty()) {
+        auto found = g_dedupEntries.find(g_dedupUse.back());
+        g_dedupStats.bytes -= found->second.content.size() + found->second.page->pixels.size();
+        g_dedupEntries.erase(found);
+        g_dedupUse.pop_back();
+        g_dedupStats.evictions++;
+    }
+    g_dedupStats.entries = (int)g_dedupEntries.size();
+}
+
+bool PageDedup::Configure(const PageDedupConfig& config, std::string* error) {
+    (void)error;
+    std::lock_guard<std::mutex> lock(g_dedupMutex);
+    g_dedupConfig = config;
+    EvictLocked();
+    return true;
+}
+
+PageDedupConfig PageDedup::GetConfig() {
+    std::lock_guard<std::mutex> lock(g_dedupMutex);
+    return g_dedupConfig;
+}
+
+PageDedupStats PageDedup::GetStats() {
+    std::lock_guard<std::mutex> lock(g_dedupMutex);
+    return g_dedupStats;
+}
+
+void PageDedup::Clear() {
+    std::lock_guard<std::mutex> lock(g_dedupMutex);
+    g_dedupEntries.clear();
+    g_dedupUse.clear();
+    g_dedupStats.bytes = 0;
+    g_dedupStats.entries = 0;
+}
+
+std::string PageDedup::Fingerprint(PdfDocument* document, int pageIndex) {
+    std::string description;
+    if (!PdfiumWrapper::DescribePageContent(document, pageIndex, &description)) {
+        return std::string();
+    }
+    return description;
+}
+
+// Entries are found by the hash of their content but only reused when the
+// content itself matches, so a crafted hash collision cannot return another
+// document's page
+static std::string ContentKey(const std::string& content) {
+    return PageCache::HashBytes(content.data(), content.size());
+}
+
+// Counts the page and returns the stored rendering, if any. Empty content
+// means the page could not be fingerprinted
+static std::shared_ptr<const StoredPage> Lookup(const std::string& content) {
+    if (content.empty()) {
+        std::lock_guard<std::mutex> lock(g_dedupMutex);
+        g_dedupStats.skipped++;
+        return nullptr;
+    }
+    std::string key = ContentKey(content);
+    std::lock_guard<std::mutex> lock(g_dedupMutex);
+    g_dedupStats.pages++;
+    auto found = g_dedupEntries.find(key);
+    if (found == g_dedupEntries.end() || found->second.content != content) {
+        g_dedupStats.misses++;
+        return nullptr;
+    }
+    g_dedupStats.hits++;
+    g_dedupUse.splice(g_dedupUse.begin(), g_dedupUse, found->second.use);
+    return found->second.page;
+}
+
+static void Store(const std::string& content, const std::shared_ptr<const StoredPage>& page) {
+    std::string key = ContentKey(content);
+    size_t bytes = content.size() + page->pixels.size();
+    std::lock_guard<std::mutex> lock(g_dedupMutex);
+    // Another job may have rendered the same page meanwhile; either copy will
+    // do. A colliding entry is left alone
+    if (bytes > g_dedupConfig.maxBytes || g_dedupEntries.count(key)) {
+        return;
+    }
+    g_dedupUse.push_front(key);
+    DedupEntry& entry = g_dedupEntries[key];
+    entry.content = content;
+    entry.page = page;
+    entry.use = g_dedupUse.begin();
+    g_dedupStats.bytes += bytes;
+    EvictLocked();
+}
+
+static bool Enabled() {
+    std::lock_guard<std::mutex> lock(g_dedupMutex);
+    return g_dedupConfig.maxBytes > 0;
+}
+
+static std::string PageContent(const std::string& fingerprint, const std::string& settings) {
+    return fingerprint.empty() ? std::string() : settings + "|" + fingerprint;
+}
+
+static BitmapData* CopyBitmap(const StoredPage& page) {
+    BitmapData* bitmap = new (std::nothrow) BitmapData();
+    unsigned char* data = bitmap ? new (std::nothrow) unsigned char[page.pixels.size()] : nullptr;
+    if (!data) {
+        delete bitmap;
+        return nullptr;
+    }
+    memcpy(data, page.pixels.data(), page.pixels.size());
+    bitmap->data = data;
+    bitmap->width = page.width;
+    bitmap->height = page.height;
+    bitmap->stride = page.rowBytes;
+    bitmap->bitmapFormat = page.format;
+    return bitmap;
+}
+
+BitmapRenderer PageDedup::DedupRenderer(const BitmapRenderer& render, const PageFingerprint& fingerprint,
+                                        const std::string& settings) {
+    return [render, fingerprint, settings](int pageIndex, int dpi, int rotation, RenderStatus* status) {
+        if (!Enabled()) {
+            return render(pageIndex, dpi, rotation, status);
+        }
+        std::string content = PageContent(fingerprint(pageIndex), "bitmap|dpi=" + std::to_string(dpi) + "|rotation=" +
+                                  std::to_string(rotation) + "|" + settings);
+        std::shared_ptr<const StoredPage> stored = Lookup(content);
+        if (stored) {
+            BitmapData* bitmap = CopyBitmap(*stored);
+            if (bitmap) {
+                SetStatus(status, RENDER_OK);
+                return bitmap;
+            }
+        }
+        BitmapData* bitmap = render(pageIndex, dpi, rotation, status);
+        if (bitmap && !content.empty()) {
+            std::shared_ptr<StoredPage> page = std::make_shared<StoredPage>();
+            page->format = bitmap->bitmapFormat;
+            page->width = bitmap->width;
+            page->height = bitmap->height;
+            page->rowBytes = bitmap->width * BytesPerPixel(bitmap->bitmapFormat);
+            page->pixels.resize((size_t)page->rowBytes * page->height);
+            for (int y = 0; y < page->height; y++) {
+                memcpy(&page->pixels[(size_t)y * page->rowBytes], bitmap->data + (size_t)y * bitmap->stride,
+                       page->rowBytes);
+            }
+            Store(content, page);
+        }
+        return bitmap;
+    };
+}
+
+// Stored rows are handed to onBand in place, bandHeight rows at a time
+static bool ReplayBands(const StoredPage& page, int bandHeight, const BandCallback& onBand,
+                        const RenderControl* control, RenderStatus* status) {
+    for (int top = 0; top < page.height; top += bandHeight) {
+        RenderStatus stop = control ? control->Check(Clock::now()) : RENDER_OK;
+        if (stop != RENDER_OK) {
+            SetStatus(status, stop);
+            return false;
+        }
+        int rows = std::min(bandHeight, page.height - top);
+        if (!onBand(&page.pixels[(size_t)top * page.rowBytes], page.rowBytes, top, rows)) {
+            SetStatus(status, RENDER_FAILED);
+            return false;
+        }
+    }
+    SetStatus(status, RENDER_OK);
+    return true;
+}
+
+RasterPageSource PageDedup::DedupSource(const RasterPageSource& source, const PageFingerprint& fingerprint,
+                                        const std::string& settings) {
+    RasterPageSource dedup = source;
+    dedup.renderBands = [source, fingerprint, settings](int pageIndex, int bandWidth, int pixelWidth,
+                                                        int pixelHeight, int bandHeight, const BandCallback& onBand,
+                                                        const RenderControl* control, RenderStatus* status) {
+        if (!Enabled()) {
+            return source.renderBands(pageIndex, bandWidth, pixelWidth, pixelHeight, bandHeight, onBand, control,
+                                      status);
+        }
+        std::string content = PageContent(fingerprint(pageIndex), "bands|width=" + std::to_string(bandWidth) +
+                                  "|page=" + std::to_string(pixelWidth) + "x" + std::to_string(pixelHeight) + "|" +
+                                  settings);
+        std::shared_ptr<const StoredPage> stored = Lookup(content);
+        if (stored) {
+            return ReplayBands(*stored, bandHeight, onBand, control, status);
+        }
+        // Pages larger than the whole store are not worth copying
+        if (content.empty() || (size_t)bandWidth * pixelHeight > PageDedup::GetConfig().maxBytes) {
+            return source.renderBands(pageIndex, bandWidth, pixelWidth, pixelHeight, bandHeight, onBand, control,
+                                      status);
+        }
+
+        // Rows are copied as they pass through; the page is only kept once
+        // every band has been rendered and accepted
+        std::shared_ptr<StoredPage> page = std::make_shared<StoredPage>();
+        page->format = 2;
+        page->width = bandWidth;
+        page->rowBytes = bandWidth;
+        page->pixels.reserve((size_t)bandWidth * pixelHeight);
+        bool rendered = source.renderBands(pageIndex, bandWidth, pixelWidth, pixelHeight, bandHeight,
+            [&](const unsigned char* gray, int stride, int top, int rows) {
+                page->pixels.resize((size_t)(top + rows) * bandWidth);
+                for (int y = 0; y < rows; y++) {
+                    memcpy(&page->pixels[(size_t)(top + y) * bandWidth], gray + (size_t)y * stride, bandWidth);
+                }
+                page->height = top + rows;
+                return onBand(gray, stride, top, rows);
+            }, control, status);
+        if (rendered) {
+            Store(content, page);
+        }
+        return rendered;
+    };
+    return dedup;
+}
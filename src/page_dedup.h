@@ -0,0 +1,92 @@
+#ifndef PAGE_DEDUP_H
+#define PAGE_DEDUP_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "page_cache.h"
+
+/**
+ * 重复页面复用配置
+ */
+struct PageDedupConfig {
+    size_t maxBytes = (size_t)256 * 1024 * 1024;  // 保留的渲染结果总大小上限，超过后淘汰最久未使用的页面；0 为停用
+};
+
+/**
+ * 重复页面复用统计
+ */
+struct PageDedupStats {
+    long long pages = 0;      // 识别过内容的页面数
+    long long hits = 0;       // 复用已有渲染结果的页面数
+    long long misses = 0;     // 内容首次出现（或已被淘汰）而渲染的页面数
+    long long skipped = 0;    // 内容无法完整描述而直接渲染的页面数
+    long long evictions = 0;  // 淘汰的页面数
+    int entries = 0;          // 当前保留的页面数
+    size_t bytes = 0;         // 当前保留的像素和页面描述总大小
+};
+
+/**
+ * 页面内容指纹函数：返回页面内容的完整描述，内容相同的页面返回相同的描述，无法识别时返回空字符串
+ */
+typedef std::function<std::string(int pageIndex)> PageFingerprint;
+
+/**
+ * 重复页面复用
+ * 渲染前按页面内容计算指纹（PdfiumWrapper::DescribePageContent 的完整描述），
+ * 同一作业或之前的作业已经以相同参数渲染过同样内容的页面时，直接复用内存中的像素。
+ * 以描述的哈希查找，命中后仍比较完整描述，哈希碰撞不会复用其他页面。
+ * 适用于条款页、封面等在文档内和文档间反复出现的页面。与文件路径和文档无关。线程安全
+ */
+class PageDedup {
+public:
+    /**
+     * 修改配置，缩小上限时立即淘汰
+     * @param config 配置
+     * @param error 失败时输出错误描述
+     * @return 成功返回 true
+     */
+    static bool Configure(const PageDedupConfig& config, std::string* error);
+
+    /**
+     * 获取当前配置
+     */
+    static PageDedupConfig GetConfig();
+
+    /**
+     * 获取统计信息
+     */
+    static PageDedupStats GetStats();
+
+    /**
+     * 释放所有保留的渲染结果
+     */
+    static void Clear();
+
+    /**
+     * 计算已加载文档中页面的内容指纹
+     * @param document 文档指针
+     * @param pageIndex 页面索引（从 0 开始）
+     * @return 页面内容的完整描述，无法完整描述时返回空字符串
+     */
+    static std::string Fingerprint(PdfDocument* document, int pageIndex);
+
+    /**
+     * 为整页位图渲染加上重复页面复用：指纹相同且分辨率、旋转和 settings 相同时复制已有位图，不调用 render
+     * @param render 实际的渲染函数
+     * @param fingerprint 页面指纹函数
+     * @param settings 影响渲染结果的其他参数（如表单处理方式）
+     * @return 带复用的渲染函数
+     */
+    static BitmapRenderer DedupRenderer(const BitmapRenderer& render, const PageFingerprint& fingerprint,
+                                        const std::string& settings);
+
+    /**
+     * 为按条带渲染的页面来源加上重复页面复用：命中时按请求的条带高度直接回放保留的像素
+     * 参数与 DedupRenderer 相同
+     */
+    static RasterPageSource DedupSource(const RasterPageSource& source, const PageFingerprint& fingerprint,
+                                        const std::string& settings);
+};
+
+#endif // PAGE_DEDUP_H
@@ -0,0 +1,142 @@
+#include "page_stream.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+
+PageStream::PageStream(const std::shared_ptr<PdfDocument>& document, const PageStreamOptions& options,
+                       const ChunkCallback& onChunk, const EndCallback& onEnd)
+    : m_document(document), m_options(options), m_onChunk(onChunk), m_onEnd(onEnd) {
+    m_thread = std::thread(&PageStream::Run, this);
+}
+
+PageStream::~PageStream() {
+    Cancel();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void PageStream::Request(int count) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_credits += count;
+    m_changed.notify_all();
+}
+
+void PageStream::Cancel() {
+    m_control.Cancel();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cancelled = true;
+    m_changed.notify_all();
+}
+
+// Block until the consumer wants another chunk; false once cancelled
+bool PageStream::WaitForCredit() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [this]() { return m_cancelled || m_credits > 0; });
+    if (m_cancelled) {
+        return false;
+    }
+    m_credits--;
+    return true;
+}
+
+bool PageStream::RenderPage(int pageIndex, std::string* error) {
+    if (!WaitForCredit()) {
+        return true;
+    }
+    RenderStatus status = RENDER_FAILED;
+    BitmapData* bitmap = PdfiumWrapper::RenderPageToBitmap(m_document.get(), pageIndex, m_options.dpi,
+                                                           &m_control, &status, m_options.rotation);
+    if (!bitmap) {
+        if (status == RENDER_CANCELLED) {
+            return true;
+        }
+        *error = PdfiumWrapper::RenderStatusMessage(status, pageIndex);
+        return false;
+    }
+    PageChunk chunk;
+    chunk.pageIndex = pageIndex;
+    chunk.bitmap = bitmap;
+    m_onChunk(chunk);
+    return true;
+}
+
+bool PageStream::RenderBands(int pageIndex, std::string* error) {
+    float width = 0;
+    float height = 0;
+    if (!PdfiumWrapper::GetPageSize(m_document.get(), pageIndex, &width, &height)) {
+        *error = PdfiumWrapper::RenderStatusMessage(RENDER_FAILED, pageIndex);
+        return false;
+    }
+    int pixelWidth = std::max(1, (int)std::lround(width * m_options.dpi / 72.0));
+    int pixelHeight = std::max(1, (int)std::lround(height * m_options.dpi / 72.0));
+
+    // The callback runs without the pdfium lock, so waiting here for the
+    // consumer does not hold up other renders
+    bool outOfMemory = false;
+    BandCallback onBand = [&](const unsigned char* gray, int stride, int top, int rows) {
+        if (!WaitForCredit()) {
+            return false;
+        }
+        BitmapData* bitmap = new (std::nothrow) BitmapData();
+        unsigned char* data = new (std::nothrow) unsigned char[(size_t)stride * rows];
+        if (!bitmap || !data) {
+            delete bitmap;
+            delete[] data;
+            outOfMemory = true;
+            return false;
+        }
+        memcpy(data, gray, (size_t)stride * rows);
+        bitmap->data = data;
+        bitmap->width = pixelWidth;
+        bitmap->height = rows;
+        bitmap->stride = stride;
+        bitmap->bitmapFormat = 2;
+
+        PageChunk chunk;
+        chunk.pageIndex = pageIndex;
+        chunk.top = top;
+        chunk.bitmap = bitmap;
+        m_onChunk(chunk);
+        return true;
+    };
+    RenderStatus status = RENDER_FAILED;
+    if (PdfiumWrapper::RenderPageBands(m_document.get(), pageIndex, pixelWidth, pixelWidth, pixelHeight,
+                                       m_options.bandHeight, onBand, &m_control, &status)) {
+        return true;
+    }
+    if (outOfMemory) {
+        *error = "Out of memory for page " + std::to_string(pageIndex + 1);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_cancelled) {
+            return true;
+        }
+    }
+    *error = PdfiumWrapper::RenderStatusMessage(status, pageIndex);
+    return false;
+}
+
+void PageStream::Run() {
+    Tracing::SetThreadName("page stream");
+    int pageCount = PdfiumWrapper::GetPageCount(m_document.get());
+    int lastPage = m_options.lastPage < 0 ? pageCount - 1 : std::min(m_options.lastPage, pageCount - 1);
+
+    std::string error;
+    bool ok = true;
+    for (int pageIndex = m_options.firstPage; ok && pageIndex <= lastPage; pageIndex++) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_cancelled) {
+                break;
+            }
+        }
+        ok = m_options.bandHeight > 0 ? RenderBands(pageIndex, &error) : RenderPage(pageIndex, &error);
+    }
+    m_onEnd(ok, error);
+}
@@ -0,0 +1,97 @@
+#ifndef PAGE_STREAM_H
+#define PAGE_STREAM_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "pdfium_win.h"
+
+/**
+ * 页面流选项
+ */
+struct PageStreamOptions {
+    int dpi = 150;        // 渲染分辨率
+    int rotation = 0;     // 顺时针旋转的 90° 次数（0-3），仅整页模式
+    int firstPage = 0;    // 起始页面索引（从 0 开始）
+    int lastPage = -1;    // 结束页面索引（包含），-1 表示最后一页
+    int bandHeight = 0;   // 大于 0 时按条带输出 8 位灰度，否则按整页输出 BGRA
+};
+
+/**
+ * 流中的一块：一整页或一页中的一个条带
+ */
+struct PageChunk {
+    int pageIndex = 0;            // 页面索引
+    int top = 0;                  // 条带在页面中的起始行，整页为 0
+    BitmapData* bitmap = nullptr;  // 像素，由接收方调用 PdfiumWrapper::FreeBitmap 释放
+};
+
+/**
+ * 按需渲染的页面流
+ * 在自己的线程中按顺序渲染页面（或条带），但只有在消费方通过 Request 给出额度后
+ * 才渲染下一块，未消费的数据量由消费方控制，而不是由文档大小决定
+ */
+class PageStream {
+public:
+    /**
+     * 数据块回调，在渲染线程中调用，接收方负责释放位图
+     */
+    typedef std::function<void(const PageChunk& chunk)> ChunkCallback;
+
+    /**
+     * 结束回调，在渲染线程中调用且只调用一次
+     * 参数为：是否成功（取消也算成功结束）、失败时的错误描述
+     */
+    typedef std::function<void(bool ok, const std::string& error)> EndCallback;
+
+    /**
+     * 创建页面流并启动渲染线程
+     * @param document 文档，流结束前保持打开
+     * @param options 选项
+     * @param onChunk 数据块回调
+     * @param onEnd 结束回调
+     */
+    PageStream(const std::shared_ptr<PdfDocument>& document, const PageStreamOptions& options,
+               const ChunkCallback& onChunk, const EndCallback& onEnd);
+
+    /**
+     * 取消并等待渲染线程结束
+     */
+    ~PageStream();
+
+    /**
+     * 允许再渲染 count 块
+     * @param count 块数
+     */
+    void Request(int count);
+
+    /**
+     * 取消，正在渲染的页面在当前时间片结束时停止。可以在任意线程调用
+     */
+    void Cancel();
+
+private:
+    PageStream(const PageStream&);
+    PageStream& operator=(const PageStream&);
+
+    bool WaitForCredit();
+    bool RenderPage(int pageIndex, std::string* error);
+    bool RenderBands(int pageIndex, std::string* error);
+    void Run();
+
+    std::shared_ptr<PdfDocument> m_document;
+    PageStreamOptions m_options;
+    ChunkCallback m_onChunk;
+    EndCallback m_onEnd;
+    RenderControl m_control;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    int m_credits = 0;
+    bool m_cancelled = false;
+    std::thread m_thread;
+};
+
+#endif // PAGE_STREAM_H
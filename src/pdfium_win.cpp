@@ -1,29 +1,302 @@
 #include "pdfium_win.h"
+#include "metrics.h"
+#include "util.h"
 #include "fpdfview.h"
 #include "fpdf_doc.h"
+#include "fpdf_edit.h"
+#include "fpdf_flatten.h"
+#include "fpdf_formfill.h"
+#include "fpdf_ppo.h"
+#include "fpdf_progressive.h"
+#include "fpdf_annot.h"
+#include "fpdf_text.h"
+#include "fpdf_transformpage.h"
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <string>
 #include <memory>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
 
-static FPDF_DOCUMENT g_document = nullptr;
+typedef std::chrono::steady_clock Clock;
+
+// Length of one progressive rendering slice; the pause callback is polled by
+// pdfium between drawing operations, so slices can run somewhat longer
+static const int kRenderSliceMs = 20;
+
+struct PdfDocument {
+    FPDF_DOCUMENT handle = nullptr;
+    // FPDF_LoadMemDocument requires the buffer to outlive the document
+    std::vector<unsigned char> data;
+    
+    // Form fields: one form-fill environment per document, created on the
+    // first render and shared by all pages; in flatten mode pages are
+    // flattened in memory once and the result is reused
+    FormMode formMode = FORMS_DRAW;
+    bool formChecked = false;
+    bool hasForm = false;
+    FPDF_FORMFILLINFO formInfo;
+    FPDF_FORMHANDLE form = nullptr;
+    std::vector<bool> flattened;
+};
+
+// pdfium keeps global state and is not thread-safe: every call into it is
+// serialized through this lock. Recursive so wrapper functions can nest.
+static std::recursive_mutex g_pdfiumMutex;
+static int g_libraryRefs = 0;
+
+struct PdfOverlay {
+    FPDF_DOCUMENT document = nullptr;
+    FPDF_PAGE page = nullptr;
+    float height = 0;
+    int objects = 0;
+    std::map<std::string, FPDF_FONT> fonts;
+};
+
+// The document loaded through LoadPdf (the single-document API)
+static PdfDocument* g_document = nullptr;
+
+// Only contended acquisitions are timed; the common case is one try_lock
+template <typename Lock>
+static void LockPdfium(Lock& lock) {
+    if (!lock.try_lock()) {
+        StageTimer wait(STAGE_LOCK_WAIT);
+        lock.lock();
+    }
+}
+
+PdfiumLock::PdfiumLock() {
+    LockPdfium(g_pdfiumMutex);
+}
+
+PdfiumLock::~PdfiumLock() {
+    g_pdfiumMutex.unlock();
+}
+
+RenderControl::RenderControl() : m_cancelled(false), m_pageBudgetMs(0), m_hasDeadline(false) {
+}
+
+void RenderControl::Cancel() {
+    m_cancelled = true;
+}
+
+bool RenderControl::IsCancelled() const {
+    return m_cancelled;
+}
+
+void RenderControl::SetPageBudget(unsigned int budgetMs) {
+    m_pageBudgetMs = budgetMs;
+}
+
+unsigned int RenderControl::PageBudget() const {
+    return m_pageBudgetMs;
+}
+
+void RenderControl::SetTimeout(unsigned int timeoutMs) {
+    m_hasDeadline = timeoutMs > 0;
+    m_deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+}
+
+RenderStatus RenderControl::Check(Clock::time_point pageStart) const {
+    if (m_cancelled) {
+        return RENDER_CANCELLED;
+    }
+    Clock::time_point now = Clock::now();
+    if (m_hasDeadline && now >= m_deadline) {
+        return RENDER_JOB_TIMEOUT;
+    }
+    if (m_pageBudgetMs > 0 && now - pageStart >= std::chrono::milliseconds(m_pageBudgetMs)) {
+        return RENDER_PAGE_TIMEOUT;
+    }
+    return RENDER_OK;
+}
+
+struct RenderPause : IFSDK_PAUSE {
+    const RenderControl* control;
+    Clock::time_point pageStart;
+    Clock::time_point sliceEnd;
+};
+
+static FPDF_BOOL NeedToPauseNow(IFSDK_PAUSE* pause) {
+    RenderPause* state = static_cast<RenderPause*>(pause);
+    return Clock::now() >= state->sliceEnd || state->control->Check(state->pageStart) != RENDER_OK;
+}
+
+// Render a page into a bitmap. With a control, rendering runs in time slices:
+// between slices the stop conditions are checked and the pdfium lock (held by
+// the caller through lock) is released so other jobs can render.
+static RenderStatus RenderPage(std::unique_lock<std::recursive_mutex>& lock, FPDF_BITMAP bitmap, FPDF_PAGE page,
+                               int x, int y, int width, int height, int rotation, int flags,
+                               const RenderControl* control, Clock::time_point pageStart) {
+    if (!control) {
+        StageTimer timer(STAGE_RENDER);
+        FPDF_RenderPageBitmap(bitmap, page, x, y, width, height, rotation, flags);
+        return RENDER_OK;
+    }
+    
+    // Time spent yielding the lock to other jobs is not counted as rendering;
+    // on the timeline a page that yielded shows its slices inside the render
+    bool timed = Metrics::IsEnabled() || Tracing::IsActive();
+    Clock::duration rendering = Clock::duration::zero();
+    Clock::time_point renderStart = timed ? Clock::now() : Clock::time_point();
+    Clock::time_point sliceStart = renderStart;
+    int slices = 0;
+    auto endSlice = [&](bool last) {
+        Clock::time_point sliceEnd = Clock::now();
+        rendering += sliceEnd - sliceStart;
+        if (!last || slices > 0) {
+            Tracing::Complete("render_slice", sliceStart, sliceEnd);
+        }
+        slices++;
+        if (last) {
+            Metrics::Record(STAGE_RENDER,
+                            (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(rendering).count());
+            Tracing::Complete(Metrics::StageName(STAGE_RENDER), renderStart, sliceEnd);
+        }
+    };
+    
+    RenderPause pause;
+    pause.version = 1;
+    pause.NeedToPauseNow = NeedToPauseNow;
+    pause.user = nullptr;
+    pause.control = control;
+    pause.pageStart = pageStart;
+    pause.sliceEnd = Clock::now() + std::chrono::milliseconds(kRenderSliceMs);
+    
+    int state = FPDF_RenderPageBitmap_Start(bitmap, page, x, y, width, height, rotation, flags, &pause);
+    while (state == FPDF_RENDER_TOBECONTINUED) {
+        RenderStatus check = control->Check(pageStart);
+        if (check != RENDER_OK) {
+            FPDF_RenderPage_Close(page);
+            if (timed) {
+                endSlice(true);
+            }
+            return check;
+        }
+        
+        if (timed) {
+            endSlice(false);
+        }
+        lock.unlock();
+        std::this_thread::yield();
+        LockPdfium(lock);
+        if (timed) {
+            sliceStart = Clock::now();
+        }
+        
+        pause.sliceEnd = Clock::now() + std::chrono::milliseconds(kRenderSliceMs);
+        state = FPDF_RenderPage_Continue(page, &pause);
+    }
+    FPDF_RenderPage_Close(page);
+    if (timed) {
+        endSlice(true);
+    }
+    return state == FPDF_RENDER_DONE ? RENDER_OK : RENDER_FAILED;
+}
+
+// Whether the document has an AcroForm; the form-fill environment for draw
+// mode is created along with the check
+static bool PrepareForms(PdfDocument* document) {
+    if (document->formChecked) {
+        return document->hasForm;
+    }
+    document->formChecked = true;
+    document->hasForm = FPDF_GetFormType(document->handle) != FORMTYPE_NONE;
+    if (document->hasForm && document->formMode == FORMS_DRAW) {
+        memset(&document->formInfo, 0, sizeof(document->formInfo));
+        document->formInfo.version = 1;
+        document->form = FPDFDOC_InitFormFillEnvironment(document->handle, &document->formInfo);
+    }
+    return document->hasForm;
+}
+
+// Bake the form fields of a page into its content; pdfium only shows the
+// result on pages loaded afterwards
+static void FlattenPage(PdfDocument* document, int pageIndex) {
+    if ((int)document->flattened.size() <= pageIndex) {
+        document->flattened.resize(FPDF_GetPageCount(document->handle), false);
+    }
+    if (document->flattened[pageIndex]) {
+        return;
+    }
+    FPDF_PAGE page = FPDF_LoadPage(document->handle, pageIndex);
+    if (page) {
+        FPDFPage_Flatten(page, FLAT_PRINT);
+        FPDF_ClosePage(page);
+    }
+    document->flattened[pageIndex] = true;
+}
+
+// Load a page for rendering with its form fields prepared for the document's mode
+static FPDF_PAGE LoadRenderPage(PdfDocument* document, int pageIndex) {
+    StageTimer timer(STAGE_PAGE_LOAD);
+    if (document->formMode != FORMS_NONE && PrepareForms(document) && document->formMode == FORMS_FLATTEN) {
+        FlattenPage(document, pageIndex);
+    }
+    FPDF_PAGE page = FPDF_LoadPage(document->handle, pageIndex);
+    if (page && document->form) {
+        FORM_OnAfterLoadPage(page, document->form);
+    }
+    return page;
+}
+
+static void CloseRenderPage(PdfDocument* document, FPDF_PAGE page) {
+    if (document->form) {
+        FORM_OnBeforeClosePage(page, document->form);
+    }
+    FPDF_ClosePage(page);
+}
+
+// Draw the form fields over a rendered page (draw mode only)
+static void DrawForms(PdfDocument* document, FPDF_BITMAP bitmap, FPDF_PAGE page,
+                      int x, int y, int width, int height, int rotation, int flags) {
+    if (document->form) {
+        FPDF_FFLDraw(document->form, bitmap, page, x, y, width, height, rotation, flags);
+    }
+}
 
 bool PdfiumWrapper::Initialize() {
-    FPDF_InitLibrary();
-    return true;
+    return AcquireLibrary();
 }
 
 void PdfiumWrapper::Shutdown() {
+    PdfiumLock lock;
     CloseDocument();
-    FPDF_DestroyLibrary();
+    ReleaseLibrary();
 }
 
-bool PdfiumWrapper::LoadPdf(const std::string& filePath) {
-    CloseDocument();
+bool PdfiumWrapper::AcquireLibrary() {
+    PdfiumLock lock;
+    if (g_libraryRefs++ == 0) {
+        FPDF_InitLibrary();
+    }
+    return true;
+}
+
+void PdfiumWrapper::ReleaseLibrary() {
+    PdfiumLock lock;
+    if (g_libraryRefs > 0 && --g_libraryRefs == 0) {
+        FPDF_DestroyLibrary();
+    }
+}
+
+static bool ReadFileData(const std::string& filePath, std::vector<unsigned char>* buffer) {
+    StageTimer timer(STAGE_FILE_READ);
+#ifdef _WIN32
+    std::wstring wpath = Utf8ToWide(filePath);
     
-    std::wstring wpath(filePath.begin(), filePath.end());
     FILE* file = _wfopen(wpath.c_str(), L"rb");
+#else
+    // The renderer process also builds on POSIX, where paths are UTF-8 already
+    FILE* file = fopen(filePath.c_str(), "rb");
+#endif
     if (!file) {
         return false;
     }
@@ -37,37 +310,126 @@ bool PdfiumWrapper::LoadPdf(const std::string& filePath) {
         return false;
     }
     
-    std::vector<unsigned char> buffer(fileSize);
-    size_t bytesRead = fread(buffer.data(), 1, fileSize, file);
+    buffer->resize(fileSize);
+    size_t bytesRead = fread(buffer->data(), 1, fileSize, file);
     fclose(file);
+    Metrics::Add(COUNTER_BYTES_READ, (long long)bytesRead);
+    
+    return bytesRead == static_cast<size_t>(fileSize);
+}
+
+PdfDocument* PdfiumWrapper::OpenDocument(const std::string& filePath) {
+    // Read the file before taking the lock; only the parse needs pdfium
+    PdfDocument* document = new PdfDocument();
+    if (!ReadFileData(filePath, &document->data)) {
+        delete document;
+        return nullptr;
+    }
     
-    if (bytesRead != static_cast<size_t>(fileSize)) {
+    PdfiumLock lock;
+    StageTimer timer(STAGE_DOCUMENT_LOAD);
+    document->handle = FPDF_LoadMemDocument(document->data.data(), (int)document->data.size(), nullptr);
+    if (!document->handle) {
+        delete document;
+        return nullptr;
+    }
+    return document;
+}
+
+void PdfiumWrapper::CloseDocument(PdfDocument* document) {
+    if (!document) {
+        return;
+    }
+    {
+        PdfiumLock lock;
+        if (document->form) {
+            FPDFDOC_ExitFormFillEnvironment(document->form);
+        }
+        if (document->handle) {
+            FPDF_CloseDocument(document->handle);
+        }
+    }
+    delete document;
+}
+
+PdfDocument* PdfiumWrapper::CurrentDocument() {
+    PdfiumLock lock;
+    return g_document;
+}
+
+bool PdfiumWrapper::LoadPdf(const std::string& filePath) {
+    CloseDocument();
+    
+    PdfDocument* document = OpenDocument(filePath);
+    if (!document) {
         return false;
     }
     
-    g_document = FPDF_LoadMemDocument(buffer.data(), fileSize, nullptr);
-    return g_document != nullptr;
+    PdfiumLock lock;
+    CloseDocument();
+    g_document = document;
+    return true;
 }
 
 int PdfiumWrapper::GetPageCount() {
-    if (!g_document) {
+    PdfiumLock lock;
+    return GetPageCount(g_document);
+}
+
+int PdfiumWrapper::GetPageCount(PdfDocument* document) {
+    if (!document) {
         return 0;
     }
-    return FPDF_GetPageCount(g_document);
+    PdfiumLock lock;
+    return FPDF_GetPageCount(document->handle);
+}
+
+size_t PdfiumWrapper::GetDocumentSize(PdfDocument* document) {
+    return document ? document->data.size() : 0;
+}
+
+const unsigned char* PdfiumWrapper::GetDocumentData(PdfDocument* document) {
+    return document && !document->data.empty() ? document->data.data() : nullptr;
+}
+
+void PdfiumWrapper::SetFormMode(PdfDocument* document, FormMode mode) {
+    if (!document) {
+        return;
+    }
+    PdfiumLock lock;
+    // The mode applies from the first render on; later changes are ignored
+    if (!document->formChecked) {
+        document->formMode = mode;
+    }
 }
 
 BitmapData* PdfiumWrapper::RenderPageToBitmap(int pageIndex, int dpi) {
-    if (!g_document) {
+    PdfiumLock lock;
+    return RenderPageToBitmap(g_document, pageIndex, dpi);
+}
+
+BitmapData* PdfiumWrapper::RenderPageToBitmap(PdfDocument* document, int pageIndex, int dpi) {
+    return RenderPageToBitmap(document, pageIndex, dpi, nullptr, nullptr);
+}
+
+BitmapData* PdfiumWrapper::RenderPageToBitmap(PdfDocument* document, int pageIndex, int dpi,
+                                              const RenderControl* control, RenderStatus* status, int rotation) {
+    SetStatus(status, RENDER_FAILED);
+    if (!document) {
         return nullptr;
     }
     
+    Clock::time_point pageStart = Clock::now();
+    std::unique_lock<std::recursive_mutex> lock(g_pdfiumMutex, std::defer_lock);
+    LockPdfium(lock);
+    
     // Validate page index
-    int pageCount = FPDF_GetPageCount(g_document);
+    int pageCount = FPDF_GetPageCount(document->handle);
     if (pageIndex < 0 || pageIndex >= pageCount) {
         return nullptr;
     }
     
-    FPDF_PAGE page = FPDF_LoadPage(g_document, pageIndex);
+    FPDF_PAGE page = LoadRenderPage(document, pageIndex);
     if (!page) {
         return nullptr;
     }
@@ -82,23 +444,30 @@ BitmapData* PdfiumWrapper::RenderPageToBitmap(int pageIndex, int dpi) {
     
     // Validate dimensions
     if (pixelWidth <= 0 || pixelHeight <= 0) {
-        FPDF_ClosePage(page);
+        CloseRenderPage(document, page);
         return nullptr;
     }
     
+    // Quarter turns swap the bitmap's sides; pdfium rotates while rendering
+    rotation &= 3;
+    if (rotation & 1) {
+        std::swap(pixelWidth, pixelHeight);
+    }
+    
     // Create bitmap with 4 bytes per pixel (BGRA)
     int stride = pixelWidth * 4;
     unsigned char* bitmapBuffer = new (std::nothrow) unsigned char[stride * pixelHeight];
     if (!bitmapBuffer) {
-        FPDF_ClosePage(page);
+        CloseRenderPage(document, page);
         return nullptr;
     }
+    Metrics::CountAllocation((size_t)stride * pixelHeight);
     
     // Create FPDF bitmap
     FPDF_BITMAP bitmap = FPDFBitmap_CreateEx(pixelWidth, pixelHeight, FPDFBitmap_BGRA, 
                                               bitmapBuffer, stride);
     if (!bitmap) {
-        FPDF_ClosePage(page);
+        CloseRenderPage(document, page);
         delete[] bitmapBuffer;
         return nullptr;
     }
@@ -107,9 +476,19 @@ BitmapData* PdfiumWrapper::RenderPageToBitmap(int pageIndex, int dpi) {
     FPDFBitmap_FillRect(bitmap, 0, 0, pixelWidth, pixelHeight, 0xFFFFFFFF);
     
     // Render page to bitmap
-    // Parameters: bitmap, page, start_x, start_y, size_x, size_y, rotate, flags
-    FPDF_RenderPageBitmap(bitmap, page, 0, 0, pixelWidth, pixelHeight, 0, 
-                         FPDF_ANNOT | FPDF_LCD_TEXT | FPDF_NO_CATCH);
+    int flags = FPDF_ANNOT | FPDF_LCD_TEXT | FPDF_NO_CATCH;
+    RenderStatus rendered = RenderPage(lock, bitmap, page, 0, 0, pixelWidth, pixelHeight, rotation,
+                                       flags, control, pageStart);
+    if (rendered != RENDER_OK) {
+        FPDFBitmap_Destroy(bitmap);
+        CloseRenderPage(document, page);
+        delete[] bitmapBuffer;
+        SetStatus(status, rendered);
+        return nullptr;
+    }
+    
+    DrawForms(document, bitmap, page, 0, 0, pixelWidth, pixelHeight, rotation, flags);
+    Metrics::Add(COUNTER_PIXELS, (long long)pixelWidth * pixelHeight);
     
     BitmapData* result = new BitmapData();
     result->data = bitmapBuffer;
@@ -119,11 +498,728 @@ BitmapData* PdfiumWrapper::RenderPageToBitmap(int pageIndex, int dpi) {
     result->bitmapFormat = 0; // BGRA
     
     FPDFBitmap_Destroy(bitmap);
-    FPDF_ClosePage(page);
+    CloseRenderPage(document, page);
+    
+    SetStatus(status, RENDER_OK);
+    return result;
+}
+
+bool PdfiumWrapper::GetPageSize(int pageIndex, float* width, float* height) {
+    PdfiumLock lock;
+    return GetPageSize(g_document, pageIndex, width, height);
+}
+
+bool PdfiumWrapper::GetPageSize(PdfDocument* document, int pageIndex, float* width, float* height) {
+    if (!document) {
+        return false;
+    }
+    
+    PdfiumLock lock;
+    FS_SIZEF size;
+    if (!FPDF_GetPageSizeByIndexF(document->handle, pageIndex, &size)) {
+        return false;
+    }
+    *width = size.width;
+    *height = size.height;
+    return true;
+}
+
+// Columns and rows of an N-up sheet for portrait pages; 2-up and 6-up turn
+// the sheet sideways
+static bool GetNupGrid(int nup, int* columns, int* rows, bool* rotateSheet) {
+    switch (nup) {
+    case 2:  *columns = 2; *rows = 1; *rotateSheet = true; return true;
+    case 4:  *columns = 2; *rows = 2; *rotateSheet = false; return true;
+    case 6:  *columns = 3; *rows = 2; *rotateSheet = true; return true;
+    case 9:  *columns = 3; *rows = 3; *rotateSheet = false; return true;
+    case 16: *columns = 4; *rows = 4; *rotateSheet = false; return true;
+    default: return false;
+    }
+}
+
+// Place a source page into a cell of the target page, scaled to fit and centred
+static bool PlacePage(FPDF_DOCUMENT target, FPDF_PAGE sheet, FPDF_DOCUMENT source, int pageIndex,
+                      double cellX, double cellY, double cellWidth, double cellHeight) {
+    FS_SIZEF size;
+    if (!FPDF_GetPageSizeByIndexF(source, pageIndex, &size) || size.width <= 0 || size.height <= 0) {
+        return false;
+    }
+    FPDF_XOBJECT xobject = FPDF_NewXObjectFromPage(target, source, pageIndex);
+    if (!xobject) {
+        return false;
+    }
+    FPDF_PAGEOBJECT form = FPDF_NewFormObjectFromXObject(xobject);
+    FPDF_CloseXObject(xobject);
+    if (!form) {
+        return false;
+    }
+    double scale = std::min(cellWidth / size.width, cellHeight / size.height);
+    double x = cellX + (cellWidth - size.width * scale) / 2;
+    double y = cellY + (cellHeight - size.height * scale) / 2;
+    FPDFPageObj_Transform(form, scale, 0, 0, scale, x, y);
+    FPDFPage_InsertObject(sheet, form);
+    return true;
+}
+
+// Saddle-stitch order: the sheet stack is folded in half, so the outermost
+// side carries the last and first pages. Blank padding is -1.
+static std::vector<int> BookletOrder(int pageCount) {
+    int padded = (pageCount + 3) / 4 * 4;
+    std::vector<int> order;
+    for (int sheet = 0; sheet < padded / 4; sheet++) {
+        int front[2] = { padded - 1 - 2 * sheet, 2 * sheet };
+        int back[2] = { 2 * sheet + 1, padded - 2 - 2 * sheet };
+        for (int page : front) {
+            order.push_back(page < pageCount ? page : -1);
+        }
+        for (int page : back) {
+            order.push_back(page < pageCount ? page : -1);
+        }
+    }
+    return order;
+}
+
+static FPDF_DOCUMENT ImposeBooklet(FPDF_DOCUMENT source, float pageWidth, float pageHeight) {
+    int pageCount = FPDF_GetPageCount(source);
+    std::vector<int> order = BookletOrder(pageCount);
+    FPDF_DOCUMENT target = FPDF_CreateNewDocument();
+    if (!target) {
+        return nullptr;
+    }
+    for (size_t side = 0; side * 2 < order.size(); side++) {
+        FPDF_PAGE sheet = FPDFPage_New(target, (int)side, pageWidth * 2, pageHeight);
+        if (!sheet) {
+            FPDF_CloseDocument(target);
+            return nullptr;
+        }
+        bool placed = true;
+        for (int half = 0; half < 2 && placed; half++) {
+            int page = order[side * 2 + half];
+            if (page >= 0) {
+                placed = PlacePage(target, sheet, source, page, half * pageWidth, 0, pageWidth, pageHeight);
+            }
+        }
+        placed = placed && FPDFPage_GenerateContent(sheet);
+        FPDF_ClosePage(sheet);
+        if (!placed) {
+            FPDF_CloseDocument(target);
+            return nullptr;
+        }
+    }
+    return target;
+}
+
+PdfDocument* PdfiumWrapper::ImposeDocument(PdfDocument* source, const PageLayout& layout) {
+    if (!source) {
+        return nullptr;
+    }
+    int columns = 1, rows = 1;
+    bool rotateSheet = false;
+    if (!layout.booklet && !GetNupGrid(layout.nup, &columns, &rows, &rotateSheet)) {
+        return nullptr;
+    }
+    
+    PdfiumLock lock;
+    FS_SIZEF size;
+    if (!FPDF_GetPageSizeByIndexF(source->handle, 0, &size)) {
+        return nullptr;
+    }
+    
+    // Imposition copies page content but not widgets, so form fields are
+    // flattened into the source pages first
+    if (source->formMode != FORMS_NONE && PrepareForms(source)) {
+        int pageCount = FPDF_GetPageCount(source->handle);
+        for (int i = 0; i < pageCount; i++) {
+            FlattenPage(source, i);
+        }
+    }
     
+    FPDF_DOCUMENT handle = nullptr;
+    if (layout.booklet) {
+        handle = ImposeBooklet(source->handle, size.width, size.height);
+    } else {
+        // Portrait pages 2-up go side by side on a landscape sheet, landscape
+        // pages 2-up are stacked on a portrait one
+        float sheetWidth = rotateSheet ? size.height : size.width;
+        float sheetHeight = rotateSheet ? size.width : size.height;
+        if (size.width > size.height) {
+            std::swap(columns, rows);
+        }
+        handle = FPDF_ImportNPagesToOne(source->handle, sheetWidth, sheetHeight, columns, rows);
+    }
+    if (!handle) {
+        return nullptr;
+    }
+    
+    PdfDocument* document = new PdfDocument();
+    document->handle = handle;
+    return document;
+}
+
+// pdfium takes UTF-16LE strings; decoded here rather than through the
+// platform's wchar_t, whose width differs between systems
+static std::vector<unsigned short> Utf8ToUtf16(const std::string& text) {
+    std::vector<unsigned short> result;
+    result.reserve(text.size() + 1);
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char lead = (unsigned char)text[i];
+        unsigned int codePoint = 0xFFFD;
+        int length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        if (length == 0 || i + length > text.size()) {
+            i++;
+        } else {
+            codePoint = length == 1 ? lead : lead & (0x7F >> length);
+            for (int k = 1; k < length; k++) {
+                codePoint = (codePoint << 6) | ((unsigned char)text[i + k] & 0x3F);
+            }
+            i += length;
+        }
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            result.push_back((unsigned short)(0xD800 + (codePoint >> 10)));
+            result.push_back((unsigned short)(0xDC00 + (codePoint & 0x3FF)));
+        } else {
+            result.push_back((unsigned short)codePoint);
+        }
+    }
+    result.push_back(0);
     return result;
 }
 
+PdfOverlay* PdfiumWrapper::CreateOverlay(float width, float height) {
+    if (width <= 0 || height <= 0) {
+        return nullptr;
+    }
+    PdfiumLock lock;
+    PdfOverlay* overlay = new PdfOverlay();
+    overlay->document = FPDF_CreateNewDocument();
+    overlay->page = overlay->document ? FPDFPage_New(overlay->document, 0, width, height) : nullptr;
+    if (!overlay->page) {
+        CloseOverlay(overlay);
+        return nullptr;
+    }
+    overlay->height = height;
+    return overlay;
+}
+
+bool PdfiumWrapper::AddOverlayText(PdfOverlay* overlay, float x, float y, const std::string& text,
+                                   const std::string& font, float fontSize, unsigned int color) {
+    if (!overlay || fontSize <= 0) {
+        return false;
+    }
+    PdfiumLock lock;
+    FPDF_FONT& handle = overlay->fonts[font];
+    if (!handle) {
+        handle = FPDFText_LoadStandardFont(overlay->document, font.c_str());
+        if (!handle) {
+            overlay->fonts.erase(font);
+            return false;
+        }
+    }
+    FPDF_PAGEOBJECT object = FPDFPageObj_CreateTextObj(overlay->document, handle, fontSize);
+    if (!object) {
+        return false;
+    }
+    std::vector<unsigned short> wide = Utf8ToUtf16(text);
+    if (!FPDFText_SetText(object, (FPDF_WIDESTRING)wide.data()) ||
+        !FPDFPageObj_SetFillColor(object, (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF, color >> 24)) {
+        FPDFPageObj_Destroy(object);
+        return false;
+    }
+    // PDF space has its origin at the bottom left
+    FPDFPageObj_Transform(object, 1, 0, 0, 1, x, overlay->height - y);
+    FPDFPage_InsertObject(overlay->page, object);
+    overlay->objects++;
+    return true;
+}
+
+bool PdfiumWrapper::AddOverlayImage(PdfOverlay* overlay, float x, float y, float width, float height,
+                                    const unsigned char* pixels, int pixelWidth, int pixelHeight, int stride) {
+    if (!overlay || !pixels || pixelWidth <= 0 || pixelHeight <= 0 || stride < pixelWidth * 4 ||
+        width <= 0 || height <= 0) {
+        return false;
+    }
+    PdfiumLock lock;
+    FPDF_PAGEOBJECT object = FPDFPageObj_NewImageObj(overlay->document);
+    if (!object) {
+        return false;
+    }
+    // The image object copies the pixels, so the caller's buffer is only borrowed
+    FPDF_BITMAP bitmap = FPDFBitmap_CreateEx(pixelWidth, pixelHeight, FPDFBitmap_BGRA,
+                                             const_cast<unsigned char*>(pixels), stride);
+    bool set = bitmap && FPDFImageObj_SetBitmap(nullptr, 0, object, bitmap);
+    if (bitmap) {
+        FPDFBitmap_Destroy(bitmap);
+    }
+    if (!set) {
+        FPDFPageObj_Destroy(object);
+        return false;
+    }
+    // Images occupy the unit square; scale it to the display size
+    FPDFPageObj_Transform(object, width, 0, 0, height, x, overlay->height - y - height);
+    FPDFPage_InsertObject(overlay->page, object);
+    overlay->objects++;
+    return true;
+}
+
+void PdfiumWrapper::ClearOverlay(PdfOverlay* overlay) {
+    if (!overlay) {
+        return;
+    }
+    PdfiumLock lock;
+    for (int i = FPDFPage_CountObjects(overlay->page) - 1; i >= 0; i--) {
+        FPDF_PAGEOBJECT object = FPDFPage_GetObject(overlay->page, i);
+        if (object && FPDFPage_RemoveObject(overlay->page, object)) {
+            FPDFPageObj_Destroy(object);
+        }
+    }
+    overlay->objects = 0;
+}
+
+bool PdfiumWrapper::RenderOverlay(PdfOverlay* overlay, unsigned char* buffer, int bufferWidth, int bufferHeight,
+                                  int stride, bool gray, int x, int y, int pixelWidth, int pixelHeight, int rotation) {
+    if (!overlay || !buffer || bufferWidth <= 0 || bufferHeight <= 0) {
+        return false;
+    }
+    if (overlay->objects == 0) {
+        return true;
+    }
+    PdfiumLock lock;
+    FPDF_BITMAP bitmap = FPDFBitmap_CreateEx(bufferWidth, bufferHeight, gray ? FPDFBitmap_Gray : FPDFBitmap_BGRA,
+                                             buffer, stride);
+    if (!bitmap) {
+        return false;
+    }
+    // Same flags as the page renders the overlay is composited onto; the
+    // page has no background, so only the new objects are painted
+    int flags = gray ? FPDF_GRAYSCALE | FPDF_PRINTING | FPDF_NO_CATCH : FPDF_LCD_TEXT | FPDF_NO_CATCH;
+    FPDF_RenderPageBitmap(bitmap, overlay->page, x, y, pixelWidth, pixelHeight, rotation & 3, flags);
+    FPDFBitmap_Destroy(bitmap);
+    return true;
+}
+
+void PdfiumWrapper::CloseOverlay(PdfOverlay* overlay) {
+    if (!overlay) {
+        return;
+    }
+    {
+        PdfiumLock lock;
+        if (overlay->page) {
+            FPDF_ClosePage(overlay->page);
+        }
+        for (auto& entry : overlay->fonts) {
+            FPDFFont_Close(entry.second);
+        }
+        if (overlay->document) {
+            FPDF_CloseDocument(overlay->document);
+        }
+    }
+    delete overlay;
+}
+
+// Form XObjects can nest; deeper content is rare and not worth the walk
+static const int kMaxFormDepth = 8;
+
+// Images drawn smaller than this (in points) are hairlines or dots whose
+// effective resolution says nothing about the page
+static const float kMinImageExtent = 4.0f;
+
+static void AnalyzeObject(FPDF_PAGEOBJECT object, double scale, int depth, PageContent* content) {
+    switch (FPDFPageObj_GetType(object)) {
+    case FPDF_PAGEOBJ_TEXT:
+        content->textObjects++;
+        break;
+    case FPDF_PAGEOBJ_PATH:
+        content->pathObjects++;
+        break;
+    case FPDF_PAGEOBJ_SHADING:
+        content->shadingObjects++;
+        break;
+    case FPDF_PAGEOBJ_IMAGE: {
+        content->imageObjects++;
+        unsigned int pixelWidth = 0, pixelHeight = 0;
+        float left = 0, bottom = 0, right = 0, top = 0;
+        if (!FPDFImageObj_GetImagePixelSize(object, &pixelWidth, &pixelHeight) ||
+            !FPDFPageObj_GetBounds(object, &left, &bottom, &right, &top)) {
+            break;
+        }
+        content->imageMegapixels += (double)pixelWidth * pixelHeight / 1e6;
+        double width = (right - left) * scale;
+        double height = (top - bottom) * scale;
+        if (width < kMinImageExtent || height < kMinImageExtent) {
+            break;
+        }
+        // Source pixels per inch of page area; independent of 90 degree rotation
+        double dpi = std::sqrt((double)pixelWidth * pixelHeight / (width / 72.0 * height / 72.0));
+        if (dpi > content->maxImageDpi) {
+            content->maxImageDpi = dpi;
+        }
+        break;
+    }
+    case FPDF_PAGEOBJ_FORM: {
+        content->formObjects++;
+        if (depth >= kMaxFormDepth) {
+            break;
+        }
+        // Bounds of nested objects are in form space; carry the form's scale
+        FS_MATRIX matrix;
+        double formScale = scale;
+        if (FPDFPageObj_GetMatrix(object, &matrix)) {
+            formScale *= std::sqrt(std::fabs((double)matrix.a * matrix.d - (double)matrix.b * matrix.c));
+        }
+        int count = FPDFFormObj_CountObjects(object);
+        for (int i = 0; i < count; i++) {
+            FPDF_PAGEOBJECT child = FPDFFormObj_GetObject(object, i);
+            if (child) {
+                AnalyzeObject(child, formScale, depth + 1, content);
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+bool PdfiumWrapper::AnalyzePage(PdfDocument* document, int pageIndex, PageContent* content) {
+    if (!document || !content) {
+        return false;
+    }
+    
+    PdfiumLock lock;
+    FPDF_PAGE page = FPDF_LoadPage(document->handle, pageIndex);
+    if (!page) {
+        return false;
+    }
+    
+    *content = PageContent();
+    content->width = FPDF_GetPageWidthF(page);
+    content->height = FPDF_GetPageHeightF(page);
+    content->hasTransparency = FPDFPage_HasTransparency(page) != 0;
+    int count = FPDFPage_CountObjects(page);
+    for (int i = 0; i < count; i++) {
+        FPDF_PAGEOBJECT object = FPDFPage_GetObject(page, i);
+        if (object) {
+            AnalyzeObject(object, 1.0, 0, content);
+        }
+    }
+    
+    FPDF_ClosePage(page);
+    return true;
+}
+
+// Content descriptions are raw bytes; values are appended in native layout,
+// which is fine since they are only compared within one process
+template <typename T>
+static void AppendValue(std::string* out, const T& value) {
+    out->append((const char*)&value, sizeof(value));
+}
+
+static void AppendBytes(std::string* out, const void* data, size_t size) {
+    AppendValue(out, (uint64_t)size);
+    out->append((const char*)data, size);
+}
+
+static void DescribeSegment(FPDF_PATHSEGMENT segment, std::string* out) {
+    float x = 0, y = 0;
+    FPDFPathSegment_GetPoint(segment, &x, &y);
+    AppendValue(out, FPDFPathSegment_GetType(segment));
+    AppendValue(out, FPDFPathSegment_GetClose(segment));
+    AppendValue(out, x);
+    AppendValue(out, y);
+}
+
+// Embedded font programs are included once per page, so two documents that
+// subset the same font differently do not look alike
+static void DescribeFont(FPDF_FONT font, std::map<FPDF_FONT, int>& fonts, std::string* out) {
+    auto found = fonts.find(font);
+    if (found != fonts.end()) {
+        AppendValue(out, found->second);
+        return;
+    }
+    int ordinal = (int)fonts.size();
+    fonts[font] = ordinal;
+    AppendValue(out, ordinal);
+    AppendValue(out, FPDFFont_GetFlags(font));
+    AppendValue(out, FPDFFont_GetWeight(font));
+    char name[256] = { 0 };
+    size_t length = FPDFFont_GetBaseFontName(font, name, sizeof(name));
+    AppendBytes(out, name, std::min(length, sizeof(name)));
+    size_t dataLength = 0;
+    if (FPDFFont_GetIsEmbedded(font) && FPDFFont_GetFontData(font, nullptr, 0, &dataLength) && dataLength > 0) {
+        std::vector<uint8_t> data(dataLength);
+        FPDFFont_GetFontData(font, data.data(), data.size(), &dataLength);
+        AppendBytes(out, data.data(), std::min(dataLength, data.size()));
+    }
+}
+
+struct PageDescription {
+    std::map<FPDF_FONT, int> fonts;
+    std::map<FPDF_PAGEOBJECT, int> textObjects;  // ordinal of each text object, tying characters to their font
+    std::string bytes;
+};
+
+// Appends everything that affects how the object is drawn. Returns false for
+// content whose appearance is not fully visible through the API (shadings,
+// blend modes and soft masks)
+static bool DescribeObject(FPDF_PAGEOBJECT object, int depth, PageDescription* description) {
+    std::string* out = &description->bytes;
+    int type = FPDFPageObj_GetType(object);
+    if (FPDFPageObj_HasTransparency(object)) {
+        return false;
+    }
+    AppendValue(out, type);
+    FS_MATRIX matrix = { 1, 0, 0, 1, 0, 0 };
+    FPDFPageObj_GetMatrix(object, &matrix);
+    AppendValue(out, matrix);
+    unsigned int color[8] = { 0 };
+    FPDFPageObj_GetFillColor(object, &color[0], &color[1], &color[2], &color[3]);
+    FPDFPageObj_GetStrokeColor(object, &color[4], &color[5], &color[6], &color[7]);
+    AppendValue(out, color);
+
+    FPDF_CLIPPATH clip = FPDFPageObj_GetClipPath(object);
+    int clipPaths = clip ? FPDFClipPath_CountPaths(clip) : 0;
+    AppendValue(out, clipPaths);
+    for (int i = 0; i < clipPaths; i++) {
+        int segments = FPDFClipPath_CountPathSegments(clip, i);
+        AppendValue(out, segments);
+        for (int j = 0; j < segments; j++) {
+            DescribeSegment(FPDFClipPath_GetPathSegment(clip, i, j), out);
+        }
+    }
+
+    switch (type) {
+    case FPDF_PAGEOBJ_PATH: {
+        int fillMode = 0;
+        FPDF_BOOL stroke = 0;
+        FPDFPath_GetDrawMode(object, &fillMode, &stroke);
+        float width = 0;
+        FPDFPageObj_GetStrokeWidth(object, &width);
+        AppendValue(out, fillMode);
+        AppendValue(out, stroke);
+        AppendValue(out, width);
+        AppendValue(out, FPDFPageObj_GetLineJoin(object));
+        AppendValue(out, FPDFPageObj_GetLineCap(object));
+        int dashes = std::max(FPDFPageObj_GetDashCount(object), 0);
+        std::vector<float> dashArray((size_t)dashes);
+        float phase = 0;
+        if (dashes > 0) {
+            FPDFPageObj_GetDashArray(object, dashArray.data(), dashArray.size());
+            FPDFPageObj_GetDashPhase(object, &phase);
+        }
+        AppendBytes(out, dashArray.data(), dashArray.size() * sizeof(float));
+        AppendValue(out, phase);
+        int segments = FPDFPath_CountSegments(object);
+        AppendValue(out, segments);
+        for (int i = 0; i < segments; i++) {
+            DescribeSegment(FPDFPath_GetPathSegment(object, i), out);
+        }
+        return true;
+    }
+    case FPDF_PAGEOBJ_IMAGE: {
+        FPDF_IMAGEOBJ_METADATA metadata;
+        memset(&metadata, 0, sizeof(metadata));
+        FPDFImageObj_GetImageMetadata(object, nullptr, &metadata);
+        AppendValue(out, metadata.width);
+        AppendValue(out, metadata.height);
+        AppendValue(out, metadata.bits_per_pixel);
+        AppendValue(out, metadata.colorspace);
+        int filters = FPDFImageObj_GetImageFilterCount(object);
+        AppendValue(out, filters);
+        for (int i = 0; i < filters; i++) {
+            char filter[64] = { 0 };
+            size_t length = FPDFImageObj_GetImageFilter(object, i, filter, sizeof(filter));
+            AppendBytes(out, filter, std::min(length, sizeof(filter)));
+        }
+        unsigned long length = FPDFImageObj_GetImageDataRaw(object, nullptr, 0);
+        std::vector<uint8_t> data(length);
+        if (length > 0) {
+            FPDFImageObj_GetImageDataRaw(object, data.data(), length);
+        }
+        AppendBytes(out, data.data(), data.size());
+        return true;
+    }
+    case FPDF_PAGEOBJ_TEXT: {
+        int ordinal = (int)description->textObjects.size();
+        description->textObjects[object] = ordinal;
+        float size = 0;
+        FPDFTextObj_GetFontSize(object, &size);
+        AppendValue(out, size);
+        AppendValue(out, (int)FPDFTextObj_GetTextRenderMode(object));
+        FPDF_FONT font = FPDFTextObj_GetFont(object);
+        if (!font) {
+            return false;
+        }
+        DescribeFont(font, description->fonts, out);
+        return true;
+    }
+    case FPDF_PAGEOBJ_FORM: {
+        if (depth >= kMaxFormDepth) {
+            return false;
+        }
+        int count = FPDFFormObj_CountObjects(object);
+        AppendValue(out, count);
+        for (int i = 0; i < count; i++) {
+            FPDF_PAGEOBJECT child = FPDFFormObj_GetObject(object, i);
+            if (!child || !DescribeObject(child, depth + 1, description)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Glyph codes are not exposed, so each character is pinned down by its
+// unicode value, its position and the text object (and so font) drawing it
+static bool DescribeText(FPDF_PAGE page, PageDescription* description) {
+    FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
+    if (!textPage) {
+        return false;
+    }
+    std::string* out = &description->bytes;
+    int count = FPDFText_CountChars(textPage);
+    AppendValue(out, count);
+    for (int i = 0; i < count; i++) {
+        double x = 0, y = 0;
+        FPDFText_GetCharOrigin(textPage, i, &x, &y);
+        FS_MATRIX matrix = { 1, 0, 0, 1, 0, 0 };
+        FPDFText_GetMatrix(textPage, i, &matrix);
+        auto found = description->textObjects.find(FPDFText_GetTextObject(textPage, i));
+        AppendValue(out, FPDFText_GetUnicode(textPage, i));
+        AppendValue(out, x);
+        AppendValue(out, y);
+        AppendValue(out, matrix);
+        AppendValue(out, found != description->textObjects.end() ? found->second : -1);
+    }
+    FPDFText_ClosePage(textPage);
+    return true;
+}
+
+bool PdfiumWrapper::DescribePageContent(PdfDocument* document, int pageIndex, std::string* description) {
+    if (!document || !description) {
+        return false;
+    }
+    
+    PdfiumLock lock;
+    FPDF_PAGE page = FPDF_LoadPage(document->handle, pageIndex);
+    if (!page) {
+        return false;
+    }
+    
+    // Annotations and form widgets are drawn from appearance streams the
+    // object API does not reach, and page-level transparency groups are not
+    // described either; such pages are never considered identical
+    PageDescription content;
+    bool ok = FPDFPage_GetAnnotCount(page) == 0 && !FPDFPage_HasTransparency(page);
+    if (ok) {
+        AppendValue(&content.bytes, FPDF_GetPageWidthF(page));
+        AppendValue(&content.bytes, FPDF_GetPageHeightF(page));
+        AppendValue(&content.bytes, FPDFPage_GetRotation(page));
+        int count = FPDFPage_CountObjects(page);
+        AppendValue(&content.bytes, count);
+        for (int i = 0; ok && i < count; i++) {
+            FPDF_PAGEOBJECT object = FPDFPage_GetObject(page, i);
+            ok = object && DescribeObject(object, 0, &content);
+        }
+    }
+    ok = ok && DescribeText(page, &content);
+    
+    FPDF_ClosePage(page);
+    if (ok) {
+        description->swap(content.bytes);
+    }
+    return ok;
+}
+
+bool PdfiumWrapper::RenderPageBands(PdfDocument* document, int pageIndex, int bandWidth,
+                                    int pixelWidth, int pixelHeight, int bandHeight,
+                                    const BandCallback& onBand,
+                                    const RenderControl* control, RenderStatus* status) {
+    SetStatus(status, RENDER_FAILED);
+    if (!document || bandWidth <= 0 || pixelWidth <= 0 || pixelHeight <= 0 || bandHeight <= 0) {
+        return false;
+    }
+    
+    Clock::time_point pageStart = Clock::now();
+    std::unique_lock<std::recursive_mutex> lock(g_pdfiumMutex, std::defer_lock);
+    LockPdfium(lock);
+    
+    int pageCount = FPDF_GetPageCount(document->handle);
+    if (pageIndex < 0 || pageIndex >= pageCount) {
+        return false;
+    }
+    
+    FPDF_PAGE page = LoadRenderPage(document, pageIndex);
+    if (!page) {
+        return false;
+    }
+    
+    // One 8-bit gray band buffer, reused for every band of the page
+    int stride = (bandWidth + 3) & ~3;
+    std::vector<unsigned char> bandBuffer((size_t)stride * bandHeight);
+    Metrics::CountAllocation(bandBuffer.size());
+    FPDF_BITMAP bitmap = FPDFBitmap_CreateEx(bandWidth, bandHeight, FPDFBitmap_Gray,
+                                             bandBuffer.data(), stride);
+    if (!bitmap) {
+        CloseRenderPage(document, page);
+        return false;
+    }
+    
+    int offsetX = (bandWidth - pixelWidth) / 2;
+    int flags = FPDF_ANNOT | FPDF_GRAYSCALE | FPDF_PRINTING | FPDF_NO_CATCH;
+    RenderStatus result = RENDER_OK;
+    for (int top = 0; top < pixelHeight; top += bandHeight) {
+        int rows = pixelHeight - top < bandHeight ? pixelHeight - top : bandHeight;
+        
+        FPDFBitmap_FillRect(bitmap, 0, 0, bandWidth, bandHeight, 0xFFFFFFFF);
+        
+        // Shift the page up so that this band's first row lands on bitmap row 0;
+        // pdfium clips everything outside the band
+        result = RenderPage(lock, bitmap, page, offsetX, -top, pixelWidth, pixelHeight, 0,
+                            flags, control, pageStart);
+        if (result != RENDER_OK) {
+            break;
+        }
+        DrawForms(document, bitmap, page, offsetX, -top, pixelWidth, pixelHeight, 0, flags);
+        Metrics::Add(COUNTER_PIXELS, (long long)pixelWidth * rows);
+        
+        // Conversion and output do not touch pdfium; let other jobs render meanwhile.
+        // The page budget only counts rendering, so the callback time is added back.
+        lock.unlock();
+        Clock::time_point callbackStart = Clock::now();
+        bool keepGoing = onBand(bandBuffer.data(), stride, top, rows);
+        pageStart += Clock::now() - callbackStart;
+        LockPdfium(lock);
+        if (!keepGoing) {
+            result = RENDER_FAILED;
+            break;
+        }
+    }
+    
+    FPDFBitmap_Destroy(bitmap);
+    CloseRenderPage(document, page);
+    
+    SetStatus(status, result);
+    return result == RENDER_OK;
+}
+
+std::string PdfiumWrapper::RenderStatusMessage(RenderStatus status, int pageIndex) {
+    switch (status) {
+    case RENDER_CANCELLED:
+        return "Job cancelled";
+    case RENDER_PAGE_TIMEOUT:
+        return "Page " + std::to_string(pageIndex + 1) + " exceeded the render time budget";
+    case RENDER_JOB_TIMEOUT:
+        return "Job exceeded its time limit";
+    default:
+        return "Failed to render page " + std::to_string(pageIndex + 1);
+    }
+}
+
 void PdfiumWrapper::FreeBitmap(BitmapData* bitmap) {
     if (bitmap && bitmap->data) {
         delete[] bitmap->data;
@@ -132,9 +1228,8 @@ void PdfiumWrapper::FreeBitmap(BitmapData* bitmap) {
 }
 
 void PdfiumWrapper::CloseDocument() {
-    if (g_document) {
-        FPDF_CloseDocument(g_document);
-        g_document = nullptr;
-    }
+    PdfiumLock lock;
+    CloseDocument(g_document);
+    g_document = nullptr;
 }
 
@@ -1,6 +1,10 @@
 #ifndef PDFIUM_WIN_H
 #define PDFIUM_WIN_H
 
+#include <atomic>
+#include <cstddef>
+#include <chrono>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -13,7 +17,137 @@ struct BitmapData {
     int width;            // 位图宽度（像素）
     int height;           // 位图高度（像素）
     int stride;           // 每行字节数
-    int bitmapFormat;     // 格式：0 = BGRA, 1 = BGR
+    int bitmapFormat;     // 格式：0 = BGRA, 1 = BGR, 2 = 8 位灰度
+};
+
+/**
+ * 条带回调
+ * 参数依次为：灰度像素数据、每行字节数、条带在页面中的起始行、条带行数
+ * 返回 false 时停止渲染
+ */
+typedef std::function<bool(const unsigned char* gray, int stride, int top, int rows)> BandCallback;
+
+/**
+ * 渲染结果
+ */
+enum RenderStatus {
+    RENDER_OK = 0,            // 渲染完成
+    RENDER_FAILED = 1,        // 页面加载或渲染失败
+    RENDER_CANCELLED = 2,     // 被取消
+    RENDER_PAGE_TIMEOUT = 3,  // 超过单页时间预算
+    RENDER_JOB_TIMEOUT = 4    // 超过作业时间限制
+};
+
+/**
+ * 渲染控制
+ * 传入渲染函数后，页面按时间片渐进渲染；每个时间片之间检查取消标志和时间预算，
+ * 并释放 pdfium 全局锁，让其他作业的页面也能渲染。
+ * Cancel 可以在任意线程调用
+ */
+class RenderControl {
+public:
+    RenderControl();
+
+    /**
+     * 请求取消，正在进行的渲染会在当前时间片结束时停止
+     */
+    void Cancel();
+
+    /**
+     * 是否已请求取消
+     */
+    bool IsCancelled() const;
+
+    /**
+     * 设置单页渲染时间预算
+     * @param budgetMs 毫秒，0 表示不限
+     */
+    void SetPageBudget(unsigned int budgetMs);
+
+    /**
+     * 获取单页渲染时间预算（毫秒），0 表示不限
+     */
+    unsigned int PageBudget() const;
+
+    /**
+     * 设置作业时间限制，从调用时开始计时
+     * @param timeoutMs 毫秒，0 表示不限
+     */
+    void SetTimeout(unsigned int timeoutMs);
+
+    /**
+     * 检查是否应停止渲染
+     * @param pageStart 当前页面开始渲染的时间
+     * @return RENDER_OK 表示可以继续，否则为停止原因
+     */
+    RenderStatus Check(std::chrono::steady_clock::time_point pageStart) const;
+
+private:
+    std::atomic<bool> m_cancelled;
+    unsigned int m_pageBudgetMs;
+    bool m_hasDeadline;
+    std::chrono::steady_clock::time_point m_deadline;
+};
+
+/**
+ * 页面内容统计
+ * 只解析页面对象，不渲染
+ */
+struct PageContent {
+    float width = 0;             // 页面宽度（点）
+    float height = 0;            // 页面高度（点）
+    int textObjects = 0;         // 文本对象数
+    int pathObjects = 0;         // 路径对象数
+    int imageObjects = 0;        // 图像对象数
+    int shadingObjects = 0;      // 渐变对象数
+    int formObjects = 0;         // 表单 XObject 数（其中的对象也计入上面各项）
+    double imageMegapixels = 0;  // 图像源像素总数（百万像素）
+    double maxImageDpi = 0;      // 图像在页面上的最高有效分辨率（源像素 / 显示尺寸）
+    bool hasTransparency = false;  // 页面包含透明度（需要合成）
+};
+
+/**
+ * 表单域（AcroForm）的打印方式
+ */
+enum FormMode {
+    FORMS_DRAW = 0,     // 通过表单填写环境绘制（默认），每个文档一个表单句柄，各页共用
+    FORMS_FLATTEN = 1,  // 渲染前在内存中将表单域合并到页面内容，每页只合并一次
+    FORMS_NONE = 2      // 不打印表单域的值
+};
+
+/**
+ * 拼版方式
+ */
+struct PageLayout {
+    int nup = 1;           // 每张纸的页数：1、2、4、6、9、16
+    bool booklet = false;  // 骑马钉小册子：每面 2 页，页序按对折装订排列，需双面打印
+};
+
+/**
+ * 叠加层（不透明句柄）
+ * 一个只含新建对象的空白页面，渲染到已有位图上，不清除底色
+ */
+struct PdfOverlay;
+
+/**
+ * 已加载的 PDF 文档（不透明句柄）
+ * 每个打印作业可以持有自己的文档，互不影响
+ */
+struct PdfDocument;
+
+/**
+ * pdfium 全局锁
+ * pdfium 不是线程安全的，所有 pdfium 调用都必须在持有该锁时进行。
+ * PdfiumWrapper 的函数内部已经加锁；直接调用 pdfium API 的代码需要自行构造此对象
+ */
+class PdfiumLock {
+public:
+    PdfiumLock();
+    ~PdfiumLock();
+
+private:
+    PdfiumLock(const PdfiumLock&);
+    PdfiumLock& operator=(const PdfiumLock&);
 };
 
 /**
@@ -35,6 +169,38 @@ public:
      */
     static void Shutdown();
     
+    /**
+     * 增加 pdfium 库的引用计数，第一次调用时初始化库
+     * Initialize 也会增加引用计数
+     * @return 成功返回 true
+     */
+    static bool AcquireLibrary();
+    
+    /**
+     * 减少 pdfium 库的引用计数，归零时销毁库
+     * 与 Shutdown 不同，不会关闭当前文档
+     */
+    static void ReleaseLibrary();
+    
+    /**
+     * 打开一个独立的 PDF 文档
+     * @param filePath PDF 文件路径（UTF-8 编码）
+     * @return 文档指针，失败返回 nullptr。使用完后需调用 CloseDocument(document) 释放
+     */
+    static PdfDocument* OpenDocument(const std::string& filePath);
+    
+    /**
+     * 关闭由 OpenDocument 打开的文档
+     * @param document 文档指针（可为 nullptr）
+     */
+    static void CloseDocument(PdfDocument* document);
+    
+    /**
+     * 获取当前文档（LoadPdf 加载的文档）
+     * @return 文档指针，未加载时返回 nullptr。由 CloseDocument() 释放，调用方不得关闭
+     */
+    static PdfDocument* CurrentDocument();
+    
     /**
      * 加载 PDF 文件
      * @param filePath PDF 文件路径（UTF-8 编码）
@@ -48,6 +214,34 @@ public:
      */
     static int GetPageCount();
     
+    /**
+     * 获取文档页数
+     * @param document 文档指针
+     * @return 页数，文档为空时返回 0
+     */
+    static int GetPageCount(PdfDocument* document);
+    
+    /**
+     * 获取文档文件数据的大小
+     * @param document 文档指针
+     * @return 字节数，文档为空时返回 0
+     */
+    static size_t GetDocumentSize(PdfDocument* document);
+    
+    /**
+     * 获取文档的文件数据，在文档关闭前有效
+     * @param document 文档指针
+     * @return 文件数据（GetDocumentSize 字节），文档不是从文件打开的（如拼版生成）时返回 nullptr
+     */
+    static const unsigned char* GetDocumentData(PdfDocument* document);
+    
+    /**
+     * 设置表单域的打印方式，需在第一次渲染前设置
+     * @param document 文档指针
+     * @param mode 打印方式
+     */
+    static void SetFormMode(PdfDocument* document, FormMode mode);
+    
     /**
      * 将指定页面渲染为位图
      * @param pageIndex 页面索引（从 0 开始）
@@ -56,6 +250,170 @@ public:
      */
     static BitmapData* RenderPageToBitmap(int pageIndex, int dpi);
     
+    /**
+     * 将指定文档的页面渲染为位图
+     * @param document 文档指针
+     * @param pageIndex 页面索引（从 0 开始）
+     * @param dpi 渲染分辨率
+     * @return 位图数据指针，失败返回 nullptr。使用完后需调用 FreeBitmap 释放
+     */
+    static BitmapData* RenderPageToBitmap(PdfDocument* document, int pageIndex, int dpi);
+    
+    /**
+     * 将指定文档的页面渐进渲染为位图，可取消、受时间预算约束
+     * @param document 文档指针
+     * @param pageIndex 页面索引（从 0 开始）
+     * @param dpi 渲染分辨率
+     * @param control 渲染控制（为 nullptr 时一次性渲染）
+     * @param status 输出渲染结果（可为 nullptr）
+     * @param rotation 顺时针旋转的 90° 次数（0-3），在渲染时完成，旋转 90° 或 270° 时位图宽高互换
+     * @return 位图数据指针，失败、取消或超时返回 nullptr。使用完后需调用 FreeBitmap 释放
+     */
+    static BitmapData* RenderPageToBitmap(PdfDocument* document, int pageIndex, int dpi,
+                                          const RenderControl* control, RenderStatus* status,
+                                          int rotation = 0);
+    
+    /**
+     * 获取页面尺寸（无需加载页面）
+     * @param pageIndex 页面索引（从 0 开始）
+     * @param width 输出页面宽度（点，1/72 英寸）
+     * @param height 输出页面高度（点）
+     * @return 成功返回 true
+     */
+    static bool GetPageSize(int pageIndex, float* width, float* height);
+    
+    /**
+     * 获取指定文档的页面尺寸
+     * @param document 文档指针
+     * @param pageIndex 页面索引（从 0 开始）
+     * @param width 输出页面宽度（点）
+     * @param height 输出页面高度（点）
+     * @return 成功返回 true
+     */
+    static bool GetPageSize(PdfDocument* document, int pageIndex, float* width, float* height);
+    
+    /**
+     * 按拼版方式生成新文档，每张纸为一页，渲染时按纸张分辨率渲染一次
+     * 纸张大小取源文档第一页：2 和 6 合 1 时纸张转为另一方向，小册子纸张宽度加倍
+     * @param source 源文档，必须在拼版文档关闭后再关闭
+     * @param layout 拼版方式
+     * @return 新文档指针，失败或拼版方式无效时返回 nullptr。使用完后需调用 CloseDocument 释放
+     */
+    static PdfDocument* ImposeDocument(PdfDocument* source, const PageLayout& layout);
+    
+    /**
+     * 创建叠加层
+     * @param width 页面宽度（点）
+     * @param height 页面高度（点）
+     * @return 叠加层指针，失败返回 nullptr。使用完后需调用 CloseOverlay 释放
+     */
+    static PdfOverlay* CreateOverlay(float width, float height);
+    
+    /**
+     * 在叠加层上添加文本
+     * @param overlay 叠加层
+     * @param x 基线起点横坐标（点，相对页面左边）
+     * @param y 基线纵坐标（点，相对页面上边）
+     * @param text 文本（UTF-8 编码）
+     * @param font 标准 14 字体名称（如 Helvetica、Courier-Bold）
+     * @param fontSize 字号（点）
+     * @param color 颜色（0xAARRGGBB）
+     * @return 成功返回 true
+     */
+    static bool AddOverlayText(PdfOverlay* overlay, float x, float y, const std::string& text,
+                               const std::string& font, float fontSize, unsigned int color);
+    
+    /**
+     * 在叠加层上添加图像
+     * @param overlay 叠加层
+     * @param x 左边位置（点，相对页面左边）
+     * @param y 上边位置（点，相对页面上边）
+     * @param width 显示宽度（点）
+     * @param height 显示高度（点）
+     * @param pixels 图像像素（BGRA）
+     * @param pixelWidth 图像宽度（像素）
+     * @param pixelHeight 图像高度（像素）
+     * @param stride 每行字节数
+     * @return 成功返回 true
+     */
+    static bool AddOverlayImage(PdfOverlay* overlay, float x, float y, float width, float height,
+                                const unsigned char* pixels, int pixelWidth, int pixelHeight, int stride);
+    
+    /**
+     * 移除叠加层上的所有对象，以便复用
+     */
+    static void ClearOverlay(PdfOverlay* overlay);
+    
+    /**
+     * 将叠加层渲染到已有的像素缓冲区上（不清除原有内容）
+     * @param overlay 叠加层
+     * @param buffer 像素缓冲区
+     * @param bufferWidth 缓冲区宽度（像素）
+     * @param bufferHeight 缓冲区高度（像素）
+     * @param stride 每行字节数
+     * @param gray true 表示 8 位灰度缓冲区（打印模式渲染），false 表示 BGRA
+     * @param x 页面左上角在缓冲区中的横坐标（可为负）
+     * @param y 页面左上角在缓冲区中的纵坐标（可为负）
+     * @param pixelWidth 页面渲染宽度（像素）
+     * @param pixelHeight 页面渲染高度（像素）
+     * @param rotation 顺时针旋转的 90° 次数（0-3）
+     * @return 成功返回 true
+     */
+    static bool RenderOverlay(PdfOverlay* overlay, unsigned char* buffer, int bufferWidth, int bufferHeight,
+                              int stride, bool gray, int x, int y, int pixelWidth, int pixelHeight, int rotation);
+    
+    /**
+     * 释放叠加层
+     */
+    static void CloseOverlay(PdfOverlay* overlay);
+    
+    /**
+     * 分析页面内容：对象类型统计和图像有效分辨率
+     * @param document 文档指针
+     * @param pageIndex 页面索引（从 0 开始）
+     * @param content 输出页面内容统计
+     * @return 成功返回 true
+     */
+    static bool AnalyzePage(PdfDocument* document, int pageIndex, PageContent* content);
+    
+    /**
+     * 描述页面的绘制内容（对象、路径、图像数据、嵌入字体和字符位置），用于识别内容相同的页面。
+     * 描述相同的页面渲染结果相同；含注释、表单域、透明度或渐变的页面无法完整描述
+     * @param document 文档指针
+     * @param pageIndex 页面索引（从 0 开始）
+     * @param description 输出描述（二进制，只在同一进程内可比较）
+     * @return 成功返回 true，页面无法完整描述时返回 false
+     */
+    static bool DescribePageContent(PdfDocument* document, int pageIndex, std::string* description);
+    
+    /**
+     * 将指定页面按条带渲染为 8 位灰度
+     * 页面只加载一次，条带缓冲区复用，内存占用与页面高度无关。
+     * 回调执行期间不持有 pdfium 全局锁，其他线程可以继续渲染
+     * @param document 文档指针
+     * @param pageIndex 页面索引（从 0 开始）
+     * @param bandWidth 条带宽度（像素），页面水平居中放置
+     * @param pixelWidth 页面渲染宽度（像素）
+     * @param pixelHeight 页面渲染高度（像素）
+     * @param bandHeight 每个条带的行数
+     * @param onBand 条带回调
+     * @param control 渲染控制（可为 nullptr），单页时间预算不计回调耗时
+     * @param status 输出渲染结果（可为 nullptr）
+     * @return 全部条带渲染完成返回 true
+     */
+    static bool RenderPageBands(PdfDocument* document, int pageIndex, int bandWidth,
+                                int pixelWidth, int pixelHeight, int bandHeight,
+                                const BandCallback& onBand,
+                                const RenderControl* control = nullptr, RenderStatus* status = nullptr);
+    
+    /**
+     * 生成渲染失败的错误描述
+     * @param status 渲染结果
+     * @param pageIndex 页面索引（从 0 开始）
+     * @return 错误描述
+     */
+    static std::string RenderStatusMessage(RenderStatus status, int pageIndex);
+    
     /**
      * 释放位图数据
      * @param bitmap 位图数据指针（可为 nullptr）
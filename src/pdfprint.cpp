@@ -4,202 +4,99 @@
 #include <commdlg.h>
 #include <cstring>
 #include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <thread>
+#include <vector>
+#include "barcode.h"
+#include "connection_pool.h"
+#include "cost_estimator.h"
+#include "gdi_printer.h"
+#include "job_scheduler.h"
+#include "metrics.h"
+#include "page_cache.h"
+#include "page_dedup.h"
+#include "page_stream.h"
 #include "pdfium_win.h"
+#include "printer_caps.h"
+#include "raster_pipeline.h"
+#include "raster_sink.h"
+#include "render_pool.h"
+#include "template_merge.h"
+#include "trace.h"
+#include "util.h"
 
-// Windows printing functions - silently print to default printer
-static void PrintBitmapToPrinter(HBITMAP hBitmap, const wchar_t* printerName, Napi::Env env) {
-    if (!hBitmap) {
-        throw Napi::Error::New(env, "PrintBitmapToPrinter: hBitmap is null");
-    }
-    
-    // Get default printer name if not provided
-    wchar_t defaultPrinterName[256] = {0};
-    DWORD nameLen = sizeof(defaultPrinterName) / sizeof(defaultPrinterName[0]);
-    wchar_t printerNameBuffer[256] = {0};
-    const wchar_t* actualPrinterName = printerName;
-    
-    if (!printerName) {
-        if (!GetDefaultPrinterW(defaultPrinterName, &nameLen)) {
-            DWORD errorCode = GetLastError();
-            std::string errorMsg = "Failed to get default printer, error code: " + std::to_string(errorCode);
-            throw Napi::Error::New(env, errorMsg);
-        }
-        actualPrinterName = defaultPrinterName;
-    } else {
-        wcscpy_s(printerNameBuffer, sizeof(printerNameBuffer) / sizeof(printerNameBuffer[0]), printerName);
-        actualPrinterName = printerNameBuffer;
-    }
-    
-    // Open printer (need non-const string for OpenPrinterW)
-    HANDLE hPrinter = nullptr;
-    PRINTER_DEFAULTSW printerDefaults = {0};
-    printerDefaults.DesiredAccess = PRINTER_ACCESS_USE;
-    
-    wchar_t printerNameCopy[256] = {0};
-    wcscpy_s(printerNameCopy, sizeof(printerNameCopy) / sizeof(printerNameCopy[0]), actualPrinterName);
-    
-    if (!OpenPrinterW(printerNameCopy, &hPrinter, &printerDefaults)) {
-        DWORD errorCode = GetLastError();
-        std::string errorMsg = "Failed to open printer, error code: " + std::to_string(errorCode);
-        throw Napi::Error::New(env, errorMsg);
-    }
-    
-    // Get printer DC
-    HDC hdcPrinter = nullptr;
-    DOCINFOW di = {0};
-    di.cbSize = sizeof(di);
-    di.lpszDocName = L"PDF Print Job";
-    
-    bool success = false;
-    
-    // Use StartDoc/StartPage/EndPage/EndDoc for printing
-    hdcPrinter = CreateDCW(L"WINSPOOL", printerNameCopy, nullptr, nullptr);
-    if (!hdcPrinter) {
-        DWORD errorCode = GetLastError();
-        ClosePrinter(hPrinter);
-        std::string errorMsg = "Failed to create printer DC, error code: " + std::to_string(errorCode);
-        throw Napi::Error::New(env, errorMsg);
-    }
-    
-    int docResult = StartDocW(hdcPrinter, &di);
-    if (docResult <= 0) {
-        DWORD errorCode = GetLastError();
-        DeleteDC(hdcPrinter);
-        ClosePrinter(hPrinter);
-        std::string errorMsg = "Failed to start print job (StartDocW), error code: " + std::to_string(errorCode);
-        throw Napi::Error::New(env, errorMsg);
-    }
-    
-    int pageResult = StartPage(hdcPrinter);
-    if (pageResult <= 0) {
-        DWORD errorCode = GetLastError();
-        EndDoc(hdcPrinter);
-        DeleteDC(hdcPrinter);
-        ClosePrinter(hPrinter);
-        std::string errorMsg = "Failed to start page (StartPage), error code: " + std::to_string(errorCode);
-        throw Napi::Error::New(env, errorMsg);
-    }
-    
-    // Get bitmap dimensions
-    BITMAP bm;
-    GetObject(hBitmap, sizeof(BITMAP), &bm);
-    
-    // Get printer page size and margins
-    int pageWidth = GetDeviceCaps(hdcPrinter, PHYSICALWIDTH);
-    int pageHeight = GetDeviceCaps(hdcPrinter, PHYSICALHEIGHT);
-    int marginX = GetDeviceCaps(hdcPrinter, PHYSICALOFFSETX);
-    int marginY = GetDeviceCaps(hdcPrinter, PHYSICALOFFSETY);
-    int printableWidth = GetDeviceCaps(hdcPrinter, HORZRES);
-    int printableHeight = GetDeviceCaps(hdcPrinter, VERTRES);
-    
-    // Validate dimensions
-    if (bm.bmWidth <= 0 || bm.bmHeight <= 0 || 
-        printableWidth <= 0 || printableHeight <= 0) {
-        EndPage(hdcPrinter);
-        EndDoc(hdcPrinter);
-        DeleteDC(hdcPrinter);
-        ClosePrinter(hPrinter);
-        std::string errorMsg = "Invalid bitmap or printer dimensions (bitmap: " + 
-                               std::to_string(bm.bmWidth) + "x" + std::to_string(bm.bmHeight) +
-                               ", printable: " + std::to_string(printableWidth) + "x" + std::to_string(printableHeight) + ")";
-        throw Napi::Error::New(env, errorMsg);
-    }
-    
-    // Calculate scaling to fit printable area
-    double scaleX = (double)printableWidth / bm.bmWidth;
-    double scaleY = (double)printableHeight / bm.bmHeight;
-    double scale = (scaleX < scaleY) ? scaleX : scaleY;
-    
-    int printWidth = (int)(bm.bmWidth * scale);
-    int printHeight = (int)(bm.bmHeight * scale);
-    int printX = marginX + (printableWidth - printWidth) / 2;
-    int printY = marginY + (printableHeight - printHeight) / 2;
-    
-    // Create memory DC for bitmap
-    HDC hdcMem = CreateCompatibleDC(hdcPrinter);
-    if (!hdcMem) {
-        DWORD errorCode = GetLastError();
-        EndPage(hdcPrinter);
-        EndDoc(hdcPrinter);
-        DeleteDC(hdcPrinter);
-        ClosePrinter(hPrinter);
-        std::string errorMsg = "Failed to create memory DC, error code: " + std::to_string(errorCode);
-        throw Napi::Error::New(env, errorMsg);
-    }
-    
-    HGDIOBJ oldBitmap = SelectObject(hdcMem, hBitmap);
-    
-    // Use HALFTONE for better quality
-    SetStretchBltMode(hdcPrinter, HALFTONE);
-    SetBrushOrgEx(hdcPrinter, 0, 0, nullptr);
-    
-    // Blit bitmap to printer DC (reference WinUtil.cpp BlitHBITMAP)
-    BOOL blitSuccess = StretchBlt(hdcPrinter, printX, printY, printWidth, printHeight,
-                                 hdcMem, 0, 0, bm.bmWidth, bm.bmHeight, SRCCOPY);
-    
-    SelectObject(hdcMem, oldBitmap);
-    DeleteDC(hdcMem);
-    
-    if (!blitSuccess) {
-        DWORD errorCode = GetLastError();
-        EndPage(hdcPrinter);
-        EndDoc(hdcPrinter);
-        DeleteDC(hdcPrinter);
-        ClosePrinter(hPrinter);
-        std::string errorMsg = "Failed to blit bitmap to printer, error code: " + std::to_string(errorCode);
-        throw Napi::Error::New(env, errorMsg);
-    }
-    
-    EndPage(hdcPrinter);
-    EndDoc(hdcPrinter);
-    DeleteDC(hdcPrinter);
-    ClosePrinter(hPrinter);
-}
-
-static HBITMAP CreateHBITMAPFromBitmapData(BitmapData* bitmapData) {
-    if (!bitmapData || !bitmapData->data || 
-        bitmapData->width <= 0 || bitmapData->height <= 0) {
-        return nullptr;
-    }
-    
-    BITMAPINFO bmi = {0};
-    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bmi.bmiHeader.biWidth = bitmapData->width;
-    bmi.bmiHeader.biHeight = -bitmapData->height; // Negative for top-down DIB
-    bmi.bmiHeader.biPlanes = 1;
-    bmi.bmiHeader.biBitCount = 32;
-    bmi.bmiHeader.biCompression = BI_RGB;
-    
-    void* bits = nullptr;
-    HBITMAP hBitmap = CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
-    
-    if (!hBitmap || !bits) {
-        if (hBitmap) {
-            DeleteObject(hBitmap);
-        }
+struct PageStreamHandle;
+
+// Deletes garbage-collected page streams off the JS thread: deleting a stream
+// joins its render thread. One thread per environment, started on the first
+// finalized stream and joined when the environment goes away. Handles keep
+// it alive, so a stream finalized after the environment's instance data
+// still finds it, stopped, and is deleted in place
+struct PageStreamReaper {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<PageStreamHandle*> queue;
+    bool stopping = false;
+    std::thread thread;
+};
+
+// State of one Node environment: the main thread and every worker_threads
+// Worker that loads the addon get their own instance. The pdfium library,
+// the scheduler, templates and the capability and connection caches are
+// shared by all of them; the library is reference counted, so it stays
+// initialized while any environment uses it.
+class PdfPrintAddon : public Napi::Addon<PdfPrintAddon> {
+public:
+    PdfPrintAddon(Napi::Env env, Napi::Object exports);
+    ~PdfPrintAddon();
+
+    bool libraryAcquired = false;                 // initialize() was called
+    std::shared_ptr<PdfDocument> loadedDocument;  // loadPdf / getPageCount
+    std::map<long long, std::shared_ptr<PdfDocument>> documents;  // openDocument
+    long long nextDocumentId = 1;
+    std::set<long long> jobs;                     // submitted here, result not delivered yet
+    std::set<long long> templates;                // opened here
+    std::shared_ptr<PageStreamReaper> streamReaper = std::make_shared<PageStreamReaper>();
+};
+
+static std::mutex g_addonsMutex;
+static int g_addons = 0;
+
+static PdfPrintAddon& GetAddon(Napi::Env env) {
+    return *env.GetInstanceData<PdfPrintAddon>();
+}
+
+static void CloseDocumentHandle(PdfDocument* document) {
+    PdfiumWrapper::CloseDocument(document);
+    PdfiumWrapper::ReleaseLibrary();
+}
+
+// Open a document that keeps the library initialized until its last
+// reference is gone
+static std::shared_ptr<PdfDocument> OpenSharedDocument(const std::string& filePath) {
+    PdfiumWrapper::AcquireLibrary();
+    PdfDocument* document = PdfiumWrapper::OpenDocument(filePath);
+    if (!document) {
+        PdfiumWrapper::ReleaseLibrary();
         return nullptr;
     }
-    
-    // Copy bitmap data (BGRA format)
-    unsigned char* dest = (unsigned char*)bits;
-    unsigned char* src = bitmapData->data;
-    int destStride = bitmapData->width * 4;
-    
-    for (int y = 0; y < bitmapData->height; y++) {
-        memcpy(dest, src, destStride);
-        dest += destStride;
-        src += bitmapData->stride;
-    }
-    
-    return hBitmap;
+    return std::shared_ptr<PdfDocument>(document, CloseDocumentHandle);
 }
 
 // Initialize pdfium library
 Napi::Value Initialize(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
-    bool result = PdfiumWrapper::Initialize();
-    return Napi::Boolean::New(env, result);
+    PdfPrintAddon& addon = GetAddon(env);
+    if (!addon.libraryAcquired) {
+        addon.libraryAcquired = PdfiumWrapper::AcquireLibrary();
+    }
+    return Napi::Boolean::New(env, addon.libraryAcquired);
 }
 
 // Load PDF file
@@ -212,14 +109,15 @@ Napi::Value LoadPdf(const Napi::CallbackInfo& info) {
     }
     
     std::string filePath = info[0].As<Napi::String>().Utf8Value();
-    bool result = PdfiumWrapper::LoadPdf(filePath);
-    return Napi::Boolean::New(env, result);
+    PdfPrintAddon& addon = GetAddon(env);
+    addon.loadedDocument = OpenSharedDocument(filePath);
+    return Napi::Boolean::New(env, addon.loadedDocument != nullptr);
 }
 
 // Get page count
 Napi::Value GetPageCount(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
-    int count = PdfiumWrapper::GetPageCount();
+    int count = PdfiumWrapper::GetPageCount(GetAddon(env).loadedDocument.get());
     return Napi::Number::New(env, count);
 }
 
@@ -244,111 +142,1627 @@ Napi::Value PrintPdf(const Napi::CallbackInfo& info) {
     
     std::string filePath = info[0].As<Napi::String>().Utf8Value();
     
-    // Initialize pdfium
-    if (!PdfiumWrapper::Initialize()) {
-        throw Napi::Error::New(env, "Failed to initialize pdfium");
+    // Load PDF; the document is this call's own, so other environments and
+    // a document opened with loadPdf are not affected
+    std::shared_ptr<PdfDocument> document = OpenSharedDocument(filePath);
+    if (!document) {
+        throw Napi::Error::New(env, "Failed to load PDF file: " + filePath);
     }
     
+    std::string error;
+    bool success = false;
     try {
-        // Load PDF
-        if (!PdfiumWrapper::LoadPdf(filePath)) {
-            PdfiumWrapper::Shutdown();
-            throw Napi::Error::New(env, "Failed to load PDF file: " + filePath);
+        GdiJobOptions gdiOptions;
+        gdiOptions.dpi = dpi;
+        success = GdiPrinter::PrintDocument(document.get(), gdiOptions, nullptr, &error);
+    } catch (const std::exception& e) {
+        error = "Exception during PDF processing: " + std::string(e.what());
+    } catch (...) {
+        error = "Unknown exception during PDF processing";
+    }
+    document.reset();
+    
+    if (!success) {
+        throw Napi::Error::New(env, error);
+    }
+    return Napi::Boolean::New(env, true);
+}
+
+// Read an optional integer option, validating its range
+static int GetIntOption(Napi::Object options, const char* name, int defaultValue, int minValue, int maxValue) {
+    Napi::Env env = options.Env();
+    if (!options.Has(name) || options.Get(name).IsUndefined()) {
+        return defaultValue;
+    }
+    Napi::Value value = options.Get(name);
+    if (!value.IsNumber()) {
+        throw Napi::TypeError::New(env, std::string("Option '") + name + "' must be a number");
+    }
+    int result = value.As<Napi::Number>().Int32Value();
+    if (result < minValue || result > maxValue) {
+        throw Napi::RangeError::New(env, std::string("Option '") + name + "' must be between " +
+                                    std::to_string(minValue) + " and " + std::to_string(maxValue));
+    }
+    return result;
+}
+
+static bool GetBoolOption(Napi::Object options, const char* name, bool defaultValue) {
+    if (!options.Has(name) || options.Get(name).IsUndefined()) {
+        return defaultValue;
+    }
+    return options.Get(name).ToBoolean().Value();
+}
+
+static std::string GetStringOption(Napi::Object options, const char* name) {
+    if (!options.Has(name) || !options.Get(name).IsString()) {
+        return std::string();
+    }
+    return options.Get(name).As<Napi::String>().Utf8Value();
+}
+
+// Read the raw raster options shared by printPdfRaw and submitJob
+static void GetRasterOptions(Napi::Object options, RasterJobOptions* jobOptions, RasterOutput* output) {
+    Napi::Env env = options.Env();
+    
+    std::string language = GetStringOption(options, "language");
+    if (language.empty() || language == "escpos") {
+        jobOptions->language = RASTER_ESCPOS;
+    } else if (language == "zpl") {
+        jobOptions->language = RASTER_ZPL;
+    } else {
+        throw Napi::TypeError::New(env, "Option 'language' must be 'escpos' or 'zpl'");
+    }
+    jobOptions->dpi = GetIntOption(options, "dpi", 203, 72, 1200);
+    jobOptions->widthDots = GetIntOption(options, "width", 0, 0, 65535);
+    jobOptions->heightDots = GetIntOption(options, "height", 0, 0, 65535);
+    jobOptions->bandHeight = GetIntOption(options, "bandHeight", 128, 1, 2303);
+    jobOptions->threshold = GetIntOption(options, "threshold", 128, 0, 255);
+    jobOptions->dither = GetBoolOption(options, "dither", false);
+    jobOptions->cut = GetBoolOption(options, "cut", true);
+    jobOptions->roll = GetBoolOption(options, "roll", false);
+    jobOptions->trim = GetBoolOption(options, "trim", false);
+    jobOptions->skipBlank = GetBoolOption(options, "skipBlank", false);
+    jobOptions->feedUnits = GetIntOption(options, "feedUnits", 0, 0, 1440);
+    jobOptions->skipBlankPages = GetBoolOption(options, "skipBlankPages", false);
+    
+    output->file = GetStringOption(options, "file");
+    output->host = GetStringOption(options, "host");
+    output->port = GetIntOption(options, "port", 9100, 1, 65535);
+    output->timeoutMs = GetIntOption(options, "timeout", 10000, 0, 600000);
+    output->printer = GetStringOption(options, "printer");
+}
+
+static Napi::Object RasterStatsToObject(Napi::Env env, const RasterJobStats& stats) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("pages", Napi::Number::New(env, stats.pages));
+    result.Set("rows", Napi::Number::New(env, (double)stats.rows));
+    result.Set("bytesWritten", Napi::Number::New(env, (double)stats.bytesWritten));
+    result.Set("trimmedRows", Napi::Number::New(env, (double)stats.trimmedRows));
+    result.Set("rowsElided", Napi::Number::New(env, (double)stats.rowsElided));
+    result.Set("bytesElided", Napi::Number::New(env, (double)stats.bytesElided));
+    result.Set("pagesSkipped", Napi::Number::New(env, stats.pagesSkipped));
+    result.Set("renderMs", Napi::Number::New(env, stats.renderMs));
+    result.Set("encodeMs", Napi::Number::New(env, stats.encodeMs));
+    result.Set("writeMs", Napi::Number::New(env, stats.writeMs));
+    result.Set("totalMs", Napi::Number::New(env, stats.totalMs));
+    return result;
+}
+
+// Print PDF as raw ESC/POS or ZPL raster to a file, socket or printer queue
+Napi::Value PrintPdfRaw(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!info[0].IsString()) {
+        Napi::TypeError::New(env, "Argument must be a string (file path)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object options = (info.Length() > 1 && info[1].IsObject())
+        ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+    
+    RasterJobOptions jobOptions;
+    RasterOutput output;
+    GetRasterOptions(options, &jobOptions, &output);
+    
+    std::string filePath = info[0].As<Napi::String>().Utf8Value();
+    
+    std::shared_ptr<PdfDocument> document = OpenSharedDocument(filePath);
+    if (!document) {
+        throw Napi::Error::New(env, "Failed to load PDF file: " + filePath);
+    }
+    
+    RasterJobStats stats;
+    std::string error;
+    bool success = RasterPipeline::PrintToOutput(document.get(), jobOptions, output, &stats, &error);
+    document.reset();
+    
+    if (!success) {
+        throw Napi::Error::New(env, "Raw print failed: " + error);
+    }
+    
+    return RasterStatsToObject(env, stats);
+}
+
+// GDI jobs hold the BGRA page bitmap and its DIB copy at once; raw jobs
+// render in bands and need little beyond the document
+static const double kGdiBytesPerPixel = 4 * 2;
+
+// Rough peak memory of a job for scheduler admission until the preflight has
+// looked at its pages (assumes US Letter)
+static size_t EstimateJobBytes(const std::string& filePath, bool gdi, int dpi) {
+    size_t fileBytes = 0;
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExW(Utf8ToWide(filePath).c_str(), GetFileExInfoStandard, &attributes)) {
+        fileBytes = ((size_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    }
+    double pageMegapixels = (8.5 * dpi) * (11.0 * dpi) / 1e6;
+    return CostEstimator::EstimateBytes(fileBytes, pageMegapixels, gdi ? kGdiBytesPerPixel : 0);
+}
+
+static float GetFloatOption(Napi::Object options, const char* name, float defaultValue) {
+    if (!options.Has(name) || options.Get(name).IsUndefined()) {
+        return defaultValue;
+    }
+    Napi::Value value = options.Get(name);
+    if (!value.IsNumber()) {
+        throw Napi::TypeError::New(options.Env(), std::string("Option '") + name + "' must be a number");
+    }
+    return value.As<Napi::Number>().FloatValue();
+}
+
+// Convert one merge field object; sizes and fonts are checked against the
+// template by MergeTemplate::ValidateRecord
+static MergeField GetMergeField(Napi::Object object) {
+    Napi::Env env = object.Env();
+    MergeField field;
+    std::string type = GetStringOption(object, "type");
+    if (type == "image") {
+        field.type = MERGE_IMAGE;
+    } else if (type == "barcode") {
+        field.type = MERGE_BARCODE;
+    } else if (!type.empty() && type != "text") {
+        throw Napi::TypeError::New(env, "Field 'type' must be 'text', 'image' or 'barcode'");
+    }
+    field.page = GetIntOption(object, "page", 0, 0, INT_MAX);
+    field.x = GetFloatOption(object, "x", 0);
+    field.y = GetFloatOption(object, "y", 0);
+    
+    if (field.type == MERGE_TEXT) {
+        if (object.Has("text") && !object.Get("text").IsUndefined()) {
+            field.text = object.Get("text").ToString().Utf8Value();
+        }
+        std::string font = GetStringOption(object, "font");
+        if (!font.empty()) {
+            field.font = font;
+        }
+        field.fontSize = GetFloatOption(object, "size", field.fontSize);
+        if (object.Has("color") && !object.Get("color").IsUndefined()) {
+            if (!object.Get("color").IsNumber()) {
+                throw Napi::TypeError::New(env, "Field 'color' must be a number (0xAARRGGBB)");
+            }
+            field.color = object.Get("color").As<Napi::Number>().Uint32Value();
+        }
+        return field;
+    }
+    
+    // Barcodes are encoded once here; rendering only draws the modules
+    if (field.type == MERGE_BARCODE) {
+        BarcodeType symbology;
+        if (!Barcode::ParseType(GetStringOption(object, "symbology"), &symbology)) {
+            throw Napi::TypeError::New(env, "Field 'symbology' must be 'code128', 'gs1-128', 'datamatrix' or 'qr'");
+        }
+        std::string ecc = GetStringOption(object, "ecc");
+        size_t eccLevel = ecc.empty() ? 1 : std::string("LMQH").find(ecc);
+        if (ecc.size() > 1 || eccLevel == std::string::npos) {
+            throw Napi::TypeError::New(env, "Field 'ecc' must be 'L', 'M', 'Q' or 'H'");
+        }
+        std::string data;
+        if (object.Has("data") && !object.Get("data").IsUndefined()) {
+            data = object.Get("data").ToString().Utf8Value();
+        }
+        std::string error;
+        if (!Barcode::Encode(symbology, data, (int)eccLevel, &field.barcode, &error)) {
+            throw Napi::RangeError::New(env, error);
+        }
+        field.moduleSize = GetFloatOption(object, "moduleSize", field.moduleSize);
+        field.height = GetFloatOption(object, "height", 36);
+        return field;
+    }
+    
+    field.width = GetFloatOption(object, "width", 0);
+    field.height = GetFloatOption(object, "height", 0);
+    if (!object.Get("image").IsObject()) {
+        throw Napi::TypeError::New(env, "Image field needs an 'image' object ({ width, height, data })");
+    }
+    Napi::Object image = object.Get("image").As<Napi::Object>();
+    field.imageWidth = GetIntOption(image, "width", 0, 1, 65535);
+    field.imageHeight = GetIntOption(image, "height", 0, 1, 65535);
+    if (!image.Get("data").IsTypedArray() ||
+        image.Get("data").As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array) {
+        throw Napi::TypeError::New(env, "Image 'data' must be a Buffer or Uint8Array of BGRA pixels");
+    }
+    Napi::Uint8Array data = image.Get("data").As<Napi::Uint8Array>();
+    field.pixels.assign(data.Data(), data.Data() + data.ElementLength());
+    return field;
+}
+
+// Copy the records of a template merge job out of JS on the calling thread;
+// the workers only ever see the native copy
+static std::shared_ptr<const std::vector<MergeRecord>> GetMergeRecords(Napi::Object options,
+                                                                       const MergeTemplate& mergeTemplate) {
+    Napi::Env env = options.Env();
+    if (!options.Get("records").IsArray()) {
+        throw Napi::TypeError::New(env, "Option 'records' must be an array");
+    }
+    Napi::Array array = options.Get("records").As<Napi::Array>();
+    if (array.Length() == 0 || array.Length() > (uint32_t)(INT_MAX / mergeTemplate.PageCount())) {
+        throw Napi::RangeError::New(env, "Option 'records' must contain between 1 and " +
+                                    std::to_string(INT_MAX / mergeTemplate.PageCount()) + " records");
+    }
+    
+    std::shared_ptr<std::vector<MergeRecord>> records = std::make_shared<std::vector<MergeRecord>>(array.Length());
+    for (uint32_t i = 0; i < array.Length(); i++) {
+        Napi::Value value = array.Get(i);
+        if (!value.IsArray()) {
+            throw Napi::TypeError::New(env, "Record " + std::to_string(i) + " must be an array of fields");
+        }
+        Napi::Array fields = value.As<Napi::Array>();
+        MergeRecord& record = (*records)[i];
+        for (uint32_t j = 0; j < fields.Length(); j++) {
+            if (!fields.Get(j).IsObject()) {
+                throw Napi::TypeError::New(env, "Record " + std::to_string(i) + ": fields must be objects");
+            }
+            record.fields.push_back(GetMergeField(fields.Get(j).As<Napi::Object>()));
         }
-        
-        int pageCount = PdfiumWrapper::GetPageCount();
-        if (pageCount == 0) {
-            PdfiumWrapper::Shutdown();
-            throw Napi::Error::New(env, "PDF has no pages");
+        std::string error;
+        if (!mergeTemplate.ValidateRecord(record, &error)) {
+            throw Napi::RangeError::New(env, "Record " + std::to_string(i) + ": " + error);
         }
-        
-        // Print each page
-        for (int i = 0; i < pageCount; i++) {
-            BitmapData* bitmap = nullptr;
-            HBITMAP hBitmap = nullptr;
-            
-            try {
-                // Render page to bitmap
-                bitmap = PdfiumWrapper::RenderPageToBitmap(i, dpi);
-                if (!bitmap) {
-                    throw Napi::Error::New(env, "Failed to render page " + std::to_string(i + 1) + " to bitmap");
+    }
+    return records;
+}
+
+// Pages of a template merge job: each record fills the template pages in turn
+static RasterPageSource MergeRasterSource(const std::shared_ptr<MergeTemplate>& mergeTemplate,
+                                          const std::shared_ptr<const std::vector<MergeRecord>>& records) {
+    int templatePages = mergeTemplate->PageCount();
+    RasterPageSource source;
+    source.pageCount = (int)records->size() * templatePages;
+    source.getPageSize = [mergeTemplate, templatePages](int pageIndex, float* width, float* height) {
+        return mergeTemplate->GetPageSize(pageIndex % templatePages, width, height);
+    };
+    source.renderBands = [mergeTemplate, records, templatePages](int pageIndex, int bandWidth, int pixelWidth,
+                                                                 int pixelHeight, int bandHeight,
+                                                                 const BandCallback& onBand,
+                                                                 const RenderControl* control, RenderStatus* status) {
+        return mergeTemplate->RenderPageBands((*records)[pageIndex / templatePages], pageIndex % templatePages,
+                                              bandWidth, pixelWidth, pixelHeight, bandHeight, onBand,
+                                              control, status);
+    };
+    return source;
+}
+
+// Pages of an isolated job, rendered by the session's renderer process
+static RasterPageSource SessionRasterSource(RenderSession* session) {
+    RasterPageSource source;
+    source.pageCount = session->PageCount();
+    source.getPageSize = [session](int pageIndex, float* width, float* height) {
+        return session->GetPageSize(pageIndex, width, height);
+    };
+    source.renderBands = [session](int pageIndex, int bandWidth, int pixelWidth, int pixelHeight, int bandHeight,
+                                   const BandCallback& onBand, const RenderControl* control, RenderStatus* status) {
+        return session->RenderPageBands(pageIndex, bandWidth, pixelWidth, pixelHeight, bandHeight, onBand,
+                                        control, status);
+    };
+    return source;
+}
+
+// Content hash of a job's document for the page cache; empty when the cache
+// is off or the document was not read from a file
+static std::string DocumentCacheHash(PdfDocument* document, bool useCache) {
+    const unsigned char* data = PdfiumWrapper::GetDocumentData(document);
+    if (!useCache || !data || !PageCache::IsEnabled()) {
+        return std::string();
+    }
+    return PageCache::HashBytes(data, PdfiumWrapper::GetDocumentSize(document));
+}
+
+// Isolated jobs never load the document here, so the file is hashed instead
+static std::string FileCacheHash(const std::string& filePath, bool useCache) {
+    std::string hash;
+    if (useCache && PageCache::IsEnabled()) {
+        PageCache::HashFile(filePath, &hash);
+    }
+    return hash;
+}
+
+// Page fingerprints of a loaded document for identical-page reuse
+static PageFingerprint DocumentFingerprint(PdfDocument* document) {
+    return [document](int pageIndex) {
+        return PageDedup::Fingerprint(document, pageIndex);
+    };
+}
+
+static const char* JobStateName(PrintJobState state) {
+    switch (state) {
+    case JOB_QUEUED: return "queued";
+    case JOB_RUNNING: return "running";
+    case JOB_COMPLETED: return "completed";
+    case JOB_FAILED: return "failed";
+    case JOB_CANCELLED: return "cancelled";
+    }
+    return "unknown";
+}
+
+static Napi::Object JobInfoToObject(Napi::Env env, const PrintJobInfo& job) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("id", Napi::Number::New(env, (double)job.id));
+    result.Set("state", Napi::String::New(env, JobStateName(job.state)));
+    if (!job.error.empty()) {
+        result.Set("error", Napi::String::New(env, job.error));
+    }
+    result.Set("printer", Napi::String::New(env, job.resourceKey));
+    result.Set("priority", Napi::Number::New(env, job.priority));
+    result.Set("estimatedBytes", Napi::Number::New(env, (double)job.estimatedBytes));
+    if (job.costScore > 0) {
+        result.Set("costScore", Napi::Number::New(env, job.costScore));
+        result.Set("estimatedMs", Napi::Number::New(env, job.estimatedMs));
+    }
+    result.Set("queuedMs", Napi::Number::New(env, job.queuedMs));
+    result.Set("runMs", Napi::Number::New(env, job.runMs));
+    result.Set("deadlineMissed", Napi::Boolean::New(env, job.deadlineMissed));
+    return result;
+}
+
+static const char* JobEventName(JobEventType type) {
+    switch (type) {
+    case JOB_EVENT_STARTED: return "started";
+    case JOB_EVENT_LOADED: return "loaded";
+    case JOB_EVENT_PAGE_RENDERED: return "pageRendered";
+    case JOB_EVENT_PAGE_SPOOLED: return "pageSpooled";
+    case JOB_EVENT_BYTES_WRITTEN: return "bytesWritten";
+    case JOB_EVENT_COMPLETED: return "completed";
+    case JOB_EVENT_FAILED: return "failed";
+    }
+    return "unknown";
+}
+
+static Napi::Object JobEventToObject(Napi::Env env, const JobEvent& event) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("type", Napi::String::New(env, JobEventName(event.type)));
+    result.Set("jobId", Napi::Number::New(env, (double)event.jobId));
+    result.Set("timestamp", Napi::Number::New(env, event.timestamp));
+    result.Set("elapsedMs", Napi::Number::New(env, event.elapsedMs));
+    result.Set("durationMs", Napi::Number::New(env, event.durationMs));
+    if (event.page >= 0) {
+        result.Set("page", Napi::Number::New(env, event.page));
+    }
+    if (event.type == JOB_EVENT_LOADED) {
+        result.Set("pageCount", Napi::Number::New(env, event.pageCount));
+    }
+    if (event.dpi > 0) {
+        result.Set("dpi", Napi::Number::New(env, event.dpi));
+    }
+    if (event.type == JOB_EVENT_BYTES_WRITTEN) {
+        result.Set("bytes", Napi::Number::New(env, (double)event.bytes));
+        result.Set("totalBytes", Napi::Number::New(env, (double)event.totalBytes));
+    }
+    if (!event.error.empty()) {
+        result.Set("error", Napi::String::New(env, event.error));
+    }
+    return result;
+}
+
+// Events and the result of one job, filled in on worker threads and handed to
+// JS in batches. At most one delivery is queued at a time, so a busy event
+// loop gets many events per call instead of one call per event.
+struct JobChannel {
+    std::mutex mutex;
+    std::vector<JobEvent> events;
+    bool deliveryQueued = false;
+    bool finished = false;
+    bool finalDelivered = false;
+    PrintJobInfo info;
+    bool raw = false;
+    GdiJobStats gdi;
+    RasterJobStats raster;
+    Napi::ThreadSafeFunction callback;
+};
+
+static void DeliverJobChannel(Napi::Env env, Napi::Function jsCallback, std::shared_ptr<JobChannel>* data) {
+    std::shared_ptr<JobChannel> channel = *data;
+    delete data;
+    
+    std::vector<JobEvent> events;
+    bool final = false;
+    {
+        std::lock_guard<std::mutex> lock(channel->mutex);
+        events.swap(channel->events);
+        channel->deliveryQueued = false;
+        if (channel->finished && !channel->finalDelivered) {
+            channel->finalDelivered = true;
+            final = true;
+        }
+    }
+    if (events.empty() && !final) {
+        return;
+    }
+    
+    Napi::Array batch = Napi::Array::New(env, events.size());
+    for (size_t i = 0; i < events.size(); i++) {
+        batch.Set((uint32_t)i, JobEventToObject(env, events[i]));
+    }
+    if (!final) {
+        jsCallback.Call({ batch, Napi::Boolean::New(env, false) });
+        return;
+    }
+    
+    GetAddon(env).jobs.erase(channel->info.id);
+    Napi::Object result = JobInfoToObject(env, channel->info);
+    if (channel->info.state == JOB_COMPLETED) {
+        Napi::Object stats = channel->raw ? RasterStatsToObject(env, channel->raster) : Napi::Object::New(env);
+        if (!channel->raw) {
+            stats.Set("pages", Napi::Number::New(env, channel->gdi.pages));
+            stats.Set("pagesDegraded", Napi::Number::New(env, channel->gdi.pagesDegraded));
+            stats.Set("blankPages", Napi::Number::New(env, channel->gdi.blankPages));
+            stats.Set("sheets", Napi::Number::New(env, channel->gdi.sheets));
+            Napi::Array pageDpi = Napi::Array::New(env, channel->gdi.pageDpi.size());
+            for (size_t i = 0; i < channel->gdi.pageDpi.size(); i++) {
+                pageDpi.Set((uint32_t)i, Napi::Number::New(env, channel->gdi.pageDpi[i]));
+            }
+            stats.Set("pageDpi", pageDpi);
+            stats.Set("analyzeMs", Napi::Number::New(env, channel->gdi.analyzeMs));
+            stats.Set("renderMs", Napi::Number::New(env, channel->gdi.renderMs));
+            stats.Set("spoolMs", Napi::Number::New(env, channel->gdi.spoolMs));
+            stats.Set("totalMs", Napi::Number::New(env, channel->gdi.totalMs));
+        }
+        result.Set("stats", stats);
+        jsCallback.Call({ batch, Napi::Boolean::New(env, true), env.Null(), result });
+    } else {
+        Napi::Error error = Napi::Error::New(env, channel->info.error);
+        error.Set("job", result);
+        jsCallback.Call({ batch, Napi::Boolean::New(env, true), error.Value() });
+    }
+}
+
+// Queue a delivery unless one is already pending; called with the channel lock held
+static void ScheduleJobDelivery(const std::shared_ptr<JobChannel>& channel) {
+    if (channel->deliveryQueued) {
+        return;
+    }
+    std::shared_ptr<JobChannel>* data = new std::shared_ptr<JobChannel>(channel);
+    if (channel->callback.NonBlockingCall(data, DeliverJobChannel) == napi_ok) {
+        channel->deliveryQueued = true;
+    } else {
+        // The environment is shutting down; nobody is left to notify
+        delete data;
+    }
+}
+
+// Queue a print job on the native scheduler. The callback receives batches of
+// job events as (events, false) and finally (events, true, error, result).
+Napi::Value SubmitJob(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!info[0].IsString()) {
+        Napi::TypeError::New(env, "Argument must be a string (file path)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (!info[2].IsFunction()) {
+        Napi::TypeError::New(env, "Third argument must be a function (completion callback)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object options = info[1].IsObject() ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+    std::string filePath = info[0].As<Napi::String>().Utf8Value();
+    
+    // Template merge jobs print records over an open template instead of a file
+    std::shared_ptr<MergeTemplate> mergeTemplate;
+    std::shared_ptr<const std::vector<MergeRecord>> records;
+    if (options.Has("template") && !options.Get("template").IsUndefined()) {
+        if (!options.Get("template").IsNumber()) {
+            throw Napi::TypeError::New(env, "Option 'template' must be a number (template id)");
+        }
+        mergeTemplate = MergeTemplate::Find(options.Get("template").As<Napi::Number>().Int64Value());
+        if (!mergeTemplate) {
+            throw Napi::Error::New(env, "Template is not open");
+        }
+        records = GetMergeRecords(options, *mergeTemplate);
+        filePath.clear();
+    } else if (filePath.empty()) {
+        throw Napi::TypeError::New(env, "File path must not be empty");
+    }
+    
+    std::string mode = GetStringOption(options, "mode");
+    if (!mode.empty() && mode != "gdi" && mode != "raw") {
+        throw Napi::TypeError::New(env, "Option 'mode' must be 'gdi' or 'raw'");
+    }
+    bool raw = mode == "raw";
+    
+    PrintJobRequest request;
+    request.filePath = filePath;
+    request.priority = GetIntOption(options, "priority", 0, -1000, 1000);
+    request.deadlineMs = (unsigned int)GetIntOption(options, "deadlineMs", 0, 0, 86400000);
+    request.timeoutMs = (unsigned int)GetIntOption(options, "timeoutMs", 0, 0, 86400000);
+    request.pageBudgetMs = (unsigned int)GetIntOption(options, "pageBudgetMs", 0, 0, 86400000);
+    bool preflight = GetBoolOption(options, "preflight", true);
+    request.layout.nup = GetIntOption(options, "nup", 1, 1, 16);
+    request.layout.booklet = GetBoolOption(options, "booklet", false);
+    std::string forms = GetStringOption(options, "forms");
+    if (forms == "flatten") {
+        request.formMode = FORMS_FLATTEN;
+    } else if (forms == "none") {
+        request.formMode = FORMS_NONE;
+    } else if (!forms.empty() && forms != "draw") {
+        throw Napi::TypeError::New(env, "Option 'forms' must be 'draw', 'flatten' or 'none'");
+    }
+    int nup = request.layout.nup;
+    if (nup != 1 && nup != 2 && nup != 4 && nup != 6 && nup != 9 && nup != 16) {
+        throw Napi::RangeError::New(env, "Option 'nup' must be 1, 2, 4, 6, 9 or 16");
+    }
+    if (request.layout.booklet && nup != 1) {
+        throw Napi::TypeError::New(env, "Options 'nup' and 'booklet' cannot be combined");
+    }
+    if (mergeTemplate && (nup != 1 || request.layout.booklet)) {
+        throw Napi::TypeError::New(env, "Template merge jobs cannot use 'nup' or 'booklet'");
+    }
+    // Isolated jobs render in a renderer process, so a file that crashes
+    // pdfium fails the job instead of taking down the host process
+    bool isolate = GetBoolOption(options, "isolate", false);
+    if (isolate && (mergeTemplate || nup != 1 || request.layout.booklet)) {
+        throw Napi::TypeError::New(env, "Option 'isolate' cannot be combined with 'template', 'nup' or 'booklet'");
+    }
+    if (isolate && !RenderPool::IsConfigured()) {
+        throw Napi::Error::New(env, "Render pool is not configured");
+    }
+    if (isolate) {
+        // The scheduler would otherwise open and preflight the file in-process
+        request.filePath.clear();
+        preflight = false;
+    }
+    FormMode formMode = request.formMode;
+    // Reprints skip rendering when the page cache is enabled. Imposed sheets
+    // and merge records are not cached
+    bool useCache = GetBoolOption(options, "cache", true) && !mergeTemplate && nup == 1 && !request.layout.booklet;
+    std::string cacheSettings = "forms=" + std::to_string((int)formMode);
+    // Pages whose content already rendered, in this job or an earlier one,
+    // reuse those pixels. Isolated jobs are excluded: fingerprinting parses
+    // the page in this process
+    bool dedup = GetBoolOption(options, "dedup", false) && !isolate && !mergeTemplate && nup == 1 &&
+                 !request.layout.booklet;
+    
+    std::shared_ptr<JobChannel> channel = std::make_shared<JobChannel>();
+    channel->raw = raw;
+    std::string error;
+    if (raw) {
+        RasterJobOptions jobOptions;
+        RasterOutput output;
+        GetRasterOptions(options, &jobOptions, &output);
+        if (!RasterPipeline::GetOutputKey(output, &request.resourceKey, &error)) {
+            throw Napi::Error::New(env, error);
+        }
+        request.estimatedBytes = EstimateJobBytes(filePath, false, jobOptions.dpi);
+        request.preflightDpi = preflight ? jobOptions.dpi : 0;
+        if (mergeTemplate) {
+            RasterPageSource source = MergeRasterSource(mergeTemplate, records);
+            request.run = [jobOptions, output, channel, source](PdfDocument*, const RenderControl& control,
+                                                                const JobEventCallback& onEvent, std::string* runError) {
+                return RasterPipeline::PrintToOutput(source, jobOptions, output, &channel->raster, runError,
+                                                     onEvent, &control);
+            };
+        } else if (isolate) {
+            request.run = [jobOptions, output, channel, filePath, formMode, useCache, cacheSettings](
+                              PdfDocument*, const RenderControl& control, const JobEventCallback& onEvent,
+                              std::string* runError) {
+                std::unique_ptr<RenderSession> session = RenderSession::Open(filePath, formMode, &control, runError);
+                if (!session) {
+                    return false;
                 }
-                
-                // Convert to HBITMAP
-                hBitmap = CreateHBITMAPFromBitmapData(bitmap);
-                if (!hBitmap) {
-                    PdfiumWrapper::FreeBitmap(bitmap);
-                    throw Napi::Error::New(env, "Failed to create HBITMAP for page " + std::to_string(i + 1));
+                RasterPageSource source = SessionRasterSource(session.get());
+                std::string documentHash = FileCacheHash(filePath, useCache);
+                if (!documentHash.empty()) {
+                    source = PageCache::CachedSource(source, documentHash, cacheSettings);
                 }
-                
-                // Print bitmap
-                PrintBitmapToPrinter(hBitmap, nullptr, env);
-                
-                // Clean up
-                DeleteObject(hBitmap);
-                PdfiumWrapper::FreeBitmap(bitmap);
-                
-            } catch (const Napi::Error& e) {
-                // Clean up resources before rethrowing
-                if (hBitmap) {
-                    DeleteObject(hBitmap);
+                bool ok = RasterPipeline::PrintToOutput(source, jobOptions, output, &channel->raster, runError,
+                                                        onEvent, &control);
+                if (!ok && !session->LastError().empty()) {
+                    *runError = session->LastError();
                 }
-                if (bitmap) {
-                    PdfiumWrapper::FreeBitmap(bitmap);
+                return ok;
+            };
+        } else {
+            request.run = [jobOptions, output, channel, useCache, dedup, cacheSettings](
+                              PdfDocument* document, const RenderControl& control, const JobEventCallback& onEvent,
+                              std::string* runError) {
+                RasterPageSource source = RasterPipeline::DocumentSource(document);
+                std::string documentHash = DocumentCacheHash(document, useCache);
+                if (!documentHash.empty()) {
+                    source = PageCache::CachedSource(source, documentHash, cacheSettings);
                 }
-                PdfiumWrapper::CloseDocument();
-                PdfiumWrapper::Shutdown();
-                throw;
-            } catch (const std::exception& e) {
-                // Clean up resources before throwing
-                if (hBitmap) {
-                    DeleteObject(hBitmap);
+                if (dedup) {
+                    source = PageDedup::DedupSource(source, DocumentFingerprint(document), cacheSettings);
+                }
+                return RasterPipeline::PrintToOutput(source, jobOptions, output, &channel->raster, runError,
+                                                     onEvent, &control);
+            };
+        }
+    } else {
+        GdiJobOptions gdiOptions;
+        gdiOptions.dpi = GetIntOption(options, "dpi", 300, 72, 1200);
+        gdiOptions.minDpi = GetIntOption(options, "minDpi", 0, 0, 1200);
+        gdiOptions.fallbackDpi = GetIntOption(options, "fallbackDpi", 0, 0, 1200);
+        // Booklets are folded across the short edge
+        std::string duplex = GetStringOption(options, "duplex");
+        if (duplex == "long") {
+            gdiOptions.duplex = DUPLEX_LONG_EDGE;
+        } else if (duplex == "short" || (duplex.empty() && request.layout.booklet)) {
+            gdiOptions.duplex = DUPLEX_SHORT_EDGE;
+        } else if (!duplex.empty() && duplex != "none") {
+            throw Napi::TypeError::New(env, "Option 'duplex' must be 'none', 'long' or 'short'");
+        }
+        if (!PrinterCapsCache::ResolvePrinterName(Utf8ToWide(GetStringOption(options, "printer")),
+                                                  &gdiOptions.printerName, &error)) {
+            throw Napi::Error::New(env, error);
+        }
+        request.resourceKey = "gdi:" + WideToUtf8(gdiOptions.printerName);
+        request.estimatedBytes = EstimateJobBytes(filePath, true, gdiOptions.dpi);
+        request.preflightDpi = preflight ? gdiOptions.dpi : 0;
+        request.bytesPerPixel = kGdiBytesPerPixel;
+        if (mergeTemplate) {
+            request.run = [gdiOptions, channel, mergeTemplate, records](PdfDocument*, const RenderControl& control,
+                                                                        const JobEventCallback& onEvent,
+                                                                        std::string* runError) {
+                int templatePages = mergeTemplate->PageCount();
+                PageRenderer render = [&](int pageIndex, int dpi, int rotation, RenderStatus* status) {
+                    return mergeTemplate->RenderPage((*records)[pageIndex / templatePages], pageIndex % templatePages,
+                                                     dpi, rotation, &control, status);
+                };
+                return GdiPrinter::PrintPages((int)records->size() * templatePages, render, nullptr, gdiOptions,
+                                              &channel->gdi, runError, onEvent, &control);
+            };
+        } else if (isolate) {
+            request.run = [gdiOptions, channel, filePath, formMode, useCache, cacheSettings](
+                              PdfDocument*, const RenderControl& control, const JobEventCallback& onEvent,
+                              std::string* runError) {
+                std::unique_ptr<RenderSession> session = RenderSession::Open(filePath, formMode, &control, runError);
+                if (!session) {
+                    return false;
                 }
-                if (bitmap) {
-                    PdfiumWrapper::FreeBitmap(bitmap);
+                PageRenderer render = [&](int pageIndex, int dpi, int rotation, RenderStatus* status) {
+                    return session->RenderPage(pageIndex, dpi, rotation, &control, status);
+                };
+                std::string documentHash = FileCacheHash(filePath, useCache);
+                if (!documentHash.empty()) {
+                    render = PageCache::CachedRenderer(render, documentHash, cacheSettings);
                 }
-                PdfiumWrapper::CloseDocument();
-                PdfiumWrapper::Shutdown();
-                throw Napi::Error::New(env, "Exception while printing page " + std::to_string(i + 1) + ": " + std::string(e.what()));
-            } catch (...) {
-                // Clean up resources before throwing
-                if (hBitmap) {
-                    DeleteObject(hBitmap);
+                bool ok = GdiPrinter::PrintPages(session->PageCount(), render, nullptr, gdiOptions, &channel->gdi,
+                                                 runError, onEvent, &control);
+                if (!ok && !session->LastError().empty()) {
+                    *runError = session->LastError();
                 }
-                if (bitmap) {
-                    PdfiumWrapper::FreeBitmap(bitmap);
+                return ok;
+            };
+        } else {
+            request.run = [gdiOptions, channel, useCache, dedup, cacheSettings](PdfDocument* document,
+                                                                                const RenderControl& control,
+                                                                                const JobEventCallback& onEvent,
+                                                                                std::string* runError) {
+                std::string documentHash = DocumentCacheHash(document, useCache);
+                if (documentHash.empty() && !dedup) {
+                    return GdiPrinter::PrintDocument(document, gdiOptions, &channel->gdi, runError, onEvent, &control);
                 }
-                PdfiumWrapper::CloseDocument();
-                PdfiumWrapper::Shutdown();
-                throw Napi::Error::New(env, "Unknown exception while printing page " + std::to_string(i + 1));
+                PageRenderer render = [document, &control](int pageIndex, int dpi, int rotation, RenderStatus* status) {
+                    return PdfiumWrapper::RenderPageToBitmap(document, pageIndex, dpi, &control, status, rotation);
+                };
+                if (!documentHash.empty()) {
+                    render = PageCache::CachedRenderer(render, documentHash, cacheSettings);
+                }
+                if (dedup) {
+                    render = PageDedup::DedupRenderer(render, DocumentFingerprint(document), cacheSettings);
+                }
+                return GdiPrinter::PrintPages(PdfiumWrapper::GetPageCount(document), render, document, gdiOptions,
+                                              &channel->gdi, runError, onEvent, &control);
+            };
+        }
+    }
+    
+    channel->callback = Napi::ThreadSafeFunction::New(env, info[2].As<Napi::Function>(), "pdfprint.job", 0, 1);
+    // Progress events are only collected when someone listens for them
+    if (options.Has("onEvent") && options.Get("onEvent").IsFunction()) {
+        request.onEvent = [channel](const JobEvent& event) {
+            std::lock_guard<std::mutex> lock(channel->mutex);
+            channel->events.push_back(event);
+            ScheduleJobDelivery(channel);
+        };
+    }
+    request.onFinished = [channel](const PrintJobInfo& job) {
+        {
+            std::lock_guard<std::mutex> lock(channel->mutex);
+            channel->info = job;
+            channel->finished = true;
+            ScheduleJobDelivery(channel);
+        }
+        channel->callback.Release();
+    };
+    
+    long long id = PrintJobScheduler::Submit(request, &error);
+    if (id == 0) {
+        channel->callback.Release();
+        throw Napi::Error::New(env, error);
+    }
+    GetAddon(env).jobs.insert(id);
+    return Napi::Number::New(env, (double)id);
+}
+
+// Cancel a queued job, or stop a running one at its next render slice
+Napi::Value CancelJob(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Argument must be a number (job id)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    bool cancelled = PrintJobScheduler::Cancel(info[0].As<Napi::Number>().Int64Value());
+    return Napi::Boolean::New(env, cancelled);
+}
+
+// Get the state of a queued, running or recently finished job
+Napi::Value GetJob(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Argument must be a number (job id)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    PrintJobInfo job;
+    if (!PrintJobScheduler::GetJob(info[0].As<Napi::Number>().Int64Value(), &job)) {
+        return env.Null();
+    }
+    return JobInfoToObject(env, job);
+}
+
+// Configure scheduler workers, per-printer concurrency and admission limits
+Napi::Value ConfigureScheduler(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsObject()) {
+        Napi::TypeError::New(env, "Argument must be an object (scheduler options)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    
+    SchedulerConfig config = PrintJobScheduler::GetConfig();
+    config.workers = GetIntOption(options, "workers", config.workers, 1, 64);
+    config.maxPerPrinter = GetIntOption(options, "maxPerPrinter", config.maxPerPrinter, 1, 64);
+    config.memoryBudgetBytes = (size_t)GetIntOption(options, "memoryBudgetMB",
+                                                    (int)(config.memoryBudgetBytes / (1024 * 1024)), 16, 1048576) * 1024 * 1024;
+    config.maxQueued = GetIntOption(options, "maxQueued", config.maxQueued, 1, 1000000);
+    PrintJobScheduler::Configure(config);
+    return env.Undefined();
+}
+
+// Get scheduler throughput and admission counters
+Napi::Value GetSchedulerStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    SchedulerStats stats = PrintJobScheduler::GetStats();
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("submitted", Napi::Number::New(env, (double)stats.submitted));
+    result.Set("rejected", Napi::Number::New(env, (double)stats.rejected));
+    result.Set("completed", Napi::Number::New(env, (double)stats.completed));
+    result.Set("failed", Napi::Number::New(env, (double)stats.failed));
+    result.Set("cancelled", Napi::Number::New(env, (double)stats.cancelled));
+    result.Set("expired", Napi::Number::New(env, (double)stats.expired));
+    result.Set("deadlineMisses", Napi::Number::New(env, (double)stats.deadlineMisses));
+    result.Set("memoryWaits", Napi::Number::New(env, (double)stats.memoryWaits));
+    result.Set("preflighted", Napi::Number::New(env, (double)stats.preflighted));
+    result.Set("costSamples", Napi::Number::New(env, (double)stats.costSamples));
+    result.Set("costErrorPct", Napi::Number::New(env, stats.costErrorPct));
+    result.Set("msPerCostUnit", Napi::Number::New(env, stats.msPerCostUnit));
+    result.Set("queued", Napi::Number::New(env, stats.queued));
+    result.Set("running", Napi::Number::New(env, stats.running));
+    result.Set("memoryInUse", Napi::Number::New(env, (double)stats.memoryInUse));
+    return result;
+}
+
+// Get printer capabilities (cached), so callers can size rasters before printing
+Napi::Value GetPrinterCapabilities(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    std::wstring printerName;
+    if (info.Length() > 0 && info[0].IsString()) {
+        printerName = Utf8ToWide(info[0].As<Napi::String>().Utf8Value());
+    }
+    
+    unsigned int maxAgeMs = PrinterCapsCache::kDefaultMaxAgeMs;
+    if (info.Length() > 1 && info[1].IsNumber()) {
+        double value = info[1].As<Napi::Number>().DoubleValue();
+        maxAgeMs = value <= 0 ? 0 : (unsigned int)std::min(value, 4294967295.0);
+    }
+    
+    PrinterCaps caps;
+    std::string error;
+    if (!PrinterCapsCache::Get(printerName, maxAgeMs, &caps, &error)) {
+        throw Napi::Error::New(env, error);
+    }
+    
+    Napi::Array paperNames = Napi::Array::New(env, caps.paperNames.size());
+    for (size_t i = 0; i < caps.paperNames.size(); i++) {
+        paperNames.Set((uint32_t)i, Napi::String::New(env, WideToUtf8(caps.paperNames[i])));
+    }
+    Napi::Array resolutions = Napi::Array::New(env, caps.resolutions.size());
+    for (size_t i = 0; i < caps.resolutions.size(); i++) {
+        Napi::Object resolution = Napi::Object::New(env);
+        resolution.Set("x", Napi::Number::New(env, caps.resolutions[i].first));
+        resolution.Set("y", Napi::Number::New(env, caps.resolutions[i].second));
+        resolutions.Set((uint32_t)i, resolution);
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("name", Napi::String::New(env, WideToUtf8(caps.name)));
+    result.Set("dpiX", Napi::Number::New(env, caps.dpiX));
+    result.Set("dpiY", Napi::Number::New(env, caps.dpiY));
+    result.Set("physicalWidth", Napi::Number::New(env, caps.physicalWidth));
+    result.Set("physicalHeight", Napi::Number::New(env, caps.physicalHeight));
+    result.Set("offsetX", Napi::Number::New(env, caps.offsetX));
+    result.Set("offsetY", Napi::Number::New(env, caps.offsetY));
+    result.Set("printableWidth", Napi::Number::New(env, caps.printableWidth));
+    result.Set("printableHeight", Napi::Number::New(env, caps.printableHeight));
+    result.Set("color", Napi::Boolean::New(env, caps.color));
+    result.Set("duplex", Napi::Boolean::New(env, caps.duplex));
+    result.Set("paperNames", paperNames);
+    result.Set("resolutions", resolutions);
+    return result;
+}
+
+// Drop cached capabilities for one printer, or for all printers
+Napi::Value InvalidatePrinterCapabilities(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    std::wstring printerName;
+    if (info.Length() > 0 && info[0].IsString()) {
+        printerName = Utf8ToWide(info[0].As<Napi::String>().Utf8Value());
+    }
+    PrinterCapsCache::Invalidate(printerName);
+    return env.Undefined();
+}
+
+// Get connection pool hit rates and the setup time saved by reuse
+Napi::Value GetConnectionPoolStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    ConnectionPoolStats stats = ConnectionPool::GetStats();
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("acquires", Napi::Number::New(env, (double)stats.acquires));
+    result.Set("hits", Napi::Number::New(env, (double)stats.hits));
+    result.Set("misses", Napi::Number::New(env, (double)stats.misses));
+    result.Set("hitRate", Napi::Number::New(env, stats.acquires > 0 ? (double)stats.hits / stats.acquires : 0.0));
+    result.Set("waits", Napi::Number::New(env, (double)stats.waits));
+    result.Set("healthFailures", Napi::Number::New(env, (double)stats.healthFailures));
+    result.Set("idleEvictions", Napi::Number::New(env, (double)stats.idleEvictions));
+    result.Set("discarded", Napi::Number::New(env, (double)stats.discarded));
+    result.Set("setupMs", Napi::Number::New(env, stats.setupMs));
+    result.Set("savedMs", Napi::Number::New(env, stats.savedMs));
+    result.Set("idle", Napi::Number::New(env, stats.idle));
+    result.Set("active", Napi::Number::New(env, stats.active));
+    return result;
+}
+
+// Configure the connection pool limits
+Napi::Value ConfigureConnectionPool(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsObject()) {
+        Napi::TypeError::New(env, "Argument must be an object (pool options)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    
+    ConnectionPoolConfig config = ConnectionPool::GetConfig();
+    config.maxPerKey = GetIntOption(options, "maxPerPrinter", config.maxPerKey, 1, 1024);
+    config.idleTimeoutMs = (unsigned int)GetIntOption(options, "idleTimeoutMs", (int)config.idleTimeoutMs, 0, 86400000);
+    config.acquireTimeoutMs = (unsigned int)GetIntOption(options, "acquireTimeoutMs", (int)config.acquireTimeoutMs, 0, 86400000);
+    ConnectionPool::Configure(config);
+    return env.Undefined();
+}
+
+// Close all idle pooled connections
+Napi::Value ClearConnectionPool(const Napi::CallbackInfo& info) {
+    ConnectionPool::Clear();
+    return info.Env().Undefined();
+}
+
+// Configure the renderer process pool used by isolated jobs; idle renderer
+// processes restart with the new settings
+Napi::Value ConfigureRenderPool(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsObject()) {
+        Napi::TypeError::New(env, "Argument must be an object (render pool options)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    
+    RenderPoolConfig config = RenderPool::GetConfig();
+    std::string workerPath = GetStringOption(options, "workerPath");
+    if (!workerPath.empty()) {
+        config.workerPath = workerPath;
+    }
+    config.processes = GetIntOption(options, "processes", config.processes, 1, 64);
+    config.slots = GetIntOption(options, "slots", config.slots, 1, 64);
+    config.slotBytes = (size_t)GetIntOption(options, "slotMB", (int)(config.slotBytes / (1024 * 1024)), 1, 4096) *
+                       1024 * 1024;
+    std::string error;
+    if (!RenderPool::Configure(config, &error)) {
+        throw Napi::Error::New(env, error);
+    }
+    return env.Undefined();
+}
+
+// Get renderer process counts, restarts and crashes
+Napi::Value GetRenderPoolStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    RenderPoolStats stats = RenderPool::GetStats();
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("configured", Napi::Boolean::New(env, RenderPool::IsConfigured()));
+    result.Set("processes", Napi::Number::New(env, stats.processes));
+    result.Set("busy", Napi::Number::New(env, stats.busy));
+    result.Set("spawned", Napi::Number::New(env, (double)stats.spawned));
+    result.Set("crashes", Napi::Number::New(env, (double)stats.crashes));
+    result.Set("killed", Napi::Number::New(env, (double)stats.killed));
+    result.Set("sessions", Napi::Number::New(env, (double)stats.sessions));
+    return result;
+}
+
+// Enable or reconfigure the on-disk page cache
+Napi::Value ConfigurePageCache(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsObject()) {
+        Napi::TypeError::New(env, "Argument must be an object (page cache options)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    
+    PageCacheConfig config = PageCache::GetConfig();
+    if (options.Has("directory")) {
+        config.directory = GetStringOption(options, "directory");
+    }
+    config.maxBytes = (size_t)GetIntOption(options, "maxMB", (int)(config.maxBytes / (1024 * 1024)), 1, 1048576) *
+                      1024 * 1024;
+    std::string error;
+    if (!PageCache::Configure(config, &error)) {
+        throw Napi::Error::New(env, error);
+    }
+    return env.Undefined();
+}
+
+// Get page cache hit rates and size
+Napi::Value GetPageCacheStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    PageCacheStats stats = PageCache::GetStats();
+    long long lookups = stats.hits + stats.misses;
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("enabled", Napi::Boolean::New(env, PageCache::IsEnabled()));
+    result.Set("hits", Napi::Number::New(env, (double)stats.hits));
+    result.Set("misses", Napi::Number::New(env, (double)stats.misses));
+    result.Set("hitRate", Napi::Number::New(env, lookups > 0 ? (double)stats.hits / lookups : 0.0));
+    result.Set("writes", Napi::Number::New(env, (double)stats.writes));
+    result.Set("writeErrors", Napi::Number::New(env, (double)stats.writeErrors));
+    result.Set("evictions", Napi::Number::New(env, (double)stats.evictions));
+    result.Set("corrupt", Napi::Number::New(env, (double)stats.corrupt));
+    result.Set("entries", Napi::Number::New(env, stats.entries));
+    result.Set("bytes", Napi::Number::New(env, (double)stats.bytes));
+    return result;
+}
+
+// Delete all cached pages
+Napi::Value ClearPageCache(const Napi::CallbackInfo& info) {
+    PageCache::Clear();
+    return info.Env().Undefined();
+}
+
+// Limit the memory kept for identical-page reuse
+Napi::Value ConfigurePageDedup(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsObject()) {
+        Napi::TypeError::New(env, "Argument must be an object (page dedup options)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    
+    PageDedupConfig config = PageDedup::GetConfig();
+    config.maxBytes = (size_t)GetIntOption(options, "maxMB", (int)(config.maxBytes / (1024 * 1024)), 0, 1048576) *
+                      1024 * 1024;
+    std::string error;
+    if (!PageDedup::Configure(config, &error)) {
+        throw Napi::Error::New(env, error);
+    }
+    return env.Undefined();
+}
+
+// Get identical-page reuse counters and the dedup hit rate
+Napi::Value GetPageDedupStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    PageDedupStats stats = PageDedup::GetStats();
+    long long pages = stats.pages + stats.skipped;
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("pages", Napi::Number::New(env, (double)stats.pages));
+    result.Set("hits", Napi::Number::New(env, (double)stats.hits));
+    result.Set("misses", Napi::Number::New(env, (double)stats.misses));
+    result.Set("skipped", Napi::Number::New(env, (double)stats.skipped));
+    result.Set("hitRate", Napi::Number::New(env, pages > 0 ? (double)stats.hits / pages : 0.0));
+    result.Set("evictions", Napi::Number::New(env, (double)stats.evictions));
+    result.Set("entries", Napi::Number::New(env, stats.entries));
+    result.Set("bytes", Napi::Number::New(env, (double)stats.bytes));
+    return result;
+}
+
+// Release all pages kept for identical-page reuse
+Napi::Value ClearPageDedup(const Napi::CallbackInfo& info) {
+    PageDedup::Clear();
+    return info.Env().Undefined();
+}
+
+// Turn stage timing on or off; recorded values are kept
+Napi::Value ConfigureMetrics(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsObject()) {
+        Napi::TypeError::New(env, "Argument must be an object (metrics options)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    Metrics::SetEnabled(GetBoolOption(options, "enabled", Metrics::IsEnabled()));
+    if (GetBoolOption(options, "reset", false)) {
+        Metrics::Reset();
+    }
+    return env.Undefined();
+}
+
+// Get per-stage latency percentiles and pipeline counters
+Napi::Value GetMetrics(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    MetricsSnapshot snapshot = Metrics::GetSnapshot();
+    
+    Napi::Object stages = Napi::Object::New(env);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const StageMetrics& metrics = snapshot.stages[i];
+        Napi::Object stage = Napi::Object::New(env);
+        stage.Set("count", Napi::Number::New(env, (double)metrics.count));
+        stage.Set("totalMs", Napi::Number::New(env, metrics.totalMs));
+        stage.Set("meanMs", Napi::Number::New(env, metrics.count > 0 ? metrics.totalMs / metrics.count : 0.0));
+        stage.Set("maxMs", Napi::Number::New(env, metrics.maxMs));
+        stage.Set("p50Ms", Napi::Number::New(env, metrics.p50Ms));
+        stage.Set("p90Ms", Napi::Number::New(env, metrics.p90Ms));
+        stage.Set("p99Ms", Napi::Number::New(env, metrics.p99Ms));
+        stage.Set("p999Ms", Napi::Number::New(env, metrics.p999Ms));
+        stages.Set(Metrics::StageName((MetricStage)i), stage);
+    }
+    Napi::Object counters = Napi::Object::New(env);
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        counters.Set(Metrics::CounterName((MetricCounter)i), Napi::Number::New(env, (double)snapshot.counters[i]));
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("enabled", Napi::Boolean::New(env, snapshot.enabled));
+    result.Set("stages", stages);
+    result.Set("counters", counters);
+    return result;
+}
+
+// Dump all metrics in the Prometheus text exposition format
+Napi::Value GetMetricsText(const Napi::CallbackInfo& info) {
+    return Napi::String::New(info.Env(), Metrics::PrometheusText());
+}
+
+// Start recording a timeline of the print pipeline
+Napi::Value StartTrace(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    TraceConfig config;
+    if (info.Length() > 0 && !info[0].IsUndefined()) {
+        if (!info[0].IsObject()) {
+            Napi::TypeError::New(env, "Argument must be an object (trace options)").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        Napi::Object options = info[0].As<Napi::Object>();
+        config.maxEventsPerThread = (size_t)GetIntOption(options, "maxEventsPerThread",
+                                                         (int)config.maxEventsPerThread, 1, INT_MAX);
+    }
+    Tracing::Start(config);
+    return env.Undefined();
+}
+
+// Stop recording and return the timeline as Chrome trace-event JSON
+Napi::Value StopTrace(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!Tracing::IsActive()) {
+        return env.Null();
+    }
+    long long dropped = 0;
+    std::string json = Tracing::Stop(&dropped);
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("json", Napi::String::New(env, json));
+    result.Set("droppedEvents", Napi::Number::New(env, (double)dropped));
+    return result;
+}
+
+// Open a merge template; the page content is rendered once per resolution
+// and reused for every record
+Napi::Value OpenTemplate(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsString()) {
+        Napi::TypeError::New(env, "Argument must be a string (file path)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    std::string error;
+    long long id = MergeTemplate::Register(info[0].As<Napi::String>().Utf8Value(), &error);
+    if (id == 0) {
+        throw Napi::Error::New(env, error);
+    }
+    GetAddon(env).templates.insert(id);
+    return Napi::Number::New(env, (double)id);
+}
+
+// Close a merge template; jobs already submitted with it still complete
+Napi::Value CloseTemplate(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Argument must be a number (template id)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    long long id = info[0].As<Napi::Number>().Int64Value();
+    GetAddon(env).templates.erase(id);
+    return Napi::Boolean::New(env, MergeTemplate::Unregister(id));
+}
+
+// Get page count and static layer cache statistics of a merge template
+Napi::Value GetTemplateStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Argument must be a number (template id)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    std::shared_ptr<MergeTemplate> mergeTemplate = MergeTemplate::Find(info[0].As<Napi::Number>().Int64Value());
+    if (!mergeTemplate) {
+        return env.Null();
+    }
+    MergeStats stats = mergeTemplate->GetStats();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("pageCount", Napi::Number::New(env, mergeTemplate->PageCount()));
+    result.Set("pages", Napi::Number::New(env, (double)stats.pages));
+    result.Set("layersRendered", Napi::Number::New(env, (double)stats.layersRendered));
+    result.Set("layerHits", Napi::Number::New(env, (double)stats.layerHits));
+    result.Set("cacheBytes", Napi::Number::New(env, (double)stats.cacheBytes));
+    result.Set("staticMs", Napi::Number::New(env, stats.staticMs));
+    result.Set("overlayMs", Napi::Number::New(env, stats.overlayMs));
+    return result;
+}
+
+// Documents opened with openDocument belong to the environment that opened
+// them. Page streams hold their own reference, so closing a document they
+// still read from is safe
+static std::shared_ptr<PdfDocument> GetDocumentArgument(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsNumber()) {
+        throw Napi::TypeError::New(env, "Argument must be a number (document id)");
+    }
+    PdfPrintAddon& addon = GetAddon(env);
+    auto it = addon.documents.find(info[0].As<Napi::Number>().Int64Value());
+    if (it == addon.documents.end()) {
+        throw Napi::Error::New(env, "Document is not open");
+    }
+    return it->second;
+}
+
+// Open a PDF for renderPage and createPageStream; it stays parsed until
+// closeDocument
+Napi::Value OpenDocument(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsString()) {
+        Napi::TypeError::New(env, "Argument must be a string (file path)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info.Length() > 1 && info[1].IsObject() ? info[1].As<Napi::Object>()
+                                                                   : Napi::Object::New(env);
+    FormMode formMode = FORMS_DRAW;
+    std::string forms = GetStringOption(options, "forms");
+    if (forms == "flatten") {
+        formMode = FORMS_FLATTEN;
+    } else if (forms == "none") {
+        formMode = FORMS_NONE;
+    } else if (!forms.empty() && forms != "draw") {
+        throw Napi::TypeError::New(env, "Option 'forms' must be 'draw', 'flatten' or 'none'");
+    }
+
+    std::string filePath = info[0].As<Napi::String>().Utf8Value();
+    std::shared_ptr<PdfDocument> document = OpenSharedDocument(filePath);
+    if (!document) {
+        throw Napi::Error::New(env, "Failed to load PDF file: " + filePath);
+    }
+    PdfiumWrapper::SetFormMode(document.get(), formMode);
+    PdfPrintAddon& addon = GetAddon(env);
+    long long id = addon.nextDocumentId++;
+    addon.documents[id] = document;
+    return Napi::Number::New(env, (double)id);
+}
+
+// Close a document opened with openDocument. Pages already rendered from it
+// stay valid, and open page streams finish first
+Napi::Value CloseDocument(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Argument must be a number (document id)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    return Napi::Boolean::New(env, GetAddon(env).documents.erase(info[0].As<Napi::Number>().Int64Value()) > 0);
+}
+
+// Get the page count and page sizes (points) of an open document
+Napi::Value GetDocumentInfo(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    std::shared_ptr<PdfDocument> document = GetDocumentArgument(info);
+    int pageCount = PdfiumWrapper::GetPageCount(document.get());
+    Napi::Array pages = Napi::Array::New(env, pageCount);
+    for (int i = 0; i < pageCount; i++) {
+        float width = 0;
+        float height = 0;
+        PdfiumWrapper::GetPageSize(document.get(), i, &width, &height);
+        Napi::Object page = Napi::Object::New(env);
+        page.Set("width", Napi::Number::New(env, width));
+        page.Set("height", Napi::Number::New(env, height));
+        pages.Set((uint32_t)i, page);
+    }
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("pageCount", Napi::Number::New(env, pageCount));
+    result.Set("pages", pages);
+    return result;
+}
+
+static void FinalizePageBitmap(Napi::Env env, void* /*data*/, BitmapData* bitmap) {
+    Napi::MemoryManagement::AdjustExternalMemory(env, -(int64_t)((size_t)bitmap->stride * bitmap->height));
+    PdfiumWrapper::FreeBitmap(bitmap);
+}
+
+// Hand a rendered bitmap to JS. The ArrayBuffer is the native bitmap itself:
+// no copy is made, and it is freed when the buffer is garbage collected
+static Napi::Object BitmapToObject(Napi::Env env, BitmapData* bitmap) {
+    int width = bitmap->width;
+    int height = bitmap->height;
+    int stride = bitmap->stride;
+    const char* format = bitmap->bitmapFormat == 2 ? "gray" : "bgra";
+    size_t byteLength = (size_t)stride * height;
+#ifdef NODE_API_NO_EXTERNAL_BUFFERS_ALLOWED
+    // Runtimes with the V8 sandbox cannot wrap outside memory
+    Napi::ArrayBuffer data = Napi::ArrayBuffer::New(env, byteLength);
+    memcpy(data.Data(), bitmap->data, byteLength);
+    PdfiumWrapper::FreeBitmap(bitmap);
+#else
+    Napi::ArrayBuffer data = Napi::ArrayBuffer::New(env, bitmap->data, byteLength, FinalizePageBitmap, bitmap);
+    // Let V8 count the pixels against its heap so large renders trigger GC
+    Napi::MemoryManagement::AdjustExternalMemory(env, (int64_t)byteLength);
+#endif
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("data", data);
+    result.Set("width", Napi::Number::New(env, width));
+    result.Set("height", Napi::Number::New(env, height));
+    result.Set("stride", Napi::Number::New(env, stride));
+    result.Set("format", Napi::String::New(env, format));
+    return result;
+}
+
+static int GetRotateOption(Napi::Object options) {
+    int rotate = GetIntOption(options, "rotate", 0, 0, 270);
+    if (rotate % 90 != 0) {
+        throw Napi::RangeError::New(options.Env(), "Option 'rotate' must be 0, 90, 180 or 270");
+    }
+    return rotate / 90;
+}
+
+// Render one page to BGRA pixels
+Napi::Value RenderPage(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    std::shared_ptr<PdfDocument> document = GetDocumentArgument(info);
+    if (!info[1].IsNumber()) {
+        Napi::TypeError::New(env, "Argument must be a number (page index)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    int pageIndex = info[1].As<Napi::Number>().Int32Value();
+    int pageCount = PdfiumWrapper::GetPageCount(document.get());
+    if (pageIndex < 0 || pageIndex >= pageCount) {
+        throw Napi::RangeError::New(env, "Page index must be between 0 and " + std::to_string(pageCount - 1));
+    }
+    Napi::Object options = info.Length() > 2 && info[2].IsObject() ? info[2].As<Napi::Object>()
+                                                                   : Napi::Object::New(env);
+    int dpi = GetIntOption(options, "dpi", 150, 18, 1200);
+    int rotation = GetRotateOption(options);
+
+    RenderStatus status = RENDER_FAILED;
+    BitmapData* bitmap = PdfiumWrapper::RenderPageToBitmap(document.get(), pageIndex, dpi, nullptr, &status,
+                                                           rotation);
+    if (!bitmap) {
+        throw Napi::Error::New(env, PdfiumWrapper::RenderStatusMessage(status, pageIndex));
+    }
+    return BitmapToObject(env, bitmap);
+}
+
+// Chunks of one page stream on their way from the render thread to JS. The
+// stream only renders when JS asks for the next chunk, so this holds at most
+// one chunk per request.
+struct PageStreamChannel {
+    std::mutex mutex;
+    std::vector<PageChunk> chunks;
+    bool deliveryQueued = false;
+    bool finished = false;
+    bool finalDelivered = false;
+    bool ok = true;
+    std::string error;
+    Napi::ThreadSafeFunction callback;
+    // JS thread only: chunks asked for but not delivered yet. The callback
+    // keeps the event loop alive only while this is nonzero, so an abandoned
+    // stream does not hold up process exit
+    int requested = 0;
+
+    ~PageStreamChannel() {
+        for (const PageChunk& chunk : chunks) {
+            PdfiumWrapper::FreeBitmap(chunk.bitmap);
+        }
+    }
+};
+
+static void DeliverPageStream(Napi::Env env, Napi::Function jsCallback, std::shared_ptr<PageStreamChannel>* data) {
+    std::shared_ptr<PageStreamChannel> channel = *data;
+    delete data;
+
+    std::vector<PageChunk> chunks;
+    bool final = false;
+    {
+        std::lock_guard<std::mutex> lock(channel->mutex);
+        chunks.swap(channel->chunks);
+        channel->deliveryQueued = false;
+        if (channel->finished && !channel->finalDelivered) {
+            channel->finalDelivered = true;
+            final = true;
+        }
+    }
+    channel->requested = std::max(0, channel->requested - (int)chunks.size());
+    if (channel->requested == 0 && !final) {
+        channel->callback.Unref(env);
+    }
+    for (const PageChunk& chunk : chunks) {
+        Napi::Object result = BitmapToObject(env, chunk.bitmap);
+        result.Set("page", Napi::Number::New(env, chunk.pageIndex));
+        result.Set("top", Napi::Number::New(env, chunk.top));
+        jsCallback.Call({ env.Null(), result });
+    }
+    if (!final) {
+        return;
+    }
+    if (channel->ok) {
+        jsCallback.Call({ env.Null(), env.Null() });
+    } else {
+        jsCallback.Call({ Napi::Error::New(env, channel->error).Value() });
+    }
+}
+
+// Queue a delivery unless one is already pending; called with the channel lock held
+static void SchedulePageStreamDelivery(const std::shared_ptr<PageStreamChannel>& channel) {
+    if (channel->deliveryQueued) {
+        return;
+    }
+    std::shared_ptr<PageStreamChannel>* data = new std::shared_ptr<PageStreamChannel>(channel);
+    if (channel->callback.NonBlockingCall(data, DeliverPageStream) == napi_ok) {
+        channel->deliveryQueued = true;
+    } else {
+        delete data;
+    }
+}
+
+// What JS holds for a page stream
+struct PageStreamHandle {
+    std::shared_ptr<PageStreamChannel> channel;
+    std::unique_ptr<PageStream> stream;
+    std::shared_ptr<PageStreamReaper> reaper;
+};
+
+// Marks the externals made by createPageStream, so an External from another
+// addon is never taken for a page stream
+static const napi_type_tag kPageStreamTag = { 0x5d3c8f1e2a7b4c06ULL, 0x9e41b6d07f28a3c5ULL };
+
+static void RunPageStreamReaper(PageStreamReaper* reaper) {
+    std::unique_lock<std::mutex> lock(reaper->mutex);
+    while (true) {
+        reaper->wake.wait(lock, [reaper]() { return reaper->stopping || !reaper->queue.empty(); });
+        if (reaper->queue.empty()) {
+            return;
+        }
+        std::vector<PageStreamHandle*> handles;
+        handles.swap(reaper->queue);
+        lock.unlock();
+        for (PageStreamHandle* handle : handles) {
+            delete handle;
+        }
+        lock.lock();
+    }
+}
+
+// Runs during GC on the JS thread. Deleting the stream joins its render
+// thread, which may be in the middle of a page, so only cancel here and
+// hand the join to the reaper
+static void FinalizePageStream(Napi::Env /*env*/, PageStreamHandle* handle) {
+    handle->stream->Cancel();
+    std::shared_ptr<PageStreamReaper> reaper = handle->reaper;
+    {
+        std::lock_guard<std::mutex> lock(reaper->mutex);
+        if (!reaper->stopping) {
+            if (!reaper->thread.joinable()) {
+                reaper->thread = std::thread(RunPageStreamReaper, reaper.get());
             }
+            reaper->queue.push_back(handle);
+            reaper->wake.notify_one();
+            return;
         }
-        
-        PdfiumWrapper::CloseDocument();
-        PdfiumWrapper::Shutdown();
-        
-        return Napi::Boolean::New(env, true);
-        
-    } catch (const Napi::Error& e) {
-        // Re-throw NAPI errors as-is
-        throw;
-    } catch (const std::exception& e) {
-        PdfiumWrapper::Shutdown();
-        throw Napi::Error::New(env, "Exception during PDF processing: " + std::string(e.what()));
-    } catch (...) {
-        PdfiumWrapper::Shutdown();
-        throw Napi::Error::New(env, "Unknown exception during PDF processing");
     }
+    delete handle;
+}
+
+// Start rendering a document page by page (or band by band) for a JS
+// Readable. The callback receives (null, chunk) for each chunk, (null, null)
+// at the end and (error) on failure. Nothing is rendered until
+// readPageStream asks for a chunk.
+Napi::Value CreatePageStream(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    std::shared_ptr<PdfDocument> document = GetDocumentArgument(info);
+    if (!info[2].IsFunction()) {
+        Napi::TypeError::New(env, "Third argument must be a function (chunk callback)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info[1].IsObject() ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+    int pageCount = PdfiumWrapper::GetPageCount(document.get());
+
+    PageStreamOptions streamOptions;
+    streamOptions.dpi = GetIntOption(options, "dpi", 150, 18, 1200);
+    streamOptions.rotation = GetRotateOption(options);
+    streamOptions.firstPage = GetIntOption(options, "firstPage", 0, 0, std::max(0, pageCount - 1));
+    streamOptions.lastPage = GetIntOption(options, "lastPage", pageCount - 1, streamOptions.firstPage,
+                                          std::max(0, pageCount - 1));
+    streamOptions.bandHeight = GetIntOption(options, "bandHeight", 0, 0, 65536);
+    if (streamOptions.bandHeight > 0 && streamOptions.rotation != 0) {
+        throw Napi::TypeError::New(env, "Options 'bandHeight' and 'rotate' cannot be combined");
+    }
+
+    std::shared_ptr<PageStreamChannel> channel = std::make_shared<PageStreamChannel>();
+    channel->callback = Napi::ThreadSafeFunction::New(env, info[2].As<Napi::Function>(), "pdfprint.pageStream",
+                                                      0, 1);
+    PageStream::ChunkCallback onChunk = [channel](const PageChunk& chunk) {
+        std::lock_guard<std::mutex> lock(channel->mutex);
+        channel->chunks.push_back(chunk);
+        SchedulePageStreamDelivery(channel);
+    };
+    PageStream::EndCallback onEnd = [channel](bool ok, const std::string& error) {
+        {
+            std::lock_guard<std::mutex> lock(channel->mutex);
+            channel->ok = ok;
+            channel->error = error;
+            channel->finished = true;
+            SchedulePageStreamDelivery(channel);
+        }
+        channel->callback.Release();
+    };
+    channel->callback.Unref(env);
+    PageStreamHandle* handle = new PageStreamHandle();
+    handle->channel = channel;
+    handle->reaper = GetAddon(env).streamReaper;
+    handle->stream.reset(new PageStream(document, streamOptions, onChunk, onEnd));
+    Napi::External<PageStreamHandle> external = Napi::External<PageStreamHandle>::New(env, handle, FinalizePageStream);
+    external.TypeTag(&kPageStreamTag);
+    return external;
+}
+
+static PageStreamHandle* GetPageStreamArgument(const Napi::CallbackInfo& info) {
+    if (!info[0].IsExternal()) {
+        throw Napi::TypeError::New(info.Env(), "Argument must be a page stream");
+    }
+    Napi::External<PageStreamHandle> external = info[0].As<Napi::External<PageStreamHandle>>();
+    if (!external.CheckTypeTag(&kPageStreamTag)) {
+        throw Napi::TypeError::New(info.Env(), "Argument must be a page stream");
+    }
+    return external.Data();
 }
 
-// Module initialization
-Napi::Object Init(Napi::Env env, Napi::Object exports) {
+// Allow a page stream to render its next chunk
+Napi::Value ReadPageStream(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    PageStreamHandle* handle = GetPageStreamArgument(info);
+    PageStreamChannel& channel = *handle->channel;
+    if (channel.finalDelivered) {
+        return env.Undefined();
+    }
+    if (channel.requested++ == 0) {
+        channel.callback.Ref(env);
+    }
+    handle->stream->Request(1);
+    return env.Undefined();
+}
+
+// Stop a page stream; the page being rendered stops at its next render slice
+Napi::Value ClosePageStream(const Napi::CallbackInfo& info) {
+    GetPageStreamArgument(info)->stream->Cancel();
+    return info.Env().Undefined();
+}
+
+// Module initialization, once per environment
+PdfPrintAddon::PdfPrintAddon(Napi::Env env, Napi::Object exports) {
     exports.Set(Napi::String::New(env, "initialize"), Napi::Function::New(env, Initialize));
     exports.Set(Napi::String::New(env, "loadPdf"), Napi::Function::New(env, LoadPdf));
     exports.Set(Napi::String::New(env, "getPageCount"), Napi::Function::New(env, GetPageCount));
     exports.Set(Napi::String::New(env, "printPdf"), Napi::Function::New(env, PrintPdf));
-    return exports;
+    exports.Set(Napi::String::New(env, "printPdfRaw"), Napi::Function::New(env, PrintPdfRaw));
+    exports.Set(Napi::String::New(env, "getPrinterCapabilities"), Napi::Function::New(env, GetPrinterCapabilities));
+    exports.Set(Napi::String::New(env, "invalidatePrinterCapabilities"), Napi::Function::New(env, InvalidatePrinterCapabilities));
+    exports.Set(Napi::String::New(env, "getConnectionPoolStats"), Napi::Function::New(env, GetConnectionPoolStats));
+    exports.Set(Napi::String::New(env, "configureConnectionPool"), Napi::Function::New(env, ConfigureConnectionPool));
+    exports.Set(Napi::String::New(env, "clearConnectionPool"), Napi::Function::New(env, ClearConnectionPool));
+    exports.Set(Napi::String::New(env, "submitJob"), Napi::Function::New(env, SubmitJob));
+    exports.Set(Napi::String::New(env, "cancelJob"), Napi::Function::New(env, CancelJob));
+    exports.Set(Napi::String::New(env, "getJob"), Napi::Function::New(env, GetJob));
+    exports.Set(Napi::String::New(env, "configureScheduler"), Napi::Function::New(env, ConfigureScheduler));
+    exports.Set(Napi::String::New(env, "getSchedulerStats"), Napi::Function::New(env, GetSchedulerStats));
+    exports.Set(Napi::String::New(env, "configureRenderPool"), Napi::Function::New(env, ConfigureRenderPool));
+    exports.Set(Napi::String::New(env, "getRenderPoolStats"), Napi::Function::New(env, GetRenderPoolStats));
+    exports.Set(Napi::String::New(env, "configurePageCache"), Napi::Function::New(env, ConfigurePageCache));
+    exports.Set(Napi::String::New(env, "getPageCacheStats"), Napi::Function::New(env, GetPageCacheStats));
+    exports.Set(Napi::String::New(env, "clearPageCache"), Napi::Function::New(env, ClearPageCache));
+    exports.Set(Napi::String::New(env, "configurePageDedup"), Napi::Function::New(env, ConfigurePageDedup));
+    exports.Set(Napi::String::New(env, "getPageDedupStats"), Napi::Function::New(env, GetPageDedupStats));
+    exports.Set(Napi::String::New(env, "clearPageDedup"), Napi::Function::New(env, ClearPageDedup));
+    exports.Set(Napi::String::New(env, "configureMetrics"), Napi::Function::New(env, ConfigureMetrics));
+    exports.Set(Napi::String::New(env, "getMetrics"), Napi::Function::New(env, GetMetrics));
+    exports.Set(Napi::String::New(env, "getMetricsText"), Napi::Function::New(env, GetMetricsText));
+    exports.Set(Napi::String::New(env, "startTrace"), Napi::Function::New(env, StartTrace));
+    exports.Set(Napi::String::New(env, "stopTrace"), Napi::Function::New(env, StopTrace));
+    exports.Set(Napi::String::New(env, "openTemplate"), Napi::Function::New(env, OpenTemplate));
+    exports.Set(Napi::String::New(env, "closeTemplate"), Napi::Function::New(env, CloseTemplate));
+    exports.Set(Napi::String::New(env, "getTemplateStats"), Napi::Function::New(env, GetTemplateStats));
+    exports.Set(Napi::String::New(env, "openDocument"), Napi::Function::New(env, OpenDocument));
+    exports.Set(Napi::String::New(env, "closeDocument"), Napi::Function::New(env, CloseDocument));
+    exports.Set(Napi::String::New(env, "getDocumentInfo"), Napi::Function::New(env, GetDocumentInfo));
+    exports.Set(Napi::String::New(env, "renderPage"), Napi::Function::New(env, RenderPage));
+    exports.Set(Napi::String::New(env, "createPageStream"), Napi::Function::New(env, CreatePageStream));
+    exports.Set(Napi::String::New(env, "readPageStream"), Napi::Function::New(env, ReadPageStream));
+    exports.Set(Napi::String::New(env, "closePageStream"), Napi::Function::New(env, ClosePageStream));
+    DefineAddon(exports, {});
+    
+    std::lock_guard<std::mutex> lock(g_addonsMutex);
+    g_addons++;
 }
 
-NODE_API_MODULE(pdfprint, Init)
+// The environment is going away: its jobs are cancelled, its documents and
+// templates closed and its collected page streams joined. The scheduler
+// workers and renderer processes are stopped with the last environment.
+PdfPrintAddon::~PdfPrintAddon() {
+    for (long long id : jobs) {
+        PrintJobScheduler::Cancel(id);
+    }
+    for (long long id : templates) {
+        MergeTemplate::Unregister(id);
+    }
+    // Streams already finalized finish deleting before the module can unload
+    {
+        std::lock_guard<std::mutex> lock(streamReaper->mutex);
+        streamReaper->stopping = true;
+        streamReaper->wake.notify_all();
+    }
+    if (streamReaper->thread.joinable()) {
+        streamReaper->thread.join();
+    }
+    loadedDocument.reset();
+    documents.clear();
+    if (libraryAcquired) {
+        PdfiumWrapper::ReleaseLibrary();
+    }
+    
+    std::lock_guard<std::mutex> lock(g_addonsMutex);
+    if (--g_addons == 0) {
+        PrintJobScheduler::Shutdown();
+        RenderPool::Shutdown();
+    }
+}
 
+NODE_API_ADDON(PdfPrintAddon)
@@ -0,0 +1,123 @@
+#include "printer_caps.h"
+#include <windows.h>
+#include <winspool.h>
+#include <map>
+#include <mutex>
+
+static std::mutex g_capsMutex;
+static std::map<std::wstring, PrinterCaps> g_capsCache;
+
+static unsigned long long NowMs() {
+    return GetTickCount64();
+}
+
+bool PrinterCapsCache::ResolvePrinterName(const std::wstring& printerName, std::wstring* resolved, std::string* error) {
+    if (!printerName.empty()) {
+        *resolved = printerName;
+        return true;
+    }
+
+    // The default printer can change at any time; this is a local lookup,
+    // not a spooler round trip, so it is resolved on every call
+    wchar_t defaultPrinterName[256] = {0};
+    DWORD nameLen = sizeof(defaultPrinterName) / sizeof(defaultPrinterName[0]);
+    if (!GetDefaultPrinterW(defaultPrinterName, &nameLen)) {
+        if (error) {
+            *error = "Failed to get default printer, error code: " + std::to_string(GetLastError());
+        }
+        return false;
+    }
+    *resolved = defaultPrinterName;
+    return true;
+}
+
+static bool QueryPrinterCaps(const std::wstring& name, PrinterCaps* caps, std::string* error) {
+    // An information context is enough for GetDeviceCaps and is cheaper than a DC
+    HDC hdc = CreateICW(L"WINSPOOL", name.c_str(), nullptr, nullptr);
+    if (!hdc) {
+        if (error) {
+            *error = "Failed to query printer capabilities (CreateICW), error code: " + std::to_string(GetLastError());
+        }
+        return false;
+    }
+
+    caps->name = name;
+    caps->dpiX = GetDeviceCaps(hdc, LOGPIXELSX);
+    caps->dpiY = GetDeviceCaps(hdc, LOGPIXELSY);
+    caps->physicalWidth = GetDeviceCaps(hdc, PHYSICALWIDTH);
+    caps->physicalHeight = GetDeviceCaps(hdc, PHYSICALHEIGHT);
+    caps->offsetX = GetDeviceCaps(hdc, PHYSICALOFFSETX);
+    caps->offsetY = GetDeviceCaps(hdc, PHYSICALOFFSETY);
+    caps->printableWidth = GetDeviceCaps(hdc, HORZRES);
+    caps->printableHeight = GetDeviceCaps(hdc, VERTRES);
+    DeleteDC(hdc);
+
+    caps->color = DeviceCapabilitiesW(name.c_str(), nullptr, DC_COLORDEVICE, nullptr, nullptr) == 1;
+    caps->duplex = DeviceCapabilitiesW(name.c_str(), nullptr, DC_DUPLEX, nullptr, nullptr) == 1;
+
+    caps->paperNames.clear();
+    int paperCount = DeviceCapabilitiesW(name.c_str(), nullptr, DC_PAPERNAMES, nullptr, nullptr);
+    if (paperCount > 0) {
+        // Each paper name is a fixed 64-character slot, not always terminated
+        std::vector<wchar_t> names((size_t)paperCount * 64 + 1, L'\0');
+        paperCount = DeviceCapabilitiesW(name.c_str(), nullptr, DC_PAPERNAMES, names.data(), nullptr);
+        for (int i = 0; i < paperCount; i++) {
+            const wchar_t* slot = &names[(size_t)i * 64];
+            size_t length = 0;
+            while (length < 64 && slot[length]) {
+                length++;
+            }
+            caps->paperNames.push_back(std::wstring(slot, length));
+        }
+    }
+
+    caps->resolutions.clear();
+    int resolutionCount = DeviceCapabilitiesW(name.c_str(), nullptr, DC_ENUMRESOLUTIONS, nullptr, nullptr);
+    if (resolutionCount > 0) {
+        std::vector<LONG> values((size_t)resolutionCount * 2);
+        resolutionCount = DeviceCapabilitiesW(name.c_str(), nullptr, DC_ENUMRESOLUTIONS, (LPWSTR)values.data(), nullptr);
+        for (int i = 0; i < resolutionCount; i++) {
+            caps->resolutions.push_back(std::make_pair((int)values[i * 2], (int)values[i * 2 + 1]));
+        }
+    }
+
+    caps->fetchedAt = NowMs();
+    return true;
+}
+
+bool PrinterCapsCache::Get(const std::wstring& printerName, unsigned int maxAgeMs, PrinterCaps* caps, std::string* error) {
+    std::wstring name;
+    if (!ResolvePrinterName(printerName, &name, error)) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_capsMutex);
+        auto it = g_capsCache.find(name);
+        if (it != g_capsCache.end() && NowMs() - it->second.fetchedAt < maxAgeMs) {
+            *caps = it->second;
+            return true;
+        }
+    }
+
+    // Query outside the lock: driver calls can take a long time for network printers
+    PrinterCaps fresh;
+    if (!QueryPrinterCaps(name, &fresh, error)) {
+        Invalidate(name);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_capsMutex);
+    g_capsCache[name] = fresh;
+    *caps = fresh;
+    return true;
+}
+
+void PrinterCapsCache::Invalidate(const std::wstring& printerName) {
+    std::lock_guard<std::mutex> lock(g_capsMutex);
+    if (printerName.empty()) {
+        g_capsCache.clear();
+    } else {
+        g_capsCache.erase(printerName);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef PRINTER_CAPS_H
+#define PRINTER_CAPS_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * 打印机能力信息
+ * 尺寸单位均为设备像素（打印机点）
+ */
+struct PrinterCaps {
+    std::wstring name;           // 打印机名称
+    int dpiX = 0;                // 水平分辨率
+    int dpiY = 0;                // 垂直分辨率
+    int physicalWidth = 0;       // 纸张物理宽度
+    int physicalHeight = 0;      // 纸张物理高度
+    int offsetX = 0;             // 可打印区域左边距
+    int offsetY = 0;             // 可打印区域上边距
+    int printableWidth = 0;      // 可打印区域宽度
+    int printableHeight = 0;     // 可打印区域高度
+    bool color = false;          // 是否支持彩色
+    bool duplex = false;         // 是否支持双面
+    std::vector<std::wstring> paperNames;             // 支持的纸张名称
+    std::vector<std::pair<int, int>> resolutions;     // 支持的分辨率（x, y）
+    unsigned long long fetchedAt = 0;                 // 获取时间（单调时钟毫秒）
+};
+
+/**
+ * 打印机能力缓存
+ * 分辨率、可打印区域等信息几乎不会变化，缓存后每页打印无需再查询
+ * 后台打印程序和驱动。条目在超过有效期、被显式失效或打印失败时重新获取。
+ * 线程安全
+ */
+class PrinterCapsCache {
+public:
+    /**
+     * 解析打印机名称
+     * @param printerName 打印机名称，为空时使用当前默认打印机
+     * @param resolved 输出实际打印机名称
+     * @param error 失败时输出错误描述
+     * @return 成功返回 true
+     */
+    static bool ResolvePrinterName(const std::wstring& printerName, std::wstring* resolved, std::string* error);
+
+    /**
+     * 获取打印机能力（优先使用缓存）
+     * @param printerName 打印机名称，为空时使用当前默认打印机
+     * @param maxAgeMs 缓存有效期（毫秒），超过后重新查询；0 表示强制刷新
+     * @param caps 输出能力信息
+     * @param error 失败时输出错误描述
+     * @return 成功返回 true
+     */
+    static bool Get(const std::wstring& printerName, unsigned int maxAgeMs, PrinterCaps* caps, std::string* error);
+
+    /**
+     * 使缓存失效
+     * @param printerName 打印机名称，为空时清空全部缓存
+     */
+    static void Invalidate(const std::wstring& printerName);
+
+    /**
+     * 默认缓存有效期（毫秒）
+     */
+    static const unsigned int kDefaultMaxAgeMs = 5 * 60 * 1000;
+};
+
+#endif // PRINTER_CAPS_H
@@ -0,0 +1,107 @@
+#include "raster_ops.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define RASTER_OPS_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RASTER_OPS_NEON 1
+#endif
+
+// 4x4 Bayer matrix scaled to 0..255 thresholds
+static const unsigned char kBayer4x4[4][4] = {
+    {  8, 136,  40, 168 },
+    { 200,  72, 232, 104 },
+    {  56, 184,  24, 152 },
+    { 248, 120, 216,  88 }
+};
+
+void RasterOps::GrayRowToMono(const unsigned char* gray, int width, unsigned char* mono,
+                              int threshold, int ditherRow) {
+    int monoBytes = (width + 7) / 8;
+    memset(mono, 0, monoBytes);
+
+    if (ditherRow < 0) {
+        for (int x = 0; x < width; x++) {
+            if (gray[x] < threshold) {
+                mono[x >> 3] |= (unsigned char)(0x80 >> (x & 7));
+            }
+        }
+        return;
+    }
+
+    const unsigned char* bayerRow = kBayer4x4[ditherRow & 3];
+    for (int x = 0; x < width; x++) {
+        if (gray[x] < bayerRow[x & 3]) {
+            mono[x >> 3] |= (unsigned char)(0x80 >> (x & 7));
+        }
+    }
+}
+
+int RasterOps::MinWhiteLevel(int threshold, bool dither) {
+    if (!dither) {
+        return threshold;
+    }
+    // A pixel is printed when gray < bayer, so nothing at or above the largest
+    // matrix entry is ever printed
+    int level = 0;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            if (kBayer4x4[y][x] > level) {
+                level = kBayer4x4[y][x];
+            }
+        }
+    }
+    return level;
+}
+
+bool RasterOps::IsGrayRowBlank(const unsigned char* gray, int width, int minWhite) {
+    if (minWhite <= 0) {
+        return true;
+    }
+    if (minWhite > 255) {
+        return false;
+    }
+
+    int x = 0;
+#if defined(RASTER_OPS_SSE2)
+    // Unsigned compare: v >= t  <=>  max(v, t) == v
+    const __m128i level = _mm_set1_epi8((char)minWhite);
+    for (; x + 64 <= width; x += 64) {
+        __m128i m = _mm_min_epu8(
+            _mm_min_epu8(_mm_loadu_si128((const __m128i*)(gray + x)),
+                         _mm_loadu_si128((const __m128i*)(gray + x + 16))),
+            _mm_min_epu8(_mm_loadu_si128((const __m128i*)(gray + x + 32)),
+                         _mm_loadu_si128((const __m128i*)(gray + x + 48))));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(m, level), m)) != 0xFFFF) {
+            return false;
+        }
+    }
+    for (; x + 16 <= width; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(gray + x));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, level), v)) != 0xFFFF) {
+            return false;
+        }
+    }
+#elif defined(RASTER_OPS_NEON)
+    for (; x + 64 <= width; x += 64) {
+        uint8x16_t m = vminq_u8(vminq_u8(vld1q_u8(gray + x), vld1q_u8(gray + x + 16)),
+                                vminq_u8(vld1q_u8(gray + x + 32), vld1q_u8(gray + x + 48)));
+        if (vminvq_u8(m) < minWhite) {
+            return false;
+        }
+    }
+    for (; x + 16 <= width; x += 16) {
+        if (vminvq_u8(vld1q_u8(gray + x)) < minWhite) {
+            return false;
+        }
+    }
+#endif
+    for (; x < width; x++) {
+        if (gray[x] < minWhite) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef RASTER_OPS_H
+#define RASTER_OPS_H
+
+/**
+ * 栅格像素操作
+ * 为热敏/标签打印机输出提供灰度到单色的转换和空白行检测
+ */
+class RasterOps {
+public:
+    /**
+     * 将一行 8 位灰度像素转换为 1 位单色像素
+     * 输出按字节打包，最高位在左，1 表示打印（黑），末尾不足 8 位的部分补 0
+     * @param gray 灰度行数据（0 = 黑，255 = 白）
+     * @param width 像素数
+     * @param mono 输出缓冲区，至少 (width + 7) / 8 字节
+     * @param threshold 阈值，灰度小于该值视为黑
+     * @param ditherRow 有序抖动使用的行号（页面内绝对行号），小于 0 表示不抖动
+     */
+    static void GrayRowToMono(const unsigned char* gray, int width, unsigned char* mono,
+                              int threshold, int ditherRow);
+
+    /**
+     * 判断一行灰度像素转换为单色后是否全白（使用 SSE2 / NEON 加速）
+     * 在单色化之前检测，空白行无需再转换
+     * @param gray 灰度行数据
+     * @param width 像素数
+     * @param minWhite 不会被打印的最小灰度值（阈值模式为阈值，抖动模式为抖动矩阵最大值）
+     * @return 所有像素都不小于 minWhite 返回 true
+     */
+    static bool IsGrayRowBlank(const unsigned char* gray, int width, int minWhite);
+
+    /**
+     * 获取单色化后不会被打印的最小灰度值
+     * @param threshold 阈值
+     * @param dither 是否使用有序抖动
+     */
+    static int MinWhiteLevel(int threshold, bool dither);
+};
+
+#endif // RASTER_OPS_H
@@ -0,0 +1,463 @@
+#include "raster_pipeline.h"
+#include "connection_pool.h"
+#include "metrics.h"
+#include "raster_ops.h"
+#include "util.h"
+#ifdef _WIN32
+#include <windows.h>
+#include "printer_caps.h"
+#endif
+#include <chrono>
+#include <memory>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+RasterPageSource RasterPipeline::DocumentSource(PdfDocument* document) {
+    RasterPageSource source;
+    source.pageCount = PdfiumWrapper::GetPageCount(document);
+    source.getPageSize = [document](int pageIndex, float* width, float* height) {
+        return PdfiumWrapper::GetPageSize(document, pageIndex, width, height);
+    };
+    source.renderBands = [document](int pageIndex, int bandWidth, int pixelWidth, int pixelHeight, int bandHeight,
+                                    const BandCallback& onBand, const RenderControl* control, RenderStatus* status) {
+        return PdfiumWrapper::RenderPageBands(document, pageIndex, bandWidth, pixelWidth, pixelHeight, bandHeight,
+                                              onBand, control, status);
+    };
+    return source;
+}
+
+bool RasterPipeline::PrintDocument(PdfDocument* document, const RasterJobOptions& options, RasterSink& sink,
+                                   RasterJobStats* stats, std::string* error, const JobEventCallback& onEvent,
+                                   const RenderControl* control) {
+    return PrintPages(DocumentSource(document), options, sink, stats, error, onEvent, control);
+}
+
+bool RasterPipeline::PrintPages(const RasterPageSource& source, const RasterJobOptions& options, RasterSink& sink,
+                                RasterJobStats* stats, std::string* error, const JobEventCallback& onEvent,
+                                const RenderControl* control) {
+    Clock::time_point jobStart = Clock::now();
+    RasterJobStats local;
+
+    if (options.dpi <= 0 || options.bandHeight <= 0 || options.widthDots < 0 || options.heightDots < 0) {
+        return Fail(error, "Invalid raster job options");
+    }
+
+    std::unique_ptr<RasterEncoder> encoder(RasterEncoder::Create(options.language, options.cut, options.dpi, options.feedUnits));
+    if (!encoder) {
+        return Fail(error, "Unsupported printer language");
+    }
+
+    int pageCount = source.pageCount;
+    if (pageCount <= 0) {
+        return Fail(error, "PDF has no pages");
+    }
+
+    std::vector<unsigned char> out;
+    out.reserve(64 * 1024);
+    std::vector<unsigned char> mono;
+    std::vector<unsigned char> blankMono;
+    std::vector<unsigned char> rowBlank;
+    bool writeFailed = false;
+
+    // Hand the encoded bytes to the sink and reuse the buffer
+    auto flush = [&]() -> bool {
+        if (out.empty()) {
+            return true;
+        }
+        Clock::time_point t0 = Clock::now();
+        bool ok = sink.Write(out.data(), out.size());
+        Clock::time_point t1 = Clock::now();
+        double writeMs = ElapsedMs(t0, t1);
+        local.writeMs += writeMs;
+        local.bytesWritten += (long long)out.size();
+        Metrics::RecordMs(STAGE_WRITE, writeMs);
+        Tracing::Complete(Metrics::StageName(STAGE_WRITE), t0, t1, "bytes", (long long)out.size());
+        Metrics::Add(COUNTER_BYTES_WRITTEN, (long long)out.size());
+        out.clear();
+        return ok;
+    };
+
+    // Roll media is one continuous strip: every page uses the same width and
+    // is appended below the previous one
+    int rollWidth = 0;
+    if (options.roll) {
+        rollWidth = options.widthDots;
+        if (rollWidth == 0) {
+            float pageWidth = 0, pageHeight = 0;
+            if (!source.getPageSize(0, &pageWidth, &pageHeight)) {
+                return Fail(error, "Failed to get size of page 1");
+            }
+            rollWidth = (int)(pageWidth * options.dpi / 72.0);
+        }
+    }
+
+    int minWhite = RasterOps::MinWhiteLevel(options.threshold, options.dither);
+    bool detectBlank = options.skipBlank || options.skipBlankPages || (options.roll && options.trim);
+
+    int bandWidth = 0;
+    int monoStride = 0;
+    int outputTop = 0;
+    int labelHeight = 0;
+    bool pageOpen = false;
+    bool rollHasContent = false;
+    long long pendingBlank = 0;
+
+    auto emit = [&](const unsigned char* data, int rows) -> bool {
+        encoder->EncodeBand(out, data, monoStride, bandWidth, outputTop, rows);
+        outputTop += rows;
+        local.rows += rows;
+        return flush();
+    };
+
+    // Cut-sheet pages are opened lazily so that blank pages can be dropped
+    auto openPage = [&]() {
+        if (!options.roll && !pageOpen) {
+            encoder->BeginPage(out, bandWidth, labelHeight);
+            pageOpen = true;
+        }
+    };
+
+    // Send the blank rows held back so far: dropped at the start of a trimmed
+    // roll, as a media feed command when skipping, otherwise as white raster
+    auto flushBlank = [&]() -> bool {
+        long long rows = pendingBlank;
+        pendingBlank = 0;
+        if (rows == 0) {
+            return true;
+        }
+        if (options.roll && options.trim && !rollHasContent) {
+            local.trimmedRows += rows;
+            local.rowsElided += rows;
+            local.bytesElided += rows * monoStride;
+            return true;
+        }
+        openPage();
+        if (options.skipBlank) {
+            encoder->SkipRows(out, outputTop, (int)rows);
+            outputTop += (int)rows;
+            local.rowsElided += rows;
+            local.bytesElided += rows * monoStride;
+            return flush();
+        }
+        while (rows > 0) {
+            int count = rows < options.bandHeight ? (int)rows : options.bandHeight;
+            if (!emit(blankMono.data(), count)) {
+                return false;
+            }
+            rows -= count;
+        }
+        return true;
+    };
+
+    auto convert = [&](const unsigned char* gray, int stride, int top, int first, int rows) {
+        for (int y = 0; y < rows; y++) {
+            RasterOps::GrayRowToMono(gray + (size_t)(first + y) * stride, bandWidth,
+                                     &mono[(size_t)y * monoStride], options.threshold,
+                                     options.dither ? top + first + y : -1);
+        }
+    };
+
+    encoder->BeginJob(out);
+    if (options.roll) {
+        bandWidth = rollWidth;
+        monoStride = (bandWidth + 7) / 8;
+        encoder->BeginPage(out, bandWidth, 0);
+    }
+
+    for (int i = 0; i < pageCount; i++) {
+        TraceScope pageScope("page", "page", i);
+        if (control && control->IsCancelled()) {
+            return Fail(error, PdfiumWrapper::RenderStatusMessage(RENDER_CANCELLED, i));
+        }
+
+        float pageWidth = 0, pageHeight = 0;
+        if (!source.getPageSize(i, &pageWidth, &pageHeight)) {
+            return Fail(error, "Failed to get size of page " + std::to_string(i + 1));
+        }
+
+        // Points to dots at the printer's native resolution (72 points = 1 inch)
+        double scale = options.dpi / 72.0;
+        double fitX = options.roll ? rollWidth / (pageWidth * scale)
+                    : options.widthDots > 0 ? options.widthDots / (pageWidth * scale) : 1.0;
+        double fitY = !options.roll && options.heightDots > 0 ? options.heightDots / (pageHeight * scale) : 1.0;
+        double fit = fitX < fitY ? fitX : fitY;
+        if (fit < 1.0) {
+            // Shrink pages that do not fit on the media, never enlarge; roll
+            // media has no length limit so only the width is constrained
+            scale *= fit;
+        }
+
+        int pixelWidth = (int)(pageWidth * scale);
+        int pixelHeight = (int)(pageHeight * scale);
+        if (pixelWidth <= 0 || pixelHeight <= 0) {
+            return Fail(error, "Invalid size of page " + std::to_string(i + 1));
+        }
+
+        labelHeight = options.heightDots > 0 ? options.heightDots : pixelHeight;
+        if (!options.roll) {
+            bandWidth = options.widthDots > 0 ? options.widthDots : pixelWidth;
+            monoStride = (bandWidth + 7) / 8;
+            outputTop = 0;
+            pageOpen = false;
+            pendingBlank = 0;
+        }
+        mono.resize((size_t)monoStride * options.bandHeight);
+        blankMono.assign((size_t)monoStride * options.bandHeight, 0);
+        rowBlank.resize(options.bandHeight);
+
+        long long pendingAtPageStart = pendingBlank;
+        bool pageHasContent = false;
+        double renderAtPageStart = local.renderMs;
+        double outputAtPageStart = local.encodeMs + local.writeMs;
+        long long bytesAtPageStart = local.bytesWritten;
+
+        Clock::time_point mark = Clock::now();
+        RenderStatus renderStatus = RENDER_OK;
+        bool rendered = source.renderBands(i, bandWidth, pixelWidth, pixelHeight, options.bandHeight,
+            [&](const unsigned char* gray, int stride, int top, int rows) -> bool {
+                Clock::time_point renderEnd = Clock::now();
+                local.renderMs += ElapsedMs(mark, renderEnd);
+                double writeBefore = local.writeMs;
+                bool ok = true;
+
+                if (!detectBlank) {
+                    openPage();
+                    convert(gray, stride, top, 0, rows);
+                    ok = emit(mono.data(), rows);
+                } else {
+                    for (int y = 0; y < rows; y++) {
+                        rowBlank[y] = RasterOps::IsGrayRowBlank(gray + (size_t)y * stride, bandWidth, minWhite);
+                    }
+
+                    // Short blank gaps inside the band stay in the raster: a
+                    // separate command would cost more than the rows it saves
+                    const int minGap = 16;
+                    for (int y = 0; y < rows;) {
+                        int end = y;
+                        while (end < rows && rowBlank[end] == rowBlank[y]) {
+                            end++;
+                        }
+                        if (rowBlank[y] && y > 0 && end < rows && end - y < minGap) {
+                            for (int k = y; k < end; k++) {
+                                rowBlank[k] = 0;
+                            }
+                        }
+                        y = end;
+                    }
+
+                    for (int y = 0; y < rows && ok;) {
+                        int end = y;
+                        while (end < rows && rowBlank[end] == rowBlank[y]) {
+                            end++;
+                        }
+                        if (rowBlank[y]) {
+                            pendingBlank += end - y;
+                        } else {
+                            ok = flushBlank();
+                            if (ok) {
+                                openPage();
+                                convert(gray, stride, top, y, end - y);
+                                ok = emit(mono.data(), end - y);
+                            }
+                            pageHasContent = true;
+                            rollHasContent = true;
+                        }
+                        y = end;
+                    }
+                }
+
+                // Writes inside the band show up nested in its encode span
+                Clock::time_point encodeEnd = Clock::now();
+                double encodeMs = ElapsedMs(renderEnd, encodeEnd) - (local.writeMs - writeBefore);
+                local.encodeMs += encodeMs;
+                Metrics::RecordMs(STAGE_ENCODE, encodeMs);
+                Tracing::Complete(Metrics::StageName(STAGE_ENCODE), renderEnd, encodeEnd, "row", top);
+                if (!ok) {
+                    writeFailed = true;
+                    return false;
+                }
+                mark = Clock::now();
+                return true;
+            }, control, &renderStatus);
+
+        if (writeFailed) {
+            return Fail(error, sink.LastError());
+        }
+        if (!rendered) {
+            // Raster already sent for this page cannot be taken back, so a page
+            // over budget fails the job; the printer resolution is fixed
+            return Fail(error, PdfiumWrapper::RenderStatusMessage(renderStatus, i));
+        }
+
+        if (onEvent) {
+            JobEvent event;
+            event.type = JOB_EVENT_PAGE_RENDERED;
+            event.page = i;
+            event.durationMs = local.renderMs - renderAtPageStart;
+            onEvent(event);
+        }
+
+        if (detectBlank && !pageHasContent && options.skipBlankPages) {
+            // Drop the page entirely, including its blank rows
+            long long pageRows = pendingBlank - pendingAtPageStart;
+            pendingBlank = pendingAtPageStart;
+            local.pagesSkipped++;
+            local.rowsElided += pageRows;
+            local.bytesElided += pageRows * monoStride;
+            continue;
+        }
+
+        if (!options.roll) {
+            // Trailing blank rows keep the page length (a feed on ESC/POS,
+            // nothing on ZPL where ^LL already sets it)
+            if (!flushBlank()) {
+                return Fail(error, sink.LastError());
+            }
+            openPage();
+            encoder->EndPage(out, labelHeight);
+            if (!flush()) {
+                return Fail(error, sink.LastError());
+            }
+        }
+        local.pages++;
+        Metrics::Add(COUNTER_PAGES, 1);
+
+        // Bands are encoded and written while the page renders; report the
+        // page's share once it is complete
+        if (onEvent) {
+            JobEvent event;
+            event.type = JOB_EVENT_PAGE_SPOOLED;
+            event.page = i;
+            event.durationMs = local.encodeMs + local.writeMs - outputAtPageStart;
+            onEvent(event);
+
+            if (local.bytesWritten > bytesAtPageStart) {
+                JobEvent written;
+                written.type = JOB_EVENT_BYTES_WRITTEN;
+                written.page = i;
+                written.bytes = local.bytesWritten - bytesAtPageStart;
+                written.totalBytes = local.bytesWritten;
+                onEvent(written);
+            }
+        }
+    }
+
+    if (options.roll) {
+        if (options.trim) {
+            local.trimmedRows += pendingBlank;
+            local.rowsElided += pendingBlank;
+            local.bytesElided += pendingBlank * monoStride;
+            pendingBlank = 0;
+        } else if (!flushBlank()) {
+            return Fail(error, sink.LastError());
+        }
+        encoder->EndPage(out, outputTop);
+    }
+    encoder->EndJob(out);
+    if (!flush()) {
+        return Fail(error, sink.LastError());
+    }
+
+    local.totalMs = ElapsedMs(jobStart, Clock::now());
+    if (stats) {
+        *stats = local;
+    }
+    return true;
+}
+
+bool RasterPipeline::GetOutputKey(const RasterOutput& output, std::string* key, std::string* error) {
+    if (!output.file.empty()) {
+        *key = "file:" + output.file;
+        return true;
+    }
+    if (!output.host.empty()) {
+        *key = "tcp:" + output.host + ":" + std::to_string(output.port);
+        return true;
+    }
+#ifdef _WIN32
+    std::wstring resolvedName;
+    if (!PrinterCapsCache::ResolvePrinterName(Utf8ToWide(output.printer), &resolvedName, error)) {
+        return false;
+    }
+    *key = "raw:" + WideToUtf8(resolvedName);
+    return true;
+#else
+    return Fail(error, "Printer queues are only supported on Windows; set 'file' or 'host'");
+#endif
+}
+
+bool RasterPipeline::PrintToOutput(PdfDocument* document, const RasterJobOptions& options, const RasterOutput& output,
+                                   RasterJobStats* stats, std::string* error, const JobEventCallback& onEvent,
+                                   const RenderControl* control) {
+    return PrintToOutput(DocumentSource(document), options, output, stats, error, onEvent, control);
+}
+
+bool RasterPipeline::PrintToOutput(const RasterPageSource& source, const RasterJobOptions& options,
+                                   const RasterOutput& output, RasterJobStats* stats, std::string* error,
+                                   const JobEventCallback& onEvent, const RenderControl* control) {
+    std::string key;
+    if (!GetOutputKey(output, &key, error)) {
+        return false;
+    }
+
+    // Select the output sink: file, TCP socket (e.g. port 9100) or RAW spooler
+    // job; sockets and printer handles come from the connection pool
+    std::unique_ptr<RasterSink> ownedSink;
+    RasterSink* sink = nullptr;
+    PooledConnection* pooled = nullptr;
+    std::string message;
+    if (!output.file.empty()) {
+        FileSink* fileSink = new FileSink();
+        ownedSink.reset(fileSink);
+        if (fileSink->Open(output.file)) {
+            sink = fileSink;
+        } else {
+            message = fileSink->LastError();
+        }
+    } else if (!output.host.empty()) {
+        pooled = ConnectionPool::Acquire(key, [&](std::string* createError) -> PooledConnection* {
+            SocketConnection* connection = new SocketConnection();
+            if (!connection->sink.Open(output.host, output.port, output.timeoutMs)) {
+                *createError = connection->sink.LastError();
+                delete connection;
+                return nullptr;
+            }
+            return connection;
+        }, &message);
+        if (pooled) {
+            sink = &static_cast<SocketConnection*>(pooled)->sink;
+        }
+    } else {
+#ifdef _WIN32
+        // The key carries the resolved printer name after the "raw:" prefix
+        std::wstring resolvedName = Utf8ToWide(key.substr(4));
+        pooled = ConnectionPool::Acquire(key, [&](std::string* createError) -> PooledConnection* {
+            return PrinterConnection::Open(resolvedName, false, createError);
+        }, &message);
+        if (pooled) {
+            SpoolerSink* spoolerSink = new SpoolerSink();
+            ownedSink.reset(spoolerSink);
+            if (spoolerSink->Attach(static_cast<PrinterConnection*>(pooled)->printer, "PDF Raw Print Job")) {
+                sink = spoolerSink;
+            } else {
+                message = spoolerSink->LastError();
+            }
+        }
+#endif
+    }
+
+    bool success = sink && PrintPages(source, options, *sink, stats, &message, onEvent, control);
+
+    if (sink && ownedSink && !ownedSink->Close() && success) {
+        success = false;
+        message = ownedSink->LastError();
+    }
+    if (pooled) {
+        ConnectionPool::Release(key, pooled, success);
+    }
+    if (!success) {
+        return Fail(error, message);
+    }
+    return true;
+}
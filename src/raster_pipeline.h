@@ -0,0 +1,154 @@
+#ifndef RASTER_PIPELINE_H
+#define RASTER_PIPELINE_H
+
+#include <functional>
+#include <string>
+#include "job_events.h"
+#include "pdfium_win.h"
+#include "raster_sink.h"
+#include "thermal_encoder.h"
+
+/**
+ * 原始光栅打印选项
+ */
+struct RasterJobOptions {
+    RasterLanguage language = RASTER_ESCPOS;  // 打印机语言
+    int dpi = 203;           // 打印机原生分辨率（203 / 300）
+    int widthDots = 0;       // 打印头宽度（点），0 表示使用页面宽度
+    int heightDots = 0;      // 标签长度（点），0 表示使用页面高度
+    int bandHeight = 128;    // 每个条带的行数
+    int threshold = 128;     // 单色化阈值（0-255）
+    bool dither = false;     // 是否使用有序抖动（适合照片/徽标）
+    bool cut = true;         // 每页结束后是否切纸（ESC/POS）
+    bool roll = false;       // 连续卷纸模式：所有页面按原生宽度连续输出，不按页缩放、不分页
+    bool trim = false;       // 卷纸模式下去除开头和末尾空白
+    bool skipBlank = false;  // 空白区域使用走纸命令代替光栅数据
+    int feedUnits = 0;       // 打印机走纸命令（ESC J）每英寸的单位数，0 表示与 dpi 相同
+    bool skipBlankPages = false;  // 跳过完全空白的页面
+};
+
+/**
+ * 原始光栅输出目标
+ * 按 file、host、printer 的顺序选择第一个已设置的目标
+ */
+struct RasterOutput {
+    std::string file;        // 输出文件路径
+    std::string host;        // 打印机主机名或 IP 地址（TCP 原始端口）
+    int port = 9100;         // TCP 端口
+    int timeoutMs = 10000;   // TCP 发送超时（毫秒）
+    std::string printer;     // Windows 打印机名称（UTF-8），为空时使用默认打印机
+};
+
+/**
+ * 原始光栅打印统计
+ */
+struct RasterJobStats {
+    int pages = 0;               // 输出页数
+    long long rows = 0;          // 输出光栅行数
+    long long bytesWritten = 0;  // 写入输出端的字节数
+    long long trimmedRows = 0;   // 卷纸模式下去除的开头和末尾空白行数
+    long long rowsElided = 0;    // 未作为光栅数据发送的空白行数（跳过、去除或空白页）
+    long long bytesElided = 0;   // 因此节省的光栅数据字节数
+    int pagesSkipped = 0;        // 跳过的空白页数
+    double renderMs = 0;         // 渲染耗时
+    double encodeMs = 0;         // 单色化与编码耗时
+    double writeMs = 0;          // 写出耗时
+    double totalMs = 0;          // 总耗时
+};
+
+/**
+ * 光栅页面来源
+ * 通常来自已加载的文档（RasterPipeline::DocumentSource），也可以由模板套打等自行按条带渲染
+ */
+struct RasterPageSource {
+    int pageCount = 0;
+
+    /**
+     * 获取页面尺寸（点）
+     */
+    std::function<bool(int pageIndex, float* width, float* height)> getPageSize;
+
+    /**
+     * 按条带渲染页面，参数与 PdfiumWrapper::RenderPageBands 相同
+     */
+    std::function<bool(int pageIndex, int bandWidth, int pixelWidth, int pixelHeight, int bandHeight,
+                       const BandCallback& onBand, const RenderControl* control, RenderStatus* status)> renderBands;
+};
+
+/**
+ * 原始光栅打印管线
+ * 以打印机原生分辨率按条带渲染已加载的文档，转换为 1 位单色，
+ * 编码为打印机语言后直接写入输出端。
+ * 卷纸模式下整份文档作为一条可变长度的光栅流输出，内存占用只与条带大小有关
+ */
+class RasterPipeline {
+public:
+    /**
+     * 打印文档
+     * @param document 文档指针
+     * @param options 打印选项
+     * @param sink 输出端（调用方负责打开和关闭）
+     * @param stats 输出统计信息（可为 nullptr）
+     * @param error 失败时输出错误描述（可为 nullptr）
+     * @param onEvent 页面进度回调（可为空）
+     * @param control 渲染控制（可为 nullptr），用于取消和时间预算
+     * @return 成功返回 true
+     */
+    static bool PrintDocument(PdfDocument* document, const RasterJobOptions& options, RasterSink& sink,
+                              RasterJobStats* stats, std::string* error,
+                              const JobEventCallback& onEvent = JobEventCallback(),
+                              const RenderControl* control = nullptr);
+
+    /**
+     * 打印页面来源中的所有页面
+     * 参数与 PrintDocument 相同
+     */
+    static bool PrintPages(const RasterPageSource& source, const RasterJobOptions& options, RasterSink& sink,
+                           RasterJobStats* stats, std::string* error,
+                           const JobEventCallback& onEvent = JobEventCallback(),
+                           const RenderControl* control = nullptr);
+
+    /**
+     * 以已加载的文档作为页面来源
+     * @param document 文档指针，需在页面来源使用期间保持打开
+     */
+    static RasterPageSource DocumentSource(PdfDocument* document);
+
+    /**
+     * 打开输出目标并打印文档
+     * TCP 连接和打印机句柄从连接池获取，成功后归还以便复用
+     * @param document 文档指针
+     * @param options 打印选项
+     * @param output 输出目标
+     * @param stats 输出统计信息（可为 nullptr）
+     * @param error 失败时输出错误描述（可为 nullptr）
+     * @param onEvent 页面进度回调（可为空）
+     * @param control 渲染控制（可为 nullptr），用于取消和时间预算
+     * @return 成功返回 true
+     */
+    static bool PrintToOutput(PdfDocument* document, const RasterJobOptions& options, const RasterOutput& output,
+                              RasterJobStats* stats, std::string* error,
+                              const JobEventCallback& onEvent = JobEventCallback(),
+                              const RenderControl* control = nullptr);
+
+    /**
+     * 打开输出目标并打印页面来源中的所有页面
+     * 参数与 PrintToOutput(PdfDocument*, ...) 相同
+     */
+    static bool PrintToOutput(const RasterPageSource& source, const RasterJobOptions& options,
+                              const RasterOutput& output, RasterJobStats* stats, std::string* error,
+                              const JobEventCallback& onEvent = JobEventCallback(),
+                              const RenderControl* control = nullptr);
+
+    /**
+     * 获取输出目标的分组键（如 "tcp:主机:端口"、"raw:打印机名"），
+     * 与连接池使用的键相同，可用于按打印机限制并发
+     * @param output 输出目标
+     * @param key 输出分组键
+     * @param error 失败时输出错误描述（可为 nullptr）
+     * @return 成功返回 true
+     */
+    static bool GetOutputKey(const RasterOutput& output, std::string* key, std::string* error);
+};
+
+#endif // RASTER_PIPELINE_H
@@ -0,0 +1,329 @@
+#include "raster_sink.h"
+#include "util.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <winspool.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#include <string>
+
+#ifdef _WIN32
+static bool EnsureWinsock() {
+    static bool started = false;
+    if (!started) {
+        WSADATA wsaData;
+        started = WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+    }
+    return started;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// FileSink
+
+FileSink::~FileSink() {
+    Close();
+}
+
+bool FileSink::Open(const std::string& filePath) {
+    Close();
+#ifdef _WIN32
+    m_file = _wfopen(Utf8ToWide(filePath).c_str(), L"wb");
+#else
+    m_file = fopen(filePath.c_str(), "wb");
+#endif
+    if (!m_file) {
+        m_lastError = "Failed to open output file: " + filePath;
+        return false;
+    }
+    return true;
+}
+
+bool FileSink::Write(const unsigned char* data, size_t length) {
+    if (!m_file) {
+        m_lastError = "Output file is not open";
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+    if (fwrite(data, 1, length, m_file) != length) {
+        m_lastError = "Failed to write output file";
+        return false;
+    }
+    m_bytesWritten += length;
+    return true;
+}
+
+bool FileSink::Close() {
+    if (!m_file) {
+        return true;
+    }
+    bool ok = fclose(m_file) == 0;
+    m_file = nullptr;
+    if (!ok) {
+        m_lastError = "Failed to close output file";
+    }
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// SocketSink
+
+SocketSink::~SocketSink() {
+    Close();
+}
+
+bool SocketSink::Open(const std::string& host, int port, int timeoutMs) {
+    Close();
+#ifdef _WIN32
+    if (!EnsureWinsock()) {
+        m_lastError = "Failed to initialize Winsock";
+        return false;
+    }
+#endif
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    addrinfo* addresses = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0 || !addresses) {
+        m_lastError = "Failed to resolve printer host: " + host;
+        return false;
+    }
+
+    for (addrinfo* it = addresses; it; it = it->ai_next) {
+#ifdef _WIN32
+        SOCKET s = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+        if (s == INVALID_SOCKET) {
+            continue;
+        }
+        if (timeoutMs > 0) {
+            DWORD timeout = (DWORD)timeoutMs;
+            setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+        }
+        if (connect(s, it->ai_addr, (int)it->ai_addrlen) == 0) {
+            m_socket = (long long)s;
+            break;
+        }
+        closesocket(s);
+#else
+        int s = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+        if (s < 0) {
+            continue;
+        }
+        if (timeoutMs > 0) {
+            timeval timeout;
+            timeout.tv_sec = timeoutMs / 1000;
+            timeout.tv_usec = (timeoutMs % 1000) * 1000;
+            setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        }
+        if (connect(s, it->ai_addr, it->ai_addrlen) == 0) {
+            m_socket = s;
+            break;
+        }
+        close(s);
+#endif
+    }
+    freeaddrinfo(addresses);
+
+    if (m_socket == -1) {
+        m_lastError = "Failed to connect to printer " + host + ":" + service;
+        return false;
+    }
+    return true;
+}
+
+bool SocketSink::IsAlive() {
+    if (m_socket == -1) {
+        return false;
+    }
+
+    // Readable with nothing to read means the peer closed the connection;
+    // status bytes sent by the printer leave it usable. poll rather than
+    // select: a long-lived process easily has descriptors past FD_SETSIZE
+    char byte = 0;
+#ifdef _WIN32
+    WSAPOLLFD entry = {};
+    entry.fd = (SOCKET)m_socket;
+    entry.events = POLLRDNORM;
+    int ready = WSAPoll(&entry, 1, 0);
+    if (ready == SOCKET_ERROR) {
+        return false;
+    }
+    if (ready == 0) {
+        return true;
+    }
+    return recv((SOCKET)m_socket, &byte, 1, MSG_PEEK) > 0;
+#else
+    pollfd entry = {};
+    entry.fd = (int)m_socket;
+    entry.events = POLLIN;
+    int ready = poll(&entry, 1, 0);
+    if (ready < 0) {
+        return false;
+    }
+    if (ready == 0) {
+        return true;
+    }
+    return recv((int)m_socket, &byte, 1, MSG_PEEK | MSG_DONTWAIT) > 0;
+#endif
+}
+
+bool SocketSink::Write(const unsigned char* data, size_t length) {
+    if (m_socket == -1) {
+        m_lastError = "Printer connection is not open";
+        return false;
+    }
+    size_t offset = 0;
+    while (offset < length) {
+        size_t chunk = length - offset;
+        if (chunk > 1 << 20) {
+            chunk = 1 << 20;
+        }
+#ifdef _WIN32
+        int sent = send((SOCKET)m_socket, (const char*)data + offset, (int)chunk, 0);
+        if (sent == SOCKET_ERROR) {
+            m_lastError = "Failed to send to printer, error code: " + std::to_string(WSAGetLastError());
+            return false;
+        }
+#else
+        ssize_t sent = send((int)m_socket, data + offset, chunk, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            m_lastError = std::string("Failed to send to printer: ") + strerror(errno);
+            return false;
+        }
+#endif
+        offset += (size_t)sent;
+    }
+    m_bytesWritten += length;
+    return true;
+}
+
+bool SocketSink::Close() {
+    if (m_socket == -1) {
+        return true;
+    }
+#ifdef _WIN32
+    shutdown((SOCKET)m_socket, SD_SEND);
+    closesocket((SOCKET)m_socket);
+#else
+    shutdown((int)m_socket, SHUT_WR);
+    close((int)m_socket);
+#endif
+    m_socket = -1;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// SpoolerSink
+
+#ifdef _WIN32
+SpoolerSink::~SpoolerSink() {
+    Close();
+}
+
+bool SpoolerSink::Open(const std::string& printerName, const std::string& docName) {
+    Close();
+
+    std::wstring name = Utf8ToWide(printerName);
+    if (name.empty()) {
+        wchar_t defaultPrinterName[256] = {0};
+        DWORD nameLen = sizeof(defaultPrinterName) / sizeof(defaultPrinterName[0]);
+        if (!GetDefaultPrinterW(defaultPrinterName, &nameLen)) {
+            m_lastError = "Failed to get default printer, error code: " + std::to_string(GetLastError());
+            return false;
+        }
+        name = defaultPrinterName;
+    }
+
+    HANDLE hPrinter = nullptr;
+    PRINTER_DEFAULTSW printerDefaults = {0};
+    printerDefaults.DesiredAccess = PRINTER_ACCESS_USE;
+    if (!OpenPrinterW(&name[0], &hPrinter, &printerDefaults)) {
+        m_lastError = "Failed to open printer, error code: " + std::to_string(GetLastError());
+        return false;
+    }
+    m_printer = hPrinter;
+    m_ownsPrinter = true;
+    return StartRawDoc(docName);
+}
+
+bool SpoolerSink::Attach(void* printer, const std::string& docName) {
+    Close();
+    m_printer = printer;
+    m_ownsPrinter = false;
+    return StartRawDoc(docName);
+}
+
+bool SpoolerSink::StartRawDoc(const std::string& docName) {
+    HANDLE hPrinter = (HANDLE)m_printer;
+    std::wstring wdocName = Utf8ToWide(docName);
+    DOC_INFO_1W docInfo = {0};
+    docInfo.pDocName = &wdocName[0];
+    docInfo.pDatatype = const_cast<wchar_t*>(L"RAW");
+    if (StartDocPrinterW(hPrinter, 1, (LPBYTE)&docInfo) == 0) {
+        m_lastError = "Failed to start raw print job (StartDocPrinterW), error code: " + std::to_string(GetLastError());
+        Close();
+        return false;
+    }
+    m_docStarted = true;
+    StartPagePrinter(hPrinter);
+    return true;
+}
+
+bool SpoolerSink::Write(const unsigned char* data, size_t length) {
+    if (!m_docStarted) {
+        m_lastError = "Raw print job is not started";
+        return false;
+    }
+    size_t offset = 0;
+    while (offset < length) {
+        DWORD written = 0;
+        DWORD chunk = (DWORD)((length - offset) > (1u << 20) ? (1u << 20) : (length - offset));
+        if (!WritePrinter((HANDLE)m_printer, (LPVOID)(data + offset), chunk, &written) || written == 0) {
+            m_lastError = "Failed to write to printer (WritePrinter), error code: " + std::to_string(GetLastError());
+            return false;
+        }
+        offset += written;
+    }
+    m_bytesWritten += length;
+    return true;
+}
+
+bool SpoolerSink::Close() {
+    bool ok = true;
+    if (m_docStarted) {
+        EndPagePrinter((HANDLE)m_printer);
+        if (!EndDocPrinter((HANDLE)m_printer)) {
+            m_lastError = "Failed to end raw print job (EndDocPrinter), error code: " + std::to_string(GetLastError());
+            ok = false;
+        }
+        m_docStarted = false;
+    }
+    if (m_printer && m_ownsPrinter) {
+        ClosePrinter((HANDLE)m_printer);
+    }
+    m_printer = nullptr;
+    m_ownsPrinter = false;
+    return ok;
+}
+#endif
@@ -0,0 +1,135 @@
+#ifndef RASTER_SINK_H
+#define RASTER_SINK_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+/**
+ * 原始打印数据输出端
+ * 编码后的打印机语言字节流（ESC/POS、ZPL 等）通过它写出，
+ * 不经过 GDI 驱动
+ */
+class RasterSink {
+public:
+    virtual ~RasterSink() {}
+
+    /**
+     * 写出一段数据
+     * @param data 数据指针
+     * @param length 字节数
+     * @return 全部写出返回 true
+     */
+    virtual bool Write(const unsigned char* data, size_t length) = 0;
+
+    /**
+     * 结束输出并释放底层资源
+     * @return 成功返回 true
+     */
+    virtual bool Close() = 0;
+
+    /**
+     * 获取最近一次失败的描述
+     */
+    const std::string& LastError() const { return m_lastError; }
+
+    /**
+     * 获取已写出的字节数
+     */
+    size_t BytesWritten() const { return m_bytesWritten; }
+
+protected:
+    std::string m_lastError;
+    size_t m_bytesWritten = 0;
+};
+
+/**
+ * 文件输出端
+ * 用于调试、基准测试或由其他进程转发
+ */
+class FileSink : public RasterSink {
+public:
+    ~FileSink() override;
+
+    /**
+     * 打开（截断）输出文件
+     * @param filePath 文件路径（UTF-8 编码）
+     * @return 成功返回 true
+     */
+    bool Open(const std::string& filePath);
+
+    bool Write(const unsigned char* data, size_t length) override;
+    bool Close() override;
+
+private:
+    FILE* m_file = nullptr;
+};
+
+/**
+ * TCP 输出端
+ * 直接连接打印机的原始端口（通常为 9100）
+ */
+class SocketSink : public RasterSink {
+public:
+    ~SocketSink() override;
+
+    /**
+     * 连接打印机
+     * @param host 主机名或 IP 地址
+     * @param port 端口号
+     * @param timeoutMs 发送超时（毫秒），0 表示不设置
+     * @return 成功返回 true
+     */
+    bool Open(const std::string& host, int port, int timeoutMs);
+
+    /**
+     * 检查连接是否仍然可用（对端未关闭、没有错误），不阻塞
+     * @return 可用返回 true
+     */
+    bool IsAlive();
+
+    bool Write(const unsigned char* data, size_t length) override;
+    bool Close() override;
+
+private:
+    long long m_socket = -1;
+};
+
+#ifdef _WIN32
+/**
+ * Windows 打印队列输出端
+ * 以 RAW 数据类型提交给后台打印程序，绕过驱动渲染
+ */
+class SpoolerSink : public RasterSink {
+public:
+    ~SpoolerSink() override;
+
+    /**
+     * 打开打印机并开始 RAW 打印作业
+     * @param printerName 打印机名称（UTF-8 编码），为空时使用默认打印机
+     * @param docName 作业名称
+     * @return 成功返回 true
+     */
+    bool Open(const std::string& printerName, const std::string& docName);
+
+    /**
+     * 在已打开的打印机句柄上开始 RAW 打印作业（句柄由调用方管理，Close 时不关闭）
+     * @param printer 打印机句柄（HANDLE）
+     * @param docName 作业名称
+     * @return 成功返回 true
+     */
+    bool Attach(void* printer, const std::string& docName);
+
+    bool Write(const unsigned char* data, size_t length) override;
+    bool Close() override;
+
+private:
+    bool StartRawDoc(const std::string& docName);
+
+    void* m_printer = nullptr;
+    bool m_ownsPrinter = false;
+    bool m_docStarted = false;
+};
+#endif
+
+#endif // RASTER_SINK_H
@@ -0,0 +1,896 @@
+#include "render_pool.h"
+#include "metrics.h"
+#include "render_protocol.h"
+#include "util.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+extern char** environ;
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+typedef std::chrono::steady_clock Clock;
+
+// How often a wait for a worker checks for cancellation and job timeouts
+static const int kPollMs = 50;
+
+// A worker that overruns its page budget by this much has stopped answering
+// its own pause checks (stuck inside pdfium) and is killed
+static const int kHangGraceMs = 5000;
+
+// Upper bound on the page count a worker may report for a document, which
+// sizes the page-size table read after it
+static const int kMaxPageCount = 1 << 24;
+
+// Upper bound on an error message from a worker; the longest real one names
+// a file path
+static const uint32_t kMaxMessageBytes = 64 * 1024;
+
+struct RenderProcess {
+#ifdef _WIN32
+    HANDLE process = nullptr;
+    HANDLE input = nullptr;   // commands to the worker
+    HANDLE output = nullptr;  // replies from the worker
+#else
+    pid_t pid = -1;
+    int channel = -1;         // Unix socket, both directions
+#endif
+    unsigned char* memory = nullptr;
+    int slots = 0;
+    size_t slotBytes = 0;
+    bool alive = false;
+    bool busy = false;
+    bool retire = false;      // configuration changed; replace when released
+};
+
+static std::mutex g_renderPoolMutex;
+static std::condition_variable g_renderPoolReleased;
+static std::vector<RenderProcess*> g_renderProcesses;
+static RenderPoolConfig g_renderPoolConfig;
+static RenderPoolStats g_renderPoolStats;
+
+// ---------------------------------------------------------------------------
+// Platform layer: start and stop a worker, move bytes over its channel
+
+#ifdef _WIN32
+// Workers are killed with the job object when this process exits, even if it crashes
+static HANDLE WorkerJobObject() {
+    static HANDLE job = nullptr;
+    if (!job) {
+        job = CreateJobObjectW(nullptr, nullptr);
+        if (job) {
+            JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits = {};
+            limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+            SetInformationJobObject(job, JobObjectExtendedLimitInformation, &limits, sizeof(limits));
+        }
+    }
+    return job;
+}
+
+static bool SpawnProcess(RenderProcess* process, const RenderPoolConfig& config, std::string* error) {
+    size_t bytes = config.slotBytes * config.slots;
+    SECURITY_ATTRIBUTES inherit = { sizeof(inherit), nullptr, TRUE };
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, &inherit, PAGE_READWRITE,
+                                        (DWORD)((unsigned long long)bytes >> 32), (DWORD)(bytes & 0xFFFFFFFF),
+                                        nullptr);
+    if (!mapping) {
+        return Fail(error, "Failed to create shared memory for the renderer process");
+    }
+    void* memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+    if (!memory) {
+        CloseHandle(mapping);
+        return Fail(error, "Failed to map shared memory for the renderer process");
+    }
+
+    HANDLE childInput = nullptr;
+    HANDLE parentInput = nullptr;
+    HANDLE parentOutput = nullptr;
+    HANDLE childOutput = nullptr;
+    if (!CreatePipe(&childInput, &parentInput, &inherit, 0)) {
+        UnmapViewOfFile(memory);
+        CloseHandle(mapping);
+        return Fail(error, "Failed to create renderer pipe");
+    }
+    if (!CreatePipe(&parentOutput, &childOutput, &inherit, 0)) {
+        CloseHandle(childInput);
+        CloseHandle(parentInput);
+        UnmapViewOfFile(memory);
+        CloseHandle(mapping);
+        return Fail(error, "Failed to create renderer pipe");
+    }
+    SetHandleInformation(parentInput, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(parentOutput, HANDLE_FLAG_INHERIT, 0);
+
+    // Only the mapping and the worker's pipe ends are inherited
+    HANDLE inherited[] = { mapping, childInput, childOutput };
+    SIZE_T attributeBytes = 0;
+    InitializeProcThreadAttributeList(nullptr, 1, 0, &attributeBytes);
+    std::vector<unsigned char> attributeBuffer(attributeBytes);
+    LPPROC_THREAD_ATTRIBUTE_LIST attributes = (LPPROC_THREAD_ATTRIBUTE_LIST)attributeBuffer.data();
+    InitializeProcThreadAttributeList(attributes, 1, 0, &attributeBytes);
+    UpdateProcThreadAttribute(attributes, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, inherited, sizeof(inherited),
+                              nullptr, nullptr);
+
+    std::wstring path = Utf8ToWide(config.workerPath);
+    std::wstring commandLine = L"\"" + path + L"\"" +
+        L" --shm " + std::to_wstring((unsigned long long)(uintptr_t)mapping) +
+        L" --in " + std::to_wstring((unsigned long long)(uintptr_t)childInput) +
+        L" --out " + std::to_wstring((unsigned long long)(uintptr_t)childOutput) +
+        L" --slots " + std::to_wstring(config.slots) +
+        L" --slot-bytes " + std::to_wstring((unsigned long long)config.slotBytes);
+    STARTUPINFOEXW startup = {};
+    startup.StartupInfo.cb = sizeof(startup);
+    startup.lpAttributeList = attributes;
+    PROCESS_INFORMATION info = {};
+    BOOL created = CreateProcessW(path.c_str(), &commandLine[0], nullptr, nullptr, TRUE,
+                                  EXTENDED_STARTUPINFO_PRESENT | CREATE_NO_WINDOW, nullptr, nullptr,
+                                  &startup.StartupInfo, &info);
+    DeleteProcThreadAttributeList(attributes);
+    CloseHandle(childInput);
+    CloseHandle(childOutput);
+    CloseHandle(mapping);
+    if (!created) {
+        CloseHandle(parentInput);
+        CloseHandle(parentOutput);
+        UnmapViewOfFile(memory);
+        return Fail(error, "Failed to start renderer process: " + config.workerPath);
+    }
+    HANDLE job = WorkerJobObject();
+    if (job) {
+        AssignProcessToJobObject(job, info.hProcess);
+    }
+    CloseHandle(info.hThread);
+
+    process->process = info.hProcess;
+    process->input = parentInput;
+    process->output = parentOutput;
+    process->memory = (unsigned char*)memory;
+    return true;
+}
+
+static void StopProcess(RenderProcess* process, bool kill) {
+    if (kill && process->process) {
+        TerminateProcess(process->process, 1);
+    }
+    // Closing the command pipe makes an idle worker exit on its own
+    if (process->input) {
+        CloseHandle(process->input);
+    }
+    if (process->output) {
+        CloseHandle(process->output);
+    }
+    if (process->process) {
+        WaitForSingleObject(process->process, INFINITE);
+        CloseHandle(process->process);
+    }
+    if (process->memory) {
+        UnmapViewOfFile(process->memory);
+    }
+    process->process = nullptr;
+    process->input = nullptr;
+    process->output = nullptr;
+    process->memory = nullptr;
+}
+
+static bool WriteAll(RenderProcess* process, const void* data, size_t length) {
+    const char* bytes = (const char*)data;
+    while (length > 0) {
+        DWORD written = 0;
+        if (!WriteFile(process->input, bytes, (DWORD)std::min(length, (size_t)(1 << 20)), &written, nullptr) ||
+            written == 0) {
+            return false;
+        }
+        bytes += written;
+        length -= written;
+    }
+    return true;
+}
+
+static bool ReadAll(RenderProcess* process, void* data, size_t length) {
+    char* bytes = (char*)data;
+    while (length > 0) {
+        DWORD read = 0;
+        if (!ReadFile(process->output, bytes, (DWORD)std::min(length, (size_t)(1 << 20)), &read, nullptr) ||
+            read == 0) {
+            return false;
+        }
+        bytes += read;
+        length -= read;
+    }
+    return true;
+}
+
+// 1 when a reply is waiting, 0 on timeout, -1 when the worker is gone.
+// Anonymous pipes cannot be waited on, so this polls: yielding first to keep
+// band round trips short, then sleeping.
+static int WaitReadable(RenderProcess* process, int timeoutMs) {
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (int spins = 0;; spins++) {
+        DWORD available = 0;
+        if (!PeekNamedPipe(process->output, nullptr, 0, nullptr, &available, nullptr)) {
+            return -1;
+        }
+        if (available > 0) {
+            return 1;
+        }
+        if (Clock::now() >= deadline) {
+            return 0;
+        }
+        if (spins < 200) {
+            SwitchToThread();
+        } else {
+            Sleep(1);
+        }
+    }
+}
+#else
+// Move a descriptor above the ones the worker expects, so the dup2 calls
+// in the child cannot overwrite each other
+static int MoveHigh(int fd) {
+    int moved = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+    close(fd);
+    return moved;
+}
+
+static int CreateSharedMemory(size_t bytes) {
+#ifdef __linux__
+    int fd = memfd_create("pdfprint-render", MFD_CLOEXEC);
+#else
+    // Unlinked right away; the descriptors keep the object alive
+    std::string name = "/pdfprint-" + std::to_string(getpid()) + "-" +
+                       std::to_string(g_renderPoolStats.spawned);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        shm_unlink(name.c_str());
+    }
+#endif
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        close(fd);
+        return -1;
+    }
+    return MoveHigh(fd);
+}
+
+static bool SpawnProcess(RenderProcess* process, const RenderPoolConfig& config, std::string* error) {
+    size_t bytes = config.slotBytes * config.slots;
+    int memoryFd = CreateSharedMemory(bytes);
+    if (memoryFd < 0) {
+        return Fail(error, std::string("Failed to create shared memory: ") + strerror(errno));
+    }
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+    if (memory == MAP_FAILED) {
+        close(memoryFd);
+        return Fail(error, std::string("Failed to map shared memory: ") + strerror(errno));
+    }
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        munmap(memory, bytes);
+        close(memoryFd);
+        return Fail(error, std::string("Failed to create renderer socket: ") + strerror(errno));
+    }
+    int parentSocket = MoveHigh(sockets[0]);
+    int childSocket = MoveHigh(sockets[1]);
+
+    // The worker finds the shared memory on descriptor 3 and its socket on 4
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, memoryFd, 3);
+    posix_spawn_file_actions_adddup2(&actions, childSocket, 4);
+    std::string slots = std::to_string(config.slots);
+    std::string slotBytes = std::to_string(config.slotBytes);
+    const char* argv[] = {
+        config.workerPath.c_str(), "--shm", "3", "--in", "4", "--out", "4",
+        "--slots", slots.c_str(), "--slot-bytes", slotBytes.c_str(), nullptr
+    };
+    pid_t pid = -1;
+    int spawned = posix_spawn(&pid, config.workerPath.c_str(), &actions, nullptr, (char* const*)argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(memoryFd);
+    close(childSocket);
+    if (spawned != 0) {
+        close(parentSocket);
+        munmap(memory, bytes);
+        return Fail(error, "Failed to start renderer process " + config.workerPath + ": " + strerror(spawned));
+    }
+#ifdef SO_NOSIGPIPE
+    int noSigPipe = 1;
+    setsockopt(parentSocket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+    process->pid = pid;
+    process->channel = parentSocket;
+    process->memory = (unsigned char*)memory;
+    return true;
+}
+
+static void StopProcess(RenderProcess* process, bool kill) {
+    if (kill && process->pid > 0) {
+        ::kill(process->pid, SIGKILL);
+    }
+    // Closing the socket makes an idle worker exit on its own
+    if (process->channel >= 0) {
+        close(process->channel);
+    }
+    if (process->pid > 0) {
+        int status = 0;
+        while (waitpid(process->pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+    if (process->memory) {
+        munmap(process->memory, process->slotBytes * process->slots);
+    }
+    process->pid = -1;
+    process->channel = -1;
+    process->memory = nullptr;
+}
+
+static bool WriteAll(RenderProcess* process, const void* data, size_t length) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    const char* bytes = (const char*)data;
+    while (length > 0) {
+        ssize_t written = send(process->channel, bytes, length, flags);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+static bool ReadAll(RenderProcess* process, void* data, size_t length) {
+    char* bytes = (char*)data;
+    while (length > 0) {
+        ssize_t read = recv(process->channel, bytes, length, 0);
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            return false;
+        }
+        bytes += read;
+        length -= (size_t)read;
+    }
+    return true;
+}
+
+// 1 when a reply is waiting (or the worker hung up, which the read reports),
+// 0 on timeout, -1 on error
+static int WaitReadable(RenderProcess* process, int timeoutMs) {
+    pollfd target = { process->channel, POLLIN, 0 };
+    int ready = poll(&target, 1, timeoutMs);
+    if (ready < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    return ready > 0 ? 1 : 0;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Pool
+
+// Start (or restart) a worker with the given configuration
+static bool StartProcess(RenderProcess* process, const RenderPoolConfig& config, std::string* error) {
+    process->slots = config.slots;
+    process->slotBytes = config.slotBytes;
+    if (!SpawnProcess(process, config, error)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(g_renderPoolMutex);
+    process->alive = true;
+    process->retire = false;
+    g_renderPoolStats.spawned++;
+    return true;
+}
+
+static void CountProcesses() {
+    int alive = 0;
+    for (RenderProcess* process : g_renderProcesses) {
+        alive += process->alive ? 1 : 0;
+    }
+    g_renderPoolStats.processes = alive;
+}
+
+// The worker died or must be stopped: reap it now, restart on next use
+static void MarkDead(RenderProcess* process, bool kill) {
+    StopProcess(process, kill);
+    std::lock_guard<std::mutex> lock(g_renderPoolMutex);
+    process->alive = false;
+    if (kill) {
+        g_renderPoolStats.killed++;
+    } else {
+        g_renderPoolStats.crashes++;
+    }
+    CountProcesses();
+}
+
+bool RenderPool::Configure(const RenderPoolConfig& config, std::string* error) {
+    if (config.workerPath.empty()) {
+        return Fail(error, "Renderer process path must not be empty");
+    }
+    if (config.processes < 1 || config.processes > 64) {
+        return Fail(error, "Renderer process count must be between 1 and 64");
+    }
+    if (config.slots < 1 || config.slots > 64) {
+        return Fail(error, "Renderer slot count must be between 1 and 64");
+    }
+    if (config.slotBytes < 1024 * 1024) {
+        return Fail(error, "Renderer slots must be at least 1 MB");
+    }
+
+    // Idle workers are replaced now, busy ones when their session ends
+    std::vector<RenderProcess*> stopped;
+    std::vector<RenderProcess*> started;
+    {
+        std::lock_guard<std::mutex> lock(g_renderPoolMutex);
+        g_renderPoolConfig = config;
+        std::vector<RenderProcess*> kept;
+        for (RenderProcess* process : g_renderProcesses) {
+            if (process->busy) {
+                process->retire = true;
+                kept.push_back(process);
+            } else {
+                stopped.push_back(process);
+            }
+        }
+        for (int i = (int)kept.size(); i < config.processes; i++) {
+            RenderProcess* process = new RenderProcess();
+            process->busy = true;  // not handed out while starting
+            kept.push_back(process);
+            started.push_back(process);
+        }
+        g_renderProcesses.swap(kept);
+        CountProcesses();
+    }
+    for (RenderProcess* process : stopped) {
+        if (process->alive) {
+            StopProcess(process, false);
+        }
+        delete process;
+    }
+
+    // Pre-start the workers so the first jobs do not pay for process start
+    std::string startError;
+    bool ok = true;
+    for (RenderProcess* process : started) {
+        if (!StartProcess(process, config, ok ? &startError : nullptr)) {
+            ok = false;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_renderPoolMutex);
+        for (RenderProcess* process : started) {
+            process->busy = false;
+        }
+        CountProcesses();
+    }
+    g_renderPoolReleased.notify_all();
+    return ok || Fail(error, startError);
+}
+
+RenderPoolConfig RenderPool::GetConfig() {
+    std::lock_guard<std::mutex> lock(g_renderPoolMutex);
+    return g_renderPoolConfig;
+}
+
+bool RenderPool::IsConfigured() {
+    std::lock_guard<std::mutex> lock(g_renderPoolMutex);
+    return !g_renderPoolConfig.workerPath.empty();
+}
+
+RenderPoolStats RenderPool::GetStats() {
+    std::lock_guard<std::mutex> lock(g_renderPoolMutex);
+    RenderPoolStats stats = g_renderPoolStats;
+    stats.busy = 0;
+    for (RenderProcess* process : g_renderProcesses) {
+        stats.busy += process->busy ? 1 : 0;
+    }
+    return stats;
+}
+
+void RenderPool::Shutdown() {
+    std::vector<RenderProcess*> stopped;
+    {
+        std::lock_guard<std::mutex> lock(g_renderPoolMutex);
+        std::vector<RenderProcess*> kept;
+        for (RenderProcess* process : g_renderProcesses) {
+            if (process->busy) {
+                process->retire = true;
+                kept.push_back(process);
+            } else {
+                stopped.push_back(process);
+            }
+        }
+        g_renderProcesses.swap(kept);
+        CountProcesses();
+    }
+    for (RenderProcess* process : stopped) {
+        if (process->alive) {
+            StopProcess(process, false);
+        }
+        delete process;
+    }
+}
+
+RenderProcess* RenderPool::Acquire(const RenderControl* control, std::string* error) {
+    RenderProcess* process = nullptr;
+    RenderPoolConfig config;
+    {
+        std::unique_lock<std::mutex> lock(g_renderPoolMutex);
+        if (g_renderPoolConfig.workerPath.empty()) {
+            Fail(error, "Render pool is not configured");
+            return nullptr;
+        }
+        for (;;) {
+            // Workers stopped by Shutdown come back on demand
+            while ((int)g_renderProcesses.size() < g_renderPoolConfig.processes) {
+                g_renderProcesses.push_back(new RenderProcess());
+            }
+            for (RenderProcess* candidate : g_renderProcesses) {
+                if (!candidate->busy && !candidate->retire) {
+                    process = candidate;
+                    break;
+                }
+            }
+            if (process) {
+                break;
+            }
+            RenderStatus stop = control ? control->Check(Clock::now()) : RENDER_OK;
+            if (stop != RENDER_OK) {
+                Fail(error, PdfiumWrapper::RenderStatusMessage(stop, 0));
+                return nullptr;
+            }
+            g_renderPoolReleased.wait_for(lock, std::chrono::milliseconds(kPollMs));
+        }
+        process->busy = true;
+        config = g_renderPoolConfig;
+    }
+
+    // A worker that crashed earlier and could not be restarted then, or was
+    // stopped by Shutdown
+    if (!process->alive && !StartProcess(process, config, error)) {
+        Release(process);
+        return nullptr;
+    }
+    return process;
+}
+
+void RenderPool::Release(RenderProcess* process) {
+    bool remove = false;
+    RenderPoolConfig config;
+    {
+        std::lock_guard<std::mutex> lock(g_renderPoolMutex);
+        config = g_renderPoolConfig;
+        auto it = std::find(g_renderProcesses.begin(), g_renderProcesses.end(), process);
+        remove = process->retire || it == g_renderProcesses.end() ||
+                 it - g_renderProcesses.begin() >= (std::ptrdiff_t)config.processes;
+        if (remove && it != g_renderProcesses.end()) {
+            g_renderProcesses.erase(it);
+        }
+    }
+    if (remove) {
+        if (process->alive) {
+            StopProcess(process, false);
+        }
+        delete process;
+    } else if (!process->alive && !config.workerPath.empty()) {
+        // Replace a crashed or killed worker right away, so the next job
+        // does not wait for it; on failure the next Acquire tries again
+        StartProcess(process, config, nullptr);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_renderPoolMutex);
+        if (!remove) {
+            process->busy = false;
+        }
+        CountProcesses();
+    }
+    g_renderPoolReleased.notify_all();
+}
+
+// ---------------------------------------------------------------------------
+// Session
+
+static std::string CrashMessage(int pageIndex) {
+    if (pageIndex < 0) {
+        return "Renderer process exited unexpectedly";
+    }
+    return "Renderer process crashed on page " + std::to_string(pageIndex + 1);
+}
+
+static bool SendRequest(RenderProcess* process, const RenderRequest& request, const std::string& payload) {
+    return WriteAll(process, &request, sizeof(request)) &&
+           (payload.empty() || WriteAll(process, payload.data(), payload.size()));
+}
+
+// The worker is the untrusted side of the channel, so every field the parent
+// later indexes shared memory with is checked against the request it answers
+static bool ValidReply(const RenderProcess* process, const RenderRequest& request, const RenderReply& reply) {
+    if (reply.type == RENDER_REPLY_DONE && request.op == RENDER_OP_OPEN) {
+        return reply.value >= 0 && reply.value <= kMaxPageCount;
+    }
+    if (reply.type == RENDER_REPLY_DONE && request.op == RENDER_OP_BANDS) {
+        return true;
+    }
+    bool page = reply.type == RENDER_REPLY_DONE && request.op == RENDER_OP_PAGE;
+    bool band = reply.type == RENDER_REPLY_BAND && request.op == RENDER_OP_BANDS;
+    if (!page && !band) {
+        return false;
+    }
+    if (reply.slot < 0 || reply.slot >= process->slots || reply.width <= 0 || reply.height <= 0 ||
+        reply.stride <= 0 || (size_t)reply.stride * reply.height > process->slotBytes) {
+        return false;
+    }
+    if (page) {
+        return reply.slot == request.slot && (long long)reply.width * 4 <= reply.stride;
+    }
+    return reply.width == request.pixelWidth && reply.stride >= request.bandWidth && reply.top >= 0 &&
+           reply.height <= request.bandHeight && (long long)reply.top + reply.height <= request.pixelHeight;
+}
+
+// Wait for the worker's reply to a request. While it works, the job's control
+// is checked; a cancelled or timed-out job, or a worker stuck well past its
+// page budget, gets the worker killed (and later replaced).
+static bool ReadReply(RenderProcess* process, const RenderRequest& request, const RenderControl* control,
+                      int pageIndex, Clock::time_point pageStart, RenderReply* reply, std::string* message,
+                      RenderStatus* status) {
+    SetStatus(status, RENDER_FAILED);
+    unsigned int budgetMs = control ? control->PageBudget() : 0;
+    for (;;) {
+        int ready = WaitReadable(process, kPollMs);
+        if (ready > 0) {
+            break;
+        }
+        if (ready < 0) {
+            MarkDead(process, false);
+            *message = CrashMessage(pageIndex);
+            return false;
+        }
+        RenderStatus stop = control ? control->Check(Clock::now()) : RENDER_OK;
+        if (stop == RENDER_OK && budgetMs > 0 &&
+            Clock::now() - pageStart > std::chrono::milliseconds(budgetMs + kHangGraceMs)) {
+            stop = RENDER_PAGE_TIMEOUT;
+        }
+        if (stop != RENDER_OK) {
+            MarkDead(process, true);
+            SetStatus(status, stop);
+            *message = PdfiumWrapper::RenderStatusMessage(stop, std::max(0, pageIndex));
+            return false;
+        }
+    }
+
+    if (!ReadAll(process, reply, sizeof(*reply))) {
+        MarkDead(process, false);
+        *message = CrashMessage(pageIndex);
+        return false;
+    }
+    if (reply->type == RENDER_REPLY_ERROR) {
+        // The whole message has to be read, or the next reply would be parsed
+        // out of its tail; a length beyond any real message is a broken worker
+        if (reply->messageLength > kMaxMessageBytes) {
+            MarkDead(process, true);
+            *message = "Renderer process sent an invalid reply";
+            return false;
+        }
+        message->resize(reply->messageLength);
+        if (!message->empty() && !ReadAll(process, &(*message)[0], message->size())) {
+            MarkDead(process, false);
+            *message = CrashMessage(pageIndex);
+            return false;
+        }
+        SetStatus(status, (RenderStatus)reply->status);
+        return true;
+    }
+    if (!ValidReply(process, request, *reply)) {
+        MarkDead(process, true);
+        *message = "Renderer process sent an invalid reply";
+        return false;
+    }
+    SetStatus(status, RENDER_OK);
+    return true;
+}
+
+RenderSession::~RenderSession() {
+    if (m_process) {
+        if (m_process->alive) {
+            RenderRequest request;
+            request.op = RENDER_OP_CLOSE;
+            if (!SendRequest(m_process, request, std::string())) {
+                MarkDead(m_process, false);
+            }
+        }
+        RenderPool::Release(m_process);
+    }
+}
+
+std::unique_ptr<RenderSession> RenderSession::Open(const std::string& filePath, FormMode formMode,
+                                                   const RenderControl* control, std::string* error) {
+    RenderProcess* process = RenderPool::Acquire(control, error);
+    if (!process) {
+        return nullptr;
+    }
+    std::unique_ptr<RenderSession> session(new RenderSession());
+    session->m_process = process;
+
+    RenderRequest request;
+    request.op = RENDER_OP_OPEN;
+    request.formMode = formMode;
+    request.pathLength = (uint32_t)filePath.size();
+    if (!SendRequest(process, request, filePath)) {
+        MarkDead(process, false);
+        Fail(error, "Renderer process exited unexpectedly");
+        return nullptr;
+    }
+    RenderReply reply;
+    std::string message;
+    RenderStatus status = RENDER_FAILED;
+    if (!ReadReply(process, request, control, -1, Clock::now(), &reply, &message, &status)) {
+        Fail(error, message + " while loading " + filePath);
+        return nullptr;
+    }
+    if (reply.type != RENDER_REPLY_DONE) {
+        Fail(error, message.empty() ? "Failed to load PDF file: " + filePath : message);
+        return nullptr;
+    }
+    session->m_pageSizes.resize((size_t)std::max(0, reply.value) * 2);
+    if (!session->m_pageSizes.empty() &&
+        !ReadAll(process, session->m_pageSizes.data(), session->m_pageSizes.size() * sizeof(float))) {
+        MarkDead(process, false);
+        Fail(error, "Renderer process exited unexpectedly while loading " + filePath);
+        return nullptr;
+    }
+    for (float size : session->m_pageSizes) {
+        if (!std::isfinite(size) || size < 0) {
+            MarkDead(process, true);
+            Fail(error, "Renderer process sent an invalid reply while loading " + filePath);
+            return nullptr;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_renderPoolMutex);
+    g_renderPoolStats.sessions++;
+    return session;
+}
+
+bool RenderSession::GetPageSize(int pageIndex, float* width, float* height) const {
+    if (pageIndex < 0 || pageIndex >= PageCount()) {
+        return false;
+    }
+    *width = m_pageSizes[(size_t)pageIndex * 2];
+    *height = m_pageSizes[(size_t)pageIndex * 2 + 1];
+    return true;
+}
+
+BitmapData* RenderSession::RenderPage(int pageIndex, int dpi, int rotation, const RenderControl* control,
+                                      RenderStatus* status) {
+    SetStatus(status, RENDER_FAILED);
+    m_lastError.clear();
+    if (!m_process->alive) {
+        m_lastError = CrashMessage(pageIndex);
+        return nullptr;
+    }
+    RenderRequest request;
+    request.op = RENDER_OP_PAGE;
+    request.page = pageIndex;
+    request.dpi = dpi;
+    request.rotation = rotation;
+    request.slot = 0;
+    request.pageBudgetMs = control ? control->PageBudget() : 0;
+    if (!SendRequest(m_process, request, std::string())) {
+        MarkDead(m_process, false);
+        m_lastError = CrashMessage(pageIndex);
+        return nullptr;
+    }
+
+    RenderReply reply;
+    if (!ReadReply(m_process, request, control, pageIndex, Clock::now(), &reply, &m_lastError, status)) {
+        return nullptr;
+    }
+    if (reply.type != RENDER_REPLY_DONE) {
+        return nullptr;
+    }
+
+    // GDI printing keeps the bitmap beyond the next render, so it is copied
+    // out of the slot
+    size_t bytes = (size_t)reply.stride * reply.height;
+    BitmapData* bitmap = new (std::nothrow) BitmapData();
+    unsigned char* data = bitmap ? new (std::nothrow) unsigned char[bytes] : nullptr;
+    if (!data) {
+        delete bitmap;
+        SetStatus(status, RENDER_FAILED);
+        m_lastError = "Out of memory for page " + std::to_string(pageIndex + 1);
+        return nullptr;
+    }
+    Metrics::CountAllocation(bytes);
+    memcpy(data, m_process->memory + (size_t)reply.slot * m_process->slotBytes, bytes);
+    bitmap->data = data;
+    bitmap->width = reply.width;
+    bitmap->height = reply.height;
+    bitmap->stride = reply.stride;
+    bitmap->bitmapFormat = 0;
+    return bitmap;
+}
+
+bool RenderSession::RenderPageBands(int pageIndex, int bandWidth, int pixelWidth, int pixelHeight,
+                                    int bandHeight, const BandCallback& onBand, const RenderControl* control,
+                                    RenderStatus* status) {
+    SetStatus(status, RENDER_FAILED);
+    m_lastError.clear();
+    if (!m_process->alive) {
+        m_lastError = CrashMessage(pageIndex);
+        return false;
+    }
+    RenderRequest request;
+    request.op = RENDER_OP_BANDS;
+    request.page = pageIndex;
+    request.bandWidth = bandWidth;
+    request.pixelWidth = pixelWidth;
+    request.pixelHeight = pixelHeight;
+    request.bandHeight = bandHeight;
+    request.pageBudgetMs = control ? control->PageBudget() : 0;
+    if (!SendRequest(m_process, request, std::string())) {
+        MarkDead(m_process, false);
+        m_lastError = CrashMessage(pageIndex);
+        return false;
+    }
+
+    // Each band is handed to the callback straight from the slot and then
+    // acknowledged, which frees the slot for the worker. Once the callback
+    // declines, the bands the worker already sent are acknowledged unread.
+    Clock::time_point pageStart = Clock::now();
+    bool keepGoing = true;
+    for (;;) {
+        RenderReply reply;
+        if (!ReadReply(m_process, request, control, pageIndex, pageStart, &reply, &m_lastError, status)) {
+            return false;
+        }
+        if (reply.type == RENDER_REPLY_BAND) {
+            if (keepGoing) {
+                keepGoing = onBand(m_process->memory + (size_t)reply.slot * m_process->slotBytes, reply.stride,
+                                   reply.top, reply.height);
+            }
+            RenderAck ack;
+            ack.keepGoing = keepGoing ? 1 : 0;
+            if (!WriteAll(m_process, &ack, sizeof(ack))) {
+                MarkDead(m_process, false);
+                m_lastError = CrashMessage(pageIndex);
+                SetStatus(status, RENDER_FAILED);
+                return false;
+            }
+            continue;
+        }
+        if (reply.type == RENDER_REPLY_DONE && keepGoing) {
+            return true;
+        }
+        SetStatus(status, keepGoing ? (RenderStatus)reply.status : RENDER_FAILED);
+        return false;
+    }
+}
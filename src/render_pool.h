@@ -0,0 +1,141 @@
+#ifndef RENDER_POOL_H
+#define RENDER_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "pdfium_win.h"
+
+/**
+ * 渲染进程池配置
+ */
+struct RenderPoolConfig {
+    std::string workerPath;                    // 渲染进程可执行文件（pdfprint_render_worker）
+    int processes = 2;                         // 渲染进程数
+    int slots = 4;                             // 每个进程的共享内存槽数（条带环形缓冲区的深度）
+    size_t slotBytes = 64 * 1024 * 1024;       // 每个槽的大小，必须放得下一整页 BGRA 位图或一个条带
+};
+
+/**
+ * 渲染进程池统计
+ */
+struct RenderPoolStats {
+    int processes = 0;         // 当前运行的渲染进程数
+    int busy = 0;              // 正在被作业使用的进程数
+    long long spawned = 0;     // 累计启动次数（含重启）
+    long long crashes = 0;     // 渲染进程意外退出的次数
+    long long killed = 0;      // 因取消、超时或卡死被结束的次数
+    long long sessions = 0;    // 累计打开的文档数
+};
+
+struct RenderProcess;
+
+/**
+ * 在渲染进程中打开的文档
+ * 打开时从进程池取一个空闲进程，整个会话期间独占；渲染进程崩溃只会让本会话失败，
+ * 进程池随即启动新的进程替换它。不能跨线程同时使用
+ */
+class RenderSession {
+public:
+    ~RenderSession();
+
+    /**
+     * 在空闲的渲染进程中打开文档，没有空闲进程时等待
+     * @param filePath PDF 文件路径（UTF-8 编码）
+     * @param formMode 表单域处理方式
+     * @param control 渲染控制（可为 nullptr），等待和加载期间检查取消和作业超时
+     * @param error 失败时输出错误描述
+     * @return 会话，失败返回空指针
+     */
+    static std::unique_ptr<RenderSession> Open(const std::string& filePath, FormMode formMode,
+                                               const RenderControl* control, std::string* error);
+
+    /**
+     * 获取页数
+     */
+    int PageCount() const { return (int)m_pageSizes.size() / 2; }
+
+    /**
+     * 获取页面尺寸（点）
+     * @return 页面索引有效返回 true
+     */
+    bool GetPageSize(int pageIndex, float* width, float* height) const;
+
+    /**
+     * 渲染整页 BGRA 位图，从共享内存复制到调用方持有的位图
+     * 参数与 PdfiumWrapper::RenderPageToBitmap 相同
+     * @return 位图数据指针，失败返回 nullptr。使用完后需调用 PdfiumWrapper::FreeBitmap 释放
+     */
+    BitmapData* RenderPage(int pageIndex, int dpi, int rotation, const RenderControl* control,
+                           RenderStatus* status);
+
+    /**
+     * 按条带渲染 8 位灰度，回调直接读取共享内存中的条带，不复制像素。
+     * 渲染进程在回调处理当前条带时继续渲染后面的条带，最多领先环形缓冲区的槽数
+     * 参数与 PdfiumWrapper::RenderPageBands 相同
+     */
+    bool RenderPageBands(int pageIndex, int bandWidth, int pixelWidth, int pixelHeight, int bandHeight,
+                         const BandCallback& onBand, const RenderControl* control, RenderStatus* status);
+
+    /**
+     * 最近一次渲染失败的错误描述（渲染进程崩溃、共享内存槽放不下等），
+     * 最近一次渲染成功或因回调停止时为空
+     */
+    const std::string& LastError() const { return m_lastError; }
+
+private:
+    RenderSession() {}
+    RenderSession(const RenderSession&);
+    RenderSession& operator=(const RenderSession&);
+
+    RenderProcess* m_process = nullptr;
+    std::vector<float> m_pageSizes;  // 每页宽、高
+    std::string m_lastError;
+};
+
+/**
+ * 渲染进程池
+ * 预先启动若干渲染进程，每个进程有自己的共享内存环形缓冲区（Linux 上为 memfd，
+ * 其他 POSIX 系统为 shm_open，Windows 上为页面文件支持的文件映射），
+ * 主进程映射同一块内存读取像素。畸形文件导致的崩溃只影响渲染进程，
+ * 同时多个作业可以真正并行渲染，不受进程内 pdfium 全局锁的限制。线程安全
+ */
+class RenderPool {
+public:
+    /**
+     * 修改配置，立即生效：已启动的空闲进程按新配置重启，使用中的进程在会话结束后重启
+     * @param config 配置
+     * @param error 失败时输出错误描述
+     * @return 配置有效返回 true
+     */
+    static bool Configure(const RenderPoolConfig& config, std::string* error);
+
+    /**
+     * 获取当前配置
+     */
+    static RenderPoolConfig GetConfig();
+
+    /**
+     * 是否已配置渲染进程可执行文件
+     */
+    static bool IsConfigured();
+
+    /**
+     * 获取统计信息
+     */
+    static RenderPoolStats GetStats();
+
+    /**
+     * 结束所有空闲的渲染进程，使用中的进程在会话结束时结束
+     */
+    static void Shutdown();
+
+private:
+    friend class RenderSession;
+
+    static RenderProcess* Acquire(const RenderControl* control, std::string* error);
+    static void Release(RenderProcess* process);
+};
+
+#endif // RENDER_POOL_H
@@ -0,0 +1,71 @@
+#ifndef RENDER_PROTOCOL_H
+#define RENDER_PROTOCOL_H
+
+#include <cstdint>
+
+/**
+ * 渲染进程与主进程之间的消息
+ * 命令和应答通过管道（Windows）或 Unix 套接字传递，像素写入双方共同映射的共享内存，
+ * 共享内存按 slots 个大小相同的槽划分成环形缓冲区，不在进程之间复制像素
+ */
+
+/**
+ * 命令类型
+ */
+enum RenderOp {
+    RENDER_OP_OPEN = 1,    // 打开文档，请求后紧跟 pathLength 字节的 UTF-8 路径
+    RENDER_OP_PAGE = 2,    // 渲染整页 BGRA 位图到 slot 指定的槽
+    RENDER_OP_BANDS = 3,   // 按条带渲染 8 位灰度，条带依次写入环形缓冲区
+    RENDER_OP_CLOSE = 4    // 关闭文档
+};
+
+/**
+ * 应答类型
+ */
+enum RenderReplyType {
+    RENDER_REPLY_DONE = 1,   // 命令完成（OPEN 之后紧跟 value 页的尺寸，每页两个 float）
+    RENDER_REPLY_BAND = 2,   // 一个条带已写入 slot 指定的槽，主进程处理后回复 RenderAck
+    RENDER_REPLY_ERROR = 3   // 失败，status 为 RenderStatus，紧跟 messageLength 字节的错误描述
+};
+
+/**
+ * 命令
+ */
+struct RenderRequest {
+    int32_t op = 0;
+    int32_t page = 0;           // 页面索引
+    int32_t dpi = 0;            // RENDER_OP_PAGE：分辨率
+    int32_t rotation = 0;       // RENDER_OP_PAGE：顺时针旋转的 90° 次数
+    int32_t slot = 0;           // RENDER_OP_PAGE：写入的槽
+    int32_t bandWidth = 0;      // RENDER_OP_BANDS：参数与 PdfiumWrapper::RenderPageBands 相同
+    int32_t pixelWidth = 0;
+    int32_t pixelHeight = 0;
+    int32_t bandHeight = 0;
+    uint32_t pageBudgetMs = 0;  // 单页渲染时间预算，0 表示不限
+    int32_t formMode = 0;       // RENDER_OP_OPEN：FormMode
+    uint32_t pathLength = 0;    // RENDER_OP_OPEN：路径长度
+};
+
+/**
+ * 应答
+ */
+struct RenderReply {
+    int32_t type = 0;
+    int32_t status = 0;          // RenderStatus
+    int32_t slot = 0;            // 像素所在的槽
+    int32_t width = 0;
+    int32_t height = 0;          // 整页高度或条带行数
+    int32_t stride = 0;
+    int32_t top = 0;             // 条带在页面中的起始行
+    int32_t value = 0;           // OPEN：页数
+    uint32_t messageLength = 0;
+};
+
+/**
+ * 主进程对条带应答的确认，之后该槽可以重用
+ */
+struct RenderAck {
+    int32_t keepGoing = 1;  // 0 表示停止渲染这一页
+};
+
+#endif // RENDER_PROTOCOL_H
@@ -0,0 +1,311 @@
+// Renderer process for the render pool (see render_pool.h)
+//
+// Opens one document at a time and renders pages into the shared memory the
+// parent process passed in, so a malformed file that crashes pdfium only takes
+// this process down. Commands and replies follow render_protocol.h.
+//
+// Usage: pdfprint_render_worker --shm <handle> --in <handle> --out <handle>
+//                               --slots <count> --slot-bytes <bytes>
+
+#include "pdfium_win.h"
+#include "render_protocol.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#ifdef __linux__
+#include <signal.h>
+#include <sys/prctl.h>
+#endif
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+typedef HANDLE Channel;
+#else
+typedef int Channel;
+#endif
+
+static Channel g_input;
+static Channel g_output;
+static unsigned char* g_memory = nullptr;
+static int g_slots = 0;
+static size_t g_slotBytes = 0;
+
+static bool ReadAll(void* data, size_t length) {
+    char* bytes = (char*)data;
+    while (length > 0) {
+#ifdef _WIN32
+        DWORD read = 0;
+        if (!ReadFile(g_input, bytes, (DWORD)std::min(length, (size_t)(1 << 20)), &read, nullptr) || read == 0) {
+            return false;
+        }
+#else
+        ssize_t read = ::read(g_input, bytes, length);
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            return false;
+        }
+#endif
+        bytes += read;
+        length -= (size_t)read;
+    }
+    return true;
+}
+
+static bool WriteAll(const void* data, size_t length) {
+    const char* bytes = (const char*)data;
+    while (length > 0) {
+#ifdef _WIN32
+        DWORD written = 0;
+        if (!WriteFile(g_output, bytes, (DWORD)std::min(length, (size_t)(1 << 20)), &written, nullptr) ||
+            written == 0) {
+            return false;
+        }
+#else
+        ssize_t written = ::write(g_output, bytes, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+#endif
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+static bool SendError(RenderStatus status, const std::string& message) {
+    RenderReply reply;
+    reply.type = RENDER_REPLY_ERROR;
+    reply.status = status;
+    reply.messageLength = (uint32_t)message.size();
+    return WriteAll(&reply, sizeof(reply)) && WriteAll(message.data(), message.size());
+}
+
+static bool SendDone() {
+    RenderReply reply;
+    reply.type = RENDER_REPLY_DONE;
+    return WriteAll(&reply, sizeof(reply));
+}
+
+static std::string SlotTooSmall(int pageIndex, size_t bytes) {
+    return "Page " + std::to_string(pageIndex + 1) + " needs " + std::to_string(bytes / (1024 * 1024) + 1) +
+           " MB, more than a renderer slot holds (" + std::to_string(g_slotBytes / (1024 * 1024)) + " MB)";
+}
+
+static bool Open(const RenderRequest& request, PdfDocument** document) {
+    std::string path(request.pathLength, '\0');
+    if (!path.empty() && !ReadAll(&path[0], path.size())) {
+        return false;
+    }
+    PdfiumWrapper::CloseDocument(*document);
+    *document = PdfiumWrapper::OpenDocument(path);
+    if (!*document) {
+        return SendError(RENDER_FAILED, "Failed to load PDF file: " + path);
+    }
+    PdfiumWrapper::SetFormMode(*document, (FormMode)request.formMode);
+
+    int pageCount = PdfiumWrapper::GetPageCount(*document);
+    std::vector<float> sizes((size_t)pageCount * 2);
+    for (int i = 0; i < pageCount; i++) {
+        PdfiumWrapper::GetPageSize(*document, i, &sizes[(size_t)i * 2], &sizes[(size_t)i * 2 + 1]);
+    }
+    RenderReply reply;
+    reply.type = RENDER_REPLY_DONE;
+    reply.value = pageCount;
+    return WriteAll(&reply, sizeof(reply)) && WriteAll(sizes.data(), sizes.size() * sizeof(float));
+}
+
+static bool RenderPage(const RenderRequest& request, PdfDocument* document) {
+    RenderControl control;
+    control.SetPageBudget(request.pageBudgetMs);
+    RenderStatus status = RENDER_FAILED;
+    BitmapData* bitmap = document ? PdfiumWrapper::RenderPageToBitmap(document, request.page, request.dpi,
+                                                                      &control, &status, request.rotation)
+                                  : nullptr;
+    if (!bitmap) {
+        return SendError(status, PdfiumWrapper::RenderStatusMessage(status, request.page));
+    }
+    size_t bytes = (size_t)bitmap->stride * bitmap->height;
+    if (bytes > g_slotBytes || request.slot < 0 || request.slot >= g_slots) {
+        PdfiumWrapper::FreeBitmap(bitmap);
+        return SendError(RENDER_FAILED, SlotTooSmall(request.page, bytes));
+    }
+    memcpy(g_memory + (size_t)request.slot * g_slotBytes, bitmap->data, bytes);
+
+    RenderReply reply;
+    reply.type = RENDER_REPLY_DONE;
+    reply.slot = request.slot;
+    reply.width = bitmap->width;
+    reply.height = bitmap->height;
+    reply.stride = bitmap->stride;
+    PdfiumWrapper::FreeBitmap(bitmap);
+    return WriteAll(&reply, sizeof(reply));
+}
+
+// Bands go round the slots; with every slot waiting for the parent, the next
+// band first waits for the oldest one to be acknowledged
+static bool RenderBands(const RenderRequest& request, PdfDocument* document) {
+    int sent = 0;
+    int acked = 0;
+    bool keepGoing = true;
+    bool channelOk = true;
+    bool tooLarge = false;
+    auto readAck = [&]() {
+        RenderAck ack;
+        if (!ReadAll(&ack, sizeof(ack))) {
+            channelOk = false;
+            return;
+        }
+        acked++;
+        keepGoing = keepGoing && ack.keepGoing != 0;
+    };
+
+    BandCallback onBand = [&](const unsigned char* gray, int stride, int top, int rows) {
+        if ((size_t)stride * rows > g_slotBytes) {
+            tooLarge = true;
+            return false;
+        }
+        if (sent - acked >= g_slots) {
+            readAck();
+        }
+        if (!channelOk || !keepGoing) {
+            return false;
+        }
+        int slot = sent % g_slots;
+        memcpy(g_memory + (size_t)slot * g_slotBytes, gray, (size_t)stride * rows);
+        RenderReply reply;
+        reply.type = RENDER_REPLY_BAND;
+        reply.slot = slot;
+        reply.width = request.pixelWidth;
+        reply.height = rows;
+        reply.stride = stride;
+        reply.top = top;
+        if (!WriteAll(&reply, sizeof(reply))) {
+            channelOk = false;
+            return false;
+        }
+        sent++;
+        return true;
+    };
+
+    RenderControl control;
+    control.SetPageBudget(request.pageBudgetMs);
+    RenderStatus status = RENDER_FAILED;
+    bool ok = document && PdfiumWrapper::RenderPageBands(document, request.page, request.bandWidth,
+                                                         request.pixelWidth, request.pixelHeight,
+                                                         request.bandHeight, onBand, &control, &status);
+    // Every band sent gets exactly one acknowledgement
+    while (channelOk && acked < sent) {
+        readAck();
+    }
+    if (!channelOk) {
+        return false;
+    }
+    if (ok) {
+        return SendDone();
+    }
+    if (tooLarge) {
+        return SendError(RENDER_FAILED, SlotTooSmall(request.page, (size_t)request.bandWidth * request.bandHeight));
+    }
+    return SendError(status, PdfiumWrapper::RenderStatusMessage(status, request.page));
+}
+
+static bool MapMemory(const char* handle) {
+    size_t bytes = g_slotBytes * g_slots;
+#ifdef _WIN32
+    HANDLE mapping = (HANDLE)(uintptr_t)strtoull(handle, nullptr, 10);
+    g_memory = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+    CloseHandle(mapping);
+    return g_memory != nullptr;
+#else
+    int fd = atoi(handle);
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    g_memory = memory == MAP_FAILED ? nullptr : (unsigned char*)memory;
+    return g_memory != nullptr;
+#endif
+}
+
+static Channel ParseChannel(const char* handle) {
+#ifdef _WIN32
+    return (HANDLE)(uintptr_t)strtoull(handle, nullptr, 10);
+#else
+    return atoi(handle);
+#endif
+}
+
+int main(int argc, char** argv) {
+#ifdef __linux__
+    // Do not outlive the parent while stuck in a long render
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+    const char* memoryHandle = nullptr;
+    const char* inputHandle = nullptr;
+    const char* outputHandle = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        if (name == "--shm") {
+            memoryHandle = argv[i + 1];
+        } else if (name == "--in") {
+            inputHandle = argv[i + 1];
+        } else if (name == "--out") {
+            outputHandle = argv[i + 1];
+        } else if (name == "--slots") {
+            g_slots = atoi(argv[i + 1]);
+        } else if (name == "--slot-bytes") {
+            g_slotBytes = (size_t)strtoull(argv[i + 1], nullptr, 10);
+        }
+    }
+    if (!memoryHandle || !inputHandle || !outputHandle || g_slots <= 0 || g_slotBytes == 0) {
+        fprintf(stderr, "pdfprint_render_worker is started by the pdfprint render pool\n");
+        return 2;
+    }
+    g_input = ParseChannel(inputHandle);
+    g_output = ParseChannel(outputHandle);
+    if (!MapMemory(memoryHandle) || !PdfiumWrapper::AcquireLibrary()) {
+        return 1;
+    }
+
+    // Runs until the parent closes the channel
+    PdfDocument* document = nullptr;
+    bool ok = true;
+    RenderRequest request;
+    while (ok && ReadAll(&request, sizeof(request))) {
+        switch (request.op) {
+        case RENDER_OP_OPEN:
+            ok = Open(request, &document);
+            break;
+        case RENDER_OP_PAGE:
+            ok = RenderPage(request, document);
+            break;
+        case RENDER_OP_BANDS:
+            ok = RenderBands(request, document);
+            break;
+        case RENDER_OP_CLOSE:
+            PdfiumWrapper::CloseDocument(document);
+            document = nullptr;
+            break;
+        default:
+            ok = false;
+            break;
+        }
+    }
+    PdfiumWrapper::CloseDocument(document);
+    PdfiumWrapper::ReleaseLibrary();
+    return 0;
+}
@@ -0,0 +1,419 @@
+#include "template_merge.h"
+#include "metrics.h"
+#include "util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <new>
+
+typedef std::chrono::steady_clock Clock;
+
+// Static layers are kept while the template's cache stays below this; larger
+// layers are still composited, just rendered again for every use
+static const size_t kMaxCacheBytes = 256 * 1024 * 1024;
+
+// The fonts FPDFText_LoadStandardFont accepts
+static const char* const kStandardFonts[] = {
+    "Courier", "Courier-Bold", "Courier-BoldOblique", "Courier-Oblique",
+    "Helvetica", "Helvetica-Bold", "Helvetica-BoldOblique", "Helvetica-Oblique",
+    "Times-Roman", "Times-Bold", "Times-BoldItalic", "Times-Italic",
+    "Symbol", "ZapfDingbats"
+};
+
+// A template page rendered without any record fields
+struct MergeLayer {
+    std::vector<unsigned char> pixels;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+};
+
+static std::mutex g_templatesMutex;
+static std::map<long long, std::shared_ptr<MergeTemplate>> g_templates;
+static long long g_nextTemplateId = 1;
+
+// Draw the record's barcodes for one page straight into the output pixels.
+// Positions and module sizes are rounded to whole device pixels, so every
+// module of a symbol has the same width.
+static void DrawBarcodes(const MergeRecord& record, int pageIndex, double scale, const BarcodeTarget& target) {
+    for (const MergeField& field : record.fields) {
+        if (field.type != MERGE_BARCODE || field.page != pageIndex) {
+            continue;
+        }
+        int modulePixels = std::max(1, (int)std::lround(field.moduleSize * scale));
+        Barcode::Draw(field.barcode, (int)std::lround(field.x * scale), (int)std::lround(field.y * scale),
+                      modulePixels, (int)std::lround(field.height * scale), target);
+    }
+}
+
+static bool IsStandardFont(const std::string& font) {
+    for (const char* name : kStandardFonts) {
+        if (font == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+MergeTemplate::~MergeTemplate() {
+    for (auto& entry : m_idleOverlays) {
+        for (PdfOverlay* overlay : entry.second) {
+            PdfiumWrapper::CloseOverlay(overlay);
+        }
+    }
+    PdfiumWrapper::CloseDocument(m_document);
+    PdfiumWrapper::ReleaseLibrary();
+}
+
+std::shared_ptr<MergeTemplate> MergeTemplate::Open(const std::string& filePath, std::string* error) {
+    if (!PdfiumWrapper::AcquireLibrary()) {
+        Fail(error, "Failed to initialize pdfium");
+        return nullptr;
+    }
+    // From here on the destructor releases the library
+    std::shared_ptr<MergeTemplate> result(new MergeTemplate());
+    result->m_document = PdfiumWrapper::OpenDocument(filePath);
+    if (!result->m_document) {
+        Fail(error, "Failed to load PDF file: " + filePath);
+        return nullptr;
+    }
+    result->m_pageCount = PdfiumWrapper::GetPageCount(result->m_document);
+    if (result->m_pageCount <= 0) {
+        Fail(error, "PDF has no pages");
+        return nullptr;
+    }
+    return result;
+}
+
+bool MergeTemplate::GetPageSize(int pageIndex, float* width, float* height) const {
+    return PdfiumWrapper::GetPageSize(m_document, pageIndex, width, height);
+}
+
+bool MergeTemplate::ValidateRecord(const MergeRecord& record, std::string* error) const {
+    for (size_t i = 0; i < record.fields.size(); i++) {
+        const MergeField& field = record.fields[i];
+        std::string name = "Field " + std::to_string(i);
+        if (field.page < 0 || field.page >= m_pageCount) {
+            return Fail(error, name + ": page " + std::to_string(field.page) + " is not in the template");
+        }
+        if (field.type == MERGE_TEXT) {
+            if (!IsStandardFont(field.font)) {
+                return Fail(error, name + ": '" + field.font + "' is not a standard PDF font");
+            }
+            if (field.fontSize <= 0) {
+                return Fail(error, name + ": font size must be positive");
+            }
+        } else if (field.type == MERGE_BARCODE) {
+            if (field.barcode.modules.empty() || field.moduleSize <= 0) {
+                return Fail(error, name + ": barcode needs data and a positive module size");
+            }
+            if (field.barcode.rows == 1 && field.height <= 0) {
+                return Fail(error, name + ": linear barcode height must be positive");
+            }
+        } else {
+            if (field.imageWidth <= 0 || field.imageHeight <= 0 ||
+                field.pixels.size() < (size_t)field.imageWidth * field.imageHeight * 4) {
+                return Fail(error, name + ": image data does not match its width and height");
+            }
+            if (field.width <= 0 || field.height <= 0) {
+                return Fail(error, name + ": image width and height must be positive");
+            }
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<const MergeLayer> MergeTemplate::FindLayer(const LayerKey& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_layers.find(key);
+    if (found == m_layers.end()) {
+        return nullptr;
+    }
+    m_stats.layerHits++;
+    return found->second;
+}
+
+std::shared_ptr<const MergeLayer> MergeTemplate::StoreLayer(const LayerKey& key,
+                                                            const std::shared_ptr<const MergeLayer>& layer,
+                                                            double renderMs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.layersRendered++;
+    m_stats.staticMs += renderMs;
+    // Another job may have rendered the same layer meanwhile; keep the first
+    auto found = m_layers.find(key);
+    if (found != m_layers.end()) {
+        return found->second;
+    }
+    if (m_stats.cacheBytes + layer->pixels.size() <= kMaxCacheBytes) {
+        m_layers[key] = layer;
+        m_stats.cacheBytes += layer->pixels.size();
+    }
+    return layer;
+}
+
+// Take an empty overlay for the page (one per concurrent render) and add the
+// record's fields for that page
+PdfOverlay* MergeTemplate::AcquireOverlay(const MergeRecord& record, int pageIndex) {
+    PdfOverlay* overlay = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<PdfOverlay*>& idle = m_idleOverlays[pageIndex];
+        if (!idle.empty()) {
+            overlay = idle.back();
+            idle.pop_back();
+        }
+    }
+    if (!overlay) {
+        float width = 0;
+        float height = 0;
+        if (!GetPageSize(pageIndex, &width, &height)) {
+            return nullptr;
+        }
+        overlay = PdfiumWrapper::CreateOverlay(width, height);
+        if (!overlay) {
+            return nullptr;
+        }
+    }
+
+    for (const MergeField& field : record.fields) {
+        if (field.page != pageIndex || field.type == MERGE_BARCODE) {
+            continue;
+        }
+        bool added = field.type == MERGE_TEXT
+            ? PdfiumWrapper::AddOverlayText(overlay, field.x, field.y, field.text, field.font,
+                                            field.fontSize, field.color)
+            : PdfiumWrapper::AddOverlayImage(overlay, field.x, field.y, field.width, field.height,
+                                             field.pixels.data(), field.imageWidth, field.imageHeight,
+                                             field.imageWidth * 4);
+        if (!added) {
+            ReleaseOverlay(pageIndex, overlay);
+            return nullptr;
+        }
+    }
+    return overlay;
+}
+
+void MergeTemplate::ReleaseOverlay(int pageIndex, PdfOverlay* overlay) {
+    PdfiumWrapper::ClearOverlay(overlay);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_idleOverlays[pageIndex].push_back(overlay);
+}
+
+BitmapData* MergeTemplate::RenderPage(const MergeRecord& record, int pageIndex, int dpi, int rotation,
+                                      const RenderControl* control, RenderStatus* status) {
+    SetStatus(status, RENDER_FAILED);
+    if (pageIndex < 0 || pageIndex >= m_pageCount) {
+        return nullptr;
+    }
+    rotation &= 3;
+
+    LayerKey key(pageIndex, false, dpi, rotation, 0);
+    std::shared_ptr<const MergeLayer> layer = FindLayer(key);
+    if (!layer) {
+        Clock::time_point renderStart = Clock::now();
+        BitmapData* bitmap = PdfiumWrapper::RenderPageToBitmap(m_document, pageIndex, dpi, control, status, rotation);
+        if (!bitmap) {
+            return nullptr;
+        }
+        std::shared_ptr<MergeLayer> rendered = std::make_shared<MergeLayer>();
+        rendered->width = bitmap->width;
+        rendered->height = bitmap->height;
+        rendered->stride = bitmap->stride;
+        rendered->pixels.assign(bitmap->data, bitmap->data + (size_t)bitmap->stride * bitmap->height);
+        PdfiumWrapper::FreeBitmap(bitmap);
+        layer = StoreLayer(key, rendered, ElapsedMs(renderStart, Clock::now()));
+    }
+
+    // The fields are drawn onto a copy; the cached layer stays untouched
+    Clock::time_point overlayStart = Clock::now();
+    size_t bytes = (size_t)layer->stride * layer->height;
+    unsigned char* buffer = new (std::nothrow) unsigned char[bytes];
+    if (!buffer) {
+        return nullptr;
+    }
+    Metrics::CountAllocation(bytes);
+    memcpy(buffer, layer->pixels.data(), bytes);
+
+    PdfOverlay* overlay = AcquireOverlay(record, pageIndex);
+    bool drawn = overlay && PdfiumWrapper::RenderOverlay(overlay, buffer, layer->width, layer->height, layer->stride,
+                                                         false, 0, 0, layer->width, layer->height, rotation);
+    if (overlay) {
+        ReleaseOverlay(pageIndex, overlay);
+    }
+    if (!drawn) {
+        delete[] buffer;
+        return nullptr;
+    }
+    
+    BarcodeTarget target;
+    target.buffer = buffer;
+    target.width = layer->width;
+    target.height = layer->height;
+    target.stride = layer->stride;
+    target.gray = false;
+    target.pageWidth = (rotation & 1) ? layer->height : layer->width;
+    target.pageHeight = (rotation & 1) ? layer->width : layer->height;
+    target.rotation = rotation;
+    DrawBarcodes(record, pageIndex, dpi / 72.0, target);
+
+    BitmapData* result = new BitmapData();
+    result->data = buffer;
+    result->width = layer->width;
+    result->height = layer->height;
+    result->stride = layer->stride;
+    result->bitmapFormat = 0; // BGRA
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.pages++;
+        m_stats.overlayMs += ElapsedMs(overlayStart, Clock::now());
+    }
+    SetStatus(status, RENDER_OK);
+    return result;
+}
+
+bool MergeTemplate::RenderPageBands(const MergeRecord& record, int pageIndex, int bandWidth,
+                                    int pixelWidth, int pixelHeight, int bandHeight, const BandCallback& onBand,
+                                    const RenderControl* control, RenderStatus* status) {
+    SetStatus(status, RENDER_FAILED);
+    if (pageIndex < 0 || pageIndex >= m_pageCount || bandWidth <= 0 || pixelWidth <= 0 ||
+        pixelHeight <= 0 || bandHeight <= 0) {
+        return false;
+    }
+
+    LayerKey key(pageIndex, true, bandWidth, pixelWidth, pixelHeight);
+    std::shared_ptr<const MergeLayer> layer = FindLayer(key);
+    if (!layer) {
+        // One band covering the whole page gives the same pixels as the
+        // banded render, positioned the same way
+        Clock::time_point renderStart = Clock::now();
+        std::shared_ptr<MergeLayer> rendered = std::make_shared<MergeLayer>();
+        bool ok = PdfiumWrapper::RenderPageBands(m_document, pageIndex, bandWidth, pixelWidth, pixelHeight,
+                                                 pixelHeight,
+                                                 [&rendered, bandWidth](const unsigned char* gray, int stride,
+                                                                        int top, int rows) {
+                                                     (void)top;
+                                                     rendered->width = bandWidth;
+                                                     rendered->height = rows;
+                                                     rendered->stride = stride;
+                                                     rendered->pixels.assign(gray, gray + (size_t)stride * rows);
+                                                     return true;
+                                                 },
+                                                 control, status);
+        if (!ok) {
+            return false;
+        }
+        layer = StoreLayer(key, rendered, ElapsedMs(renderStart, Clock::now()));
+    }
+
+    Clock::time_point pageStart = Clock::now();
+    float pageWidth = 0;
+    float pageHeight = 0;
+    if (!GetPageSize(pageIndex, &pageWidth, &pageHeight) || pageWidth <= 0) {
+        return false;
+    }
+    PdfOverlay* overlay = AcquireOverlay(record, pageIndex);
+    if (!overlay) {
+        return false;
+    }
+
+    int stride = layer->stride;
+    std::vector<unsigned char> band((size_t)stride * bandHeight);
+    int offsetX = (bandWidth - pixelWidth) / 2;
+    BarcodeTarget target;
+    target.buffer = band.data();
+    target.width = bandWidth;
+    target.stride = stride;
+    target.gray = true;
+    target.originX = -offsetX;
+    target.pageWidth = pixelWidth;
+    target.pageHeight = pixelHeight;
+    double scale = pixelWidth / pageWidth;
+    double callbackMs = 0;
+    RenderStatus result = RENDER_OK;
+    for (int top = 0; top < pixelHeight; top += bandHeight) {
+        int rows = pixelHeight - top < bandHeight ? pixelHeight - top : bandHeight;
+        if (control) {
+            result = control->Check(pageStart);
+            if (result != RENDER_OK) {
+                break;
+            }
+        }
+
+        memcpy(band.data(), layer->pixels.data() + (size_t)top * stride, (size_t)rows * stride);
+        if (!PdfiumWrapper::RenderOverlay(overlay, band.data(), bandWidth, rows, stride, true,
+                                          offsetX, -top, pixelWidth, pixelHeight, 0)) {
+            result = RENDER_FAILED;
+            break;
+        }
+        target.height = rows;
+        target.originY = top;
+        DrawBarcodes(record, pageIndex, scale, target);
+
+        // As in RenderPageBands, the page budget does not count the callback
+        Clock::time_point callbackStart = Clock::now();
+        bool keepGoing = onBand(band.data(), stride, top, rows);
+        Clock::time_point callbackEnd = Clock::now();
+        pageStart += callbackEnd - callbackStart;
+        callbackMs += ElapsedMs(callbackStart, callbackEnd);
+        if (!keepGoing) {
+            result = RENDER_FAILED;
+            break;
+        }
+    }
+    ReleaseOverlay(pageIndex, overlay);
+
+    if (result == RENDER_OK) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.pages++;
+        m_stats.overlayMs += ElapsedMs(pageStart, Clock::now()) - callbackMs;
+    }
+    SetStatus(status, result);
+    return result == RENDER_OK;
+}
+
+MergeStats MergeTemplate::GetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+long long MergeTemplate::Register(const std::string& filePath, std::string* error) {
+    std::shared_ptr<MergeTemplate> opened = Open(filePath, error);
+    if (!opened) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(g_templatesMutex);
+    long long id = g_nextTemplateId++;
+    g_templates[id] = opened;
+    return id;
+}
+
+std::shared_ptr<MergeTemplate> MergeTemplate::Find(long long id) {
+    std::lock_guard<std::mutex> lock(g_templatesMutex);
+    auto found = g_templates.find(id);
+    return found == g_templates.end() ? nullptr : found->second;
+}
+
+bool MergeTemplate::Unregister(long long id) {
+    std::shared_ptr<MergeTemplate> removed;
+    {
+        std::lock_guard<std::mutex> lock(g_templatesMutex);
+        auto found = g_templates.find(id);
+        if (found == g_templates.end()) {
+            return false;
+        }
+        removed = found->second;
+        g_templates.erase(found);
+    }
+    // Closed here, outside the registry lock, unless a job still holds it
+    return true;
+}
+
+void MergeTemplate::UnregisterAll() {
+    std::map<long long, std::shared_ptr<MergeTemplate>> removed;
+    {
+        std::lock_guard<std::mutex> lock(g_templatesMutex);
+        removed.swap(g_templates);
+    }
+}
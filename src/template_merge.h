@@ -0,0 +1,179 @@
+#ifndef TEMPLATE_MERGE_H
+#define TEMPLATE_MERGE_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "barcode.h"
+#include "pdfium_win.h"
+
+/**
+ * 套打字段类型
+ */
+enum MergeFieldType {
+    MERGE_TEXT = 0,     // 文本
+    MERGE_IMAGE = 1,    // 图像（如签名、照片）
+    MERGE_BARCODE = 2   // 条码，不经过 pdfium，按设备分辨率直接写入像素
+};
+
+/**
+ * 套打字段
+ * 坐标以点为单位，相对模板页面左上角
+ */
+struct MergeField {
+    MergeFieldType type = MERGE_TEXT;
+    int page = 0;                    // 模板页面索引（从 0 开始）
+    float x = 0;                     // 文本基线起点 / 图像或条码左边
+    float y = 0;                     // 文本基线 / 图像或条码上边
+    std::string text;                // 文本（UTF-8 编码）
+    std::string font = "Helvetica";  // 标准 14 字体名称
+    float fontSize = 10;             // 字号（点）
+    unsigned int color = 0xFF000000;  // 文本颜色（0xAARRGGBB）
+    float width = 0;                 // 图像显示宽度（点）
+    float height = 0;                // 图像显示高度 / 一维条码条高（点）
+    int imageWidth = 0;              // 图像宽度（像素）
+    int imageHeight = 0;             // 图像高度（像素）
+    std::vector<unsigned char> pixels;  // 图像像素（BGRA，每行 imageWidth * 4 字节）
+    BarcodeSymbol barcode;           // 已编码的条码
+    float moduleSize = 1;            // 条码模块尺寸（点），渲染时取整为设备像素
+};
+
+/**
+ * 一条套打记录：模板每一页上的可变字段
+ */
+struct MergeRecord {
+    std::vector<MergeField> fields;
+};
+
+/**
+ * 套打统计
+ */
+struct MergeStats {
+    long long pages = 0;           // 已合成的页数
+    long long layersRendered = 0;  // 静态层渲染次数
+    long long layerHits = 0;       // 复用已缓存静态层的次数
+    size_t cacheBytes = 0;         // 静态层缓存占用
+    double staticMs = 0;           // 静态层渲染累计耗时
+    double overlayMs = 0;          // 复制静态层并绘制可变字段的累计耗时
+};
+
+struct MergeLayer;
+
+/**
+ * 套打模板
+ * 模板 PDF 只加载一次；每页的静态内容按输出分辨率渲染一次并缓存，
+ * 每条记录只把可变字段绘制到静态层的副本上，不再重新解析和渲染模板内容。
+ * 线程安全，同一模板可以同时用于多个作业
+ */
+class MergeTemplate {
+public:
+    ~MergeTemplate();
+
+    /**
+     * 打开模板
+     * @param filePath PDF 文件路径（UTF-8 编码）
+     * @param error 失败时输出错误描述
+     * @return 模板，失败返回空指针
+     */
+    static std::shared_ptr<MergeTemplate> Open(const std::string& filePath, std::string* error);
+
+    /**
+     * 获取模板页数
+     */
+    int PageCount() const { return m_pageCount; }
+
+    /**
+     * 获取模板页面尺寸
+     * @param pageIndex 页面索引（从 0 开始）
+     * @param width 输出页面宽度（点）
+     * @param height 输出页面高度（点）
+     * @return 成功返回 true
+     */
+    bool GetPageSize(int pageIndex, float* width, float* height) const;
+
+    /**
+     * 检查记录的字段能否绘制到模板上（页面索引、字体、图像和条码尺寸）
+     * @param record 记录
+     * @param error 失败时输出错误描述
+     * @return 有效返回 true
+     */
+    bool ValidateRecord(const MergeRecord& record, std::string* error) const;
+
+    /**
+     * 合成一条记录的一页，输出 BGRA 位图（GDI 打印）
+     * @param record 记录
+     * @param pageIndex 模板页面索引
+     * @param dpi 渲染分辨率
+     * @param rotation 顺时针旋转的 90° 次数（0-3）
+     * @param control 渲染控制（可为 nullptr），只作用于静态层的渲染
+     * @param status 输出渲染结果（可为 nullptr）
+     * @return 位图数据指针，失败返回 nullptr。使用完后需调用 PdfiumWrapper::FreeBitmap 释放
+     */
+    BitmapData* RenderPage(const MergeRecord& record, int pageIndex, int dpi, int rotation,
+                           const RenderControl* control, RenderStatus* status);
+
+    /**
+     * 合成一条记录的一页并按条带输出 8 位灰度（原始光栅打印）
+     * 参数与 PdfiumWrapper::RenderPageBands 相同
+     */
+    bool RenderPageBands(const MergeRecord& record, int pageIndex, int bandWidth,
+                         int pixelWidth, int pixelHeight, int bandHeight, const BandCallback& onBand,
+                         const RenderControl* control, RenderStatus* status);
+
+    /**
+     * 获取统计信息
+     */
+    MergeStats GetStats();
+
+    /**
+     * 打开模板并登记，之后通过 ID 引用
+     * @param filePath PDF 文件路径（UTF-8 编码）
+     * @param error 失败时输出错误描述
+     * @return 模板 ID，失败返回 0
+     */
+    static long long Register(const std::string& filePath, std::string* error);
+
+    /**
+     * 按 ID 查找已登记的模板
+     * @return 模板，不存在时返回空指针
+     */
+    static std::shared_ptr<MergeTemplate> Find(long long id);
+
+    /**
+     * 注销模板。使用该模板的作业持有自己的引用，结束后模板才真正关闭
+     * @return 模板存在返回 true
+     */
+    static bool Unregister(long long id);
+
+    /**
+     * 注销所有模板
+     */
+    static void UnregisterAll();
+
+private:
+    MergeTemplate() {}
+    MergeTemplate(const MergeTemplate&);
+    MergeTemplate& operator=(const MergeTemplate&);
+
+    // Cache key: (page, gray, dpi or band width, rotation or pixel width, pixel height)
+    typedef std::tuple<int, bool, int, int, int> LayerKey;
+
+    std::shared_ptr<const MergeLayer> FindLayer(const LayerKey& key);
+    std::shared_ptr<const MergeLayer> StoreLayer(const LayerKey& key, const std::shared_ptr<const MergeLayer>& layer,
+                                                 double renderMs);
+    PdfOverlay* AcquireOverlay(const MergeRecord& record, int pageIndex);
+    void ReleaseOverlay(int pageIndex, PdfOverlay* overlay);
+
+    PdfDocument* m_document = nullptr;
+    int m_pageCount = 0;
+    std::mutex m_mutex;
+    std::map<LayerKey, std::shared_ptr<const MergeLayer>> m_layers;
+    std::map<int, std::vector<PdfOverlay*>> m_idleOverlays;  // per template page
+    MergeStats m_stats;
+};
+
+#endif // TEMPLATE_MERGE_H
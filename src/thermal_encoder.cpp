@@ -0,0 +1,224 @@
+#include "thermal_encoder.h"
+#include <cstring>
+#include <string>
+
+static void AppendString(std::vector<unsigned char>& out, const std::string& text) {
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+RasterEncoder* RasterEncoder::Create(RasterLanguage language, bool cut, int dpi, int feedUnits) {
+    switch (language) {
+        case RASTER_ESCPOS:
+            return new EscPosEncoder(cut, dpi, feedUnits);
+        case RASTER_ZPL:
+            return new ZplEncoder();
+    }
+    return nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// ESC/POS
+
+void EscPosEncoder::BeginJob(std::vector<unsigned char>& out) {
+    // ESC @ - initialize printer
+    out.push_back(0x1B);
+    out.push_back(0x40);
+}
+
+void EscPosEncoder::BeginPage(std::vector<unsigned char>& out, int widthDots, int heightDots) {
+    (void)out;
+    (void)widthDots;
+    (void)heightDots;
+    m_feedRemainder = 0;
+}
+
+void EscPosEncoder::EncodeBand(std::vector<unsigned char>& out, const unsigned char* mono, int monoStride,
+                               int widthDots, int top, int rows) {
+    (void)top;
+    int bytesPerRow = (widthDots + 7) / 8;
+
+    // GS v 0 accepts at most 2303 rows per command on most printers
+    const int maxRows = 2303;
+    for (int y = 0; y < rows; y += maxRows) {
+        int count = rows - y < maxRows ? rows - y : maxRows;
+
+        // GS v 0 m xL xH yL yH d1...dk
+        unsigned char header[8] = {
+            0x1D, 0x76, 0x30, 0x00,
+            (unsigned char)(bytesPerRow & 0xFF), (unsigned char)((bytesPerRow >> 8) & 0xFF),
+            (unsigned char)(count & 0xFF), (unsigned char)((count >> 8) & 0xFF)
+        };
+        out.insert(out.end(), header, header + sizeof(header));
+
+        size_t offset = out.size();
+        out.resize(offset + (size_t)bytesPerRow * count);
+        for (int row = 0; row < count; row++) {
+            memcpy(&out[offset + (size_t)row * bytesPerRow], mono + (size_t)(y + row) * monoStride, bytesPerRow);
+        }
+    }
+}
+
+void EscPosEncoder::SkipRows(std::vector<unsigned char>& out, int top, int rows) {
+    (void)top;
+    // ESC J n - print buffer and feed n vertical motion units. Rows are
+    // converted to units exactly; the fraction left over is carried to the
+    // next feed on the page so that repeated gaps do not drift
+    long long scaled = (long long)rows * m_feedUnits + m_feedRemainder;
+    long long units = scaled / m_dpi;
+    m_feedRemainder = scaled % m_dpi;
+    while (units > 0) {
+        int count = units < 255 ? (int)units : 255;
+        out.push_back(0x1B);
+        out.push_back(0x4A);
+        out.push_back((unsigned char)count);
+        units -= count;
+    }
+}
+
+void EscPosEncoder::EndPage(std::vector<unsigned char>& out, int heightDots) {
+    (void)heightDots;
+    if (m_cut) {
+        // GS V 66 n - feed to cutting position and partial cut
+        unsigned char cut[4] = { 0x1D, 0x56, 0x42, 0x00 };
+        out.insert(out.end(), cut, cut + sizeof(cut));
+    }
+}
+
+void EscPosEncoder::EndJob(std::vector<unsigned char>& out) {
+    (void)out;
+}
+
+// ---------------------------------------------------------------------------
+// ZPL
+
+void ZplEncoder::BeginJob(std::vector<unsigned char>& out) {
+    (void)out;
+}
+
+void ZplEncoder::BeginPage(std::vector<unsigned char>& out, int widthDots, int heightDots) {
+    // Roll media: each band is emitted as its own format in EncodeBand
+    m_roll = heightDots == 0;
+    if (m_roll) {
+        return;
+    }
+    AppendString(out, "^XA\n^LH0,0\n^PW" + std::to_string(widthDots) + "\n");
+    if (heightDots > 0) {
+        AppendString(out, "^LL" + std::to_string(heightDots) + "\n");
+    }
+}
+
+void ZplEncoder::EncodeBand(std::vector<unsigned char>& out, const unsigned char* mono, int monoStride,
+                            int widthDots, int top, int rows) {
+    int bytesPerRow = (widthDots + 7) / 8;
+    std::string total = std::to_string(bytesPerRow * rows);
+
+    if (m_roll) {
+        // Continuous media (^MNN): formats print back to back without gaps
+        AppendString(out, "^XA\n^MNN\n^LH0,0\n^PW" + std::to_string(widthDots) +
+                          "\n^LL" + std::to_string(rows) + "\n");
+        top = 0;
+    }
+
+    // ^FOx,y^GFA,b,c,d,data^FS (b and c are both the uncompressed byte count)
+    AppendString(out, "^FO0," + std::to_string(top) + "^GFA," + total + "," + total + "," +
+                      std::to_string(bytesPerRow) + ",");
+    EncodeAcs(out, mono, monoStride, bytesPerRow, rows);
+    AppendString(out, "^FS\n");
+    if (m_roll) {
+        AppendString(out, "^XZ\n");
+    }
+}
+
+void ZplEncoder::SkipRows(std::vector<unsigned char>& out, int top, int rows) {
+    (void)top;
+    if (!m_roll) {
+        // Fields are placed with absolute ^FO offsets, the gap needs no data
+        return;
+    }
+    // An empty continuous-media format just advances the media
+    while (rows > 0) {
+        int count = rows < 32000 ? rows : 32000;
+        AppendString(out, "^XA\n^MNN\n^LL" + std::to_string(count) + "\n^XZ\n");
+        rows -= count;
+    }
+}
+
+void ZplEncoder::EndPage(std::vector<unsigned char>& out, int heightDots) {
+    (void)heightDots;
+    if (!m_roll) {
+        AppendString(out, "^XZ\n");
+    }
+}
+
+void ZplEncoder::EndJob(std::vector<unsigned char>& out) {
+    (void)out;
+}
+
+// Emit a run of `count` identical hex digits using ACS repeat characters:
+// G..Y = 1..19, g..z = 20..400 (multiples of 20); characters are additive.
+static void AppendAcsRun(std::vector<unsigned char>& out, char digit, int count) {
+    while (count > 0) {
+        int chunk = count > 419 ? 419 : count;
+        count -= chunk;
+        if (chunk == 1) {
+            out.push_back((unsigned char)digit);
+            continue;
+        }
+        if (chunk >= 20) {
+            out.push_back((unsigned char)('f' + chunk / 20));
+        }
+        if (chunk % 20) {
+            out.push_back((unsigned char)('F' + chunk % 20));
+        }
+        out.push_back((unsigned char)digit);
+    }
+}
+
+void ZplEncoder::EncodeAcs(std::vector<unsigned char>& out, const unsigned char* mono, int monoStride,
+                           int bytesPerRow, int rows) {
+    static const char kHex[] = "0123456789ABCDEF";
+    std::vector<char> digits((size_t)bytesPerRow * 2);
+
+    for (int y = 0; y < rows; y++) {
+        const unsigned char* row = mono + (size_t)y * monoStride;
+
+        // ':' repeats the previous row
+        if (y > 0 && memcmp(row, row - monoStride, bytesPerRow) == 0) {
+            out.push_back(':');
+            continue;
+        }
+
+        for (int i = 0; i < bytesPerRow; i++) {
+            digits[i * 2] = kHex[row[i] >> 4];
+            digits[i * 2 + 1] = kHex[row[i] & 0x0F];
+        }
+
+        // ',' fills the rest of the row with 0, '!' fills it with 1
+        int end = (int)digits.size();
+        char terminator = 0;
+        if (digits[end - 1] == '0' || digits[end - 1] == 'F') {
+            char tail = digits[end - 1];
+            int start = end;
+            while (start > 0 && digits[start - 1] == tail) {
+                start--;
+            }
+            if (end - start > 1) {
+                end = start;
+                terminator = tail == '0' ? ',' : '!';
+            }
+        }
+
+        int i = 0;
+        while (i < end) {
+            int j = i + 1;
+            while (j < end && digits[j] == digits[i]) {
+                j++;
+            }
+            AppendAcsRun(out, digits[i], j - i);
+            i = j;
+        }
+        if (terminator) {
+            out.push_back((unsigned char)terminator);
+        }
+    }
+}
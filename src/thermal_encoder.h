@@ -0,0 +1,131 @@
+#ifndef THERMAL_ENCODER_H
+#define THERMAL_ENCODER_H
+
+#include <vector>
+
+/**
+ * 原始打印机语言
+ */
+enum RasterLanguage {
+    RASTER_ESCPOS = 0,  // ESC/POS 热敏小票打印机（GS v 0 光栅）
+    RASTER_ZPL = 1      // Zebra ZPL 标签打印机（^GF 图形，ACS 压缩）
+};
+
+/**
+ * 单色光栅编码器
+ * 将按条带渲染的 1 位单色数据编码为打印机语言，输出追加到字节缓冲区。
+ * 单色数据按字节打包，最高位在左，1 表示打印（黑）
+ */
+class RasterEncoder {
+public:
+    virtual ~RasterEncoder() {}
+
+    /**
+     * 作业开始（打印机初始化命令）
+     */
+    virtual void BeginJob(std::vector<unsigned char>& out) = 0;
+
+    /**
+     * 页面（标签/小票）开始
+     * @param widthDots 打印宽度（点）
+     * @param heightDots 页面高度（点），0 表示连续卷纸（长度未知）
+     */
+    virtual void BeginPage(std::vector<unsigned char>& out, int widthDots, int heightDots) = 0;
+
+    /**
+     * 编码一个光栅条带
+     * @param mono 单色数据
+     * @param monoStride 每行字节数
+     * @param widthDots 条带宽度（点）
+     * @param top 条带在页面中的起始行
+     * @param rows 条带行数
+     */
+    virtual void EncodeBand(std::vector<unsigned char>& out, const unsigned char* mono, int monoStride,
+                            int widthDots, int top, int rows) = 0;
+
+    /**
+     * 跳过空白行，只走纸不发送光栅数据
+     * @param top 空白区域在页面中的起始行
+     * @param rows 空白行数
+     */
+    virtual void SkipRows(std::vector<unsigned char>& out, int top, int rows) = 0;
+
+    /**
+     * 页面结束（走纸、切纸或结束标签格式）
+     * @param heightDots 页面实际高度（点）
+     */
+    virtual void EndPage(std::vector<unsigned char>& out, int heightDots) = 0;
+
+    /**
+     * 作业结束
+     */
+    virtual void EndJob(std::vector<unsigned char>& out) = 0;
+
+    /**
+     * 创建指定语言的编码器
+     * @param language 打印机语言
+     * @param cut 每页结束后是否切纸（仅 ESC/POS）
+     * @param dpi 光栅分辨率（点/英寸）
+     * @param feedUnits 走纸命令每英寸的单位数（仅 ESC/POS 的 ESC J），0 表示与 dpi 相同
+     * @return 编码器指针，调用方负责 delete
+     */
+    static RasterEncoder* Create(RasterLanguage language, bool cut, int dpi, int feedUnits);
+};
+
+/**
+ * ESC/POS 编码器
+ * 每个条带输出一条 GS v 0 光栅位图命令，空白区域使用 ESC J 走纸。
+ * ESC J 的单位是打印机的纵向移动单位（常见 1/180 或 1/203 英寸），不一定是一个点行，
+ * 走纸距离按 feedUnits / dpi 换算，余数累计到下一次走纸
+ */
+class EscPosEncoder : public RasterEncoder {
+public:
+    EscPosEncoder(bool cut, int dpi, int feedUnits)
+        : m_cut(cut), m_dpi(dpi > 0 ? dpi : 203), m_feedUnits(feedUnits > 0 ? feedUnits : m_dpi) {}
+
+    void BeginJob(std::vector<unsigned char>& out) override;
+    void BeginPage(std::vector<unsigned char>& out, int widthDots, int heightDots) override;
+    void EncodeBand(std::vector<unsigned char>& out, const unsigned char* mono, int monoStride,
+                    int widthDots, int top, int rows) override;
+    void SkipRows(std::vector<unsigned char>& out, int top, int rows) override;
+    void EndPage(std::vector<unsigned char>& out, int heightDots) override;
+    void EndJob(std::vector<unsigned char>& out) override;
+
+private:
+    bool m_cut;
+    int m_dpi;
+    int m_feedUnits;
+    long long m_feedRemainder = 0;  // 本页尚未走出的余量（以 1/dpi 个走纸单位计）
+};
+
+/**
+ * ZPL 编码器
+ * 每页一个 ^XA...^XZ 标签格式，每个条带一个 ^GFA 字段，数据使用 ACS（ASCII 压缩十六进制）。
+ * 连续卷纸模式下每个条带单独成为一个连续介质（^MNN）格式，无需预先知道总长度。
+ * 空白区域不输出字段（后续字段使用 ^FO 绝对定位），卷纸模式下输出空格式走纸
+ */
+class ZplEncoder : public RasterEncoder {
+public:
+    void BeginJob(std::vector<unsigned char>& out) override;
+    void BeginPage(std::vector<unsigned char>& out, int widthDots, int heightDots) override;
+    void EncodeBand(std::vector<unsigned char>& out, const unsigned char* mono, int monoStride,
+                    int widthDots, int top, int rows) override;
+    void SkipRows(std::vector<unsigned char>& out, int top, int rows) override;
+    void EndPage(std::vector<unsigned char>& out, int heightDots) override;
+    void EndJob(std::vector<unsigned char>& out) override;
+
+    /**
+     * 将单色数据编码为 ACS 格式（追加到 out）
+     * @param mono 单色数据
+     * @param monoStride 每行字节数
+     * @param bytesPerRow 每行有效字节数
+     * @param rows 行数
+     */
+    static void EncodeAcs(std::vector<unsigned char>& out, const unsigned char* mono, int monoStride,
+                          int bytesPerRow, int rows);
+
+private:
+    bool m_roll = false;
+};
+
+#endif // THERMAL_ENCODER_H
@@ -0,0 +1,199 @@
+#include "trace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct TraceEvent {
+    const char* name;
+    const char* argName;
+    long long arg;
+    Clock::time_point start;
+    Clock::time_point end;
+};
+
+// Written only by its own thread. count is published with release order after
+// the event is filled in, so Stop reads every event below it complete; events
+// a thread adds after Stop took the count are simply not exported.
+struct ThreadBuffer {
+    int tid = 0;
+    std::string threadName;
+    unsigned generation = 0;
+    std::unique_ptr<TraceEvent[]> events;
+    size_t capacity = 0;
+    std::atomic<size_t> count{0};
+    std::atomic<long long> dropped{0};
+};
+
+static std::atomic<bool> g_traceActive(false);
+static std::atomic<unsigned> g_traceGeneration(0);
+static std::atomic<int> g_nextThreadId(1);
+// Buffers are only registered and collected under the mutex
+static std::mutex g_traceMutex;
+static TraceConfig g_traceConfig;
+static Clock::time_point g_traceOrigin;
+static std::vector<std::shared_ptr<ThreadBuffer>> g_traceBuffers;
+
+// The shared pointer keeps a buffer alive for a thread still writing to it
+// after Stop has handed it off
+static thread_local std::shared_ptr<ThreadBuffer> t_buffer;
+static thread_local std::string t_threadName;
+static thread_local int t_threadId = 0;
+
+static ThreadBuffer* RegisterThread(unsigned generation) {
+    std::lock_guard<std::mutex> lock(g_traceMutex);
+    if (!g_traceActive.load(std::memory_order_relaxed) ||
+        g_traceGeneration.load(std::memory_order_relaxed) != generation) {
+        return nullptr;
+    }
+    if (t_threadId == 0) {
+        t_threadId = g_nextThreadId.fetch_add(1);
+    }
+    std::shared_ptr<ThreadBuffer> buffer = std::make_shared<ThreadBuffer>();
+    buffer->tid = t_threadId;
+    buffer->threadName = t_threadName.empty() ? "thread " + std::to_string(t_threadId) : t_threadName;
+    buffer->generation = generation;
+    buffer->capacity = g_traceConfig.maxEventsPerThread;
+    buffer->events.reset(new TraceEvent[buffer->capacity]);
+    g_traceBuffers.push_back(buffer);
+    t_buffer = buffer;
+    return buffer.get();
+}
+
+void Tracing::Start(const TraceConfig& config) {
+    std::lock_guard<std::mutex> lock(g_traceMutex);
+    g_traceBuffers.clear();
+    g_traceConfig = config;
+    if (g_traceConfig.maxEventsPerThread == 0) {
+        g_traceConfig.maxEventsPerThread = 1;
+    }
+    g_traceOrigin = Clock::now();
+    g_traceGeneration.fetch_add(1, std::memory_order_release);
+    g_traceActive.store(true, std::memory_order_release);
+}
+
+bool Tracing::IsActive() {
+    return g_traceActive.load(std::memory_order_relaxed);
+}
+
+void Tracing::Complete(const char* name, TimePoint start, TimePoint end, const char* argName, long long arg) {
+    if (!IsActive()) {
+        return;
+    }
+    unsigned generation = g_traceGeneration.load(std::memory_order_acquire);
+    ThreadBuffer* buffer = t_buffer.get();
+    if (!buffer || buffer->generation != generation) {
+        buffer = RegisterThread(generation);
+        if (!buffer) {
+            return;
+        }
+    }
+    size_t index = buffer->count.load(std::memory_order_relaxed);
+    if (index >= buffer->capacity) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceEvent& event = buffer->events[index];
+    event.name = name;
+    event.argName = argName;
+    event.arg = arg;
+    event.start = start;
+    event.end = end;
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void Tracing::SetThreadName(const std::string& name) {
+    t_threadName = name;
+}
+
+static long long ProcessId() {
+#ifdef _WIN32
+    return (long long)GetCurrentProcessId();
+#else
+    return (long long)getpid();
+#endif
+}
+
+static double Microseconds(Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// Names are string constants from this code base or thread names set by it,
+// so they need no JSON escaping beyond quotes and backslashes
+static void AppendString(std::string* out, const std::string& text) {
+    out->push_back('"');
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out->push_back('\\');
+        }
+        out->push_back(c);
+    }
+    out->push_back('"');
+}
+
+std::string Tracing::Stop(long long* droppedEvents) {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    Clock::time_point origin;
+    {
+        std::lock_guard<std::mutex> lock(g_traceMutex);
+        if (!g_traceActive.load(std::memory_order_relaxed)) {
+            if (droppedEvents) {
+                *droppedEvents = 0;
+            }
+            return std::string();
+        }
+        g_traceActive.store(false, std::memory_order_release);
+        buffers.swap(g_traceBuffers);
+        origin = g_traceOrigin;
+    }
+
+    long long pid = ProcessId();
+    long long dropped = 0;
+    std::string out;
+    out.reserve(256 * 1024);
+    out.append("{\"traceEvents\":[");
+    char line[256];
+    snprintf(line, sizeof(line),
+             "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lld,\"tid\":0,\"args\":{\"name\":\"pdfprint\"}}", pid);
+    out.append(line);
+    for (const std::shared_ptr<ThreadBuffer>& buffer : buffers) {
+        snprintf(line, sizeof(line), ",{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lld,\"tid\":%d,\"args\":{\"name\":",
+                 pid, buffer->tid);
+        out.append(line);
+        AppendString(&out, buffer->threadName);
+        out.append("}}");
+
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < count; i++) {
+            const TraceEvent& event = buffer->events[i];
+            snprintf(line, sizeof(line),
+                     ",{\"name\":\"%s\",\"cat\":\"pdfprint\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lld,\"tid\":%d",
+                     event.name, Microseconds(event.start - origin), Microseconds(event.end - event.start), pid,
+                     buffer->tid);
+            out.append(line);
+            if (event.argName) {
+                snprintf(line, sizeof(line), ",\"args\":{\"%s\":%lld}", event.argName, event.arg);
+                out.append(line);
+            }
+            out.push_back('}');
+        }
+    }
+    snprintf(line, sizeof(line), "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":%lld}}", dropped);
+    out.append(line);
+    if (droppedEvents) {
+        *droppedEvents = dropped;
+    }
+    return out;
+}
@@ -0,0 +1,88 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/**
+ * 跟踪配置
+ */
+struct TraceConfig {
+    size_t maxEventsPerThread = 65536;  // 每个线程最多记录的事件数，超过后丢弃并计数
+};
+
+/**
+ * 时间线跟踪，输出 Chrome Trace Event 格式（chrome://tracing 和 Perfetto 均可打开）
+ * 每个线程写自己的事件缓冲区，记录事件不加锁；只有线程在一次跟踪中第一次记录时登记缓冲区。
+ * 事件名和参数名必须是字符串常量。线程安全
+ */
+class Tracing {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    /**
+     * 开始跟踪，丢弃上一次未取出的事件
+     * @param config 配置
+     */
+    static void Start(const TraceConfig& config);
+
+    /**
+     * 结束跟踪
+     * @param droppedEvents 输出因缓冲区已满而丢弃的事件数（可为 nullptr）
+     * @return Chrome Trace Event JSON（对象格式，事件在 traceEvents 中）；未在跟踪时返回空字符串
+     */
+    static std::string Stop(long long* droppedEvents);
+
+    /**
+     * 是否正在跟踪
+     */
+    static bool IsActive();
+
+    /**
+     * 记录一个有起止时间的事件（未在跟踪时忽略）
+     * @param name 事件名（字符串常量）
+     * @param start 开始时间
+     * @param end 结束时间
+     * @param argName 参数名（字符串常量，可为 nullptr）
+     * @param arg 参数值，如页面索引或作业 ID
+     */
+    static void Complete(const char* name, TimePoint start, TimePoint end, const char* argName = nullptr,
+                         long long arg = 0);
+
+    /**
+     * 设置当前线程在时间线中显示的名称
+     */
+    static void SetThreadName(const std::string& name);
+};
+
+/**
+ * 跟踪范围：构造时开始，析构时记录一个事件。构造时未在跟踪则不读取时钟
+ */
+class TraceScope {
+public:
+    TraceScope(const char* name, const char* argName = nullptr, long long arg = 0)
+        : m_name(name), m_argName(argName), m_arg(arg), m_active(Tracing::IsActive()) {
+        if (m_active) {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceScope() {
+        if (m_active) {
+            Tracing::Complete(m_name, m_start, std::chrono::steady_clock::now(), m_argName, m_arg);
+        }
+    }
+
+private:
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+    const char* m_name;
+    const char* m_argName;
+    long long m_arg;
+    bool m_active;
+    Tracing::TimePoint m_start;
+};
+
+#endif // TRACE_H
@@ -0,0 +1,44 @@
+#include "util.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+double ElapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+bool Fail(std::string* error, const std::string& message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+void SetStatus(RenderStatus* status, RenderStatus value) {
+    if (status) {
+        *status = value;
+    }
+}
+
+#ifdef _WIN32
+std::wstring Utf8ToWide(const std::string& text) {
+    if (text.empty()) {
+        return std::wstring();
+    }
+    int length = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), (int)text.size(), nullptr, 0);
+    std::wstring result(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, text.c_str(), (int)text.size(), &result[0], length);
+    return result;
+}
+
+std::string WideToUtf8(const std::wstring& text) {
+    if (text.empty()) {
+        return std::string();
+    }
+    int length = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), nullptr, 0, nullptr, nullptr);
+    std::string result(length, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), &result[0], length, nullptr, nullptr);
+    return result;
+}
+#endif
@@ -0,0 +1,43 @@
+#ifndef UTIL_H
+#define UTIL_H
+
+#include <chrono>
+#include <string>
+#include "pdfium_win.h"
+
+/**
+ * 计算两个时间点之间的毫秒数
+ * @param from 开始时间
+ * @param to 结束时间
+ * @return 毫秒数
+ */
+double ElapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to);
+
+/**
+ * 输出错误描述并返回 false，便于 return Fail(error, "...")
+ * @param error 错误描述输出，可为 nullptr
+ * @param message 错误描述
+ * @return 始终返回 false
+ */
+bool Fail(std::string* error, const std::string& message);
+
+/**
+ * 输出渲染状态
+ * @param status 状态输出，可为 nullptr
+ * @param value 状态
+ */
+void SetStatus(RenderStatus* status, RenderStatus value);
+
+#ifdef _WIN32
+/**
+ * UTF-8 字符串转换为 UTF-16（Windows API 使用）
+ */
+std::wstring Utf8ToWide(const std::string& text);
+
+/**
+ * UTF-16 字符串转换为 UTF-8
+ */
+std::string WideToUtf8(const std::wstring& text);
+#endif
+
+#endif // UTIL_H
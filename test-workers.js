@@ -0,0 +1,179 @@
+const { Worker, isMainThread, parentPort, workerData } = require("worker_threads");
+const crypto = require("crypto");
+const os = require("os");
+const path = require("path");
+const fs = require("fs");
+const pdfprint = require("./index.js");
+
+/**
+ * 测试在多个 worker_threads 中同时加载模块并渲染，
+ * 以及 isolate 渲染进程池在多核上的扩展
+ * 不需要打印机
+ */
+
+const DPI = 100;
+
+function hashPage(page) {
+  return crypto.createHash("sha1").update(Buffer.from(page.data)).digest("hex");
+}
+
+// worker 的结果必须覆盖分给它的每一页，且与主线程渲染结果一致
+function checkResult(result, pages, reference) {
+  if (result.hashes.length !== pages.length) {
+    throw new Error(`worker 返回 ${result.hashes.length} 页，应为 ${pages.length} 页`);
+  }
+  pages.forEach((index, i) => {
+    if (result.hashes[i] !== reference[index]) {
+      throw new Error(`第 ${index + 1} 页渲染结果与主线程不一致`);
+    }
+  });
+}
+
+// 在当前线程渲染指定页面，返回各页哈希
+function renderPages(filePath, pages) {
+  const id = pdfprint.openDocument(filePath);
+  try {
+    return pages.map((index) => hashPage(pdfprint.renderPage(id, index, { dpi: DPI })));
+  } finally {
+    pdfprint.closeDocument(id);
+  }
+}
+
+if (!isMainThread) {
+  const start = process.hrtime.bigint();
+  const hashes = renderPages(workerData.filePath, workerData.pages);
+  const ms = Number(process.hrtime.bigint() - start) / 1e6;
+  parentPort.postMessage({ pages: workerData.pages, hashes, ms });
+  return;
+}
+
+function runWorker(filePath, pages) {
+  return new Promise((resolve, reject) => {
+    const worker = new Worker(__filename, { workerData: { filePath, pages } });
+    worker.once("message", resolve);
+    worker.once("error", reject);
+    worker.once("exit", (code) => {
+      // 已经收到结果时 reject 不起作用；没有结果就退出也算失败
+      reject(new Error(`worker 退出码 ${code}，未返回结果`));
+    });
+  });
+}
+
+// 把页面轮流分给 count 个 worker，同时渲染，返回总耗时
+async function runSplit(filePath, pageCount, count, reference) {
+  const shares = Array.from({ length: count }, () => []);
+  for (let i = 0; i < pageCount; i++) {
+    shares[i % count].push(i);
+  }
+  const start = process.hrtime.bigint();
+  const used = shares.filter((pages) => pages.length);
+  const results = await Promise.all(used.map((pages) => runWorker(filePath, pages)));
+  const ms = Number(process.hrtime.bigint() - start) / 1e6;
+  results.forEach((result, i) => checkResult(result, used[i], reference));
+  return ms;
+}
+
+function hashFile(filePath) {
+  return crypto.createHash("sha1").update(fs.readFileSync(filePath)).digest("hex");
+}
+
+// 提交 jobs 个 raw 作业，各写一个文件，返回总耗时；每个文件必须与 expected 相同
+async function runIsolated(filePath, jobs, isolate, outputDir, expected) {
+  const start = process.hrtime.bigint();
+  const outputs = Array.from({ length: jobs }, (_, i) => path.join(outputDir, `job-${i}.bin`));
+  await Promise.all(
+    outputs.map((file) => pdfprint.submitJob(filePath, { mode: "raw", file, isolate, preflight: false }).done)
+  );
+  const ms = Number(process.hrtime.bigint() - start) / 1e6;
+  if (expected) {
+    outputs.forEach((file, i) => {
+      if (hashFile(file) !== expected) {
+        throw new Error(`isolate 作业 ${i + 1} 的输出与进程内渲染不一致`);
+      }
+    });
+  }
+  return { ms, hash: hashFile(outputs[0]) };
+}
+
+async function main() {
+  const testPdfPath = process.argv[2] || "test.pdf";
+  const threads = Number(process.argv[3]) || 8;
+
+  console.log("==========================================");
+  console.log("worker_threads 并发渲染测试");
+  console.log("==========================================");
+
+  if (!fs.existsSync(testPdfPath)) {
+    console.error(`\n❌ 错误: PDF 文件不存在: ${testPdfPath}`);
+    console.log("\n使用方法: node test-workers.js [pdf文件路径] [线程数]");
+    process.exit(1);
+  }
+  const filePath = path.resolve(testPdfPath);
+  console.log(`\n📄 测试文件: ${filePath}`);
+
+  // 测试 1: 主线程渲染参考结果
+  console.log(`\n[测试 1] 主线程渲染所有页面 (${DPI} DPI)...`);
+  const { pageCount } = (() => {
+    const id = pdfprint.openDocument(filePath);
+    try {
+      return pdfprint.getDocumentInfo(id);
+    } finally {
+      pdfprint.closeDocument(id);
+    }
+  })();
+  const all = Array.from({ length: pageCount }, (_, i) => i);
+  const reference = renderPages(filePath, all);
+  console.log(`✅ ${pageCount} 页`);
+
+  // 测试 2: 每个 worker 渲染全部页面，结果必须与主线程一致
+  console.log(`\n[测试 2] ${threads} 个 worker 同时渲染全部页面...`);
+  const results = await Promise.all(Array.from({ length: threads }, () => runWorker(filePath, all)));
+  if (results.length !== threads) {
+    throw new Error(`只收到 ${results.length} 个 worker 的结果`);
+  }
+  results.forEach((result) => checkResult(result, all, reference));
+  console.log(`✅ ${threads} 个 worker 的结果与主线程一致`);
+
+  // 测试 3: 页面分给 1、2、4…个 worker，比较耗时
+  console.log("\n[测试 3] 按 worker 数拆分页面...");
+  const baseline = await runSplit(filePath, pageCount, 1, reference);
+  console.log(`   1 个 worker: ${baseline.toFixed(1)} ms`);
+  for (let count = 2; count <= threads; count *= 2) {
+    const ms = await runSplit(filePath, pageCount, count, reference);
+    console.log(`   ${count} 个 worker: ${ms.toFixed(1)} ms (加速 ${(baseline / ms).toFixed(2)}x)`);
+  }
+  console.log("   注意: pdfium 不是线程安全的，同一进程内的渲染调用由全局锁串行执行，");
+  console.log("   worker_threads 不能让渲染本身并行，加速只来自哈希等 JS 侧处理");
+
+  // 测试 4: isolate 作业在各自的渲染进程中渲染，可以用满多个核
+  console.log(`\n[测试 4] isolate 渲染进程: 1 个与 ${threads} 个进程各完成 ${threads} 个作业...`);
+  const outputDir = fs.mkdtempSync(path.join(os.tmpdir(), "pdfprint-workers-"));
+  try {
+    pdfprint.configureScheduler({ workers: threads });
+    const inProcess = await runIsolated(filePath, 1, false, outputDir, null);
+    pdfprint.configureRenderPool({ processes: 1 });
+    const single = await runIsolated(filePath, threads, true, outputDir, inProcess.hash);
+    console.log(`   1 个进程: ${single.ms.toFixed(1)} ms`);
+    pdfprint.configureRenderPool({ processes: threads });
+    const multi = await runIsolated(filePath, threads, true, outputDir, inProcess.hash);
+    const speedup = single.ms / multi.ms;
+    console.log(`   ${threads} 个进程: ${multi.ms.toFixed(1)} ms (加速 ${speedup.toFixed(2)}x)`);
+    // 计时受机器负载影响，只要求多进程明显快于单进程
+    if (os.cpus().length >= 2 && threads >= 2 && speedup < 1.2) {
+      throw new Error(`${threads} 个渲染进程没有比 1 个进程更快 (${speedup.toFixed(2)}x)`);
+    }
+    console.log(`✅ ${threads * 2} 个 isolate 作业的输出与进程内渲染一致`);
+  } finally {
+    fs.rmSync(outputDir, { recursive: true, force: true });
+  }
+
+  console.log("\n==========================================");
+  console.log("✅ 所有测试通过!");
+  console.log("==========================================");
+}
+
+main().catch((error) => {
+  console.error("\n❌ 测试过程中发生错误:");
+  console.error(error);
+  process.exit(1);
+});